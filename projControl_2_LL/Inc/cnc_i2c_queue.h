@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * @file    cnc_i2c_queue.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Prioritized I2C transaction scheduler on top of cnc_ll_i2c
+ *          asynchronous transfers.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - One queue per I2C peripheral, selected by the I2Cx argument: the buses
+    run their transactions independently.
+  - Fixed capacity queue (I2C_QUEUE_SIZE descriptors), no dynamic memory.
+  - Lowest Priority value goes first. Same priority: first submitted first.
+  - A pending transaction that was overtaken I2C_QUEUE_AGING_MAX times is
+    promoted to I2C_QUEUE_PRIORITY_CONTROL, so housekeeping never starves.
+  - Callbacks are called from interrupt context.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef CNC_I2C_QUEUE_H_
+#define CNC_I2C_QUEUE_H_
+
+//Includes =====================================================================
+#include "cnc_ll_i2c.h"
+
+// Enum & structs ==============================================================
+typedef enum
+{
+  I2C_QUEUE_PRIORITY_CONTROL = 0,     /*!< Control loop sensor reads */
+  I2C_QUEUE_PRIORITY_NORMAL,
+  I2C_QUEUE_PRIORITY_HOUSEKEEPING,    /*!< Configuration, EEPROM, etc. */
+} i2c_priority_t;
+
+typedef enum
+{
+  I2C_QUEUE_READ = 0,
+  I2C_QUEUE_WRITE,
+} i2c_direction_t;
+
+/*!< status: 1 if successful, 0 if fail. */
+typedef void (*cncI2CQueue_callback_t)(void *pContext, uint8_t status);
+
+typedef struct
+{
+  uint8_t DevAddr;                    /*!< 7 bits device's address */
+  uint8_t RegAddr;
+  uint8_t *pData;
+  uint8_t Count;
+  i2c_direction_t Direction;
+  i2c_priority_t Priority;
+  uint32_t TimeoutUs;                 /*!< Deadline. 0: I2C_TIMEOUT_DEFAULT_US */
+  cncI2CQueue_callback_t Callback;
+  void *pContext;                     /*!< Passed back to Callback */
+} i2c_transaction_t;
+
+typedef struct
+{
+  uint8_t DevAddr;
+  uint32_t Transactions;
+  uint32_t Errors;
+  uint32_t BusCycles;                 /*!< Accumulated DWT cycles on the bus */
+  uint32_t MaxBusCycles;
+  uint32_t MaxWaitCycles;             /*!< Worst submit to start latency */
+} i2c_devStats_t;
+
+// Constants ===================================================================
+#define I2C_QUEUE_SIZE          8
+#define I2C_QUEUE_MAX_DEVICES   4
+#define I2C_QUEUE_AGING_MAX     4
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the transaction queue of a bus. cncI2C_InitDMA() must be called
+ *          first.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if successful. 0 if the instance is not supported.
+ ******************************************************************************/
+uint8_t cncI2CQueue_init(I2C_TypeDef *I2Cx);
+/*******************************************************************************
+ * @brief   Queue a transaction. The descriptor is copied, pData must remain
+ *          valid until the callback.
+ * @param   I2Cx: I2C instance.
+ * @param   pTransaction: transaction descriptor.
+ * @retval  1 if queued. 0 if the queue is full or not initialized.
+ ******************************************************************************/
+uint8_t cncI2CQueue_submit(I2C_TypeDef *I2Cx, i2c_transaction_t *pTransaction);
+/*******************************************************************************
+ * @brief   Start the next pending transaction if the bus is idle. Called by
+ *          submit and on completion; call it periodically to retry after a
+ *          busy bus (e.g. blocking cncI2C_* calls) and to abort a transfer
+ *          past its deadline.
+ * @param   I2Cx: I2C instance.
+ * @retval  None.
+ ******************************************************************************/
+void cncI2CQueue_process(I2C_TypeDef *I2Cx);
+/*******************************************************************************
+ * @brief   Number of pending (not yet started) transactions.
+ * @param   I2Cx: I2C instance.
+ * @retval  Pending transactions.
+ ******************************************************************************/
+uint8_t cncI2CQueue_getPending(I2C_TypeDef *I2Cx);
+/*******************************************************************************
+ * @brief   Pending transactions with none on the bus: the previous completion
+ *          did not start the next one (e.g. a blocking transfer held the
+ *          bus). cncI2CQueue_process() restarts them.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if stalled. 0 if not.
+ ******************************************************************************/
+uint8_t cncI2CQueue_isStalled(I2C_TypeDef *I2Cx);
+/*******************************************************************************
+ * @brief   Bus time statistics of a device.
+ * @param   I2Cx: I2C instance.
+ * @param   devAddr: 7 bits device's address.
+ * @param   pStats: statistics output.
+ * @retval  1 if the device has statistics. 0 if unknown.
+ ******************************************************************************/
+uint8_t cncI2CQueue_getStats(I2C_TypeDef *I2Cx, uint8_t devAddr,
+                             i2c_devStats_t *pStats);
+
+#endif /* CNC_I2C_QUEUE_H_ */
+// EOF =========================================================================
@@ -26,11 +26,91 @@
 
 #include "stm32f4xx_ll_i2c.h"
 #include "stm32f4xx_ll_gpio.h"
+#include "stm32f4xx_ll_dma.h"
 
 // Enum & structs ==============================================================
 // TODO: Replace funcion returns with enum I2C_STATE
 
+/*!< Asynchronous transfer done. pContext: as given to the transfer.
+ *   status: 1 if successful, 0 if fail. */
+typedef void (*cncI2C_callback_t)(void *pContext, uint8_t status);
+
+typedef struct
+{
+  GPIO_TypeDef *GPIO_PORT_SCL;
+  uint32_t GPIO_PIN_SCL;
+  GPIO_TypeDef *GPIO_PORT_SDA;
+  uint32_t GPIO_PIN_SDA;
+  uint32_t GPIO_ALTERNATE;
+  uint32_t GPIO_CLOCK;                /*!< LL_AHB1_GRP1_PERIPH_GPIOx mask */
+  uint32_t I2C_CLOCK;                 /*!< LL_APB1_GRP1_PERIPH_I2Cx */
+} i2c_gpio_t;
+
+typedef struct
+{
+  DMA_TypeDef *DMAx;
+  uint32_t STREAM_RX;
+  uint32_t STREAM_TX;
+  uint32_t CHANNEL;
+  IRQn_Type IRQ_RX;
+  IRQn_Type IRQ_TX;
+} i2c_dma_t;
+
+typedef enum
+{
+  I2C_ASYNC_IDLE = 0,
+  I2C_ASYNC_START_W,
+  I2C_ASYNC_ADDR_W,
+  I2C_ASYNC_REG,
+  I2C_ASYNC_START_R,
+  I2C_ASYNC_ADDR_R,
+  I2C_ASYNC_DATA_RX,
+  I2C_ASYNC_DATA_RX_SINGLE,
+  I2C_ASYNC_DATA_TX,
+  I2C_ASYNC_WAIT_BTF,
+  I2C_ASYNC_RECOVER,                  /*!< Aborted, bus recovery running */
+} i2c_async_state_t;
+
+typedef struct
+{
+  volatile i2c_async_state_t state;
+  uint8_t devAddr;
+  uint8_t regAddr;
+  uint8_t *pData;
+  uint8_t count;
+  uint8_t mode;
+  cncI2C_callback_t callback;
+  void *pContext;                     /*!< Passed back to callback */
+} i2c_async_t;
+
+/*!< Per-instance driver context. One static handle per I2C peripheral. */
+typedef struct
+{
+  I2C_TypeDef *Instance;
+  const i2c_gpio_t *pGpio;
+  const i2c_dma_t *pDma;
+  IRQn_Type IRQ_EV;
+  IRQn_Type IRQ_ER;
+  uint32_t Frequency;                 /*!< SCL clock, kept for re-init */
+  uint32_t TimeoutCycles;             /*!< Transaction deadline [DWT cycles] */
+  uint32_t StartCycles;               /*!< DWT->CYCCNT at transaction start */
+  __IO uint32_t TimeoutCount;         /*!< Transactions past the deadline */
+  __IO uint32_t ErrorCount;           /*!< NACKed or aborted transactions */
+  __IO uint32_t RecoveryCount;        /*!< Bus recovery sequences issued */
+  i2c_async_t Async;
+} cncI2C_handle_t;
+
+// Constants ===================================================================
+#define I2C_TIMEOUT_DEFAULT_US  2000  /*!< 14 bytes at 400 kHz take ~400 us */
+#define I2C_STOP_WAIT_BITS      20    /*!< Last byte + STOP, 50 us at 400 kHz */
+
 // Public functions ============================================================
+/*******************************************************************************
+ * @brief   Driver context of an I2C instance.
+ * @param   I2Cx: I2C instance (I2C1, I2C2 or I2C3).
+ * @retval  Handle. 0 if the instance is not supported.
+ ******************************************************************************/
+cncI2C_handle_t *cncI2C_getHandle(I2C_TypeDef *I2Cx);
 /*******************************************************************************
  * @brief   Init I2C bus.
  * @param   I2Cx: I2C instance.
@@ -75,10 +155,78 @@ uint8_t cncI2C_ReadByte(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData);
  * @param   I2Cx: I2C instance.
  * @param   pDev: pDev[0]: 7 bits device's address. pDev[1]: register address.
  * @param   pData: pointer to data array to store bytes from slave.
+ * @param   count: number of bytes to be read.
  * @retval  1 if successful. 0 if fail.
+ * @note    Burst read in a single transaction (register auto-increment).
  ******************************************************************************/
 uint8_t cncI2C_ReadMultipleBytes(
     I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData, uint8_t count);
+/*******************************************************************************
+ * @brief   Init DMA streams and interrupts for asynchronous transfers.
+ * @param   I2Cx: I2C instance. DMA1 streams:
+ *          I2C1: Stream0 (RX) / Stream6 (TX), Channel 1.
+ *          I2C2: Stream3 (RX) / Stream7 (TX), Channel 7.
+ *          I2C3: Stream2 (RX) / Stream4 (TX), Channel 3.
+ * @retval  1 if successful. 0 if fail.
+ ******************************************************************************/
+uint8_t cncI2C_InitDMA(I2C_TypeDef *I2Cx);
+/*******************************************************************************
+ * @brief   Start a non-blocking register read (I2C events + DMA).
+ * @param   I2Cx: I2C instance.
+ * @param   pDev: pDev[0]: 7 bits device's address. pDev[1]: register address.
+ * @param   pData: buffer for the bytes from slave. Valid after callback.
+ * @param   count: number of bytes to be read.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncI2C_ReadAsync(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData,
+                         uint8_t count, cncI2C_callback_t callback,
+                         void *pContext);
+/*******************************************************************************
+ * @brief   Start a non-blocking register write (I2C events + DMA).
+ * @param   I2Cx: I2C instance.
+ * @param   pDev: pDev[0]: 7 bits device's address. pDev[1]: register address.
+ * @param   pData: bytes to be written. Must remain valid until callback.
+ * @param   count: number of bytes to be written.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncI2C_WriteAsync(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData,
+                          uint8_t count, cncI2C_callback_t callback,
+                          void *pContext);
+/*******************************************************************************
+ * @brief   Check if an asynchronous transfer is in progress.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if busy. 0 if idle.
+ ******************************************************************************/
+uint8_t cncI2C_isBusyAsync(I2C_TypeDef *I2Cx);
+
+/*******************************************************************************
+ * @brief   Set the deadline of the next transactions (blocking and async).
+ * @param   I2Cx: I2C instance.
+ * @param   timeout_us: time from start to end of transaction [us].
+ * @retval  1 if successful. 0 if the instance is not supported.
+ * @note    On expiry the bus is recovered: 9 SCL pulses, STOP, SWRST and
+ *          re-init. The transaction fails and TimeoutCount/RecoveryCount are
+ *          incremented.
+ ******************************************************************************/
+uint8_t cncI2C_setTimeout(I2C_TypeDef *I2Cx, uint32_t timeout_us);
+/*******************************************************************************
+ * @brief   Abort the asynchronous transfer if it is past its deadline and
+ *          recover the bus. Call it periodically (e.g. sampler tick).
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if the transfer was aborted. 0 if not.
+ ******************************************************************************/
+uint8_t cncI2C_checkTimeoutAsync(I2C_TypeDef *I2Cx);
+/*******************************************************************************
+ * @brief   Release a bus held low by a slave: 9 SCL pulses, STOP condition,
+ *          peripheral software reset and re-init.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if SDA is released. 0 if the bus is still locked.
+ ******************************************************************************/
+uint8_t cncI2C_recoverBus(I2C_TypeDef *I2Cx);
 
 // In-line functions ===========================================================
 /*******************************************************************************
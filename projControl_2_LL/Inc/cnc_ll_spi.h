@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * @file    cnc_ll_spi.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Driver for SPI (master, register access devices) using STM32 Low
+ *          Layer API.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Mode 3 (CPOL = 1, CPHA = 1), 8 bits, MSB first, software chip select.
+  - Register protocol: first byte is the register address, bit 7 set for
+    read. The device auto-increments the address on bursts.
+  - The SPI peripheral is programmed through CMSIS registers: the LL SPI
+    driver is not part of this project.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef CNC_LL_SPI_H_
+#define CNC_LL_SPI_H_
+
+//Includes =====================================================================
+#include "stm32f4xx.h"
+#include "stm32f4xx_ll_system.h"
+#include "stm32f4xx_ll_cortex.h"
+#include "stm32f4xx_ll_bus.h"
+#include "stm32f4xx_ll_pwr.h"
+#include "stm32f4xx_ll_rcc.h"
+#include "stm32f4xx_ll_utils.h"
+
+#include "stm32f4xx_ll_gpio.h"
+#include "stm32f4xx_ll_dma.h"
+
+// Enum & structs ==============================================================
+/*!< Asynchronous transfer done. pContext: as given to the transfer.
+ *   status: 1 if successful, 0 if fail. */
+typedef void (*cncSPI_callback_t)(void *pContext, uint8_t status);
+
+/*!< SCK = PCLK/2^(Prescaler + 1), SPI_CR1 BR field */
+typedef enum
+{
+  SPI_PRESCALER_2 = 0,
+  SPI_PRESCALER_4,
+  SPI_PRESCALER_8,
+  SPI_PRESCALER_16,
+  SPI_PRESCALER_32,
+  SPI_PRESCALER_64,
+  SPI_PRESCALER_128,
+  SPI_PRESCALER_256,
+} spi_prescaler_t;
+
+typedef struct
+{
+  GPIO_TypeDef *GPIO_PORT_SCK;
+  uint32_t GPIO_PIN_SCK;
+  GPIO_TypeDef *GPIO_PORT_MISO;
+  uint32_t GPIO_PIN_MISO;
+  GPIO_TypeDef *GPIO_PORT_MOSI;
+  uint32_t GPIO_PIN_MOSI;
+  GPIO_TypeDef *GPIO_PORT_CS;
+  uint32_t GPIO_PIN_CS;
+  uint32_t GPIO_ALTERNATE;
+  uint32_t GPIO_CLOCK;                /*!< LL_AHB1_GRP1_PERIPH_GPIOx mask */
+  uint32_t SPI_CLOCK;                 /*!< LL_APB2_GRP1_PERIPH_SPIx */
+} spi_gpio_t;
+
+typedef struct
+{
+  DMA_TypeDef *DMAx;
+  uint32_t STREAM_RX;
+  uint32_t STREAM_TX;
+  uint32_t CHANNEL;
+  IRQn_Type IRQ_RX;
+  IRQn_Type IRQ_TX;
+} spi_dma_t;
+
+typedef struct
+{
+  volatile uint8_t busy;
+  uint8_t *pData;
+  uint8_t count;
+  cncSPI_callback_t callback;
+  void *pContext;                     /*!< Passed back to callback */
+} spi_async_t;
+
+/*!< Per-instance driver context. One static handle per SPI peripheral. */
+typedef struct
+{
+  SPI_TypeDef *Instance;
+  const spi_gpio_t *pGpio;
+  const spi_dma_t *pDma;
+  spi_prescaler_t Prescaler;
+  uint32_t TimeoutCycles;             /*!< Transaction deadline [DWT cycles] */
+  __IO uint32_t TimeoutCount;         /*!< Transactions past the deadline */
+  __IO uint32_t ErrorCount;           /*!< DMA transfer errors */
+  spi_async_t Async;
+} cncSPI_handle_t;
+
+// Constants ===================================================================
+#define SPI_TIMEOUT_DEFAULT_US  500   /*!< 256 bytes at 10.5 MHz take ~200 us */
+#define SPI_READ_MSK            0x80
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Driver context of a SPI instance.
+ * @param   SPIx: SPI instance (SPI1).
+ * @retval  Handle. 0 if the instance is not supported.
+ ******************************************************************************/
+cncSPI_handle_t *cncSPI_getHandle(SPI_TypeDef *SPIx);
+/*******************************************************************************
+ * @brief   Init SPI bus. SPI1: SCK PA5, MISO PA6, MOSI PA7, CS PA4.
+ * @param   SPIx: SPI instance.
+ * @param   prescaler: SCK = APB2 clock / prescaler.
+ * @retval  1 if successful. 0 if the instance is not supported.
+ ******************************************************************************/
+uint8_t cncSPI_Init(SPI_TypeDef *SPIx, spi_prescaler_t prescaler);
+/*******************************************************************************
+ * @brief   Change the SCK clock. Takes effect on the next transaction.
+ * @param   SPIx: SPI instance.
+ * @param   prescaler: SCK = APB2 clock / prescaler.
+ * @retval  1 if successful. 0 if an asynchronous transfer is in progress.
+ ******************************************************************************/
+uint8_t cncSPI_setPrescaler(SPI_TypeDef *SPIx, spi_prescaler_t prescaler);
+/*******************************************************************************
+ * @brief   Write registers (blocking).
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: bytes to be written.
+ * @param   count: number of bytes.
+ * @retval  1 if successful. 0 if busy or timeout.
+ ******************************************************************************/
+uint8_t cncSPI_WriteMultipleBytes(
+    SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData, uint8_t count);
+/*******************************************************************************
+ * @brief   Read registers (blocking).
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: buffer for the bytes from slave.
+ * @param   count: number of bytes.
+ * @retval  1 if successful. 0 if busy or timeout.
+ ******************************************************************************/
+uint8_t cncSPI_ReadMultipleBytes(
+    SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData, uint8_t count);
+/*******************************************************************************
+ * @brief   Init DMA streams and interrupts for asynchronous transfers.
+ * @param   SPIx: SPI instance. DMA2 streams:
+ *          SPI1: Stream0 (RX) / Stream3 (TX), Channel 3.
+ * @retval  1 if successful. 0 if fail.
+ ******************************************************************************/
+uint8_t cncSPI_InitDMA(SPI_TypeDef *SPIx);
+/*******************************************************************************
+ * @brief   Start a non-blocking register read (DMA). The address byte is sent
+ *          by polling, the data bytes by DMA.
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: buffer for the bytes from slave. Valid after callback.
+ * @param   count: number of bytes to be read.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncSPI_ReadAsync(SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData,
+                         uint8_t count, cncSPI_callback_t callback,
+                         void *pContext);
+/*******************************************************************************
+ * @brief   Start a non-blocking register write (DMA).
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: bytes to be written. Must remain valid until callback.
+ * @param   count: number of bytes to be written.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncSPI_WriteAsync(SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData,
+                          uint8_t count, cncSPI_callback_t callback,
+                          void *pContext);
+/*******************************************************************************
+ * @brief   Check if an asynchronous transfer is in progress.
+ * @param   SPIx: SPI instance.
+ * @retval  1 if busy. 0 if idle.
+ ******************************************************************************/
+uint8_t cncSPI_isBusyAsync(SPI_TypeDef *SPIx);
+
+#endif /* CNC_LL_SPI_H_ */
+// EOF =========================================================================
@@ -27,6 +27,27 @@ typedef enum
     UART_DATA_FORMAT_BS = (0x01 << 4),
 } uart_data_t;
 
+typedef struct
+{
+    GPIO_TypeDef *GPIO_PORT_TX;
+    uint32_t GPIO_PIN_TX;
+    GPIO_TypeDef *GPIO_PORT_RX;
+    uint32_t GPIO_PIN_RX;
+    uint32_t GPIO_ALTERNATE;
+    uint32_t GPIO_CLOCK;            /*!< LL_AHB1_GRP1_PERIPH_GPIOx mask */
+    uint32_t USART_CLOCK;           /*!< LL_APBx_GRP1_PERIPH_USARTx */
+    uint8_t APB;                    /*!< 1: APB1, 2: APB2 */
+} uart_gpio_t;
+
+/*!< Per-instance driver context. One static handle per USART peripheral. */
+typedef struct
+{
+    USART_TypeDef *Instance;
+    const uart_gpio_t *pGpio;
+    uint32_t TimeoutCycles;         /*!< Flag wait deadline [DWT cycles] */
+    __IO uint32_t TimeoutCount;     /*!< Waits that expired */
+} cncUSART_handle_t;
+
 // Linux bash sequences ========================================================
 static const bash_cmd_t bash_ClearScreen[] = "\033[2J";
 static const bash_cmd_t bash_EraseLine[]   = "\033[k";
@@ -50,11 +71,14 @@ static const bash_cmd_t bash_Brown[]       = "\033[0;33m";
 static const bash_cmd_t bash_Yellow[]      = "\033[1;33m";
 
 // =============================================================================
+cncUSART_handle_t *cncUSART_getHandle(USART_TypeDef *USARTx);
 uint8_t cncUSART_init(USART_TypeDef *USARTx);
+uint8_t cncUSART_setTimeout(USART_TypeDef *USARTx, uint32_t timeout_us);
 uint8_t cncUSART_putString(USART_TypeDef *USARTx, uint8_t *pStr, uint8_t count);
 uint8_t cncUSART_send2Bash(USART_TypeDef *USARTx, const bash_cmd_t *cmd, uint8_t *pStr);
 uint8_t cncUSART_sendData_float(USART_TypeDef *USARTx, float32_t *pData, uint8_t vector_len, uart_data_t mode);
 uint8_t cncUSART_sendData_int16(USART_TypeDef *USARTx, int16_t *pData, uint8_t vector_len, uart_data_t mode);
+uint8_t cncUSART_sendTimestamp(USART_TypeDef *USARTx, uint64_t timestamp, uart_data_t mode);
 uint8_t cncUSART_receiveData(USART_TypeDef *USARTx, uint8_t *pData, uint8_t len);
 
 // =============================================================================
@@ -7,9 +7,15 @@
 
 // =============================================================================
 typedef float float32_t;
+typedef int32_t q31_t;
+
+/*!< Fixed point controller: coefficients Q29 (|k| < 4), state h scaled by
+ *   2^-CONTROL_Q31_H_SHIFT (the DC gain of h is ~62) */
+#define CONTROL_Q31_H_SHIFT   8
 
 // =============================================================================
 float32_t controlador_planta(float32_t inputReference, uint8_t indice_planta);
+q31_t controlador_planta_q31(q31_t inputReference, uint8_t indice_planta);
 
 // =============================================================================
 
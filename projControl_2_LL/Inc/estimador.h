@@ -2,22 +2,163 @@
 #define ESTIMADOR_H_
 
 #include "mpu9250.h"
+#include "fast_math.h"
 
 // =============================================================================
 typedef float   float32_t;
 
 typedef enum { FILTER_ERROR = 0, FILTER_OK } filter_status_t;
 
+/*!< FILTER_COMPLEMENTARY: Euler angles, pAngles[2] = accelerometer tilt.
+ *   Quaternion backends: pAngles = pitch, roll, yaw [deg], yaw from the
+ *   gyroscope only (drifts) */
+typedef enum
+{
+  FILTER_COMPLEMENTARY = 0,
+  FILTER_MAHONY,                      /*!< PI correction, Ki: gyro bias */
+  FILTER_MADGWICK,                    /*!< Gradient descent, Beta */
+  FILTER_EKF,                         /*!< Quaternion + gyro bias states */
+} filter_type_t;
+
 typedef struct
 {
   uint16_t SampleRate;
-  float32_t Weight;
+  float32_t Weight;                   /*!< FILTER_COMPLEMENTARY */
+  filter_type_t Type;
+  float32_t Kp;                       /*!< FILTER_MAHONY [rad/s] */
+  float32_t Ki;                       /*!< FILTER_MAHONY [rad/s^2], 0: off */
+  float32_t Beta;                     /*!< FILTER_MADGWICK [rad/s] */
+  float32_t GyroNoise;                /*!< FILTER_EKF, std dev [dps] */
+  float32_t BiasNoise;                /*!< FILTER_EKF bias walk [dps/sqrt(s)] */
+  float32_t AccelNoise;               /*!< FILTER_EKF, std dev [g] */
+  uint8_t Device;                     /*!< mpu9250_getHandle() index */
+  fastMath_accuracy_t Accuracy;       /*!< Accelerometer angles atan2 */
+  uint8_t Adaptive;                   /*!< FILTER_COMPLEMENTARY, 1: gain
+                                           scheduled by |a| and |w| */
+  float32_t AccelLow;                 /*!< ||a| - 1| [g]: full trust below */
+  float32_t AccelHigh;                /*!< ||a| - 1| [g]: no trust above */
+  float32_t RateLow;                  /*!< |w| [dps]: full trust below */
+  float32_t RateHigh;                 /*!< |w| [dps]: no trust above */
+  float32_t CorrectRate;              /*!< [Hz], 0: single rate (see below) */
 } filter_init_t;
 
+/*!< Block interval beyond GAP_RATIO periods: samples were dropped. Beyond
+ *   DT_MAX_RATIO periods (e.g. wake from idle) the interval is not
+ *   integrated: the block restarts the timestamp base with the nominal dt */
+#define ESTIMATOR_GAP_RATIO       1.5f
+#define ESTIMATOR_DT_MAX_RATIO    10.0f
+
+/*!< FILTER_EKF: no accelerometer update while |a| is further than the gate
+ *   from 1 g (linear acceleration), initial bias std dev */
+#define ESTIMATOR_EKF_ACCEL_GATE  0.2f
+#define ESTIMATOR_EKF_BIAS0_DPS   1.0f
+
+/*!< Multi-rate (CorrectRate > 0): estimator_updateBlock() propagates every
+ *   gyro sample (estimator_propagate()) and applies the accelerometer mean
+ *   of the samples since the last correction at CorrectRate
+ *   (estimator_correct()). The angles are those of the newest sample.
+ *   FILTER_COMPLEMENTARY runs the adaptive form (gain 1 if not Adaptive) */
+
+/*!< Estimators owned by the module (estimator_getHandle): one per IMU, or
+ *   the control loop one and a shadow for A/B tests */
+#define ESTIMATOR_MAX_INSTANCES   2
+
+/*!< FILTER_EKF: x = [q0 q1 q2 q3 bx by bz], bias [rad/s] */
+#define ESTIMATOR_EKF_N           7
+
+/*!< Attitude quaternion (body to earth), q[0] scalar part */
+typedef struct
+{
+  float32_t q[4];
+  float32_t Integral[3];              /*!< Mahony integral, -bias [rad/s] */
+  uint8_t Aligned;                    /*!< 0: next sample sets pitch and roll */
+} estimator_quat_t;
+
+typedef struct
+{
+  estimator_quat_t Quat;
+  float32_t Bias[3];
+  float32_t P[ESTIMATOR_EKF_N*ESTIMATOR_EKF_N];
+} estimator_ekf_t;
+
+/*!< Estimator context. The state is plain memory, not volatile: an update
+ *   runs in one context (the data-ready EXTI1 interrupt, updateData() in
+ *   main.c) and keeps it in registers for the whole call. The
+ *   complementary state, touched on every call, comes first. The EKF work
+ *   matrices are shared: instances are updated from the same context, one
+ *   after the other. */
+typedef struct
+{
+  filter_type_t Type;
+  fastMath_accuracy_t Accuracy;
+  float32_t Dt;                       /*!< Integration step [s] */
+  float32_t Weight;
+  float32_t PastGyroscopeAngle[3];
+  float32_t PastAccelAngle[2];
+  float32_t PastEstimatedGyro[2];
+  float32_t PastEstimatedAccel[2];     /*!< Adaptive: filtered pitch, roll */
+  uint8_t Adaptive;
+  float32_t AccelLow;
+  float32_t AccelHigh;
+  float32_t RateLow;
+  float32_t RateHigh;
+  float32_t Gain;                     /*!< Last accelerometer trust, 0..1 */
+  float32_t Tilt;                     /*!< Multi-rate: last accel tilt */
+
+  float32_t DtNominal;                /*!< 1/SampleRate [s] */
+  uint64_t LastTimestamp;             /*!< Last block [us] */
+
+  float32_t Kp;
+  float32_t Ki;
+  float32_t Beta;
+  estimator_quat_t Quat;
+
+  float32_t GyroNoise;                /*!< [rad/s] */
+  float32_t BiasNoise;                /*!< [rad/s/sqrt(s)] */
+  float32_t AccelNoise;               /*!< [g] */
+  estimator_ekf_t Ekf;
+
+  float32_t CorrectPeriod;            /*!< [s], 0: single rate */
+  float32_t CorrectElapsed;           /*!< Since the last correction [s] */
+  float32_t AccelSum[3];              /*!< Samples since the last correction */
+  float32_t GyroSum[3];
+  uint16_t SumCount;
+
+  mpu9250_handle_t *pDevice;          /*!< estimator_filteredAngles() */
+
+  float32_t DtMeasured;               /*!< Last block interval [s] */
+  uint32_t DtGaps;                    /*!< Blocks after dropped samples */
+  uint32_t EkfPredictCycles;          /*!< Last predict step [DWT cycles] */
+  uint32_t EkfCorrectCycles;          /*!< Last update step [DWT cycles] */
+  uint32_t EkfRejected;               /*!< Accelerometer updates gated out */
+  uint32_t PropagateCycles;           /*!< Multi-rate: last block [cycles] */
+  uint32_t CorrectCycles;             /*!< Multi-rate, last correction */
+} estimator_t;
+
 // =============================================================================
-filter_status_t estimator_init(filter_init_t *filter_InitStruct);
-filter_status_t estimator_notFilteredAngles(float32_t *pAngles);
-filter_status_t estimator_filteredAngles(float32_t *pAngles);
+/*!< Context index (0..ESTIMATOR_MAX_INSTANCES-1), 0 if out of range. Every
+ *   function below takes it as first argument */
+estimator_t *estimator_getHandle(uint8_t index);
+filter_status_t estimator_init(estimator_t *pEstimator,
+                               filter_init_t *filter_InitStruct);
+filter_status_t estimator_notFilteredAngles(estimator_t *pEstimator,
+                                            float32_t *pAngles);
+filter_status_t estimator_filteredAngles(estimator_t *pEstimator,
+                                         float32_t *pAngles);
+filter_status_t estimator_update(estimator_t *pEstimator,
+                                 float32_t *pAccelerometer,
+                                 float32_t *pGyroscope, float32_t *pAngles);
+filter_status_t estimator_updateBlock(estimator_t *pEstimator,
+                                      float32_t *pAccelerometer,
+                                      float32_t *pGyroscope, uint8_t count,
+                                      uint64_t timestamp, float32_t *pAngles);
+filter_status_t estimator_propagate(estimator_t *pEstimator,
+                                    float32_t *pGyroscope, float32_t step);
+filter_status_t estimator_correct(estimator_t *pEstimator,
+                                  float32_t *pAccelerometer,
+                                  float32_t *pGyroscope, float32_t interval);
+void estimator_getAngles(estimator_t *pEstimator, float32_t *pAngles);
+filter_status_t estimator_benchmark(estimator_t *pEstimator, uint32_t *pCycles);
 
 #endif /* ESTIMADOR_H_ */
 // EOF =========================================================================
@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * @file    estimador_q31.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Fixed point complementary filter on raw MPU9250 FIFO blocks. Same
+ *          equations as the FILTER_COMPLEMENTARY backend of estimador.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Selected at build time with PIPELINE_Q31 (initHardware.h), together with
+    controlador_planta_q31().
+  - Angles: Q31 fraction of 180 deg (0x40000000 = 90 deg), wrap at +/-180.
+  - Accelerometer angles: block mean, norms with SMUAD (dual 16 bit MAC),
+    arm_sqrt_q31() and a 24 iterations CORDIC atan2 (~2e-5 deg).
+  - Gyroscope: raw block mean [Q31 of full scale] times FS*dt/180, dt from
+    the block timestamps (ESTIMATOR_GAP_RATIO / ESTIMATOR_DT_MAX_RATIO as
+    the float backend).
+  - Filter: arm_scale_q31() / arm_add_q31() with Weight in Q31.
+  - Float is only used by estimatorQ31_init() (constants) and
+    ESTIMATOR_Q31_TO_DEG() (telemetry, servo API).
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef ESTIMADOR_Q31_H_
+#define ESTIMADOR_Q31_H_
+
+//Includes =====================================================================
+#include "estimador.h"
+#include "controlador.h"
+
+// Constants ===================================================================
+#define ESTIMATOR_Q31_TO_DEG(x)   ((float32_t)(x)*(180.0f/2147483648.0f))
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the fixed point filter. Weight and SampleRate are used, the
+ *          gyro full scale is read from the driver handle 0.
+ * @param   filter_InitStruct: same settings as estimator_init().
+ * @retval  FILTER_OK if successful. FILTER_ERROR if Weight is not in [0, 1).
+ ******************************************************************************/
+filter_status_t estimatorQ31_init(filter_init_t *filter_InitStruct);
+/*******************************************************************************
+ * @brief   Update with a raw FIFO block.
+ * @param   pBlock: block of one unit, gyro bias already removed.
+ * @param   timestamp: newest sample of the block [us].
+ * @param   pAngles: pitch, roll, tilt z [Q31 of 180 deg]. Held if the block
+ *          is empty.
+ * @retval  FILTER_OK if successful. FILTER_ERROR if the block is empty.
+ ******************************************************************************/
+filter_status_t estimatorQ31_updateBlock(mpu9250_fifoBlock_t *pBlock,
+                                         uint64_t timestamp, q31_t *pAngles);
+
+#endif /* ESTIMADOR_Q31_H_ */
+// EOF =========================================================================
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * @file    fast_math.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Math kernels of the estimator: polynomial atan2 of selectable
+ *          accuracy and inverse norm on the FPU square root.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - atan2: octant reduction (|r| <= 1, one VDIV) and an odd minimax
+    polynomial of atan(r), coefficients in degrees (no rad to deg scaling):
+        FAST_MATH_FINE      7th order, max error 0.005 deg
+        FAST_MATH_COARSE    5th order, max error 0.035 deg
+        FAST_MATH_LIBM      atan2f(), reference
+    Results in [-180, 180], signed zeros as atan2f(): atan2(-0, x < 0) =
+    -180, atan2(+/-0, +/-0) = +/-0 or +/-180.
+  - fastMath_atan2Deg_f32(): same kernel on a block, the accuracy switch is
+    out of the loop (CMSIS style, pSrc..., pDst, blockSize).
+  - fastMath_invNorm(): 1/|v| with VSQRT.F32 (arm_sqrt_f32()) and VDIV, in
+    place of the 5 Newton iterations of the bit-trick inverse square root.
+  - fastMath_benchmark(): DWT cycles per call, DWT->CYCCNT must be enabled.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef FAST_MATH_H_
+#define FAST_MATH_H_
+
+//Includes =====================================================================
+#include "stm32f4xx.h"
+
+typedef float float32_t;
+
+// Enum & structs ==============================================================
+typedef enum
+{
+  FAST_MATH_LIBM = 0,                 /*!< atan2f() */
+  FAST_MATH_FINE,                     /*!< < 0.005 deg */
+  FAST_MATH_COARSE,                   /*!< < 0.035 deg */
+} fastMath_accuracy_t;
+
+// Constants ===================================================================
+#define FAST_MATH_BENCH_SIZE          32      /*!< Angles of the benchmark */
+#define FAST_MATH_BENCH_RUNS          10
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Four quadrant arctangent.
+ * @param   y, x: any scale, the ratio is used.
+ * @param   accuracy: kernel.
+ * @retval  atan2(y, x) [deg].
+ ******************************************************************************/
+float32_t fastMath_atan2Deg(float32_t y, float32_t x,
+                            fastMath_accuracy_t accuracy);
+/*******************************************************************************
+ * @brief   Four quadrant arctangent of a block.
+ * @param   pY, pX: blockSize values each.
+ * @param   pDst: atan2(pY[i], pX[i]) [deg]. May be pY or pX.
+ * @param   blockSize: values.
+ * @param   accuracy: kernel.
+ * @retval  None.
+ ******************************************************************************/
+void fastMath_atan2Deg_f32(const float32_t *pY, const float32_t *pX,
+                           float32_t *pDst, uint16_t blockSize,
+                           fastMath_accuracy_t accuracy);
+/*******************************************************************************
+ * @brief   Inverse euclidean norm.
+ * @param   pSrc: vector.
+ * @param   len: elements.
+ * @retval  1/|pSrc|. 0 for a null vector.
+ ******************************************************************************/
+float32_t fastMath_invNorm(const float32_t *pSrc, uint8_t len);
+/*******************************************************************************
+ * @brief   DWT cycles per call, mean of FAST_MATH_BENCH_RUNS sweeps of
+ *          FAST_MATH_BENCH_SIZE angles around the circle.
+ * @param   pCycles: [0] atan2f(), [1] FAST_MATH_FINE, [2] FAST_MATH_COARSE,
+ *          [3] FAST_MATH_FINE per value of a block, [4] fastMath_invNorm()
+ *          of a 3 vector.
+ * @retval  None.
+ ******************************************************************************/
+void fastMath_benchmark(uint32_t *pCycles);
+
+#endif /* FAST_MATH_H_ */
+// EOF =========================================================================
@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * @file    gyro_bias.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Online gyroscope bias estimator: per-axis linear bias vs
+ *          temperature model, learnt while the platform is still and applied
+ *          to the raw FIFO samples.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Units are the driver handles 0..count-1 (mpu9250_getHandle), as in
+    imu_redundant.
+  - Model, raw units (gyro LSB, TEMP_OUT LSB):
+        bias(T) = Offset + Slope*(T - TempRef)
+    It is the drift left after mpu9250_calibrate(): the offset registers
+    already remove the bias at power-up temperature.
+  - Learning: a block is still when every gyro axis moves less than
+    GYRO_BIAS_NOISE_DPS (max - min) and its mean is within GYRO_BIAS_STILL_DPS
+    of the model. After GYRO_BIAS_STILL_TICKS still blocks in a row, each
+    block mean (temperature, gyro) updates an exponentially weighted mean and
+    covariance (memory GYRO_BIAS_MEMORY blocks). The slope is fitted once the
+    temperature spread reaches GYRO_BIAS_MIN_SPAN, the offset on every point.
+  - Correction: 3 multiply-adds per sample. Saturated values are left as
+    they are, so imuRedundant still sees them.
+  - The model can be read back and restored (gyroBias_getModel/setModel), as
+    the hardware offsets with mpu9250_getOffsets/setOffsets.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef GYRO_BIAS_H_
+#define GYRO_BIAS_H_
+
+//Includes =====================================================================
+#include "mpu9250.h"
+
+// Enum & structs ==============================================================
+typedef struct
+{
+  float32_t Offset[3];                /*!< Bias at TempRef [gyro LSB] */
+  float32_t Slope[3];                 /*!< [gyro LSB / TEMP_OUT LSB] */
+  float32_t TempRef;                  /*!< [TEMP_OUT LSB] */
+  uint8_t Valid;                      /*!< 0: no correction applied */
+} gyroBias_model_t;
+
+typedef struct
+{
+  uint16_t StillTicks;                /*!< Still blocks in a row */
+  uint32_t Points;                    /*!< Blocks learnt */
+  uint32_t SlopeFits;                 /*!< Model updates with a slope fit */
+  float32_t TempSpread;               /*!< Std dev of the learnt temp [C] */
+} gyroBias_stats_t;
+
+// Constants ===================================================================
+#define GYRO_BIAS_STILL_DPS           2.0f    /*!< |block mean - model| */
+#define GYRO_BIAS_NOISE_DPS           1.5f    /*!< block max - min */
+#define GYRO_BIAS_STILL_TICKS         50      /*!< 0.5 s at 100 Hz */
+#define GYRO_BIAS_MEMORY              30000   /*!< 5 min of still blocks */
+#define GYRO_BIAS_MIN_SPAN            1.0f    /*!< C, temperature std dev */
+#define GYRO_BIAS_TEMP_SENSITIVITY    333.87f /*!< TEMP_OUT LSB/C */
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the estimator. Every unit starts without a model.
+ * @param   count: devices to compensate, 1..MPU9250_MAX_DEVICES.
+ * @retval  1 if successful. 0 if count is out of range.
+ ******************************************************************************/
+uint8_t gyroBias_init(uint8_t count);
+/*******************************************************************************
+ * @brief   Learn from a raw (not yet corrected) block if the unit is still.
+ * @param   index: unit (driver handle index).
+ * @param   pBlock: FIFO block, as read.
+ * @retval  1 if the block updated the model. 0 if not.
+ ******************************************************************************/
+uint8_t gyroBias_update(uint8_t index, mpu9250_fifoBlock_t *pBlock);
+/*******************************************************************************
+ * @brief   Remove the modelled bias from the gyro samples, in place.
+ * @param   index: unit (driver handle index).
+ * @param   pBlock: FIFO block. Each sample is corrected at its own
+ *          temperature.
+ * @retval  None.
+ ******************************************************************************/
+void gyroBias_correctBlock(uint8_t index, mpu9250_fifoBlock_t *pBlock);
+/*******************************************************************************
+ * @brief   Current model of a unit, to be stored.
+ * @param   index: unit (driver handle index).
+ * @param   pModel: model copy.
+ * @retval  1 if successful. 0 if index is out of range.
+ ******************************************************************************/
+uint8_t gyroBias_getModel(uint8_t index, gyroBias_model_t *pModel);
+/*******************************************************************************
+ * @brief   Restore a stored model. Learning goes on from it: the stored
+ *          point weighs as a single block.
+ * @param   index: unit (driver handle index).
+ * @param   pModel: stored model.
+ * @retval  1 if successful. 0 if index is out of range.
+ ******************************************************************************/
+uint8_t gyroBias_setModel(uint8_t index, const gyroBias_model_t *pModel);
+/*******************************************************************************
+ * @brief   Learning counters of a unit.
+ * @param   index: unit (driver handle index).
+ * @retval  Statistics. 0 if index is out of range.
+ ******************************************************************************/
+const gyroBias_stats_t *gyroBias_getStats(uint8_t index);
+
+#endif /* GYRO_BIAS_H_ */
+// EOF =========================================================================
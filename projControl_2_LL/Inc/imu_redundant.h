@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * @file    imu_redundant.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Redundant MPU9250 fusion: per-unit health monitor, averaging and
+ *          voting of the FIFO blocks read in the same tick.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Units are the driver handles 0..count-1 (mpu9250_getHandle).
+  - A unit is faulty on a tick when its read failed, its block is empty, the
+    data is stuck (every frame identical) or saturated. After
+    IMU_REDUNDANT_FAULT_TICKS faulty ticks in a row it is marked failed and
+    left out until IMU_REDUNDANT_RECOVER_TICKS good ticks in a row.
+  - Two healthy units are averaged (white noise / sqrt(2)), three or more are
+    voted (median per axis).
+  - Agreement, per axis: mean absolute difference over the block against
+    IMU_REDUNDANT_*_TOL. With three or more units each one is compared with
+    the median; an outlier is faulty on that tick (IMU_FAULT_DISAGREE), so a
+    unit that keeps disagreeing is voted out like any other fault, as long
+    as the units that agree are the majority. With two units the
+    disagreement is only counted: it cannot be attributed to either of them,
+    both stay in the mean. A recovering unit is checked against the healthy
+    ones when they agree among themselves.
+  - Blocks are aligned on the newest sample: the fused block has as many
+    samples as the shortest one.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef IMU_REDUNDANT_H_
+#define IMU_REDUNDANT_H_
+
+//Includes =====================================================================
+#include "mpu9250.h"
+
+// Enum & structs ==============================================================
+typedef enum
+{
+  IMU_FAULT_NONE = 0,
+  IMU_FAULT_READ,                     /*!< Bus transfer failed */
+  IMU_FAULT_EMPTY,                    /*!< No samples in the FIFO */
+  IMU_FAULT_STUCK,                    /*!< Every frame identical */
+  IMU_FAULT_SATURATED,                /*!< Raw value at full scale */
+  IMU_FAULT_DISAGREE,                 /*!< Outvoted by the other units */
+} imu_fault_t;
+
+typedef struct
+{
+  uint8_t Healthy;                    /*!< 1: used in the fusion */
+  imu_fault_t LastFault;
+  uint8_t FaultTicks;                 /*!< Faulty ticks in a row */
+  uint16_t GoodTicks;                 /*!< Good ticks in a row */
+  uint32_t Faults;                    /*!< Faulty ticks */
+  uint32_t Failures;                  /*!< Times marked failed */
+} imu_unit_t;
+
+typedef struct
+{
+  uint8_t Units;
+  uint8_t Used;                       /*!< Units fused on the last tick */
+  uint32_t Disagreements;             /*!< Ticks with units beyond the tolerances */
+  uint32_t NoData;                    /*!< Ticks without a healthy unit */
+} imu_redundantStats_t;
+
+// Constants ===================================================================
+#define IMU_REDUNDANT_FAULT_TICKS     3
+#define IMU_REDUNDANT_RECOVER_TICKS   100     /*!< 1 s at 100 Hz */
+#define IMU_REDUNDANT_GYRO_TOL        10.0f   /*!< dps, per axis mean |difference| */
+#define IMU_REDUNDANT_ACCEL_TOL       0.2f    /*!< g, per axis mean |difference| */
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the health monitor. Every unit starts healthy.
+ * @param   count: devices to fuse, 1..MPU9250_MAX_DEVICES.
+ * @retval  1 if successful. 0 if count is out of range.
+ ******************************************************************************/
+uint8_t imuRedundant_init(uint8_t count);
+/*******************************************************************************
+ * @brief   Check and fuse the blocks read in one tick.
+ * @param   pBlocks: one FIFO block per unit.
+ * @param   pReadOk: per unit, 1 if its read succeeded.
+ * @param   pAccel: fused accelerometer [g], XYZ interleaved.
+ * @param   pGyro: fused gyroscope [dps], XYZ interleaved.
+ * @retval  Fused samples. 0 if no unit was usable.
+ ******************************************************************************/
+uint8_t imuRedundant_fuse(mpu9250_fifoBlock_t *pBlocks, const uint8_t *pReadOk,
+                          float32_t *pAccel, float32_t *pGyro);
+/*******************************************************************************
+ * @brief   Check the blocks read in one tick and pick the first usable unit,
+ *          without scaling (fixed point pipeline). Health is updated as in
+ *          imuRedundant_fuse(), without the agreement check.
+ * @param   pBlocks: one FIFO block per unit.
+ * @param   pReadOk: per unit, 1 if its read succeeded.
+ * @retval  Unit index. MPU9250_MAX_DEVICES if no unit was usable.
+ ******************************************************************************/
+uint8_t imuRedundant_select(mpu9250_fifoBlock_t *pBlocks,
+                            const uint8_t *pReadOk);
+/*******************************************************************************
+ * @brief   Health of a unit.
+ * @param   index: unit (driver handle index).
+ * @retval  Unit state. 0 if index is out of range.
+ ******************************************************************************/
+const imu_unit_t *imuRedundant_getUnit(uint8_t index);
+/*******************************************************************************
+ * @brief   Fusion counters.
+ * @retval  Statistics.
+ ******************************************************************************/
+const imu_redundantStats_t *imuRedundant_getStats(void);
+
+#endif /* IMU_REDUNDANT_H_ */
+// EOF =========================================================================
@@ -16,7 +16,12 @@
 
 #include "cnc_ll_uart.h"
 #include "mpu9250.h"
+#include "imu_redundant.h"
+#include "gyro_bias.h"
+#include "prefilter.h"
+#include "vibration.h"
 #include "estimador.h"
+#include "estimador_q31.h"
 #include "servomotor.h"
 
 // =============================================================================
@@ -38,6 +43,41 @@ typedef struct
 
 // =============================================================================
 static const uint8_t SAMPLER_FREQ  = 100;  /*!< Hertz */
+static const uint16_t IMU_FIFO_FREQ = 1000; /*!< Hertz, drained every tick */
+static const mpu9250_Interface_t IMU_INTERFACE = MPU9250_INTERFACE_I2C;
+static const uint16_t IMU_CALIB_SAMPLES = 2000; /*!< 2 s at 1 kHz, board still */
+
+/*!< Redundant IMU: with IMU_COUNT 2 a second MPU9250 (AD0 high) sits on
+ *   IMU_AUX_I2C at IMU_AUX_ADDRESS, the first one stays on IMU_INTERFACE
+ *   (IMU_I2C if I2C). With IMU_COUNT 3 a third one sits on IMU_AUX2_I2C at
+ *   the first address that answers: the units are voted, a faulty one is
+ *   left out (imu_redundant.h). Every FIFO is drained on the first unit's
+ *   data-ready, in the same tick: on different buses the drains run in
+ *   parallel, each bus with its own transaction queue. */
+#define IMU_COUNT     1
+#define IMU_I2C       I2C1
+#define IMU_AUX_I2C   I2C1
+#define IMU_AUX2_I2C  I2C2
+static const uint8_t IMU_AUX_ADDRESS = 0x69;
+
+/*!< 1: fixed point estimator and controller on the raw FIFO block of the
+ *   first usable IMU (estimatorQ31, controlador_planta_q31). 0: float */
+#define PIPELINE_Q31  0
+
+/*!< Vibration analyzer (float pipeline), telemetry on UART5 from the main
+ *   loop, one line per control period after the tick's own: "PK" at every
+ *   window, 1: also the spectrum, "SP" lines of 2*VIBRATION_MAX_PEAKS bins */
+#define VIBRATION_SPECTRUM  1
+static const uint16_t UART_BYTE_RATE = 11520;       /*!< UART5, 115200 baud 8N1 */
+
+/*!< Idle after IDLE_TICKS control ticks with every gyro axis under
+ *   IDLE_GYRO_DPS. Wake latency: 1/IMU_WOM_ODR + 35 ms gyro start-up + one
+ *   control tick (~77 ms) */
+static const float32_t IDLE_GYRO_DPS = 2.0f;
+static const uint16_t IDLE_TICKS = 500;             /*!< 5 s at SAMPLER_FREQ */
+static const uint16_t IMU_WOM_THRESHOLD = 40;       /*!< mg */
+static const mpu9250_LowPowerODR_t IMU_WOM_ODR = MPU9250_LP_ODR_31_25HZ;
+static const uint32_t UPTIME_FREQ = 10000;          /*!< Hertz, TIM2 */
 
 static const uint32_t LED_BLINK_FAST    = 150;  /*!< mseconds */
 static const uint32_t LED_BLINK_MEDIUM  = 250;  /*!< mseconds */
@@ -48,10 +88,15 @@ static const board_gpio_t LED_ORANGE  = {GPIOD, (0x01 << 13)}; /*!< GPIOD Pin 13
 static const board_gpio_t LED_RED     = {GPIOD, (0x01 << 14)}; /*!< GPIOD Pin 14 */
 static const board_gpio_t LED_BLUE    = {GPIOD, (0x01 << 15)}; /*!< GPIOD Pin 15 */
 static const board_gpio_t BUTTON      = {GPIOA, (0x01 << 0)};  /*!< GPIOA Pin 0  */
+static const board_gpio_t IMU_INT     = {GPIOD, (0x01 << 1)};  /*!< GPIOD Pin 1, MPU9250 INT */
+static const board_gpio_t MEMS_CS     = {GPIOE, (0x01 << 3)};  /*!< GPIOE Pin 3, on-board LIS3DSH (SPI1) */
 
 // Public functions prototypes =================================================
 void initHardware_InitSystem(void);
 void initHardware_TestOutput(void);
+uint32_t initHardware_getUptime(void);
+uint64_t initHardware_getTimestamp(void);
+void initHardware_syncTimestamp(uint32_t sleepTicks);
 
 void Error_Handler(void);
 
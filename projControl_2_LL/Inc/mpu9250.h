@@ -2,6 +2,8 @@
 #define MPU9250_H_
 
 #include "cnc_ll_i2c.h"
+#include "cnc_i2c_queue.h"
+#include "cnc_ll_spi.h"
 
 // =============================================================================
 typedef float float32_t;
@@ -73,6 +75,23 @@ typedef enum
   MPU9250_ACCEL_LPF_420HZ,
 } mpu9250_Accel_LowPassFilter_t;
 
+/*!< Wake-on-motion accelerometer rate (LP_ACCEL_ODR) */
+typedef enum
+{
+  MPU9250_LP_ODR_0_24HZ = 0,
+  MPU9250_LP_ODR_0_49HZ,
+  MPU9250_LP_ODR_0_98HZ,
+  MPU9250_LP_ODR_1_95HZ,
+  MPU9250_LP_ODR_3_91HZ,
+  MPU9250_LP_ODR_7_81HZ,
+  MPU9250_LP_ODR_15_63HZ,
+  MPU9250_LP_ODR_31_25HZ,
+  MPU9250_LP_ODR_62_5HZ,
+  MPU9250_LP_ODR_125HZ,
+  MPU9250_LP_ODR_250HZ,
+  MPU9250_LP_ODR_500HZ,
+} mpu9250_LowPowerODR_t;
+
 // Structures ==================================================================
 typedef struct
 {
@@ -84,75 +103,378 @@ typedef struct
     mpu9250_Accel_Axes_t Accel_Axes;
     mpu9250_Accel_Scale_t Accel_Scale;
     mpu9250_Accel_LowPassFilter_t Accel_LPF;
+    uint8_t Address;                /*!< I2C: 0x68/0x69, 0 to probe both */
+    I2C_TypeDef *I2Cx;              /*!< I2C: bus, 0 for I2C1 */
 } mpu9250_InitStruct_t;
 
+/*!< Raw sample, same order as ACCEL_XOUT_H..GYRO_ZOUT_L (14 bytes) */
+typedef struct
+{
+    int16_t Accel[3];
+    int16_t Temperature;
+    int16_t Gyro[3];
+} mpu9250_rawData_t;
+
+/*!< Raw 9 axes sample: ACCEL_XOUT_H..GYRO_ZOUT_L and the AK8963 HXL..ST2
+ *   copy in EXT_SENS_DATA_00..06 (21 bytes, one burst) */
+typedef struct
+{
+    mpu9250_rawData_t Imu;
+    int16_t Mag[3];                 /*!< AK8963 axes */
+    uint8_t MagStatus;              /*!< AK8963 ST2 */
+} mpu9250_rawData9_t;
+
+/*!< Hardware offset registers, raw register values */
+typedef struct
+{
+    int16_t Accel[3];               /*!< XA/YA/ZA_OFFSET: 2048 LSB/g, bit 0
+                                         reserved (temperature compensation) */
+    int16_t Gyro[3];                /*!< XG/YG/ZG_OFFSET: 32.8 LSB/dps */
+} mpu9250_offsets_t;
+
+/*!< Self-test measurements: averages [LSB] at 250 dps / 2 g and the factory
+ *   trim codes (SELF_TEST_X/Y/Z_GYRO, SELF_TEST_X/Y/Z_ACCEL) */
+typedef struct
+{
+    int16_t AccelOff[3];            /*!< Self-test disabled */
+    int16_t AccelOn[3];             /*!< Self-test enabled */
+    int16_t GyroOff[3];
+    int16_t GyroOn[3];
+    uint8_t AccelTrim[3];
+    uint8_t GyroTrim[3];
+} mpu9250_selfTestData_t;
+
+/*!< Self-test result per axis */
+typedef struct
+{
+    uint8_t AccelPass[3];           /*!< 1: pass, 0: fail */
+    uint8_t GyroPass[3];
+    float32_t AccelDeviation[3];    /*!< Response vs factory response [%],
+                                         0 if the part has no trim */
+    float32_t GyroDeviation[3];
+    mpu9250_selfTestData_t Data;
+} mpu9250_selfTest_t;
+
+/*!< FIFO frames per drain. The I2C byte count is 8 bits: 18*14 = 252 bytes.
+ *   Frames beyond the block stay in the FIFO for the next drain. */
+#define MPU9250_FIFO_BLOCK_SIZE     18
+
+/*!< FIFO samples, oldest first */
+typedef struct
+{
+    mpu9250_rawData_t Samples[MPU9250_FIFO_BLOCK_SIZE];
+    uint8_t Count;                  /*!< Valid samples */
+    uint8_t Overflow;               /*!< 1: FIFO was full, samples were lost */
+} mpu9250_fifoBlock_t;
+
+/*!< Devices handled by the driver (mpu9250_getHandle). Three: two units
+ *   are averaged, a third one is needed to vote one out */
+#define MPU9250_MAX_DEVICES         3
+
+/*!< Registers kept in the configuration shadow / saved by wake-on-motion */
+#define MPU9250_SHADOW_SIZE         15
+#define MPU9250_WOM_SIZE            7
+
+typedef struct mpu9250_handle_s mpu9250_handle_t;
+typedef struct mpu9250_transport_s mpu9250_transport_t;
+
+/*!< Asynchronous read done, called from interrupt context */
+typedef void (*mpu9250_callback_t)(
+    mpu9250_handle_t *pDevice, mpu9250_status_t status);
+
+/*!< Bus transfer done (interrupt context). busStatus: 1 if successful. */
+typedef void (*mpu9250_busCallback_t)(
+    mpu9250_handle_t *pDevice, uint8_t busStatus);
+
+/*!< Per-device driver context. Bus, scale factors, register shadow and the
+ *   asynchronous read state: every device has its own, so several MPU9250 can
+ *   be read back-to-back. */
+struct mpu9250_handle_s
+{
+    const mpu9250_transport_t *pTransport;
+    mpu9250_Interface_t Interface;
+    I2C_TypeDef *I2Cx;              /*!< I2C bus and its queue */
+    uint8_t Address;                /*!< I2C address, 0 on SPI */
+    volatile uint8_t Ready;
+
+    volatile float32_t GyroResolution;
+    volatile uint8_t GyroScale;     /*!< GYRO_CONFIG FS_SEL */
+    volatile uint16_t AccelResolution;
+    float32_t MagResolution[3];     /*!< ASA times resolution [uT/LSB] */
+    volatile uint8_t MagReady;
+
+    uint8_t Shadow[MPU9250_SHADOW_SIZE];
+    uint16_t ShadowDirty;           /*!< Bit i: Shadow[i] staged */
+    uint32_t BootCycles;
+    uint8_t WomSaved[MPU9250_WOM_SIZE];
+    volatile uint8_t WomActive;
+
+    uint8_t AsyncBuffer[14];
+    mpu9250_rawData_t *pAsyncRawData;
+    mpu9250_fifoBlock_t *pAsyncBlock;
+    mpu9250_callback_t AsyncCallback;
+    mpu9250_busCallback_t BusCallback;
+    volatile uint8_t AsyncPending;
+    uint8_t FifoResetCmd;
+    uint8_t FifoCountBuffer[2];
+    uint8_t FifoBuffer[MPU9250_FIFO_BLOCK_SIZE*14];
+
+    uint32_t AsyncStart;            /*!< DWT->CYCCNT at submit */
+    volatile uint32_t ReadCycles;   /*!< Last asynchronous read, submit to
+                                         callback [DWT cycles] */
+    volatile uint32_t MaxReadCycles;
+    volatile uint32_t ReadErrors;   /*!< Asynchronous reads failed */
+};
+
 // Public constants ============================================================
 static const uint8_t MPU9250_DEVICE_ID = 0x71;
 static const uint8_t MPU9250_CMD_RESET = 0x80;
 static const uint8_t MPU9250_INT_DATA_READY_MSK = 0x01;
+static const uint8_t AK8963_DEVICE_ID = 0x48;
 
 // Function Prototypes =========================================================
+/*******************************************************************************
+ * Driver context of device index (0..MPU9250_MAX_DEVICES-1). 0 if out of
+ * range. Every function below takes it as first argument.
+ ******************************************************************************/
+mpu9250_handle_t *mpu9250_getHandle(uint8_t index);
+
 /*******************************************************************************
  * Configure and init MPU9250 IMU (Accelerometer and Gyroscope)
- * ToDo:
- *      implement SPI protocol.
+ * Interface selects the bus: I2Cx (400 kHz, transaction queue of that bus)
+ * or SPI1 (config registers at 656 kHz, data registers at 10.5 MHz, DMA).
+ * The bus must be initialized first. Returns when the first sample is ready.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_init(mpu9250_handle_t *pDevice,
+    mpu9250_InitStruct_t* mpu9250_Init);
+
+/*******************************************************************************
+ * Data-ready pulse (50us, active high, push-pull) on INT pin at sampleRate
+ * [Hz]. Internal sample rate must be 1kHz (Gyro_LPF 5..184 Hz).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_initInterrupt(mpu9250_handle_t *pDevice,
+    uint16_t samplerate);
+
+/*******************************************************************************
+ * AK8963 magnetometer through the auxiliary I2C master (400 kHz): 16 bits,
+ * continuous 100 Hz. I2C slave 0 copies HXL..ST2 into EXT_SENS_DATA_00..06
+ * every sample, right after GYRO_ZOUT_L. Reads the sensitivity adjustment
+ * (ASA) values from fuse ROM.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_initMag(mpu9250_handle_t *pDevice);
+
+/*******************************************************************************
+ * Reset device. Polls PWR_MGMT1 (H_RESET cleared) and WHO_AM_I until the
+ * device is back, then reloads the register shadow.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_reset(mpu9250_handle_t *pDevice);
+
+/*******************************************************************************
+ * Configuration registers are kept in a RAM shadow. The setters only stage
+ * a change; mpu9250_flush() writes the changed registers (contiguous ones in
+ * one burst) and updates the scale factors.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_flush(mpu9250_handle_t *pDevice);
+mpu9250_status_t mpu9250_setGyroScale(mpu9250_handle_t *pDevice,
+    mpu9250_Gyro_Scale_t scale);
+mpu9250_status_t mpu9250_setGyroLPF(mpu9250_handle_t *pDevice,
+    mpu9250_Gyro_LowPassFilter_t lpf);
+mpu9250_status_t mpu9250_setAccelScale(mpu9250_handle_t *pDevice,
+    mpu9250_Accel_Scale_t scale);
+mpu9250_status_t mpu9250_setAccelLPF(mpu9250_handle_t *pDevice,
+    mpu9250_Accel_LowPassFilter_t lpf);
+
+/*******************************************************************************
+ * DWT cycles from mpu9250_init() to the first sample (reset, configuration
+ * and sensor start-up).
  ******************************************************************************/
-mpu9250_status_t mpu9250_init(mpu9250_InitStruct_t* mpu9250_Init);
+uint32_t mpu9250_getBootCycles(mpu9250_handle_t *pDevice);
 
 /*******************************************************************************
- * init interrupt pin only if internal sample rate == 1kHz
+ * Low-power idle: gyro disabled, accelerometer cycled at odr, one INT pulse
+ * (50us) when the acceleration changes more than threshold [mg] (4..1020).
+ * Data-ready pulses stop. The previous configuration is restored on failure.
  ******************************************************************************/
-mpu9250_status_t mpu9250_initInterrupt(uint16_t samplerate);
+mpu9250_status_t mpu9250_enterWakeOnMotion(mpu9250_handle_t *pDevice,
+    uint16_t threshold, mpu9250_LowPowerODR_t odr);
 
 /*******************************************************************************
- * Reset device
+ * Back to full rate: restore the configuration, wait for the gyro start-up
+ * (35 ms) and reset the FIFO (samples taken while idle are dropped).
  ******************************************************************************/
-mpu9250_status_t mpu9250_reset(void);
+mpu9250_status_t mpu9250_exitWakeOnMotion(mpu9250_handle_t *pDevice);
 
 /*******************************************************************************
  *
  ******************************************************************************/
-mpu9250_status_t mpu9250_getBias_int16(
+mpu9250_status_t mpu9250_getBias_int16(mpu9250_handle_t *pDevice,
     uint8_t samples, int16_t *pAccel, int16_t *pGyro);
-mpu9250_status_t mpu9250_getBias_float(
+mpu9250_status_t mpu9250_getBias_float(mpu9250_handle_t *pDevice,
     uint8_t samples, float32_t *pAccel, float32_t *pGyro);
 
+/*******************************************************************************
+ * Measure bias over samples (1 kHz, device still, Z axis up) and cancel it
+ * in the offset registers. Offsets already in the device are taken into
+ * account, so calibration can be repeated. pOffsets: new register values,
+ * to be stored and restored with mpu9250_setOffsets().
+ ******************************************************************************/
+mpu9250_status_t mpu9250_calibrate(mpu9250_handle_t *pDevice, uint16_t samples,
+    mpu9250_offsets_t *pOffsets);
+
+/*******************************************************************************
+ * Datasheet self-test: sensor output with self-test off and on (200 samples
+ * each) against the factory trim in SELF_TEST_*. Device still. Takes ~0.5 s,
+ * MPU9250_ERROR past MPU9250_SELFTEST_TIMEOUT_US. The configuration is
+ * restored afterwards. MPU9250_OK if every axis passed.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_selfTest(mpu9250_handle_t *pDevice,
+    mpu9250_selfTest_t *pResult);
+
+/*******************************************************************************
+ * Self-test pass/fail criteria on pResult->Data (no bus access): fills the
+ * pass flags and deviations. MPU9250_OK if every axis passed.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_checkSelfTest(mpu9250_selfTest_t *pResult);
+
+/*******************************************************************************
+ * Read back the offset registers (gyro 32.8 LSB/dps, accel 2048 LSB/g).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_getOffsets(mpu9250_handle_t *pDevice,
+    mpu9250_offsets_t *pOffsets);
+
+/*******************************************************************************
+ * Write the offset registers. The accel temperature compensation bit
+ * (bit 0) of the device is kept, whatever pOffsets holds.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_setOffsets(mpu9250_handle_t *pDevice,
+    mpu9250_offsets_t *pOffsets);
+
 /*******************************************************************************
  *
  ******************************************************************************/
-mpu9250_status_t mpu9250_getResolution_int16(int16_t *pResolution);
-mpu9250_status_t mpu9250_getResolution_float(float32_t *pResolution);
+mpu9250_status_t mpu9250_getResolution_int16(mpu9250_handle_t *pDevice,
+    int16_t *pResolution);
+mpu9250_status_t mpu9250_getResolution_float(mpu9250_handle_t *pDevice,
+    float32_t *pResolution);
 
 /*******************************************************************************
  * Return device id --> MPU9250_DEVICE_ID == 0x71
  ******************************************************************************/
-uint8_t mpu9250_readID(void);
+uint8_t mpu9250_readID(mpu9250_handle_t *pDevice);
 
 /*******************************************************************************
  * Read device's temperature: int16_t --> raw data.
  * float32_t:
  *          temperature = [(rawData - RoomTemp_Offset)/ 333.87f] + 21.0f
  ******************************************************************************/
-mpu9250_status_t mpu9250_readTemperature_int16(int16_t *pTemperature);
-mpu9250_status_t mpu9250_readTemperature_float(float32_t *pTemperature);
+mpu9250_status_t mpu9250_readTemperature_int16(mpu9250_handle_t *pDevice,
+    int16_t *pTemperature);
+mpu9250_status_t mpu9250_readTemperature_float(mpu9250_handle_t *pDevice,
+    float32_t *pTemperature);
 
 /*******************************************************************************
  * Return Accelerometer data. Default 16.384 LSB/g
  ******************************************************************************/
-mpu9250_status_t mpu9250_readAccelData_int16(int16_t *pAccel);
-mpu9250_status_t mpu9250_readAccelData_float(float32_t *pAccel);
+mpu9250_status_t mpu9250_readAccelData_int16(mpu9250_handle_t *pDevice,
+    int16_t *pAccel);
+mpu9250_status_t mpu9250_readAccelData_float(mpu9250_handle_t *pDevice,
+    float32_t *pAccel);
 
 /*******************************************************************************
  * Return Gyroscope data. Default 131.0 LSB/dps
  ******************************************************************************/
-mpu9250_status_t mpu9250_readGyroData_int16(int16_t *pGyro);
-mpu9250_status_t mpu9250_readGyroData_float(float32_t *pGyro);
+mpu9250_status_t mpu9250_readGyroData_int16(mpu9250_handle_t *pDevice,
+    int16_t *pGyro);
+mpu9250_status_t mpu9250_readGyroData_float(mpu9250_handle_t *pDevice,
+    float32_t *pGyro);
 
 /*******************************************************************************
  * Return Accelerometer and Gyroscope data
  ******************************************************************************/
-mpu9250_status_t mpu9250_readData_int16(int16_t *pAccel, int16_t *pGyro);
-mpu9250_status_t mpu9250_readData_float(float32_t *pAccel, float32_t *pGyro);
+mpu9250_status_t mpu9250_readData_int16(mpu9250_handle_t *pDevice,
+    int16_t *pAccel, int16_t *pGyro);
+mpu9250_status_t mpu9250_readData_float(mpu9250_handle_t *pDevice,
+    float32_t *pAccel, float32_t *pGyro);
+
+/*******************************************************************************
+ * Return Accelerometer, Temperature and Gyroscope raw data in a single burst
+ * read (ACCEL_XOUT_H..GYRO_ZOUT_L).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readRawData(mpu9250_handle_t *pDevice,
+    mpu9250_rawData_t *pRawData);
+
+/*******************************************************************************
+ * Non-blocking version of mpu9250_readRawData(). Queued with control priority
+ * on the I2C transaction queue (I2C events + DMA), or SPI DMA transfer.
+ * pRawData is valid when callback is called with MPU9250_OK.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readRawData_async(mpu9250_handle_t *pDevice,
+    mpu9250_rawData_t *pRawData, mpu9250_callback_t callback);
+
+/*******************************************************************************
+ * Scale raw sample: Accelerometer [g], Gyroscope [dps]
+ ******************************************************************************/
+mpu9250_status_t mpu9250_convertData_float(mpu9250_handle_t *pDevice,
+    mpu9250_rawData_t *pRawData, float32_t *pAccel, float32_t *pGyro);
+
+/*******************************************************************************
+ * Accelerometer, Temperature, Gyroscope and Magnetometer raw data in a single
+ * burst read (ACCEL_XOUT_H..EXT_SENS_DATA_06). mpu9250_initMag() first.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readRawData9(mpu9250_handle_t *pDevice,
+    mpu9250_rawData9_t *pRawData);
+
+/*******************************************************************************
+ * Scale raw 9 axes sample: Accelerometer [g], Gyroscope [dps], Magnetometer
+ * [uT] with ASA correction, rotated to the accelerometer/gyroscope axes.
+ * MPU9250_ERROR if the magnetometer overflowed (pMag not valid).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_convertData9_float(mpu9250_handle_t *pDevice,
+    mpu9250_rawData9_t *pRawData, float32_t *pAccel, float32_t *pGyro,
+    float32_t *pMag);
+
+/*******************************************************************************
+ * Return Accelerometer [g], Gyroscope [dps] and Magnetometer [uT] data
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readData9_float(mpu9250_handle_t *pDevice,
+    float32_t *pAccel, float32_t *pGyro, float32_t *pMag);
+
+/*******************************************************************************
+ * FIFO mode: Accelerometer, Temperature and Gyroscope sampled at sampleRate
+ * [Hz] (<= 1kHz, Gyro_LPF 5..184 Hz) into the FIFO. The FIFO stops when
+ * full and is reset after an overflow is reported.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_initFifo(mpu9250_handle_t *pDevice,
+    uint16_t sampleRate);
+
+/*******************************************************************************
+ * Drain the FIFO: read FIFO_COUNT, then up to MPU9250_FIFO_BLOCK_SIZE frames
+ * in a single burst.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readFifo(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock);
+
+/*******************************************************************************
+ * Non-blocking version of mpu9250_readFifo(). Count and data reads are
+ * chained on the I2C transaction queue with control priority (or SPI DMA).
+ * pBlock is valid when callback is called with MPU9250_OK.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readFifo_async(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock, mpu9250_callback_t callback);
+
+/*******************************************************************************
+ * Scale a FIFO block. pAccel, pGyro: pBlock->Count*3 values, XYZ interleaved.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_convertBlock_float(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock, float32_t *pAccel, float32_t *pGyro);
+
+/*******************************************************************************
+ * DWT cycles spent reading one sample.
+ * pCycles[0] --> register by register path.
+ * pCycles[1] --> burst read path.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_benchmarkRead(mpu9250_handle_t *pDevice,
+    uint32_t *pCycles);
 
 #endif /* MPU9250_H_ */
 // EOF =========================================================================
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * @file    prefilter.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Biquad prefilter bank for the fused gyroscope and accelerometer
+ *          blocks, ahead of the estimator.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - One cascade per sensor (PREFILTER_GYRO, PREFILTER_ACCEL) of up to
+    PREFILTER_MAX_SECTIONS second order sections, shared by its 3 axes.
+    Each axis keeps its own state.
+  - Sections (RBJ cookbook, bilinear transform at the sample rate):
+        PREFILTER_LOWPASS   Frequency = -3 dB point, Q = 0.707 Butterworth
+        PREFILTER_NOTCH     Frequency = centre, Q = centre / -3 dB width
+        PREFILTER_NONE      pass through. Trailing ones are not run
+  - Sections can be changed at run time (e.g. notch retuning): the state is
+    kept, only the coefficients change. A section turned on from
+    PREFILTER_NONE starts with its state cleared. They are swapped with
+    interrupts masked, so any context may retune while the tick filters.
+  - prefilter_processBlock(): the XYZ interleaved block is split in six
+    contiguous channels, each filtered by one
+    arm_biquad_cascade_df2T_f32() call over the whole block, and written
+    back in place.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef PREFILTER_H_
+#define PREFILTER_H_
+
+//Includes =====================================================================
+#include "mpu9250.h"
+
+// Enum & structs ==============================================================
+typedef enum
+{
+  PREFILTER_GYRO = 0,
+  PREFILTER_ACCEL,
+} prefilter_sensor_t;
+
+typedef enum
+{
+  PREFILTER_NONE = 0,
+  PREFILTER_LOWPASS,
+  PREFILTER_NOTCH,
+} prefilter_type_t;
+
+typedef struct
+{
+  prefilter_type_t Type;
+  float32_t Frequency;                /*!< [Hz], below half the sample rate */
+  float32_t Q;
+} prefilter_section_t;
+
+typedef struct
+{
+  uint8_t Sections[2];                /*!< Sections run, per sensor */
+  uint32_t Cycles;                    /*!< Last block [DWT cycles] */
+  uint32_t SampleCycles;              /*!< Last block, per sample */
+} prefilter_stats_t;
+
+// Constants ===================================================================
+#define PREFILTER_MAX_SECTIONS        4
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the bank, every section PREFILTER_NONE.
+ * @param   sampleRate: sensor sample rate [Hz].
+ * @retval  1 if successful. 0 if sampleRate is 0.
+ ******************************************************************************/
+uint8_t prefilter_init(float32_t sampleRate);
+/*******************************************************************************
+ * @brief   Set one section of a sensor cascade.
+ * @param   sensor: cascade.
+ * @param   index: section, 0..PREFILTER_MAX_SECTIONS-1.
+ * @param   pSection: type, frequency and Q.
+ * @retval  1 if successful. 0 if index, frequency or Q is out of range.
+ ******************************************************************************/
+uint8_t prefilter_setSection(prefilter_sensor_t sensor, uint8_t index,
+                             const prefilter_section_t *pSection);
+/*******************************************************************************
+ * @brief   Filter one block in place.
+ * @param   pAccel: accelerometer, XYZ interleaved.
+ * @param   pGyro: gyroscope, XYZ interleaved.
+ * @param   count: samples, up to MPU9250_FIFO_BLOCK_SIZE.
+ * @retval  None.
+ ******************************************************************************/
+void prefilter_processBlock(float32_t *pAccel, float32_t *pGyro,
+                            uint8_t count);
+/*******************************************************************************
+ * @brief   Clear the filter states (e.g. after a gap in the samples).
+ * @retval  None.
+ ******************************************************************************/
+void prefilter_reset(void);
+/*******************************************************************************
+ * @brief   Sections in use and cost.
+ * @retval  Statistics.
+ ******************************************************************************/
+const prefilter_stats_t *prefilter_getStats(void);
+
+#endif /* PREFILTER_H_ */
+// EOF =========================================================================
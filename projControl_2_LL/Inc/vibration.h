@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * @file    vibration.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Background vibration analyzer: spectrum of the fused gyroscope
+ *          samples, tracking of the dominant peaks (e.g. servo resonance)
+ *          and optional live retuning of a prefilter notch.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Collection, control tick: vibration_addBlock() copies one gyro axis of
+    the raw fused block (before the prefilter, so a notch does not hide its
+    own peak) into a VIBRATION_FFT_SIZE window. Windows are double buffered
+    and the axis goes round robin X, Y, Z. A full window is handed over only
+    if the previous one was taken, otherwise it is refilled (Dropped).
+    A block with no samples restarts the window.
+  - Analysis, main loop (thread mode, preempted by every interrupt):
+    vibration_process() removes the mean, applies a Hann window scaled so
+    the magnitudes are sine amplitudes [dps], runs arm_rfft_fast_f32() and
+    arm_cmplx_mag_f32(). The window is released as soon as it is copied.
+  - Peaks: local maxima over MinFrequency and Threshold, the
+    VIBRATION_MAX_PEAKS strongest per axis, frequency and amplitude by
+    parabolic interpolation between bins. A peak within
+    VIBRATION_TRACK_BINS of one of the previous window of that axis keeps
+    counting Stable windows.
+  - Auto notch: the strongest peak of any axis, Stable for
+    VIBRATION_STABLE_WINDOWS, sets the gyro section NotchSection of the
+    prefilter to a notch (NotchQ). Moves of less than half a bin are
+    ignored. After VIBRATION_LOST_WINDOWS windows with no stable peak the
+    section goes back to PREFILTER_NONE.
+  - Telemetry: the last spectrum is held (vibration_holdSpectrum) while it
+    is sent, analysis keeps running on its own buffer.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef VIBRATION_H_
+#define VIBRATION_H_
+
+//Includes =====================================================================
+#include "prefilter.h"
+
+// Constants ===================================================================
+#define VIBRATION_FFT_SIZE            512   /*!< 0.512 s, 1.95 Hz bins at 1 kHz */
+#define VIBRATION_BINS                (VIBRATION_FFT_SIZE/2 + 1)
+#define VIBRATION_MAX_PEAKS           2     /*!< Per axis */
+#define VIBRATION_TRACK_BINS          2.0f
+#define VIBRATION_STABLE_WINDOWS      3     /*!< Of the same axis */
+#define VIBRATION_LOST_WINDOWS        9     /*!< Any axis, 3 rounds */
+
+// Enum & structs ==============================================================
+typedef struct
+{
+  float32_t SampleRate;               /*!< Gyro samples [Hz] */
+  float32_t MinFrequency;             /*!< Peaks above [Hz] */
+  float32_t Threshold;                /*!< Peaks above [dps] */
+  uint8_t AutoNotch;                  /*!< 1: retune the notch */
+  uint8_t NotchSection;               /*!< Prefilter gyro section */
+  float32_t NotchQ;
+} vibration_init_t;
+
+typedef struct
+{
+  float32_t Frequency;                /*!< [Hz], 0: none */
+  float32_t Amplitude;                /*!< Sine amplitude [dps] */
+  uint8_t Stable;                     /*!< Windows in a row */
+} vibration_peak_t;
+
+typedef struct
+{
+  vibration_peak_t Peaks[3][VIBRATION_MAX_PEAKS]; /*!< Per axis, strongest first */
+  float32_t NotchFrequency;           /*!< [Hz], 0: no notch */
+  uint8_t Axis;                       /*!< Of the last window */
+  uint32_t Windows;                   /*!< Analysed */
+  uint32_t Dropped;                   /*!< Refilled, previous one not taken */
+  uint32_t Cycles;                    /*!< Last analysis, preemption included */
+} vibration_stats_t;
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the analyzer, no window, no notch.
+ * @param   vibration_InitStruct: settings.
+ * @retval  1 if successful. 0 if a setting is out of range.
+ ******************************************************************************/
+uint8_t vibration_init(vibration_init_t *vibration_InitStruct);
+/*******************************************************************************
+ * @brief   Collect the samples of one block. Control tick.
+ * @param   pGyro: gyroscope, XYZ interleaved [dps].
+ * @param   count: samples.
+ * @retval  None.
+ ******************************************************************************/
+void vibration_addBlock(const float32_t *pGyro, uint8_t count);
+/*******************************************************************************
+ * @brief   A full window waits for vibration_process().
+ * @retval  1 if a window is ready.
+ ******************************************************************************/
+uint8_t vibration_isReady(void);
+/*******************************************************************************
+ * @brief   Analyse the ready window, if any. Background (main loop).
+ * @retval  1 if a window was analysed.
+ ******************************************************************************/
+uint8_t vibration_process(void);
+/*******************************************************************************
+ * @brief   Restart the window being filled (e.g. after a gap in the
+ *          samples). Not while the tick runs.
+ * @retval  None.
+ ******************************************************************************/
+void vibration_reset(void);
+/*******************************************************************************
+ * @brief   Hold the last spectrum until vibration_releaseSpectrum().
+ * @param   pAxis: axis of the spectrum.
+ * @retval  VIBRATION_BINS amplitudes [dps], bin k at k*SampleRate/
+ *          VIBRATION_FFT_SIZE. 0 if there is no new one.
+ ******************************************************************************/
+const float32_t *vibration_holdSpectrum(uint8_t *pAxis);
+/*******************************************************************************
+ * @brief   Let the analysis update the spectrum again.
+ * @retval  None.
+ ******************************************************************************/
+void vibration_releaseSpectrum(void);
+/*******************************************************************************
+ * @brief   Peaks, notch and cost.
+ * @retval  Statistics.
+ ******************************************************************************/
+const vibration_stats_t *vibration_getStats(void);
+
+#endif /* VIBRATION_H_ */
+// EOF =========================================================================
@@ -0,0 +1,399 @@
+// Includes ====================================================================
+#include "cnc_i2c_queue.h"
+
+// Structures ==================================================================
+typedef enum
+{
+  I2C_SLOT_FREE = 0,
+  I2C_SLOT_PENDING,
+  I2C_SLOT_ACTIVE,
+} i2c_slot_state_t;
+
+typedef struct
+{
+  i2c_transaction_t transaction;
+  volatile i2c_slot_state_t state;
+  uint32_t sequence;                  /*!< Submit order */
+  uint32_t submitCycles;
+  uint8_t age;                        /*!< Times overtaken */
+} i2c_slot_t;
+
+/*!< Per-bus queue. One static context per I2C peripheral: the buses run
+ *   their transactions independently. */
+typedef struct
+{
+  I2C_TypeDef *Instance;
+  uint8_t Ready;                      /*!< cncI2CQueue_init() done */
+  i2c_slot_t Slots[I2C_QUEUE_SIZE];
+  i2c_slot_t *pActiveSlot;
+  uint32_t Sequence;
+  uint32_t StartCycles;               /*!< DWT->CYCCNT at the active start */
+  i2c_devStats_t DevStats[I2C_QUEUE_MAX_DEVICES];
+} i2c_queue_t;
+
+#define I2C_QUEUE_BUSES   3
+
+// =============================================================================
+static i2c_queue_t queues[I2C_QUEUE_BUSES];
+
+// Private functions prototypes ================================================
+static i2c_queue_t *cncI2CQueue_getQueue(I2C_TypeDef *I2Cx);
+static i2c_slot_t *cncI2CQueue_select(i2c_queue_t *pQueue);
+static i2c_devStats_t *cncI2CQueue_findStats(i2c_queue_t *pQueue,
+                                             uint8_t devAddr);
+static void cncI2CQueue_done(void *pContext, uint8_t status);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the transaction queue of a bus. cncI2C_InitDMA() must be called
+ *          first.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if successful. 0 if the instance is not supported.
+ ******************************************************************************/
+uint8_t cncI2CQueue_init(I2C_TypeDef *I2Cx)
+{
+  i2c_queue_t *pQueue = cncI2CQueue_getQueue(I2Cx);
+
+  if(pQueue == 0)
+    return 0;
+
+  for(uint8_t i = 0; i < I2C_QUEUE_SIZE; i++)
+    pQueue->Slots[i].state = I2C_SLOT_FREE;
+
+  for(uint8_t i = 0; i < I2C_QUEUE_MAX_DEVICES; i++)
+  {
+    pQueue->DevStats[i].DevAddr = 0x00;
+    pQueue->DevStats[i].Transactions = 0;
+    pQueue->DevStats[i].Errors = 0;
+    pQueue->DevStats[i].BusCycles = 0;
+    pQueue->DevStats[i].MaxBusCycles = 0;
+    pQueue->DevStats[i].MaxWaitCycles = 0;
+  }
+
+  pQueue->Instance = I2Cx;
+  pQueue->pActiveSlot = 0;
+  pQueue->Sequence = 0;
+  pQueue->Ready = 1;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Queue a transaction. The descriptor is copied, pData must remain
+ *          valid until the callback.
+ * @param   I2Cx: I2C instance.
+ * @param   pTransaction: transaction descriptor.
+ * @retval  1 if queued. 0 if the queue is full or not initialized.
+ ******************************************************************************/
+uint8_t cncI2CQueue_submit(I2C_TypeDef *I2Cx, i2c_transaction_t *pTransaction)
+{
+  i2c_queue_t *pQueue = cncI2CQueue_getQueue(I2Cx);
+  i2c_slot_t *pSlot = 0;
+  uint8_t status = 0;
+  uint32_t primask = __get_PRIMASK();
+
+  if((pQueue == 0) || (pQueue->Ready != 1) || (pTransaction->Count == 0))
+    return 0;
+
+  __disable_irq();
+  for(uint8_t i = 0; i < I2C_QUEUE_SIZE; i++)
+  {
+    pSlot = &pQueue->Slots[i];
+    if(pSlot->state == I2C_SLOT_FREE)
+    {
+      pSlot->transaction = *pTransaction;
+      pSlot->sequence = pQueue->Sequence++;
+      pSlot->submitCycles = DWT->CYCCNT;
+      pSlot->age = 0;
+      pSlot->state = I2C_SLOT_PENDING;
+      status = 1;
+      break;
+    }
+  }
+  __set_PRIMASK(primask);
+
+  if(status == 1)
+    cncI2CQueue_process(I2Cx);
+
+  return status;
+}
+
+/*******************************************************************************
+ * @brief   Start the next pending transaction if the bus is idle. Called by
+ *          submit and on completion; call it periodically to retry after a
+ *          busy bus (e.g. blocking cncI2C_* calls) and to abort a transfer
+ *          past its deadline.
+ * @param   I2Cx: I2C instance.
+ * @retval  None.
+ ******************************************************************************/
+void cncI2CQueue_process(I2C_TypeDef *I2Cx)
+{
+  i2c_queue_t *pQueue = cncI2CQueue_getQueue(I2Cx);
+  i2c_slot_t *pSlot = 0;
+  i2c_devStats_t *pStats = 0;
+  uint8_t aDev[2] = { 0 };
+  uint8_t started = 0;
+  uint32_t waitCycles = 0;
+  uint32_t primask = __get_PRIMASK();
+
+  if((pQueue == 0) || (pQueue->Ready != 1))
+    return;
+
+  /*!< Stuck transfer: aborted with status 0, bus recovered */
+  cncI2C_checkTimeoutAsync(I2Cx);
+
+  __disable_irq();
+  if((pQueue->pActiveSlot != 0) || (cncI2C_isBusyAsync(I2Cx) == 1))
+  {
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  pSlot = cncI2CQueue_select(pQueue);
+  if(pSlot == 0)
+  {
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  /*!< Claimed: process() from other contexts returns on pActiveSlot. The
+   *   start waits for the previous STOP (up to I2C_STOP_WAIT_BITS), so it
+   *   runs unmasked */
+  pSlot->state = I2C_SLOT_ACTIVE;
+  pQueue->pActiveSlot = pSlot;
+  pQueue->StartCycles = DWT->CYCCNT;
+  waitCycles = pQueue->StartCycles - pSlot->submitCycles;
+  __set_PRIMASK(primask);
+
+  aDev[0] = pSlot->transaction.DevAddr;
+  aDev[1] = pSlot->transaction.RegAddr;
+
+  if(pSlot->transaction.TimeoutUs != 0)
+    cncI2C_setTimeout(I2Cx, pSlot->transaction.TimeoutUs);
+  else
+    cncI2C_setTimeout(I2Cx, I2C_TIMEOUT_DEFAULT_US);
+
+  if(pSlot->transaction.Direction == I2C_QUEUE_READ)
+    started = cncI2C_ReadAsync(I2Cx, &aDev[0], pSlot->transaction.pData,
+                               pSlot->transaction.Count, &cncI2CQueue_done,
+                               pQueue);
+  else
+    started = cncI2C_WriteAsync(I2Cx, &aDev[0], pSlot->transaction.pData,
+                                pSlot->transaction.Count, &cncI2CQueue_done,
+                                pQueue);
+
+  /*!< Bus busy (blocking transfer in progress): retry on next process */
+  __disable_irq();
+  if(started != 1)
+  {
+    pSlot->state = I2C_SLOT_PENDING;
+    pQueue->pActiveSlot = 0;
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  /*!< The slot may already be done and reused: aDev[0] is its device */
+  pStats = cncI2CQueue_findStats(pQueue, aDev[0]);
+  if((pStats != 0) && (waitCycles > pStats->MaxWaitCycles))
+    pStats->MaxWaitCycles = waitCycles;
+
+  /*!< Every other pending transaction has been overtaken once more */
+  for(uint8_t i = 0; i < I2C_QUEUE_SIZE; i++)
+  {
+    pSlot = &pQueue->Slots[i];
+    if((pSlot->state == I2C_SLOT_PENDING) && (pSlot->age < I2C_QUEUE_AGING_MAX))
+      pSlot->age++;
+  }
+  __set_PRIMASK(primask);
+}
+
+/*******************************************************************************
+ * @brief   Number of pending (not yet started) transactions.
+ * @param   I2Cx: I2C instance.
+ * @retval  Pending transactions.
+ ******************************************************************************/
+uint8_t cncI2CQueue_getPending(I2C_TypeDef *I2Cx)
+{
+  i2c_queue_t *pQueue = cncI2CQueue_getQueue(I2Cx);
+  uint8_t n = 0;
+
+  if(pQueue == 0)
+    return 0;
+
+  for(uint8_t i = 0; i < I2C_QUEUE_SIZE; i++)
+  {
+    if(pQueue->Slots[i].state == I2C_SLOT_PENDING)
+      n++;
+  }
+
+  return n;
+}
+
+/*******************************************************************************
+ * @brief   Pending transactions with none on the bus: the previous completion
+ *          did not start the next one (e.g. a blocking transfer held the
+ *          bus). cncI2CQueue_process() restarts them.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if stalled. 0 if not.
+ ******************************************************************************/
+uint8_t cncI2CQueue_isStalled(I2C_TypeDef *I2Cx)
+{
+  i2c_queue_t *pQueue = cncI2CQueue_getQueue(I2Cx);
+
+  if(pQueue == 0)
+    return 0;
+
+  return ((pQueue->pActiveSlot == 0) && (cncI2CQueue_getPending(I2Cx) != 0))
+      ? 1 : 0;
+}
+
+/*******************************************************************************
+ * @brief   Bus time statistics of a device.
+ * @param   I2Cx: I2C instance.
+ * @param   devAddr: 7 bits device's address.
+ * @param   pStats: statistics output.
+ * @retval  1 if the device has statistics. 0 if unknown.
+ ******************************************************************************/
+uint8_t cncI2CQueue_getStats(I2C_TypeDef *I2Cx, uint8_t devAddr,
+                             i2c_devStats_t *pStats)
+{
+  i2c_queue_t *pQueue = cncI2CQueue_getQueue(I2Cx);
+
+  if(pQueue == 0)
+    return 0;
+
+  for(uint8_t i = 0; i < I2C_QUEUE_MAX_DEVICES; i++)
+  {
+    if(pQueue->DevStats[i].DevAddr == devAddr)
+    {
+      *pStats = pQueue->DevStats[i];
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Private functions ===========================================================
+/*******************************************************************************
+ * @brief   Queue of an I2C instance.
+ * @param   I2Cx: I2C instance (I2C1, I2C2 or I2C3).
+ * @retval  Queue. 0 if the instance is not supported.
+ ******************************************************************************/
+static i2c_queue_t *cncI2CQueue_getQueue(I2C_TypeDef *I2Cx)
+{
+  if(I2Cx == I2C1)
+    return &queues[0];
+
+  if(I2Cx == I2C2)
+    return &queues[1];
+
+  if(I2Cx == I2C3)
+    return &queues[2];
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @brief   Next pending transaction: lowest priority value (aged transactions
+ *          count as control priority), then lowest sequence.
+ * @param   pQueue: bus queue.
+ * @retval  Selected slot. 0 if the queue is empty.
+ ******************************************************************************/
+static i2c_slot_t *cncI2CQueue_select(i2c_queue_t *pQueue)
+{
+  i2c_slot_t *pSlot = 0;
+  i2c_slot_t *pBest = 0;
+  i2c_priority_t bestPriority = I2C_QUEUE_PRIORITY_HOUSEKEEPING;
+  i2c_priority_t priority = I2C_QUEUE_PRIORITY_HOUSEKEEPING;
+
+  for(uint8_t i = 0; i < I2C_QUEUE_SIZE; i++)
+  {
+    pSlot = &pQueue->Slots[i];
+    if(pSlot->state != I2C_SLOT_PENDING)
+      continue;
+
+    priority = pSlot->transaction.Priority;
+    if(pSlot->age >= I2C_QUEUE_AGING_MAX)
+      priority = I2C_QUEUE_PRIORITY_CONTROL;
+
+    if((pBest == 0) || (priority < bestPriority) ||
+       ((priority == bestPriority) && (pSlot->sequence < pBest->sequence)))
+    {
+      pBest = pSlot;
+      bestPriority = priority;
+    }
+  }
+
+  return pBest;
+}
+
+/*******************************************************************************
+ * @brief   Statistics entry of a device, created on first use.
+ * @param   pQueue: bus queue.
+ * @param   devAddr: 7 bits device's address.
+ * @retval  Statistics entry. 0 if table is full.
+ ******************************************************************************/
+static i2c_devStats_t *cncI2CQueue_findStats(i2c_queue_t *pQueue,
+                                             uint8_t devAddr)
+{
+  for(uint8_t i = 0; i < I2C_QUEUE_MAX_DEVICES; i++)
+  {
+    if(pQueue->DevStats[i].DevAddr == devAddr)
+      return &pQueue->DevStats[i];
+  }
+
+  for(uint8_t i = 0; i < I2C_QUEUE_MAX_DEVICES; i++)
+  {
+    if(pQueue->DevStats[i].DevAddr == 0x00)
+    {
+      pQueue->DevStats[i].DevAddr = devAddr;
+      return &pQueue->DevStats[i];
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @brief   Asynchronous transfer done (interrupt context): update statistics,
+ *          release the slot, notify and start the next transaction.
+ * @param   pContext: bus queue.
+ * @param   status: 1 if successful, 0 if fail.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2CQueue_done(void *pContext, uint8_t status)
+{
+  i2c_queue_t *pQueue = (i2c_queue_t *) pContext;
+  i2c_slot_t *pSlot = pQueue->pActiveSlot;
+  i2c_devStats_t *pStats = 0;
+  i2c_transaction_t transaction;
+  uint32_t busCycles = DWT->CYCCNT - pQueue->StartCycles;
+
+  if(pSlot == 0)
+    return;
+
+  pStats = cncI2CQueue_findStats(pQueue, pSlot->transaction.DevAddr);
+  if(pStats != 0)
+  {
+    pStats->Transactions++;
+    pStats->BusCycles += busCycles;
+
+    if(busCycles > pStats->MaxBusCycles)
+      pStats->MaxBusCycles = busCycles;
+
+    if(status != 1)
+      pStats->Errors++;
+  }
+
+  transaction = pSlot->transaction;
+  pSlot->state = I2C_SLOT_FREE;
+  pQueue->pActiveSlot = 0;
+
+  if(transaction.Callback != 0)
+    transaction.Callback(transaction.pContext, status);
+
+  cncI2CQueue_process(pQueue->Instance);
+}
+
+// EOF =========================================================================
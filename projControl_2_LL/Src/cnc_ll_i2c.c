@@ -2,19 +2,36 @@
 #include "cnc_ll_i2c.h"
 
 // Structures ==================================================================
-typedef struct
-{
-  GPIO_TypeDef *GPIO_PORT;
-  uint32_t GPIO_PIN_SCL;
-  uint32_t GPIO_PIN_SDA;
-  uint32_t GPIO_ALTERNATE;
-} i2c_gpio_t;
+typedef uint32_t (*i2c_flag_t)(I2C_TypeDef *I2Cx);
 
 // Constants ===================================================================
-static __I i2c_gpio_t I2C1_PERIPH = { GPIOB, LL_GPIO_PIN_6, LL_GPIO_PIN_7,
-    LL_GPIO_AF_4 };
+static const i2c_gpio_t I2C1_GPIO = { GPIOB, LL_GPIO_PIN_6, GPIOB,
+    LL_GPIO_PIN_7, LL_GPIO_AF_4, LL_AHB1_GRP1_PERIPH_GPIOB,
+    LL_APB1_GRP1_PERIPH_I2C1 };
+static const i2c_gpio_t I2C2_GPIO = { GPIOB, LL_GPIO_PIN_10, GPIOB,
+    LL_GPIO_PIN_11, LL_GPIO_AF_4, LL_AHB1_GRP1_PERIPH_GPIOB,
+    LL_APB1_GRP1_PERIPH_I2C2 };
+static const i2c_gpio_t I2C3_GPIO = { GPIOA, LL_GPIO_PIN_8, GPIOC,
+    LL_GPIO_PIN_9, LL_GPIO_AF_4,
+    (LL_AHB1_GRP1_PERIPH_GPIOA | LL_AHB1_GRP1_PERIPH_GPIOC),
+    LL_APB1_GRP1_PERIPH_I2C3 };
+
+static const i2c_dma_t I2C1_DMA = { DMA1, LL_DMA_STREAM_0, LL_DMA_STREAM_6,
+    LL_DMA_CHANNEL_1, DMA1_Stream0_IRQn, DMA1_Stream6_IRQn };
+static const i2c_dma_t I2C2_DMA = { DMA1, LL_DMA_STREAM_3, LL_DMA_STREAM_7,
+    LL_DMA_CHANNEL_7, DMA1_Stream3_IRQn, DMA1_Stream7_IRQn };
+static const i2c_dma_t I2C3_DMA = { DMA1, LL_DMA_STREAM_2, LL_DMA_STREAM_4,
+    LL_DMA_CHANNEL_3, DMA1_Stream2_IRQn, DMA1_Stream4_IRQn };
+
+/*!< Flag position of streams 0..3 in LISR/LIFCR (4..7 in HISR/HIFCR) */
+static const uint8_t DMA_FLAG_SHIFT[4] = { 0, 6, 16, 22 };
+static __I uint32_t DMA_FLAG_ALL = 0x3D;          /*!< FE, DME, TE, HT, TC */
+static __I uint32_t DMA_FLAG_TE = (0x01 << 3);
+static __I uint32_t DMA_FLAG_TC = (0x01 << 5);
+
+static __I uint32_t RECOVERY_PULSES = 9;
+static __I uint32_t RECOVERY_HALF_PERIOD_US = 5;  /*!< 100 kHz SCL */
 
-static __I uint32_t TIMEOUT_MAX = 1000;
 static __I uint8_t I2C_ACK = 0x01;
 static __I uint8_t I2C_NACK = 0x00;
 
@@ -24,54 +41,99 @@ static __I uint8_t I2C_ADD0_WRITE = ~(0x01 << 0);
 static __I uint8_t I2C_MODE_WRITE = 0x00;
 static __I uint8_t I2C_MODE_READ = 0x01;
 
+#define I2C_INSTANCES   3
+
 // =============================================================================
-static __IO uint32_t timeout = 0;
+static cncI2C_handle_t i2cHandle[I2C_INSTANCES] =
+{
+  { I2C1, &I2C1_GPIO, &I2C1_DMA, I2C1_EV_IRQn, I2C1_ER_IRQn, 0, 0, 0, 0, 0, 0,
+    { I2C_ASYNC_IDLE, 0, 0, 0, 0, 0, 0, 0 } },
+  { I2C2, &I2C2_GPIO, &I2C2_DMA, I2C2_EV_IRQn, I2C2_ER_IRQn, 0, 0, 0, 0, 0, 0,
+    { I2C_ASYNC_IDLE, 0, 0, 0, 0, 0, 0, 0 } },
+  { I2C3, &I2C3_GPIO, &I2C3_DMA, I2C3_EV_IRQn, I2C3_ER_IRQn, 0, 0, 0, 0, 0, 0,
+    { I2C_ASYNC_IDLE, 0, 0, 0, 0, 0, 0, 0 } },
+};
 
 // Private functions prototypes ================================================
+static void cncI2C_Config(cncI2C_handle_t *hI2C);
+static uint8_t cncI2C_Recover(cncI2C_handle_t *hI2C);
+static void cncI2C_DelayUs(uint32_t us);
+static uint8_t cncI2C_Begin(cncI2C_handle_t *hI2C);
+static uint8_t cncI2C_WaitStop(cncI2C_handle_t *hI2C);
+static uint8_t cncI2C_WaitFlag(
+    cncI2C_handle_t *hI2C, i2c_flag_t isActiveFlag, uint32_t state);
 static uint8_t cncI2C_Start(
-    I2C_TypeDef *I2Cx, uint8_t devAddr, uint8_t mode, uint8_t ack);
-static uint8_t cncI2C_Stop(I2C_TypeDef *I2Cx);
-static uint8_t cncI2C_WriteData(I2C_TypeDef *I2Cx, uint8_t data);
-static uint8_t cncI2C_ReadData(I2C_TypeDef *I2Cx, uint8_t ack);
+    cncI2C_handle_t *hI2C, uint8_t devAddr, uint8_t mode, uint8_t ack);
+static uint8_t cncI2C_Stop(cncI2C_handle_t *hI2C);
+static uint8_t cncI2C_WriteData(cncI2C_handle_t *hI2C, uint8_t data);
+static uint8_t cncI2C_ReadData(cncI2C_handle_t *hI2C, uint8_t ack);
+static void cncI2C_InitStream(cncI2C_handle_t *hI2C, uint32_t stream,
+                              uint32_t direction);
+static uint32_t cncI2C_GetFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream);
+static void cncI2C_ClearFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream);
+static uint8_t cncI2C_StartAsync(I2C_TypeDef *I2Cx, uint8_t *pDev,
+                                 uint8_t *pData, uint8_t count, uint8_t mode,
+                                 cncI2C_callback_t callback, void *pContext);
+static void cncI2C_EventHandler(cncI2C_handle_t *hI2C);
+static void cncI2C_ErrorHandler(cncI2C_handle_t *hI2C);
+static void cncI2C_RxHandlerDMA(cncI2C_handle_t *hI2C);
+static void cncI2C_TxHandlerDMA(cncI2C_handle_t *hI2C);
+static void cncI2C_AbortAsync(cncI2C_handle_t *hI2C);
+static void cncI2C_EndAsync(cncI2C_handle_t *hI2C, uint8_t status);
 
 // Public functions ============================================================
+/*******************************************************************************
+ * @brief   Driver context of an I2C instance.
+ * @param   I2Cx: I2C instance (I2C1, I2C2 or I2C3).
+ * @retval  Handle. 0 if the instance is not supported.
+ ******************************************************************************/
+cncI2C_handle_t *cncI2C_getHandle(I2C_TypeDef *I2Cx)
+{
+  for(uint8_t i = 0; i < I2C_INSTANCES; i++)
+  {
+    if(i2cHandle[i].Instance == I2Cx)
+      return &i2cHandle[i];
+  }
+
+  return 0;
+}
+
 /*******************************************************************************
  * @brief   Init I2C bus.
  * @param   I2Cx: I2C instance.
  * @param   freq: Clock frequency.
- * @retval  1 if the device is connected or 0 isn't.
+ * @retval  1 if successful. 0 if the instance is not supported.
  ******************************************************************************/
 uint8_t cncI2C_Init(I2C_TypeDef *I2Cx, uint32_t freq)
 {
-  // TODO: Implement others I2C instances.
-  LL_I2C_InitTypeDef I2C_InitStruct;
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
   LL_GPIO_InitTypeDef GPIO_InitStruct;
 
-  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_GPIOB);
+  if(hI2C == 0)
+    return 0;
+
+  LL_AHB1_GRP1_EnableClock(hI2C->pGpio->GPIO_CLOCK);
 
-  GPIO_InitStruct.Pin = (I2C1_PERIPH.GPIO_PIN_SCL | I2C1_PERIPH.GPIO_PIN_SDA);
+  GPIO_InitStruct.Pin = hI2C->pGpio->GPIO_PIN_SCL;
   GPIO_InitStruct.Mode = LL_GPIO_MODE_ALTERNATE;
   GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_OPENDRAIN;
   GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
   GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_VERY_HIGH;
-  GPIO_InitStruct.Alternate = I2C1_PERIPH.GPIO_ALTERNATE;
-  LL_GPIO_Init(I2C1_PERIPH.GPIO_PORT, &GPIO_InitStruct);
+  GPIO_InitStruct.Alternate = hI2C->pGpio->GPIO_ALTERNATE;
+  LL_GPIO_Init(hI2C->pGpio->GPIO_PORT_SCL, &GPIO_InitStruct);
 
-  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_I2C1);
-  I2C_InitStruct.PeripheralMode = LL_I2C_MODE_I2C;
-  I2C_InitStruct.ClockSpeed = freq;
-  I2C_InitStruct.DutyCycle = LL_I2C_DUTYCYCLE_2;
-  I2C_InitStruct.OwnAddrSize = LL_I2C_OWNADDRESS1_7BIT;
-  I2C_InitStruct.OwnAddress1 = 0x00;
-  I2C_InitStruct.TypeAcknowledge = LL_I2C_ACK;
-  LL_I2C_Init(I2Cx, &I2C_InitStruct);
+  GPIO_InitStruct.Pin = hI2C->pGpio->GPIO_PIN_SDA;
+  LL_GPIO_Init(hI2C->pGpio->GPIO_PORT_SDA, &GPIO_InitStruct);
 
-  LL_I2C_SetOwnAddress2(I2Cx, 0x00);
-  LL_I2C_DisableOwnAddress2(I2Cx);
-  LL_I2C_DisableGeneralCall(I2Cx);
-  LL_I2C_EnableClockStretching(I2Cx);
+  LL_APB1_GRP1_EnableClock(hI2C->pGpio->I2C_CLOCK);
+  hI2C->Frequency = freq;
+  cncI2C_Config(hI2C);
 
-  return 1;
+  hI2C->TimeoutCount = 0;
+  hI2C->ErrorCount = 0;
+  hI2C->RecoveryCount = 0;
+
+  return cncI2C_setTimeout(I2Cx, I2C_TIMEOUT_DEFAULT_US);
 }
 
 /*******************************************************************************
@@ -82,47 +144,32 @@ uint8_t cncI2C_Init(I2C_TypeDef *I2Cx, uint32_t freq)
  ******************************************************************************/
 uint8_t cncI2C_isDeviceReady(I2C_TypeDef *I2Cx, uint8_t devAddr)
 {
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
   __IO uint8_t tmpAddr = (devAddr << 1);
 
+  if(hI2C == 0)
+    return 0;
+
   /*Check if I2C instance is enabled*/
   if(LL_I2C_IsEnabled(I2Cx) != 1)
     LL_I2C_Enable(I2Cx);
 
-  while(LL_I2C_IsActiveFlag_BUSY(I2Cx) == 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_Begin(hI2C) != 1)
+    return 0;
+
   // TODO: Change for cncI2C_Start function.
   LL_I2C_GenerateStartCondition(I2Cx);
 
   /*Wait for Start condition flag*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_SB(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_SB, 1) != 1)
+    return 0;
 
   LL_I2C_AcknowledgeNextData(I2Cx, LL_I2C_NACK);
   tmpAddr &= I2C_ADD0_WRITE;
   LL_I2C_TransmitData8(I2Cx, tmpAddr);
 
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_ADDR(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_ADDR, 1) != 1)
+    return 0;
 
   LL_I2C_ClearFlag_ADDR(I2Cx);
   LL_I2C_GenerateStopCondition(I2Cx);
@@ -139,28 +186,26 @@ uint8_t cncI2C_isDeviceReady(I2C_TypeDef *I2Cx, uint8_t devAddr)
  ******************************************************************************/
 uint8_t cncI2C_WriteByte(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t data)
 {
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+
+  if(hI2C == 0)
+    return 0;
+
   /*Check if I2C instance is enabled*/
   if(LL_I2C_IsEnabled(I2Cx) != 1)
     LL_I2C_Enable(I2Cx);
 
   /*Check if I2C bus is busy*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_BUSY(I2Cx) == 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_Begin(hI2C) != 1)
+    return 0;
 
-  if(cncI2C_Start(I2Cx, pDev[0], I2C_MODE_WRITE, I2C_NACK) != 1)
+  if(cncI2C_Start(hI2C, pDev[0], I2C_MODE_WRITE, I2C_NACK) != 1)
     return 0;
-  if(cncI2C_WriteData(I2Cx, pDev[1]) != 1)
+  if(cncI2C_WriteData(hI2C, pDev[1]) != 1)
     return 0;
-  if(cncI2C_WriteData(I2Cx, data) != 1)
+  if(cncI2C_WriteData(hI2C, data) != 1)
     return 0;
-  if(cncI2C_Stop(I2Cx) != 1)
+  if(cncI2C_Stop(hI2C) != 1)
     return 0;
 
   return 1;
@@ -176,35 +221,32 @@ uint8_t cncI2C_WriteByte(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t data)
 uint8_t cncI2C_WriteMultipleBytes(
     I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData, uint8_t count)
 {
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
   uint8_t n = 0;
 
+  if(hI2C == 0)
+    return 0;
+
   /*Check if I2C instance is enabled*/
   if(LL_I2C_IsEnabled(I2Cx) != 1)
     LL_I2C_Enable(I2Cx);
 
   /*Check if I2C bus is busy*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_BUSY(I2Cx) == 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_Begin(hI2C) != 1)
+    return 0;
 
-  if(cncI2C_Start(I2Cx, pDev[0], I2C_MODE_WRITE, I2C_NACK) != 1)
+  if(cncI2C_Start(hI2C, pDev[0], I2C_MODE_WRITE, I2C_NACK) != 1)
     return 0;
-  if(cncI2C_WriteData(I2Cx, pDev[1]) != 1)
+  if(cncI2C_WriteData(hI2C, pDev[1]) != 1)
     return 0;
 
   while(count--)
   {
-    if(cncI2C_WriteData(I2Cx, *pData++) == 1)
+    if(cncI2C_WriteData(hI2C, *pData++) == 1)
       n++;
   }
 
-  if(cncI2C_Stop(I2Cx) != 1)
+  if(cncI2C_Stop(hI2C) != 1)
     return 0;
 
   return n;
@@ -219,29 +261,27 @@ uint8_t cncI2C_WriteMultipleBytes(
  ******************************************************************************/
 uint8_t cncI2C_ReadByte(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData)
 {
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+
+  if(hI2C == 0)
+    return 0;
+
   if(LL_I2C_IsEnabled(I2Cx) != 1)
     LL_I2C_Enable(I2Cx);
 
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_BUSY(I2Cx) == 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_Begin(hI2C) != 1)
+    return 0;
 
-  if(cncI2C_Start(I2Cx, pDev[0], I2C_MODE_WRITE, I2C_NACK) != 1)
+  if(cncI2C_Start(hI2C, pDev[0], I2C_MODE_WRITE, I2C_NACK) != 1)
     return 0;
-  if(cncI2C_WriteData(I2Cx, pDev[1]) != 1)
+  if(cncI2C_WriteData(hI2C, pDev[1]) != 1)
     return 0;
-  if(cncI2C_Stop(I2Cx) != 1)
+  if(cncI2C_Stop(hI2C) != 1)
     return 0;
-  if(cncI2C_Start(I2Cx, pDev[0], I2C_MODE_READ, I2C_NACK) != 1)
+  if(cncI2C_Start(hI2C, pDev[0], I2C_MODE_READ, I2C_NACK) != 1)
     return 0;
 
-  *pData = cncI2C_ReadData(I2Cx, I2C_NACK);
+  *pData = cncI2C_ReadData(hI2C, I2C_NACK);
 
   return 1;
 }
@@ -251,68 +291,446 @@ uint8_t cncI2C_ReadByte(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData)
  * @param   I2Cx: I2C instance.
  * @param   pDev: pDev[0]: 7 bits device's address. pDev[1]: register address.
  * @param   pData: pointer to data array to store bytes from slave.
+ * @param   count: number of bytes to be read.
  * @retval  1 if successful. 0 if fail.
+ * @note    Single transaction with repeated start. The slave auto-increments
+ *          the register address. The last bytes follow the RM0090 master
+ *          receiver sequence: NACK and STOP are programmed while the bus is
+ *          stretched (BTF), so the slave never clocks out an extra byte.
  ******************************************************************************/
 uint8_t cncI2C_ReadMultipleBytes(
     I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData, uint8_t count)
 {
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+
+  if((hI2C == 0) || (count == 0))
+    return 0;
+
+  if(count == 1)
+    return cncI2C_ReadByte(I2Cx, pDev, pData);
+
   if(LL_I2C_IsEnabled(I2Cx) != 1)
     LL_I2C_Enable(I2Cx);
 
   /*Check if I2C bus is busy*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_BUSY(I2Cx) == 1)
+  if(cncI2C_Begin(hI2C) != 1)
+    return 0;
+
+  if(cncI2C_Start(hI2C, pDev[0], I2C_MODE_WRITE, I2C_NACK) != 1)
+    return 0;
+  if(cncI2C_WriteData(hI2C, pDev[1]) != 1)
+    return 0;
+
+  /*Wait until register address is sent before the repeated start*/
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_BTF, 1) != 1)
+    return 0;
+
+  /*Two bytes: NACK applies to the byte in the shift register (POS = 1)*/
+  if(count == 2)
   {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
+    LL_I2C_EnableBitPOS(I2Cx);
+    if(cncI2C_Start(hI2C, pDev[0], I2C_MODE_READ, I2C_NACK) != 1)
+      return 0;
+  }
+  else
+  {
+    if(cncI2C_Start(hI2C, pDev[0], I2C_MODE_READ, I2C_ACK) != 1)
+      return 0;
+  }
+
+  /*Bytes 1..N-3: plain ACKed reception*/
+  while(count > 3)
+  {
+    if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_RXNE, 1) != 1)
+      return 0;
+
+    *pData++ = LL_I2C_ReceiveData8(I2Cx);
+    count--;
+  }
+
+  /*Wait for BTF: byte N-2 in DR and byte N-1 in shift register*/
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_BTF, 1) != 1)
+    return 0;
+
+  if(count == 3)
+  {
+    /*NACK byte N, read N-2 and wait for N-1 and N to be received*/
+    LL_I2C_AcknowledgeNextData(I2Cx, LL_I2C_NACK);
+    *pData++ = LL_I2C_ReceiveData8(I2Cx);
+
+    if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_BTF, 1) != 1)
+      return 0;
   }
 
-  if(cncI2C_Start(I2Cx, pDev[0], I2C_MODE_WRITE, I2C_ACK) != 1)
+  LL_I2C_GenerateStopCondition(I2Cx);
+  *pData++ = LL_I2C_ReceiveData8(I2Cx);
+  *pData = LL_I2C_ReceiveData8(I2Cx);
+
+  LL_I2C_DisableBitPOS(I2Cx);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Init DMA streams and interrupts for asynchronous transfers.
+ * @param   I2Cx: I2C instance. DMA1 streams:
+ *          I2C1: Stream0 (RX) / Stream6 (TX), Channel 1.
+ *          I2C2: Stream3 (RX) / Stream7 (TX), Channel 7.
+ *          I2C3: Stream2 (RX) / Stream4 (TX), Channel 3.
+ * @retval  1 if successful. 0 if fail.
+ ******************************************************************************/
+uint8_t cncI2C_InitDMA(I2C_TypeDef *I2Cx)
+{
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+  uint32_t nvic_priority = 0;
+
+  if(hI2C == 0)
+    return 0;
+
+  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+
+  cncI2C_InitStream(hI2C, hI2C->pDma->STREAM_RX,
+                    LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  cncI2C_InitStream(hI2C, hI2C->pDma->STREAM_TX,
+                    LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+
+  /*!< Bus events must preempt the sampler (data-ready EXTI) that starts the
+   *   transfer */
+  nvic_priority = NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0);
+  NVIC_SetPriority(hI2C->IRQ_EV, nvic_priority);
+  NVIC_SetPriority(hI2C->IRQ_ER, nvic_priority);
+  NVIC_SetPriority(hI2C->pDma->IRQ_RX, nvic_priority);
+  NVIC_SetPriority(hI2C->pDma->IRQ_TX, nvic_priority);
+  NVIC_EnableIRQ(hI2C->IRQ_EV);
+  NVIC_EnableIRQ(hI2C->IRQ_ER);
+  NVIC_EnableIRQ(hI2C->pDma->IRQ_RX);
+  NVIC_EnableIRQ(hI2C->pDma->IRQ_TX);
+
+  hI2C->Async.state = I2C_ASYNC_IDLE;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Start a non-blocking register read (I2C events + DMA).
+ * @param   I2Cx: I2C instance.
+ * @param   pDev: pDev[0]: 7 bits device's address. pDev[1]: register address.
+ * @param   pData: buffer for the bytes from slave. Valid after callback.
+ * @param   count: number of bytes to be read.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncI2C_ReadAsync(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData,
+                         uint8_t count, cncI2C_callback_t callback,
+                         void *pContext)
+{
+  return cncI2C_StartAsync(I2Cx, pDev, pData, count, I2C_MODE_READ, callback,
+                           pContext);
+}
+
+/*******************************************************************************
+ * @brief   Start a non-blocking register write (I2C events + DMA).
+ * @param   I2Cx: I2C instance.
+ * @param   pDev: pDev[0]: 7 bits device's address. pDev[1]: register address.
+ * @param   pData: bytes to be written. Must remain valid until callback.
+ * @param   count: number of bytes to be written.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncI2C_WriteAsync(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData,
+                          uint8_t count, cncI2C_callback_t callback,
+                          void *pContext)
+{
+  return cncI2C_StartAsync(I2Cx, pDev, pData, count, I2C_MODE_WRITE, callback,
+                           pContext);
+}
+
+/*******************************************************************************
+ * @brief   Check if an asynchronous transfer is in progress.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if busy. 0 if idle.
+ ******************************************************************************/
+uint8_t cncI2C_isBusyAsync(I2C_TypeDef *I2Cx)
+{
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+
+  if(hI2C == 0)
     return 0;
-  if(cncI2C_WriteData(I2Cx, pDev[1]) != 1)
+
+  return (hI2C->Async.state != I2C_ASYNC_IDLE) ? 1 : 0;
+}
+
+/*******************************************************************************
+ * @brief   Set the deadline of the next transactions (blocking and async).
+ * @param   I2Cx: I2C instance.
+ * @param   timeout_us: time from start to end of transaction [us].
+ * @retval  1 if successful. 0 if the instance is not supported.
+ * @note    On expiry the bus is recovered: 9 SCL pulses, STOP, SWRST and
+ *          re-init. The transaction fails and TimeoutCount/RecoveryCount are
+ *          incremented.
+ ******************************************************************************/
+uint8_t cncI2C_setTimeout(I2C_TypeDef *I2Cx, uint32_t timeout_us)
+{
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+
+  if(hI2C == 0)
     return 0;
-  if(cncI2C_Start(I2Cx, pDev[0], I2C_MODE_READ, I2C_ACK) != 1)
+
+  hI2C->TimeoutCycles = timeout_us*(SystemCoreClock/1000000);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Abort the asynchronous transfer if it is past its deadline and
+ *          recover the bus. Call it periodically (e.g. sampler tick).
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if the transfer was aborted. 0 if not.
+ ******************************************************************************/
+uint8_t cncI2C_checkTimeoutAsync(I2C_TypeDef *I2Cx)
+{
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+  uint8_t aborted = 0;
+  uint32_t primask = __get_PRIMASK();
+
+  if(hI2C == 0)
     return 0;
 
-  while(count--)
+  /*!< The transfer must not end in an interrupt while it is aborted. Only
+   *   the abort is masked: the recovery takes ~100 us of SCL pulses */
+  __disable_irq();
+  if((hI2C->Async.state != I2C_ASYNC_IDLE) &&
+     (hI2C->Async.state != I2C_ASYNC_RECOVER) &&
+     ((DWT->CYCCNT - hI2C->StartCycles) > hI2C->TimeoutCycles))
   {
-    if(count != 0)
-      *pData++ = cncI2C_ReadData(I2Cx, I2C_NACK);
-    else
-      *pData++ = cncI2C_ReadData(I2Cx, I2C_ACK);
+    hI2C->TimeoutCount++;
+    cncI2C_AbortAsync(hI2C);
+    aborted = 1;
   }
+  __set_PRIMASK(primask);
 
-  return 1;
+  /*!< The bus stays owned (I2C_ASYNC_RECOVER) until the callback */
+  if(aborted == 1)
+    cncI2C_Recover(hI2C);
+
+  return aborted;
+}
+
+/*******************************************************************************
+ * @brief   Release a bus held low by a slave: 9 SCL pulses, STOP condition,
+ *          peripheral software reset and re-init.
+ * @param   I2Cx: I2C instance.
+ * @retval  1 if SDA is released. 0 if the bus is still locked.
+ ******************************************************************************/
+uint8_t cncI2C_recoverBus(I2C_TypeDef *I2Cx)
+{
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+
+  if(hI2C == 0)
+    return 0;
+
+  return cncI2C_Recover(hI2C);
 }
 
 // Private functions ===========================================================
+/*******************************************************************************
+ * @brief   Configure the I2C peripheral (master, 7 bits address, ACK).
+ * @param   hI2C: I2C handle. Frequency must be set.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_Config(cncI2C_handle_t *hI2C)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+  LL_I2C_InitTypeDef I2C_InitStruct;
+
+  I2C_InitStruct.PeripheralMode = LL_I2C_MODE_I2C;
+  I2C_InitStruct.ClockSpeed = hI2C->Frequency;
+  I2C_InitStruct.DutyCycle = LL_I2C_DUTYCYCLE_2;
+  I2C_InitStruct.OwnAddrSize = LL_I2C_OWNADDRESS1_7BIT;
+  I2C_InitStruct.OwnAddress1 = 0x00;
+  I2C_InitStruct.TypeAcknowledge = LL_I2C_ACK;
+  LL_I2C_Init(I2Cx, &I2C_InitStruct);
+
+  LL_I2C_SetOwnAddress2(I2Cx, 0x00);
+  LL_I2C_DisableOwnAddress2(I2Cx);
+  LL_I2C_DisableGeneralCall(I2Cx);
+  LL_I2C_EnableClockStretching(I2Cx);
+}
+
+/*******************************************************************************
+ * @brief   Bus recovery. Aborts the asynchronous transfer, if any.
+ * @param   hI2C: I2C handle.
+ * @retval  1 if SDA is released. 0 if the bus is still locked.
+ * @note    A slave interrupted in the middle of a read holds SDA low until it
+ *          has clocked out the rest of its byte: up to 9 SCL pulses.
+ ******************************************************************************/
+static uint8_t cncI2C_Recover(cncI2C_handle_t *hI2C)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+  const i2c_gpio_t *pGpio = hI2C->pGpio;
+  uint8_t released = 0;
+
+  hI2C->RecoveryCount++;
+
+  LL_DMA_DisableStream(hI2C->pDma->DMAx, hI2C->pDma->STREAM_RX);
+  LL_DMA_DisableStream(hI2C->pDma->DMAx, hI2C->pDma->STREAM_TX);
+  LL_I2C_Disable(I2Cx);
+
+  /*!< SCL and SDA as open drain outputs, released */
+  LL_GPIO_SetOutputPin(pGpio->GPIO_PORT_SCL, pGpio->GPIO_PIN_SCL);
+  LL_GPIO_SetOutputPin(pGpio->GPIO_PORT_SDA, pGpio->GPIO_PIN_SDA);
+  LL_GPIO_SetPinMode(pGpio->GPIO_PORT_SCL, pGpio->GPIO_PIN_SCL,
+                     LL_GPIO_MODE_OUTPUT);
+  LL_GPIO_SetPinMode(pGpio->GPIO_PORT_SDA, pGpio->GPIO_PIN_SDA,
+                     LL_GPIO_MODE_OUTPUT);
+
+  for(uint32_t i = 0; i < RECOVERY_PULSES; i++)
+  {
+    LL_GPIO_ResetOutputPin(pGpio->GPIO_PORT_SCL, pGpio->GPIO_PIN_SCL);
+    cncI2C_DelayUs(RECOVERY_HALF_PERIOD_US);
+    LL_GPIO_SetOutputPin(pGpio->GPIO_PORT_SCL, pGpio->GPIO_PIN_SCL);
+    cncI2C_DelayUs(RECOVERY_HALF_PERIOD_US);
+  }
+
+  /*!< STOP: SDA rises while SCL is high */
+  LL_GPIO_ResetOutputPin(pGpio->GPIO_PORT_SCL, pGpio->GPIO_PIN_SCL);
+  LL_GPIO_ResetOutputPin(pGpio->GPIO_PORT_SDA, pGpio->GPIO_PIN_SDA);
+  cncI2C_DelayUs(RECOVERY_HALF_PERIOD_US);
+  LL_GPIO_SetOutputPin(pGpio->GPIO_PORT_SCL, pGpio->GPIO_PIN_SCL);
+  cncI2C_DelayUs(RECOVERY_HALF_PERIOD_US);
+  LL_GPIO_SetOutputPin(pGpio->GPIO_PORT_SDA, pGpio->GPIO_PIN_SDA);
+  cncI2C_DelayUs(RECOVERY_HALF_PERIOD_US);
+
+  released = (LL_GPIO_IsInputPinSet(pGpio->GPIO_PORT_SDA,
+                                    pGpio->GPIO_PIN_SDA) == 1) ? 1 : 0;
+
+  LL_GPIO_SetPinMode(pGpio->GPIO_PORT_SCL, pGpio->GPIO_PIN_SCL,
+                     LL_GPIO_MODE_ALTERNATE);
+  LL_GPIO_SetPinMode(pGpio->GPIO_PORT_SDA, pGpio->GPIO_PIN_SDA,
+                     LL_GPIO_MODE_ALTERNATE);
+
+  /*!< Clear BUSY and the state machine, then restore the configuration */
+  LL_I2C_EnableReset(I2Cx);
+  LL_I2C_DisableReset(I2Cx);
+  cncI2C_Config(hI2C);
+
+  if(hI2C->Async.state != I2C_ASYNC_IDLE)
+    cncI2C_EndAsync(hI2C, 0);
+
+  return released;
+}
+
+/*******************************************************************************
+ * @brief   Busy wait on the DWT cycle counter.
+ * @param   us: delay [us].
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_DelayUs(uint32_t us)
+{
+  uint32_t start = DWT->CYCCNT;
+  uint32_t cycles = us*(SystemCoreClock/1000000);
+
+  while((DWT->CYCCNT - start) < cycles)
+    ;
+}
+
+/*******************************************************************************
+ * @brief   Start the deadline of a blocking transaction and wait for a free
+ *          bus.
+ * @param   hI2C: I2C handle.
+ * @retval  1 if the bus is free. 0 if an asynchronous transfer owns the bus
+ *          or timeout.
+ ******************************************************************************/
+static uint8_t cncI2C_Begin(cncI2C_handle_t *hI2C)
+{
+  /*!< Busy with our own transfer: not a locked bus, do not recover */
+  if(hI2C->Async.state != I2C_ASYNC_IDLE)
+    return 0;
+
+  hI2C->StartCycles = DWT->CYCCNT;
+
+  return cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_BUSY, 0);
+}
+
+/*******************************************************************************
+ * @brief   Wait for the STOP condition of the previous transaction to be on
+ *          the wire (STOP and BUSY cleared), bounded by I2C_STOP_WAIT_BITS
+ *          SCL periods. Interrupt context safe.
+ * @param   hI2C: I2C handle.
+ * @retval  1 if the bus is free. 0 if it is still busy (another master or a
+ *          slave holding the bus): no recovery, the caller retries.
+ ******************************************************************************/
+static uint8_t cncI2C_WaitStop(cncI2C_handle_t *hI2C)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+  uint32_t start = DWT->CYCCNT;
+  uint32_t cycles = I2C_STOP_WAIT_BITS*(SystemCoreClock/hI2C->Frequency);
+
+  while((LL_I2C_IsActiveFlag_BUSY(I2Cx) == 1)
+        || (READ_BIT(I2Cx->CR1, I2C_CR1_STOP) != 0))
+  {
+    if((DWT->CYCCNT - start) > cycles)
+      return 0;
+  }
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Wait until a status flag reaches the expected state, bounded by the
+ *          deadline of the current transaction (StartCycles + TimeoutCycles).
+ * @param   hI2C: I2C handle.
+ * @param   isActiveFlag: LL_I2C_IsActiveFlag_* function.
+ * @param   state: expected flag state (1 or 0).
+ * @retval  1 if successful. 0 if NACK or timeout (bus recovered).
+ ******************************************************************************/
+static uint8_t cncI2C_WaitFlag(
+    cncI2C_handle_t *hI2C, i2c_flag_t isActiveFlag, uint32_t state)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+
+  while(isActiveFlag(I2Cx) != state)
+  {
+    /*!< NACK: the slave is absent or busy, the bus itself is fine */
+    if(LL_I2C_IsActiveFlag_AF(I2Cx) == 1)
+    {
+      LL_I2C_ClearFlag_AF(I2Cx);
+      LL_I2C_GenerateStopCondition(I2Cx);
+      hI2C->ErrorCount++;
+      return 0;
+    }
+
+    if((DWT->CYCCNT - hI2C->StartCycles) > hI2C->TimeoutCycles)
+    {
+      hI2C->TimeoutCount++;
+      cncI2C_Recover(hI2C);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
 /*******************************************************************************
  * @brief   Generate start condition.
- * @param   I2Cx: I2C instance.
+ * @param   hI2C: I2C handle.
  * @param   devAddr: 7 bits device's address.
  * @param   Mode: I2C_MODE_READ or I2C_MODE_WRITE.
  * @param   ack: Acknowledge type.
  * @retval  1 for successful.
  ******************************************************************************/
 static uint8_t cncI2C_Start(
-    I2C_TypeDef *I2Cx, uint8_t devAddr, uint8_t mode, uint8_t ack)
+    cncI2C_handle_t *hI2C, uint8_t devAddr, uint8_t mode, uint8_t ack)
 {
+  I2C_TypeDef *I2Cx = hI2C->Instance;
   __IO uint8_t tmpAddr = (devAddr << 1);
 
   LL_I2C_GenerateStartCondition(I2Cx);
   /*Wait for Start condition flag*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_SB(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_SB, 1) != 1)
+    return 0;
 
   if(ack == I2C_ACK)
     LL_I2C_AcknowledgeNextData(I2Cx, LL_I2C_ACK);
@@ -324,15 +742,8 @@ static uint8_t cncI2C_Start(
   LL_I2C_TransmitData8(I2Cx, tmpAddr);
 
   /*Wait for address sent flag*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_ADDR(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_ADDR, 1) != 1)
+    return 0;
 
   /*Clear address sent flag*/
   LL_I2C_ClearFlag_ADDR(I2Cx);
@@ -342,80 +753,54 @@ static uint8_t cncI2C_Start(
 
 /*******************************************************************************
  * @brief   Generate stop condition.
- * @param   I2Cx: I2C instance.
+ * @param   hI2C: I2C handle.
  * @retval  None.
  ******************************************************************************/
-static uint8_t cncI2C_Stop(I2C_TypeDef *I2Cx)
+static uint8_t cncI2C_Stop(cncI2C_handle_t *hI2C)
 {
   /*Wait for TXE(Transmit data register is Empty) flag*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_TXE(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_TXE, 1) != 1)
+    return 0;
 
   /*Wait for BTF(Byte Transfer Finished) flag*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_BTF(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_BTF, 1) != 1)
+    return 0;
 
-  LL_I2C_GenerateStopCondition(I2Cx);
+  LL_I2C_GenerateStopCondition(hI2C->Instance);
 
   return 1;
 }
 
 /*******************************************************************************
  * @brief   Write single byte.
- * @param   I2Cx: I2C instance.
+ * @param   hI2C: I2C handle.
  * @param   data: Data to be written.
  * @retval  1 if successful. 0 if fail.
  ******************************************************************************/
-static uint8_t cncI2C_WriteData(I2C_TypeDef *I2Cx, uint8_t data)
+static uint8_t cncI2C_WriteData(cncI2C_handle_t *hI2C, uint8_t data)
 {
   /*Wait for TXE(Transmit data register is Empty) flag*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_TXE(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_TXE, 1) != 1)
+    return 0;
 
-  LL_I2C_TransmitData8(I2Cx, data);
+  LL_I2C_TransmitData8(hI2C->Instance, data);
 
   return 1;
 }
 
 /*******************************************************************************
  * @brief   Write single byte.
- * @param   I2Cx: I2C instance.
+ * @param   hI2C: I2C handle.
  * @param   ack: Acknowledge type.
  * @retval  Data from slave. 0 if fail.
  ******************************************************************************/
-static uint8_t cncI2C_ReadData(I2C_TypeDef *I2Cx, uint8_t ack)
+static uint8_t cncI2C_ReadData(cncI2C_handle_t *hI2C, uint8_t ack)
 {
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+
   /*Wait for RXNE(RX data register is Not Empty) flag*/
-  timeout = TIMEOUT_MAX;
-  while(LL_I2C_IsActiveFlag_RXNE(I2Cx) != 1)
-  {
-    if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-    {
-      if(--timeout == 0)
-        return 0;
-    }
-  }
+  if(cncI2C_WaitFlag(hI2C, LL_I2C_IsActiveFlag_RXNE, 1) != 1)
+    return 0;
 
   if(ack == I2C_ACK)
     LL_I2C_AcknowledgeNextData(I2Cx, LL_I2C_ACK);
@@ -428,4 +813,437 @@ static uint8_t cncI2C_ReadData(I2C_TypeDef *I2Cx, uint8_t ack)
   return LL_I2C_ReceiveData8(I2Cx);
 }
 
+/*******************************************************************************
+ * @brief   Configure a DMA stream for byte transfers to/from I2C DR.
+ * @param   hI2C: I2C handle.
+ * @param   stream: LL_DMA_STREAM_x.
+ * @param   direction: LL_DMA_DIRECTION_PERIPH_TO_MEMORY or
+ *          LL_DMA_DIRECTION_MEMORY_TO_PERIPH.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_InitStream(cncI2C_handle_t *hI2C, uint32_t stream,
+                              uint32_t direction)
+{
+  DMA_TypeDef *DMAx = hI2C->pDma->DMAx;
+
+  LL_DMA_DisableStream(DMAx, stream);
+  LL_DMA_SetChannelSelection(DMAx, stream, hI2C->pDma->CHANNEL);
+  LL_DMA_ConfigTransfer(DMAx, stream,
+                        direction |
+                        LL_DMA_PRIORITY_HIGH |
+                        LL_DMA_MODE_NORMAL |
+                        LL_DMA_PERIPH_NOINCREMENT |
+                        LL_DMA_MEMORY_INCREMENT |
+                        LL_DMA_PDATAALIGN_BYTE |
+                        LL_DMA_MDATAALIGN_BYTE);
+  LL_DMA_SetPeriphAddress(DMAx, stream,
+                          LL_I2C_DMA_GetRegAddr(hI2C->Instance));
+  cncI2C_ClearFlagsDMA(DMAx, stream);
+  LL_DMA_EnableIT_TC(DMAx, stream);
+  LL_DMA_EnableIT_TE(DMAx, stream);
+}
+
+/*******************************************************************************
+ * @brief   Interrupt flags of a DMA stream, aligned to stream 0 positions.
+ * @param   DMAx: DMA instance.
+ * @param   stream: LL_DMA_STREAM_x.
+ * @retval  Flags (DMA_FLAG_TC, DMA_FLAG_TE, ...).
+ ******************************************************************************/
+static uint32_t cncI2C_GetFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream)
+{
+  uint32_t isr = (stream < LL_DMA_STREAM_4) ? DMAx->LISR : DMAx->HISR;
+
+  return (isr >> DMA_FLAG_SHIFT[stream & 0x03]) & DMA_FLAG_ALL;
+}
+
+/*******************************************************************************
+ * @brief   Clear all interrupt flags of a DMA stream.
+ * @param   DMAx: DMA instance.
+ * @param   stream: LL_DMA_STREAM_x.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_ClearFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream)
+{
+  if(stream < LL_DMA_STREAM_4)
+    DMAx->LIFCR = (DMA_FLAG_ALL << DMA_FLAG_SHIFT[stream & 0x03]);
+  else
+    DMAx->HIFCR = (DMA_FLAG_ALL << DMA_FLAG_SHIFT[stream & 0x03]);
+}
+
+/*******************************************************************************
+ * @brief   Load the transfer descriptor and generate start condition. The rest
+ *          of the transfer runs in I2C event/error and DMA interrupts.
+ * @param   I2Cx: I2C instance.
+ * @param   pDev: pDev[0]: 7 bits device's address. pDev[1]: register address.
+ * @param   pData: data buffer.
+ * @param   count: number of bytes.
+ * @param   mode: I2C_MODE_READ or I2C_MODE_WRITE.
+ * @param   callback: end of transfer function.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+static uint8_t cncI2C_StartAsync(I2C_TypeDef *I2Cx, uint8_t *pDev,
+                                 uint8_t *pData, uint8_t count, uint8_t mode,
+                                 cncI2C_callback_t callback, void *pContext)
+{
+  cncI2C_handle_t *hI2C = cncI2C_getHandle(I2Cx);
+  i2c_async_t *pAsync = 0;
+
+  if((hI2C == 0) || (count == 0))
+    return 0;
+
+  pAsync = &hI2C->Async;
+  if(pAsync->state != I2C_ASYNC_IDLE)
+    return 0;
+
+  if(LL_I2C_IsEnabled(I2Cx) != 1)
+    LL_I2C_Enable(I2Cx);
+
+  /*!< Chained from the end of the previous transfer: its STOP is still
+   *   being generated */
+  if(cncI2C_WaitStop(hI2C) != 1)
+    return 0;
+
+  pAsync->devAddr = pDev[0];
+  pAsync->regAddr = pDev[1];
+  pAsync->pData = pData;
+  pAsync->count = count;
+  pAsync->mode = mode;
+  pAsync->callback = callback;
+  pAsync->pContext = pContext;
+  pAsync->state = I2C_ASYNC_START_W;
+  hI2C->StartCycles = DWT->CYCCNT;
+
+  LL_I2C_DisableBitPOS(I2Cx);
+  LL_I2C_AcknowledgeNextData(I2Cx, LL_I2C_ACK);
+  LL_I2C_EnableIT_ERR(I2Cx);
+  LL_I2C_EnableIT_EVT(I2Cx);
+  LL_I2C_GenerateStartCondition(I2Cx);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   I2C event state machine.
+ *          START_W -> ADDR_W -> REG -> (write) DMA TX -> BTF -> STOP
+ *                                   -> (read)  START_R -> ADDR_R -> DMA RX
+ * @param   hI2C: I2C handle.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_EventHandler(cncI2C_handle_t *hI2C)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+  i2c_async_t *pAsync = &hI2C->Async;
+  const i2c_dma_t *pDma = hI2C->pDma;
+
+  switch(pAsync->state)
+  {
+    case I2C_ASYNC_START_W:
+      if(LL_I2C_IsActiveFlag_SB(I2Cx) == 1)
+      {
+        LL_I2C_TransmitData8(I2Cx, (pAsync->devAddr << 1) & I2C_ADD0_WRITE);
+        pAsync->state = I2C_ASYNC_ADDR_W;
+      }
+      break;
+
+    case I2C_ASYNC_ADDR_W:
+      if(LL_I2C_IsActiveFlag_ADDR(I2Cx) == 1)
+      {
+        LL_I2C_ClearFlag_ADDR(I2Cx);
+        LL_I2C_TransmitData8(I2Cx, pAsync->regAddr);
+        pAsync->state = I2C_ASYNC_REG;
+      }
+      break;
+
+    case I2C_ASYNC_REG:
+      if(LL_I2C_IsActiveFlag_BTF(I2Cx) == 1)
+      {
+        if(pAsync->mode == I2C_MODE_READ)
+        {
+          LL_I2C_GenerateStartCondition(I2Cx);
+          pAsync->state = I2C_ASYNC_START_R;
+        }
+        else
+        {
+          /*!< DMA feeds DR, no more events until DMA transfer complete */
+          LL_I2C_DisableIT_EVT(I2Cx);
+          pAsync->state = I2C_ASYNC_DATA_TX;
+          LL_DMA_SetMemoryAddress(pDma->DMAx, pDma->STREAM_TX,
+                                  (uint32_t) pAsync->pData);
+          LL_DMA_SetDataLength(pDma->DMAx, pDma->STREAM_TX, pAsync->count);
+          LL_I2C_EnableDMAReq_TX(I2Cx);
+          LL_DMA_EnableStream(pDma->DMAx, pDma->STREAM_TX);
+        }
+      }
+      break;
+
+    case I2C_ASYNC_START_R:
+      if(LL_I2C_IsActiveFlag_SB(I2Cx) == 1)
+      {
+        LL_I2C_TransmitData8(I2Cx, (pAsync->devAddr << 1) | I2C_ADD0_READ);
+        pAsync->state = I2C_ASYNC_ADDR_R;
+      }
+      break;
+
+    case I2C_ASYNC_ADDR_R:
+      if(LL_I2C_IsActiveFlag_ADDR(I2Cx) == 1)
+      {
+        if(pAsync->count == 1)
+        {
+          /*!< Single byte: NACK before ADDR is cleared, then STOP */
+          LL_I2C_AcknowledgeNextData(I2Cx, LL_I2C_NACK);
+          LL_I2C_ClearFlag_ADDR(I2Cx);
+          LL_I2C_GenerateStopCondition(I2Cx);
+          LL_I2C_EnableIT_BUF(I2Cx);
+          pAsync->state = I2C_ASYNC_DATA_RX_SINGLE;
+        }
+        else
+        {
+          /*!< LAST: hardware NACKs the byte of the last DMA request */
+          LL_I2C_DisableIT_EVT(I2Cx);
+          pAsync->state = I2C_ASYNC_DATA_RX;
+          LL_DMA_SetMemoryAddress(pDma->DMAx, pDma->STREAM_RX,
+                                  (uint32_t) pAsync->pData);
+          LL_DMA_SetDataLength(pDma->DMAx, pDma->STREAM_RX, pAsync->count);
+          LL_DMA_EnableStream(pDma->DMAx, pDma->STREAM_RX);
+          LL_I2C_EnableLastDMA(I2Cx);
+          LL_I2C_EnableDMAReq_RX(I2Cx);
+          LL_I2C_ClearFlag_ADDR(I2Cx);
+        }
+      }
+      break;
+
+    case I2C_ASYNC_DATA_RX_SINGLE:
+      if(LL_I2C_IsActiveFlag_RXNE(I2Cx) == 1)
+      {
+        *pAsync->pData = LL_I2C_ReceiveData8(I2Cx);
+        cncI2C_EndAsync(hI2C, 1);
+      }
+      break;
+
+    case I2C_ASYNC_WAIT_BTF:
+      if(LL_I2C_IsActiveFlag_BTF(I2Cx) == 1)
+      {
+        LL_I2C_GenerateStopCondition(I2Cx);
+        cncI2C_EndAsync(hI2C, 1);
+      }
+      break;
+
+    case I2C_ASYNC_RECOVER:
+      /*!< Pended before the abort */
+      break;
+
+    default:
+      /*!< Unexpected event: abort */
+      LL_I2C_GenerateStopCondition(I2Cx);
+      cncI2C_EndAsync(hI2C, 0);
+      break;
+  }
+}
+
+/*******************************************************************************
+ * @brief   NACK, bus error, arbitration lost or overrun: abort the transfer.
+ * @param   hI2C: I2C handle.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_ErrorHandler(cncI2C_handle_t *hI2C)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+
+  LL_I2C_ClearFlag_AF(I2Cx);
+  LL_I2C_ClearFlag_BERR(I2Cx);
+  LL_I2C_ClearFlag_ARLO(I2Cx);
+  LL_I2C_ClearFlag_OVR(I2Cx);
+
+  if(hI2C->Async.state == I2C_ASYNC_RECOVER)
+    return;
+
+  LL_DMA_DisableStream(hI2C->pDma->DMAx, hI2C->pDma->STREAM_RX);
+  LL_DMA_DisableStream(hI2C->pDma->DMAx, hI2C->pDma->STREAM_TX);
+  LL_I2C_GenerateStopCondition(I2Cx);
+
+  if(hI2C->Async.state != I2C_ASYNC_IDLE)
+    cncI2C_EndAsync(hI2C, 0);
+}
+
+/*******************************************************************************
+ * @brief   DMA RX stream interrupt.
+ * @param   hI2C: I2C handle.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_RxHandlerDMA(cncI2C_handle_t *hI2C)
+{
+  const i2c_dma_t *pDma = hI2C->pDma;
+  uint32_t flags = cncI2C_GetFlagsDMA(pDma->DMAx, pDma->STREAM_RX);
+
+  cncI2C_ClearFlagsDMA(pDma->DMAx, pDma->STREAM_RX);
+
+  /*!< Disabling the stream on abort sets TC */
+  if(hI2C->Async.state == I2C_ASYNC_RECOVER)
+    return;
+
+  if((flags & DMA_FLAG_TE) != 0)
+  {
+    LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_RX);
+    LL_I2C_GenerateStopCondition(hI2C->Instance);
+    cncI2C_EndAsync(hI2C, 0);
+  }
+  else if((flags & DMA_FLAG_TC) != 0)
+  {
+    /*!< Last byte already NACKed by hardware (LAST bit) */
+    LL_I2C_GenerateStopCondition(hI2C->Instance);
+    LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_RX);
+    cncI2C_EndAsync(hI2C, 1);
+  }
+}
+
+/*******************************************************************************
+ * @brief   DMA TX stream interrupt.
+ * @param   hI2C: I2C handle.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_TxHandlerDMA(cncI2C_handle_t *hI2C)
+{
+  const i2c_dma_t *pDma = hI2C->pDma;
+  uint32_t flags = cncI2C_GetFlagsDMA(pDma->DMAx, pDma->STREAM_TX);
+
+  cncI2C_ClearFlagsDMA(pDma->DMAx, pDma->STREAM_TX);
+
+  /*!< Disabling the stream on abort sets TC */
+  if(hI2C->Async.state == I2C_ASYNC_RECOVER)
+    return;
+
+  if((flags & DMA_FLAG_TE) != 0)
+  {
+    LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_TX);
+    LL_I2C_GenerateStopCondition(hI2C->Instance);
+    cncI2C_EndAsync(hI2C, 0);
+  }
+  else if((flags & DMA_FLAG_TC) != 0)
+  {
+    /*!< Last byte is still in DR/shift register: wait BTF for STOP */
+    LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_TX);
+    LL_I2C_DisableDMAReq_TX(hI2C->Instance);
+    hI2C->Async.state = I2C_ASYNC_WAIT_BTF;
+    LL_I2C_EnableIT_EVT(hI2C->Instance);
+  }
+}
+
+/*******************************************************************************
+ * @brief   Stop an asynchronous transfer without ending it: no more I2C or DMA
+ *          events, the bus stays owned (I2C_ASYNC_RECOVER). Interrupts masked.
+ * @param   hI2C: I2C handle.
+ * @retval  None.
+ * @note    cncI2C_Recover() ends it: callback with status 0.
+ ******************************************************************************/
+static void cncI2C_AbortAsync(cncI2C_handle_t *hI2C)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+  const i2c_dma_t *pDma = hI2C->pDma;
+
+  LL_I2C_DisableIT_EVT(I2Cx);
+  LL_I2C_DisableIT_BUF(I2Cx);
+  LL_I2C_DisableIT_ERR(I2Cx);
+  LL_I2C_DisableDMAReq_RX(I2Cx);
+  LL_I2C_DisableDMAReq_TX(I2Cx);
+  LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_RX);
+  LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_TX);
+
+  hI2C->Async.state = I2C_ASYNC_RECOVER;
+}
+
+/*******************************************************************************
+ * @brief   Release the bus and report the end of an asynchronous transfer.
+ * @param   hI2C: I2C handle.
+ * @param   status: 1 if successful, 0 if fail.
+ * @retval  None.
+ ******************************************************************************/
+static void cncI2C_EndAsync(cncI2C_handle_t *hI2C, uint8_t status)
+{
+  I2C_TypeDef *I2Cx = hI2C->Instance;
+
+  LL_I2C_DisableIT_EVT(I2Cx);
+  LL_I2C_DisableIT_BUF(I2Cx);
+  LL_I2C_DisableIT_ERR(I2Cx);
+  LL_I2C_DisableDMAReq_RX(I2Cx);
+  LL_I2C_DisableDMAReq_TX(I2Cx);
+  LL_I2C_DisableLastDMA(I2Cx);
+  LL_I2C_AcknowledgeNextData(I2Cx, LL_I2C_ACK);
+
+  if(status != 1)
+    hI2C->ErrorCount++;
+
+  hI2C->Async.state = I2C_ASYNC_IDLE;
+
+  if(hI2C->Async.callback != 0)
+    hI2C->Async.callback(hI2C->Async.pContext, status);
+}
+
+// IRQ Handlers ================================================================
+void I2C1_EV_IRQHandler(void)
+{
+  cncI2C_EventHandler(&i2cHandle[0]);
+}
+
+void I2C1_ER_IRQHandler(void)
+{
+  cncI2C_ErrorHandler(&i2cHandle[0]);
+}
+
+void I2C2_EV_IRQHandler(void)
+{
+  cncI2C_EventHandler(&i2cHandle[1]);
+}
+
+void I2C2_ER_IRQHandler(void)
+{
+  cncI2C_ErrorHandler(&i2cHandle[1]);
+}
+
+void I2C3_EV_IRQHandler(void)
+{
+  cncI2C_EventHandler(&i2cHandle[2]);
+}
+
+void I2C3_ER_IRQHandler(void)
+{
+  cncI2C_ErrorHandler(&i2cHandle[2]);
+}
+
+/*!< I2C1_RX */
+void DMA1_Stream0_IRQHandler(void)
+{
+  cncI2C_RxHandlerDMA(&i2cHandle[0]);
+}
+
+/*!< I2C1_TX */
+void DMA1_Stream6_IRQHandler(void)
+{
+  cncI2C_TxHandlerDMA(&i2cHandle[0]);
+}
+
+/*!< I2C2_RX */
+void DMA1_Stream3_IRQHandler(void)
+{
+  cncI2C_RxHandlerDMA(&i2cHandle[1]);
+}
+
+/*!< I2C2_TX */
+void DMA1_Stream7_IRQHandler(void)
+{
+  cncI2C_TxHandlerDMA(&i2cHandle[1]);
+}
+
+/*!< I2C3_RX */
+void DMA1_Stream2_IRQHandler(void)
+{
+  cncI2C_RxHandlerDMA(&i2cHandle[2]);
+}
+
+/*!< I2C3_TX */
+void DMA1_Stream4_IRQHandler(void)
+{
+  cncI2C_TxHandlerDMA(&i2cHandle[2]);
+}
+
 // EOF =========================================================================
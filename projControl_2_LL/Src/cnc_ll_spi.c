@@ -0,0 +1,623 @@
+// Includes ====================================================================
+#include "cnc_ll_spi.h"
+
+// Constants ===================================================================
+static const spi_gpio_t SPI1_GPIO = { GPIOA, LL_GPIO_PIN_5, GPIOA,
+    LL_GPIO_PIN_6, GPIOA, LL_GPIO_PIN_7, GPIOA, LL_GPIO_PIN_4, LL_GPIO_AF_5,
+    LL_AHB1_GRP1_PERIPH_GPIOA, LL_APB2_GRP1_PERIPH_SPI1 };
+
+static const spi_dma_t SPI1_DMA = { DMA2, LL_DMA_STREAM_0, LL_DMA_STREAM_3,
+    LL_DMA_CHANNEL_3, DMA2_Stream0_IRQn, DMA2_Stream3_IRQn };
+
+/*!< Flag position of streams 0..3 in LISR/LIFCR (4..7 in HISR/HIFCR) */
+static const uint8_t DMA_FLAG_SHIFT[4] = { 0, 6, 16, 22 };
+static __I uint32_t DMA_FLAG_ALL = 0x3D;          /*!< FE, DME, TE, HT, TC */
+static __I uint32_t DMA_FLAG_TE = (0x01 << 3);
+static __I uint32_t DMA_FLAG_TC = (0x01 << 5);
+
+static __I uint8_t SPI_DUMMY_BYTE = 0x00;
+
+#define SPI_INSTANCES   1
+
+// =============================================================================
+static cncSPI_handle_t spiHandle[SPI_INSTANCES] =
+{
+  { SPI1, &SPI1_GPIO, &SPI1_DMA, SPI_PRESCALER_128, 0, 0, 0, { 0, 0, 0, 0, 0 } },
+};
+
+/*!< TX source of read transfers and RX sink of write transfers */
+static uint8_t dummyTx = 0x00;
+static uint8_t dummyRx = 0x00;
+
+// Private functions prototypes ================================================
+static void cncSPI_Config(cncSPI_handle_t *hSPI);
+static uint8_t cncSPI_Lock(cncSPI_handle_t *hSPI);
+static void cncSPI_Unlock(cncSPI_handle_t *hSPI);
+static uint8_t cncSPI_Transfer(cncSPI_handle_t *hSPI, uint8_t txData,
+                               uint8_t *pRxData, uint32_t startCycles);
+static uint8_t cncSPI_WaitIdle(cncSPI_handle_t *hSPI, uint32_t startCycles);
+static void cncSPI_InitStream(cncSPI_handle_t *hSPI, uint32_t stream,
+                              uint32_t direction);
+static uint32_t cncSPI_GetFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream);
+static void cncSPI_ClearFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream);
+static uint8_t cncSPI_StartAsync(SPI_TypeDef *SPIx, uint8_t regAddr,
+                                 uint8_t *pData, uint8_t count,
+                                 cncSPI_callback_t callback, void *pContext);
+static void cncSPI_RxHandlerDMA(cncSPI_handle_t *hSPI);
+static void cncSPI_TxHandlerDMA(cncSPI_handle_t *hSPI);
+static void cncSPI_EndAsync(cncSPI_handle_t *hSPI, uint8_t status);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Driver context of a SPI instance.
+ * @param   SPIx: SPI instance (SPI1).
+ * @retval  Handle. 0 if the instance is not supported.
+ ******************************************************************************/
+cncSPI_handle_t *cncSPI_getHandle(SPI_TypeDef *SPIx)
+{
+  for(uint8_t i = 0; i < SPI_INSTANCES; i++)
+  {
+    if(spiHandle[i].Instance == SPIx)
+      return &spiHandle[i];
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+ * @brief   Init SPI bus. SPI1: SCK PA5, MISO PA6, MOSI PA7, CS PA4.
+ * @param   SPIx: SPI instance.
+ * @param   prescaler: SCK = APB2 clock / prescaler.
+ * @retval  1 if successful. 0 if the instance is not supported.
+ ******************************************************************************/
+uint8_t cncSPI_Init(SPI_TypeDef *SPIx, spi_prescaler_t prescaler)
+{
+  cncSPI_handle_t *hSPI = cncSPI_getHandle(SPIx);
+  LL_GPIO_InitTypeDef GPIO_InitStruct;
+
+  if(hSPI == 0)
+    return 0;
+
+  LL_AHB1_GRP1_EnableClock(hSPI->pGpio->GPIO_CLOCK);
+
+  /*!< CS idle high before the bus pins are connected */
+  LL_GPIO_SetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+
+  GPIO_InitStruct.Pin = hSPI->pGpio->GPIO_PIN_CS;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
+  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
+  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_VERY_HIGH;
+  GPIO_InitStruct.Alternate = LL_GPIO_AF_0;
+  LL_GPIO_Init(hSPI->pGpio->GPIO_PORT_CS, &GPIO_InitStruct);
+
+  GPIO_InitStruct.Pin = hSPI->pGpio->GPIO_PIN_SCK;
+  GPIO_InitStruct.Mode = LL_GPIO_MODE_ALTERNATE;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_NO;
+  GPIO_InitStruct.Alternate = hSPI->pGpio->GPIO_ALTERNATE;
+  LL_GPIO_Init(hSPI->pGpio->GPIO_PORT_SCK, &GPIO_InitStruct);
+
+  GPIO_InitStruct.Pin = hSPI->pGpio->GPIO_PIN_MOSI;
+  LL_GPIO_Init(hSPI->pGpio->GPIO_PORT_MOSI, &GPIO_InitStruct);
+
+  GPIO_InitStruct.Pin = hSPI->pGpio->GPIO_PIN_MISO;
+  GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
+  LL_GPIO_Init(hSPI->pGpio->GPIO_PORT_MISO, &GPIO_InitStruct);
+
+  LL_APB2_GRP1_EnableClock(hSPI->pGpio->SPI_CLOCK);
+
+  hSPI->Prescaler = prescaler;
+  hSPI->TimeoutCycles = SPI_TIMEOUT_DEFAULT_US*(SystemCoreClock/1000000);
+  hSPI->TimeoutCount = 0;
+  hSPI->ErrorCount = 0;
+  hSPI->Async.busy = 0;
+  cncSPI_Config(hSPI);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Change the SCK clock. Takes effect on the next transaction.
+ * @param   SPIx: SPI instance.
+ * @param   prescaler: SCK = APB2 clock / prescaler.
+ * @retval  1 if successful. 0 if an asynchronous transfer is in progress.
+ ******************************************************************************/
+uint8_t cncSPI_setPrescaler(SPI_TypeDef *SPIx, spi_prescaler_t prescaler)
+{
+  cncSPI_handle_t *hSPI = cncSPI_getHandle(SPIx);
+
+  if(hSPI == 0)
+    return 0;
+
+  if(hSPI->Prescaler == prescaler)
+    return 1;
+
+  if(cncSPI_Lock(hSPI) != 1)
+    return 0;
+
+  /*!< BR can only be changed with the peripheral disabled */
+  SPIx->CR1 &= ~SPI_CR1_SPE;
+  SPIx->CR1 = (SPIx->CR1 & ~SPI_CR1_BR_Msk) |
+              ((uint32_t) prescaler << SPI_CR1_BR_Pos);
+  SPIx->CR1 |= SPI_CR1_SPE;
+  hSPI->Prescaler = prescaler;
+
+  cncSPI_Unlock(hSPI);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Write registers (blocking).
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: bytes to be written.
+ * @param   count: number of bytes.
+ * @retval  1 if successful. 0 if busy or timeout.
+ ******************************************************************************/
+uint8_t cncSPI_WriteMultipleBytes(
+    SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  cncSPI_handle_t *hSPI = cncSPI_getHandle(SPIx);
+  uint8_t status = 0;
+  uint8_t rxData = 0x00;
+  uint32_t startCycles = DWT->CYCCNT;
+
+  if((hSPI == 0) || (cncSPI_Lock(hSPI) != 1))
+    return 0;
+
+  LL_GPIO_ResetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+
+  status = cncSPI_Transfer(hSPI, (regAddr & ~SPI_READ_MSK), &rxData,
+                           startCycles);
+  for(uint8_t i = 0; (i < count) && (status == 1); i++)
+    status = cncSPI_Transfer(hSPI, pData[i], &rxData, startCycles);
+
+  if(cncSPI_WaitIdle(hSPI, startCycles) != 1)
+    status = 0;
+
+  LL_GPIO_SetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+  cncSPI_Unlock(hSPI);
+
+  return status;
+}
+
+/*******************************************************************************
+ * @brief   Read registers (blocking).
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: buffer for the bytes from slave.
+ * @param   count: number of bytes.
+ * @retval  1 if successful. 0 if busy or timeout.
+ ******************************************************************************/
+uint8_t cncSPI_ReadMultipleBytes(
+    SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  cncSPI_handle_t *hSPI = cncSPI_getHandle(SPIx);
+  uint8_t status = 0;
+  uint8_t rxData = 0x00;
+  uint32_t startCycles = DWT->CYCCNT;
+
+  if((hSPI == 0) || (cncSPI_Lock(hSPI) != 1))
+    return 0;
+
+  LL_GPIO_ResetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+
+  status = cncSPI_Transfer(hSPI, (regAddr | SPI_READ_MSK), &rxData,
+                           startCycles);
+  for(uint8_t i = 0; (i < count) && (status == 1); i++)
+    status = cncSPI_Transfer(hSPI, SPI_DUMMY_BYTE, &pData[i], startCycles);
+
+  if(cncSPI_WaitIdle(hSPI, startCycles) != 1)
+    status = 0;
+
+  LL_GPIO_SetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+  cncSPI_Unlock(hSPI);
+
+  return status;
+}
+
+/*******************************************************************************
+ * @brief   Init DMA streams and interrupts for asynchronous transfers.
+ * @param   SPIx: SPI instance. DMA2 streams:
+ *          SPI1: Stream0 (RX) / Stream3 (TX), Channel 3.
+ * @retval  1 if successful. 0 if fail.
+ ******************************************************************************/
+uint8_t cncSPI_InitDMA(SPI_TypeDef *SPIx)
+{
+  cncSPI_handle_t *hSPI = cncSPI_getHandle(SPIx);
+  uint32_t nvic_priority = 0;
+
+  if(hSPI == 0)
+    return 0;
+
+  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA2);
+
+  cncSPI_InitStream(hSPI, hSPI->pDma->STREAM_RX,
+                    LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  cncSPI_InitStream(hSPI, hSPI->pDma->STREAM_TX,
+                    LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+
+  /*!< The RX stream ends the transfer: TX only reports errors */
+  LL_DMA_DisableIT_TC(hSPI->pDma->DMAx, hSPI->pDma->STREAM_TX);
+
+  /*!< Same level as the I2C transfers: preempts the sampler */
+  nvic_priority = NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 0, 0);
+  NVIC_SetPriority(hSPI->pDma->IRQ_RX, nvic_priority);
+  NVIC_SetPriority(hSPI->pDma->IRQ_TX, nvic_priority);
+  NVIC_EnableIRQ(hSPI->pDma->IRQ_RX);
+  NVIC_EnableIRQ(hSPI->pDma->IRQ_TX);
+
+  hSPI->Async.busy = 0;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Start a non-blocking register read (DMA). The address byte is sent
+ *          by polling, the data bytes by DMA.
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: buffer for the bytes from slave. Valid after callback.
+ * @param   count: number of bytes to be read.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncSPI_ReadAsync(SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData,
+                         uint8_t count, cncSPI_callback_t callback,
+                         void *pContext)
+{
+  return cncSPI_StartAsync(SPIx, (regAddr | SPI_READ_MSK), pData, count,
+                           callback, pContext);
+}
+
+/*******************************************************************************
+ * @brief   Start a non-blocking register write (DMA).
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: first register address.
+ * @param   pData: bytes to be written. Must remain valid until callback.
+ * @param   count: number of bytes to be written.
+ * @param   callback: called from interrupt context at the end of transfer.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+uint8_t cncSPI_WriteAsync(SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData,
+                          uint8_t count, cncSPI_callback_t callback,
+                          void *pContext)
+{
+  return cncSPI_StartAsync(SPIx, (regAddr & ~SPI_READ_MSK), pData, count,
+                           callback, pContext);
+}
+
+/*******************************************************************************
+ * @brief   Check if an asynchronous transfer is in progress.
+ * @param   SPIx: SPI instance.
+ * @retval  1 if busy. 0 if idle.
+ ******************************************************************************/
+uint8_t cncSPI_isBusyAsync(SPI_TypeDef *SPIx)
+{
+  cncSPI_handle_t *hSPI = cncSPI_getHandle(SPIx);
+
+  if(hSPI == 0)
+    return 0;
+
+  return hSPI->Async.busy;
+}
+
+// Private functions ===========================================================
+/*******************************************************************************
+ * @brief   Configure the SPI peripheral: master, mode 3, 8 bits, MSB first,
+ *          software NSS.
+ * @param   hSPI: SPI handle. Prescaler must be set.
+ * @retval  None.
+ ******************************************************************************/
+static void cncSPI_Config(cncSPI_handle_t *hSPI)
+{
+  SPI_TypeDef *SPIx = hSPI->Instance;
+
+  SPIx->CR1 = 0;
+  SPIx->CR2 = 0;
+  SPIx->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI |
+              SPI_CR1_CPOL | SPI_CR1_CPHA |
+              ((uint32_t) hSPI->Prescaler << SPI_CR1_BR_Pos);
+  SPIx->CR1 |= SPI_CR1_SPE;
+}
+
+/*******************************************************************************
+ * @brief   Take the bus for a transaction. Blocking and asynchronous
+ *          transfers share the same owner flag.
+ * @param   hSPI: SPI handle.
+ * @retval  1 if the bus is taken. 0 if busy.
+ ******************************************************************************/
+static uint8_t cncSPI_Lock(cncSPI_handle_t *hSPI)
+{
+  uint8_t status = 0;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if(hSPI->Async.busy == 0)
+  {
+    hSPI->Async.busy = 1;
+    status = 1;
+  }
+  __set_PRIMASK(primask);
+
+  return status;
+}
+
+/*******************************************************************************
+ * @brief   Release the bus.
+ * @param   hSPI: SPI handle.
+ * @retval  None.
+ ******************************************************************************/
+static void cncSPI_Unlock(cncSPI_handle_t *hSPI)
+{
+  hSPI->Async.busy = 0;
+}
+
+/*******************************************************************************
+ * @brief   Full duplex byte, bounded by the transaction deadline.
+ * @param   hSPI: SPI handle.
+ * @param   txData: byte to send.
+ * @param   pRxData: byte received.
+ * @param   startCycles: DWT->CYCCNT at transaction start.
+ * @retval  1 if successful. 0 if timeout.
+ ******************************************************************************/
+static uint8_t cncSPI_Transfer(cncSPI_handle_t *hSPI, uint8_t txData,
+                               uint8_t *pRxData, uint32_t startCycles)
+{
+  SPI_TypeDef *SPIx = hSPI->Instance;
+
+  while((SPIx->SR & SPI_SR_TXE) == 0)
+  {
+    if((DWT->CYCCNT - startCycles) > hSPI->TimeoutCycles)
+    {
+      hSPI->TimeoutCount++;
+      return 0;
+    }
+  }
+
+  *(__IO uint8_t *) &SPIx->DR = txData;
+
+  while((SPIx->SR & SPI_SR_RXNE) == 0)
+  {
+    if((DWT->CYCCNT - startCycles) > hSPI->TimeoutCycles)
+    {
+      hSPI->TimeoutCount++;
+      return 0;
+    }
+  }
+
+  *pRxData = *(__IO uint8_t *) &SPIx->DR;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Wait for the last frame to leave the shift register.
+ * @param   hSPI: SPI handle.
+ * @param   startCycles: DWT->CYCCNT at transaction start.
+ * @retval  1 if successful. 0 if timeout.
+ ******************************************************************************/
+static uint8_t cncSPI_WaitIdle(cncSPI_handle_t *hSPI, uint32_t startCycles)
+{
+  while((hSPI->Instance->SR & SPI_SR_BSY) != 0)
+  {
+    if((DWT->CYCCNT - startCycles) > hSPI->TimeoutCycles)
+    {
+      hSPI->TimeoutCount++;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Configure a DMA stream for the SPI data register.
+ * @param   hSPI: SPI handle.
+ * @param   stream: LL_DMA_STREAM_x.
+ * @param   direction: LL_DMA_DIRECTION_PERIPH_TO_MEMORY or
+ *          LL_DMA_DIRECTION_MEMORY_TO_PERIPH.
+ * @retval  None.
+ ******************************************************************************/
+static void cncSPI_InitStream(cncSPI_handle_t *hSPI, uint32_t stream,
+                              uint32_t direction)
+{
+  DMA_TypeDef *DMAx = hSPI->pDma->DMAx;
+
+  LL_DMA_DisableStream(DMAx, stream);
+  LL_DMA_SetChannelSelection(DMAx, stream, hSPI->pDma->CHANNEL);
+  LL_DMA_ConfigTransfer(DMAx, stream,
+                        direction |
+                        LL_DMA_PRIORITY_VERYHIGH |
+                        LL_DMA_MODE_NORMAL |
+                        LL_DMA_PERIPH_NOINCREMENT |
+                        LL_DMA_MEMORY_INCREMENT |
+                        LL_DMA_PDATAALIGN_BYTE |
+                        LL_DMA_MDATAALIGN_BYTE);
+  LL_DMA_SetPeriphAddress(DMAx, stream, (uint32_t) &hSPI->Instance->DR);
+  cncSPI_ClearFlagsDMA(DMAx, stream);
+  LL_DMA_EnableIT_TC(DMAx, stream);
+  LL_DMA_EnableIT_TE(DMAx, stream);
+}
+
+/*******************************************************************************
+ * @brief   Interrupt flags of a DMA stream, aligned to stream 0 positions.
+ * @param   DMAx: DMA instance.
+ * @param   stream: LL_DMA_STREAM_x.
+ * @retval  Flags (DMA_FLAG_TC, DMA_FLAG_TE, ...).
+ ******************************************************************************/
+static uint32_t cncSPI_GetFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream)
+{
+  uint32_t isr = (stream < LL_DMA_STREAM_4) ? DMAx->LISR : DMAx->HISR;
+
+  return (isr >> DMA_FLAG_SHIFT[stream & 0x03]) & DMA_FLAG_ALL;
+}
+
+/*******************************************************************************
+ * @brief   Clear all interrupt flags of a DMA stream.
+ * @param   DMAx: DMA instance.
+ * @param   stream: LL_DMA_STREAM_x.
+ * @retval  None.
+ ******************************************************************************/
+static void cncSPI_ClearFlagsDMA(DMA_TypeDef *DMAx, uint32_t stream)
+{
+  if(stream < LL_DMA_STREAM_4)
+    DMAx->LIFCR = (DMA_FLAG_ALL << DMA_FLAG_SHIFT[stream & 0x03]);
+  else
+    DMAx->HIFCR = (DMA_FLAG_ALL << DMA_FLAG_SHIFT[stream & 0x03]);
+}
+
+/*******************************************************************************
+ * @brief   Select the device, send the address byte and hand the data bytes
+ *          to DMA. RX always runs: its transfer complete ends the transaction.
+ * @param   SPIx: SPI instance.
+ * @param   regAddr: register address, bit 7 set for read.
+ * @param   pData: data buffer.
+ * @param   count: number of bytes.
+ * @param   callback: end of transfer function.
+ * @param   pContext: passed back to callback.
+ * @retval  1 if the transfer was started. 0 if the bus is busy.
+ ******************************************************************************/
+static uint8_t cncSPI_StartAsync(SPI_TypeDef *SPIx, uint8_t regAddr,
+                                 uint8_t *pData, uint8_t count,
+                                 cncSPI_callback_t callback, void *pContext)
+{
+  cncSPI_handle_t *hSPI = cncSPI_getHandle(SPIx);
+  const spi_dma_t *pDma = 0;
+  uint8_t rxData = 0x00;
+  uint8_t read = ((regAddr & SPI_READ_MSK) != 0) ? 1 : 0;
+
+  if((hSPI == 0) || (count == 0))
+    return 0;
+
+  if(cncSPI_Lock(hSPI) != 1)
+    return 0;
+
+  pDma = hSPI->pDma;
+  hSPI->Async.pData = pData;
+  hSPI->Async.count = count;
+  hSPI->Async.callback = callback;
+  hSPI->Async.pContext = pContext;
+
+  LL_GPIO_ResetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+
+  /*!< One byte at SCK speed: cheaper than a third DMA descriptor */
+  if(cncSPI_Transfer(hSPI, regAddr, &rxData, DWT->CYCCNT) != 1)
+  {
+    LL_GPIO_SetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+    cncSPI_Unlock(hSPI);
+    return 0;
+  }
+
+  cncSPI_ClearFlagsDMA(pDma->DMAx, pDma->STREAM_RX);
+  cncSPI_ClearFlagsDMA(pDma->DMAx, pDma->STREAM_TX);
+
+  if(read == 1)
+  {
+    LL_DMA_SetMemoryAddress(pDma->DMAx, pDma->STREAM_RX, (uint32_t) pData);
+    LL_DMA_SetMemoryIncMode(pDma->DMAx, pDma->STREAM_RX, LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetMemoryAddress(pDma->DMAx, pDma->STREAM_TX, (uint32_t) &dummyTx);
+    LL_DMA_SetMemoryIncMode(pDma->DMAx, pDma->STREAM_TX, LL_DMA_MEMORY_NOINCREMENT);
+  }
+  else
+  {
+    LL_DMA_SetMemoryAddress(pDma->DMAx, pDma->STREAM_RX, (uint32_t) &dummyRx);
+    LL_DMA_SetMemoryIncMode(pDma->DMAx, pDma->STREAM_RX, LL_DMA_MEMORY_NOINCREMENT);
+    LL_DMA_SetMemoryAddress(pDma->DMAx, pDma->STREAM_TX, (uint32_t) pData);
+    LL_DMA_SetMemoryIncMode(pDma->DMAx, pDma->STREAM_TX, LL_DMA_MEMORY_INCREMENT);
+  }
+
+  LL_DMA_SetDataLength(pDma->DMAx, pDma->STREAM_RX, count);
+  LL_DMA_SetDataLength(pDma->DMAx, pDma->STREAM_TX, count);
+
+  /*!< RX first, so no received byte is lost when TX starts clocking */
+  LL_DMA_EnableStream(pDma->DMAx, pDma->STREAM_RX);
+  SPIx->CR2 |= SPI_CR2_RXDMAEN;
+  LL_DMA_EnableStream(pDma->DMAx, pDma->STREAM_TX);
+  SPIx->CR2 |= SPI_CR2_TXDMAEN;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   DMA RX stream interrupt: the last byte was clocked in.
+ * @param   hSPI: SPI handle.
+ * @retval  None.
+ ******************************************************************************/
+static void cncSPI_RxHandlerDMA(cncSPI_handle_t *hSPI)
+{
+  const spi_dma_t *pDma = hSPI->pDma;
+  uint32_t flags = cncSPI_GetFlagsDMA(pDma->DMAx, pDma->STREAM_RX);
+
+  cncSPI_ClearFlagsDMA(pDma->DMAx, pDma->STREAM_RX);
+
+  if((flags & DMA_FLAG_TE) != 0)
+    cncSPI_EndAsync(hSPI, 0);
+  else if((flags & DMA_FLAG_TC) != 0)
+    cncSPI_EndAsync(hSPI, 1);
+}
+
+/*******************************************************************************
+ * @brief   DMA TX stream interrupt (errors only).
+ * @param   hSPI: SPI handle.
+ * @retval  None.
+ ******************************************************************************/
+static void cncSPI_TxHandlerDMA(cncSPI_handle_t *hSPI)
+{
+  const spi_dma_t *pDma = hSPI->pDma;
+  uint32_t flags = cncSPI_GetFlagsDMA(pDma->DMAx, pDma->STREAM_TX);
+
+  cncSPI_ClearFlagsDMA(pDma->DMAx, pDma->STREAM_TX);
+
+  if(((flags & DMA_FLAG_TE) != 0) && (hSPI->Async.busy == 1))
+    cncSPI_EndAsync(hSPI, 0);
+}
+
+/*******************************************************************************
+ * @brief   Deselect the device and report the end of an asynchronous
+ *          transfer.
+ * @param   hSPI: SPI handle.
+ * @param   status: 1 if successful, 0 if fail.
+ * @retval  None.
+ ******************************************************************************/
+static void cncSPI_EndAsync(cncSPI_handle_t *hSPI, uint8_t status)
+{
+  SPI_TypeDef *SPIx = hSPI->Instance;
+  const spi_dma_t *pDma = hSPI->pDma;
+
+  LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_TX);
+  LL_DMA_DisableStream(pDma->DMAx, pDma->STREAM_RX);
+  SPIx->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+
+  /*!< RX complete: the shift register is empty, BSY clears within a cycle */
+  while((SPIx->SR & SPI_SR_BSY) != 0)
+    ;
+
+  LL_GPIO_SetOutputPin(hSPI->pGpio->GPIO_PORT_CS, hSPI->pGpio->GPIO_PIN_CS);
+
+  if(status != 1)
+    hSPI->ErrorCount++;
+
+  cncSPI_Unlock(hSPI);
+
+  if(hSPI->Async.callback != 0)
+    hSPI->Async.callback(hSPI->Async.pContext, status);
+}
+
+// IRQ Handlers ================================================================
+/*!< SPI1_RX */
+void DMA2_Stream0_IRQHandler(void)
+{
+  cncSPI_RxHandlerDMA(&spiHandle[0]);
+}
+
+/*!< SPI1_TX */
+void DMA2_Stream3_IRQHandler(void)
+{
+  cncSPI_TxHandlerDMA(&spiHandle[0]);
+}
+
+// EOF =========================================================================
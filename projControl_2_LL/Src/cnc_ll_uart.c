@@ -2,34 +2,72 @@
 #include "string.h"
 
 // =============================================================================
+static const uart_gpio_t USART1_GPIO = { GPIOA, LL_GPIO_PIN_9, GPIOA,
+    LL_GPIO_PIN_10, LL_GPIO_AF_7, LL_AHB1_GRP1_PERIPH_GPIOA,
+    LL_APB2_GRP1_PERIPH_USART1, 2 };
+static const uart_gpio_t USART2_GPIO = { GPIOA, LL_GPIO_PIN_2, GPIOA,
+    LL_GPIO_PIN_3, LL_GPIO_AF_7, LL_AHB1_GRP1_PERIPH_GPIOA,
+    LL_APB1_GRP1_PERIPH_USART2, 1 };
+static const uart_gpio_t USART3_GPIO = { GPIOD, LL_GPIO_PIN_8, GPIOD,
+    LL_GPIO_PIN_9, LL_GPIO_AF_7, LL_AHB1_GRP1_PERIPH_GPIOD,
+    LL_APB1_GRP1_PERIPH_USART3, 1 };
+static const uart_gpio_t UART4_GPIO = { GPIOC, LL_GPIO_PIN_10, GPIOC,
+    LL_GPIO_PIN_11, LL_GPIO_AF_8, LL_AHB1_GRP1_PERIPH_GPIOC,
+    LL_APB1_GRP1_PERIPH_UART4, 1 };
+static const uart_gpio_t UART5_GPIO = { GPIOC, LL_GPIO_PIN_12, GPIOD,
+    LL_GPIO_PIN_2, LL_GPIO_AF_8,
+    (LL_AHB1_GRP1_PERIPH_GPIOC | LL_AHB1_GRP1_PERIPH_GPIOD),
+    LL_APB1_GRP1_PERIPH_UART5, 1 };
+static const uart_gpio_t USART6_GPIO = { GPIOC, LL_GPIO_PIN_6, GPIOC,
+    LL_GPIO_PIN_7, LL_GPIO_AF_8, LL_AHB1_GRP1_PERIPH_GPIOC,
+    LL_APB2_GRP1_PERIPH_USART6, 2 };
 
-// =============================================================================
 static __I  uint8_t  BASH_SIZE    = 80;
-static __I  uint32_t TIMEOUT_MAX  = 1000;
-static __IO uint32_t timeout      = 0;
+static __I  uint32_t TIMEOUT_US   = 1000;    /*!< 1 char at 115200: 87 us */
+static __I  uint32_t BAUDRATE     = 115200;
+
+#define USART_INSTANCES   6
+
+// =============================================================================
+static cncUSART_handle_t usartHandle[USART_INSTANCES] =
+{
+  { USART1, &USART1_GPIO, 0, 0 },
+  { USART2, &USART2_GPIO, 0, 0 },
+  { USART3, &USART3_GPIO, 0, 0 },
+  { UART4,  &UART4_GPIO,  0, 0 },
+  { UART5,  &UART5_GPIO,  0, 0 },
+  { USART6, &USART6_GPIO, 0, 0 },
+};
 
 // =============================================================================
-static inline uint8_t cncUSART_putChar(USART_TypeDef *USARTx, uint8_t ch)
+static inline uint8_t cncUSART_waitFlag(cncUSART_handle_t *hUSART,
+                                        uint32_t (*isActiveFlag)(USART_TypeDef *))
 {
-  if(LL_USART_GetDataWidth(USARTx) == LL_USART_DATAWIDTH_8B)
+  uint32_t start = DWT->CYCCNT;
+
+  while(isActiveFlag(hUSART->Instance) != 1)
   {
-    timeout = TIMEOUT_MAX;
-    while(LL_USART_IsActiveFlag_TXE(USARTx) != 1)
+    if((DWT->CYCCNT - start) > hUSART->TimeoutCycles)
     {
-      if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-        if(--timeout == 0)
-          return 0;
+      hUSART->TimeoutCount++;
+      return 0;
     }
+  }
+
+  return 1;
+}
+
+static inline uint8_t cncUSART_putChar(cncUSART_handle_t *hUSART, uint8_t ch)
+{
+  if(LL_USART_GetDataWidth(hUSART->Instance) == LL_USART_DATAWIDTH_8B)
+  {
+    if(cncUSART_waitFlag(hUSART, LL_USART_IsActiveFlag_TXE) != 1)
+      return 0;
 
-    LL_USART_TransmitData8(USARTx, (ch & 0xFF));
+    LL_USART_TransmitData8(hUSART->Instance, (ch & 0xFF));
 
-    timeout = TIMEOUT_MAX;
-    while(LL_USART_IsActiveFlag_TC(USARTx) != 1)
-    {
-      if((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0)
-        if(--timeout == 0)
-          return 0;
-    }
+    if(cncUSART_waitFlag(hUSART, LL_USART_IsActiveFlag_TC) != 1)
+      return 0;
   }
 
   return 1;
@@ -41,53 +79,91 @@ static inline uint16_t cncUSART_Dec2Int(float32_t x)
 }
 
 // =============================================================================
+cncUSART_handle_t *cncUSART_getHandle(USART_TypeDef *USARTx)
+{
+  for(uint8_t i = 0; i < USART_INSTANCES; i++)
+  {
+    if(usartHandle[i].Instance == USARTx)
+      return &usartHandle[i];
+  }
+
+  return 0;
+}
+
 uint8_t cncUSART_init(USART_TypeDef *USARTx)
 {
-  uint8_t status = 0x00;
+  cncUSART_handle_t *hUSART = cncUSART_getHandle(USARTx);
+  const uart_gpio_t *pGpio = 0;
   uint32_t periphClock = 0;
 
   LL_GPIO_InitTypeDef  GPIO_InitStruct;
+  LL_RCC_ClocksTypeDef RCC_Clocks;
+
+  if(hUSART == 0)
+    return 0;
 
-  if(LL_APB1_GRP1_IsEnabledClock(LL_APB1_GRP1_PERIPH_UART5) != 1)
-    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_UART5);
+  pGpio = hUSART->pGpio;
+  LL_RCC_GetSystemClocksFreq(&RCC_Clocks);
 
-  /*!< APB1 clock = SystemCoreClock/4 */
-  periphClock = (SystemCoreClock/4);
+  if(pGpio->APB == 2)
+  {
+    if(LL_APB2_GRP1_IsEnabledClock(pGpio->USART_CLOCK) != 1)
+      LL_APB2_GRP1_EnableClock(pGpio->USART_CLOCK);
+    periphClock = RCC_Clocks.PCLK2_Frequency;
+  }
+  else
+  {
+    if(LL_APB1_GRP1_IsEnabledClock(pGpio->USART_CLOCK) != 1)
+      LL_APB1_GRP1_EnableClock(pGpio->USART_CLOCK);
+    periphClock = RCC_Clocks.PCLK1_Frequency;
+  }
 
-  LL_USART_SetHWFlowCtrl(UART5, LL_USART_HWCONTROL_NONE);
-  LL_USART_SetBaudRate(UART5, periphClock, LL_USART_OVERSAMPLING_16, 115200);
-  LL_USART_ConfigCharacter(UART5, LL_USART_DATAWIDTH_8B, LL_USART_PARITY_NONE, LL_USART_STOPBITS_1);
-  LL_USART_SetTransferDirection(UART5, LL_USART_DIRECTION_TX_RX);
-  LL_USART_ConfigAsyncMode(UART5);
-  LL_USART_Enable(UART5);
+  LL_USART_SetHWFlowCtrl(USARTx, LL_USART_HWCONTROL_NONE);
+  LL_USART_SetBaudRate(USARTx, periphClock, LL_USART_OVERSAMPLING_16, BAUDRATE);
+  LL_USART_ConfigCharacter(USARTx, LL_USART_DATAWIDTH_8B, LL_USART_PARITY_NONE, LL_USART_STOPBITS_1);
+  LL_USART_SetTransferDirection(USARTx, LL_USART_DIRECTION_TX_RX);
+  LL_USART_ConfigAsyncMode(USARTx);
+  LL_USART_Enable(USARTx);
 
-  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_GPIOC);
-  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_GPIOD);
+  LL_AHB1_GRP1_EnableClock(pGpio->GPIO_CLOCK);
 
-  GPIO_InitStruct.Pin = LL_GPIO_PIN_12;
+  GPIO_InitStruct.Pin = pGpio->GPIO_PIN_TX;
   GPIO_InitStruct.Mode = LL_GPIO_MODE_ALTERNATE;
   GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_VERY_HIGH;
   GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
   GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
-  GPIO_InitStruct.Alternate = LL_GPIO_AF_8;
-  LL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+  GPIO_InitStruct.Alternate = pGpio->GPIO_ALTERNATE;
+  LL_GPIO_Init(pGpio->GPIO_PORT_TX, &GPIO_InitStruct);
 
-  GPIO_InitStruct.Pin = LL_GPIO_PIN_2;
-  GPIO_InitStruct.Mode = LL_GPIO_MODE_ALTERNATE;
-  GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_VERY_HIGH;
-  GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-  GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
-  GPIO_InitStruct.Alternate = LL_GPIO_AF_8;
-  LL_GPIO_Init(GPIOD, &GPIO_InitStruct);
+  GPIO_InitStruct.Pin = pGpio->GPIO_PIN_RX;
+  LL_GPIO_Init(pGpio->GPIO_PORT_RX, &GPIO_InitStruct);
 
-  return status;
+  hUSART->TimeoutCount = 0;
+
+  return cncUSART_setTimeout(USARTx, TIMEOUT_US);
+}
+
+uint8_t cncUSART_setTimeout(USART_TypeDef *USARTx, uint32_t timeout_us)
+{
+  cncUSART_handle_t *hUSART = cncUSART_getHandle(USARTx);
+
+  if(hUSART == 0)
+    return 0;
+
+  hUSART->TimeoutCycles = timeout_us*(SystemCoreClock/1000000);
+
+  return 1;
 }
 
 uint8_t cncUSART_putString(USART_TypeDef *USARTx, uint8_t *pStr, uint8_t count)
 {
+  cncUSART_handle_t *hUSART = cncUSART_getHandle(USARTx);
   __IO uint8_t len = count;
   __IO uint8_t n = 0;
 
+  if(hUSART == 0)
+    return 0;
+
   /*Check if USART instance is enabled*/
   if (LL_USART_IsEnabled(USARTx) != 1)
     LL_USART_Enable(USARTx);
@@ -99,7 +175,7 @@ uint8_t cncUSART_putString(USART_TypeDef *USARTx, uint8_t *pStr, uint8_t count)
   /*Send byte until finish or null character*/
   while ((*pStr != '\0') && (len--))
   {
-    if (cncUSART_putChar(USARTx, *pStr++) == 1)
+    if (cncUSART_putChar(hUSART, *pStr++) == 1)
       n++;
   }
 
@@ -263,6 +339,40 @@ uint8_t cncUSART_sendData_int16(USART_TypeDef *USARTx, int16_t *pData, uint8_t v
   return 1;
 }
 
+/*!< Leading field of a log line: unsigned decimal and the separator, the
+ *   line is ended by the cncUSART_sendData_* call that follows */
+uint8_t cncUSART_sendTimestamp(USART_TypeDef *USARTx, uint64_t timestamp, uart_data_t mode)
+{
+  uint8_t tmp[21];
+  uint8_t *ptmp = &tmp[20];
+  uint8_t *pSeparator = (uint8_t *)"\t";
+
+  switch (mode & ~0x0001)
+  {
+    case UART_DATA_FORMAT_SPACE:
+      pSeparator = (uint8_t *)" ";
+      break;
+    case UART_DATA_FORMAT_BS:
+      pSeparator = (uint8_t *)"/";
+      break;
+  }
+
+  /*!< 20 digits hold any 64 bits value */
+  *ptmp = '\0';
+  do
+  {
+    *--ptmp = (uint8_t)('0' + (timestamp % 10));
+    timestamp /= 10;
+  } while(timestamp != 0);
+
+  if(cncUSART_putString(USARTx, ptmp, 20) == 0)
+    return 0;
+
+  cncUSART_putString(USARTx, pSeparator, 1);
+
+  return 1;
+}
+
 uint8_t cncUSART_receiveData(USART_TypeDef *USARTx, uint8_t *pData, uint8_t len)
 {
   return 1;
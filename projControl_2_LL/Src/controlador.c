@@ -2,6 +2,10 @@
 
 // =============================================================================
 __IO float32_t h[2][4] = { { 0.0f }, { 0.0f } }; /*!< h: funcion auxiliar de planta */
+__IO q31_t hQ31[2][4] = { { 0 }, { 0 } };
+
+// =============================================================================
+static q31_t eControl_Saturate(int64_t x);
 
 // =============================================================================
 float32_t controlador_planta(float32_t inputReference, uint8_t indice_planta)
@@ -26,4 +30,43 @@ float32_t controlador_planta(float32_t inputReference, uint8_t indice_planta)
   return y;
 }
 
+/*==============================================================================
+* Same as controlador_planta(), input and output in Q31 of 180 deg. 64 bit
+* accumulator (SMLAL): Q31 state x Q29 coefficients.
+==============================================================================*/
+q31_t controlador_planta_q31(q31_t inputReference, uint8_t indice_planta)
+{
+  static const q31_t k_num[4] = {202615082, 142915037, 198320115, 147317378};
+  static const q31_t k_den[3] = {1137575775, 796286937, 186992139};
+  __IO q31_t *pH = &hQ31[indice_planta][0];
+  int64_t acc = 0;
+
+  acc  = (int64_t)inputReference << (29 - CONTROL_Q31_H_SHIFT);
+  acc += (int64_t)k_den[0]*pH[1];
+  acc -= (int64_t)k_den[1]*pH[2];
+  acc += (int64_t)k_den[2]*pH[3];
+  pH[0] = eControl_Saturate(acc >> 29);
+
+  acc  = (int64_t)k_num[0]*pH[0];
+  acc -= (int64_t)k_num[1]*pH[1];
+  acc -= (int64_t)k_num[2]*pH[2];
+  acc += (int64_t)k_num[3]*pH[3];
+
+  for(uint8_t i = 3; i > 0; i--)
+    pH[i] = pH[i - 1];
+
+  return eControl_Saturate(acc >> (29 - CONTROL_Q31_H_SHIFT));
+}
+
+// =============================================================================
+static q31_t eControl_Saturate(int64_t x)
+{
+  if(x > INT32_MAX)
+    return INT32_MAX;
+  if(x < INT32_MIN)
+    return INT32_MIN;
+
+  return (q31_t)x;
+}
+
 // EOF =========================================================================
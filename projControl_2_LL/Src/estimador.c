@@ -3,39 +3,165 @@
 #include "arm_math.h"
 
 // =============================================================================
-volatile float32_t dt = 0.0f;
-volatile float32_t weight = 0.0f;
+static estimator_t estimators[ESTIMATOR_MAX_INSTANCES];
 
-volatile float32_t aPastGyroscope_Angle[3] = { 0.0f };
-volatile float32_t *pPastGyroscope_Angle = &aPastGyroscope_Angle[0];
+#define EKF_N   ESTIMATOR_EKF_N
+#define EKF_M   3
 
-volatile float32_t aPastAccel_Angle[3] = { 0.0f };
-volatile float32_t *pPastAccel_Angle = &aPastAccel_Angle[0];
+/*!< Fixed size work matrices, shared by predict and update */
+static float32_t aEkfF[EKF_N*EKF_N];
+static float32_t aEkfFt[EKF_N*EKF_N];
+static float32_t aEkfNN[EKF_N*EKF_N];
+static float32_t aEkfXi[4*3];
+static float32_t aEkfXit[3*4];
+static float32_t aEkfQ[4*4];
+static float32_t aEkfH[EKF_M*EKF_N];
+static float32_t aEkfHt[EKF_N*EKF_M];
+static float32_t aEkfHP[EKF_M*EKF_N];
+static float32_t aEkfPHt[EKF_N*EKF_M];
+static float32_t aEkfS[EKF_M*EKF_M];
+static float32_t aEkfSinv[EKF_M*EKF_M];
+static float32_t aEkfK[EKF_N*EKF_M];
+static float32_t aEkfY[EKF_M];
+static float32_t aEkfDx[EKF_N];
 
-volatile float32_t aPastEstimatedGyro[2]   = { 0.0f };
-volatile float32_t aPastEstimatedAccel[2]  = { 0.0f };
+static arm_matrix_instance_f32 matF    = { EKF_N, EKF_N, &aEkfF[0] };
+static arm_matrix_instance_f32 matFt   = { EKF_N, EKF_N, &aEkfFt[0] };
+static arm_matrix_instance_f32 matNN   = { EKF_N, EKF_N, &aEkfNN[0] };
+static arm_matrix_instance_f32 matXi   = { 4, 3, &aEkfXi[0] };
+static arm_matrix_instance_f32 matXit  = { 3, 4, &aEkfXit[0] };
+static arm_matrix_instance_f32 matQ    = { 4, 4, &aEkfQ[0] };
+static arm_matrix_instance_f32 matH    = { EKF_M, EKF_N, &aEkfH[0] };
+static arm_matrix_instance_f32 matHt   = { EKF_N, EKF_M, &aEkfHt[0] };
+static arm_matrix_instance_f32 matHP   = { EKF_M, EKF_N, &aEkfHP[0] };
+static arm_matrix_instance_f32 matPHt  = { EKF_N, EKF_M, &aEkfPHt[0] };
+static arm_matrix_instance_f32 matS    = { EKF_M, EKF_M, &aEkfS[0] };
+static arm_matrix_instance_f32 matSinv = { EKF_M, EKF_M, &aEkfSinv[0] };
+static arm_matrix_instance_f32 matK    = { EKF_N, EKF_M, &aEkfK[0] };
+static arm_matrix_instance_f32 matY    = { EKF_M, 1, &aEkfY[0] };
+static arm_matrix_instance_f32 matDx   = { EKF_N, 1, &aEkfDx[0] };
+
+#define ESTIMATOR_BENCH_RUNS      100
+
+/*!< Benchmark reference: the complementary filter state as volatile
+ *   globals, the layout before estimator_t */
+static volatile float32_t benchDt = 0.0f;
+static volatile float32_t benchWeight = 0.0f;
+static volatile float32_t aBenchPastAccel_Angle[2] = { 0.0f };
+static volatile float32_t aBenchPastEstimatedGyro[2] = { 0.0f };
+static volatile float32_t aBenchPastEstimatedAccel[2] = { 0.0f };
 
 // =============================================================================
 static void eCalc_NormalizeMeasure(float32_t *pMeasure, uint8_t len);
-static float32_t eCalc_FastInverse_Sqrt(float32_t x);
-static void eCalc_Angles(float32_t *pAccelerometer, float32_t *pGyroscope, float32_t *pResult);
-static void eCalc_ComplementaryFilter(float32_t *pGyroscope, float32_t *pFilteredAngles);
+static void eCalc_Angles(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope, float32_t *pResult);
+static void eCalc_AccelAngles(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pResult);
+static void eCalc_ComplementaryFilter(estimator_t *pEstimator, float32_t *pGyroscope, float32_t *pFilteredAngles);
+static float32_t eCalc_AdaptiveGain(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope);
+static float32_t eCalc_Ramp(float32_t x, float32_t low, float32_t high);
+static void eCalc_AdaptiveFilter(estimator_t *pEstimator, float32_t *pMeasures, float32_t *pGyroscope, float32_t *pFilteredAngles);
+static void eBench_VolatileFilter(float32_t *pGyroscope, float32_t *pFilteredAngles);
+static void eQuat_Update(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope, float32_t step);
+static void eQuat_Propagate(estimator_t *pEstimator, float32_t *pGyroscope, float32_t step);
+static void eQuat_Correct(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t step);
+static void eQuat_Align(estimator_quat_t *pQuat, float32_t *pAccelerometer);
+static void eQuat_Mahony(estimator_t *pEstimator, float32_t *pAccel, float32_t *pOmega, float32_t step);
+static void eQuat_Madgwick(estimator_t *pEstimator, float32_t *pAccel, float32_t *pQDot);
+static void eQuat_Derivative(float32_t *pQ, float32_t *pOmega, float32_t *pQDot);
+static void eQuat_Integrate(float32_t *pQ, float32_t *pQDot, float32_t step);
+static void eQuat_Angles(estimator_quat_t *pQuat, float32_t *pAngles);
+static void eEkf_Reset(estimator_t *pEstimator);
+static void eEkf_Predict(estimator_t *pEstimator, float32_t *pGyroscope, float32_t step);
+static void eEkf_Correct(estimator_t *pEstimator, float32_t *pAccelerometer);
 
 // =============================================================================
-filter_status_t estimator_init(filter_init_t *filter_InitStruct)
+/*==============================================================================
+* Contexts are owned by the module, as the driver handles (mpu9250_getHandle).
+==============================================================================*/
+estimator_t *estimator_getHandle(uint8_t index)
+{
+  if(index >= ESTIMATOR_MAX_INSTANCES)
+    return 0;
+
+  return &estimators[index];
+}
+
+filter_status_t estimator_init(estimator_t *pEstimator, filter_init_t *filter_InitStruct)
 {
   filter_status_t status = FILTER_ERROR;
 
-      dt  = (float32_t)(1.0f/filter_InitStruct->SampleRate);
-  weight  = filter_InitStruct->Weight;
+  pEstimator->Type      = filter_InitStruct->Type;
+  pEstimator->Accuracy  = filter_InitStruct->Accuracy;
+  pEstimator->Dt        = (float32_t)(1.0f/filter_InitStruct->SampleRate);
+  pEstimator->Weight    = filter_InitStruct->Weight;
+  pEstimator->DtNominal = pEstimator->Dt;
+  pEstimator->LastTimestamp = 0;
+
+  for(uint8_t i = 0; i < 3; i++)
+    pEstimator->PastGyroscopeAngle[i] = 0.0f;
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    pEstimator->PastAccelAngle[i]     = 0.0f;
+    pEstimator->PastEstimatedGyro[i]  = 0.0f;
+    pEstimator->PastEstimatedAccel[i] = 0.0f;
+  }
 
-  if(mpu9250_readID() == MPU9250_DEVICE_ID)
+  pEstimator->Adaptive  = filter_InitStruct->Adaptive;
+  pEstimator->AccelLow  = filter_InitStruct->AccelLow;
+  pEstimator->AccelHigh = filter_InitStruct->AccelHigh;
+  pEstimator->RateLow   = filter_InitStruct->RateLow;
+  pEstimator->RateHigh  = filter_InitStruct->RateHigh;
+  pEstimator->Gain      = 1.0f;
+  pEstimator->Tilt      = 0.0f;
+
+  pEstimator->CorrectPeriod = 0.0f;
+  if(filter_InitStruct->CorrectRate > 0.0f)
+    pEstimator->CorrectPeriod = 1.0f/filter_InitStruct->CorrectRate;
+
+  pEstimator->CorrectElapsed = 0.0f;
+  pEstimator->SumCount = 0;
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pEstimator->AccelSum[i] = 0.0f;
+    pEstimator->GyroSum[i] = 0.0f;
+  }
+
+  pEstimator->Kp   = filter_InitStruct->Kp;
+  pEstimator->Ki   = filter_InitStruct->Ki;
+  pEstimator->Beta = filter_InitStruct->Beta;
+
+  pEstimator->Quat.q[0] = 1.0f;
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pEstimator->Quat.q[i + 1] = 0.0f;
+    pEstimator->Quat.Integral[i] = 0.0f;
+  }
+  pEstimator->Quat.Aligned = 0;
+
+  pEstimator->GyroNoise  = filter_InitStruct->GyroNoise*(PI/180.0f);
+  pEstimator->BiasNoise  = filter_InitStruct->BiasNoise*(PI/180.0f);
+  pEstimator->AccelNoise = filter_InitStruct->AccelNoise;
+  pEstimator->Ekf.Quat.Aligned = 0;
+
+  pEstimator->DtMeasured = 0.0f;
+  pEstimator->DtGaps = 0;
+  pEstimator->EkfPredictCycles = 0;
+  pEstimator->EkfCorrectCycles = 0;
+  pEstimator->EkfRejected = 0;
+  pEstimator->PropagateCycles = 0;
+  pEstimator->CorrectCycles = 0;
+
+  pEstimator->pDevice = mpu9250_getHandle(filter_InitStruct->Device);
+  if(pEstimator->pDevice == 0)
+    return status;
+
+  if(mpu9250_readID(pEstimator->pDevice) == MPU9250_DEVICE_ID)
     status = FILTER_OK;
 
   return status;
 }
 
-filter_status_t estimator_notFilterAngles(float32_t *pAngles)
+filter_status_t estimator_notFilteredAngles(estimator_t *pEstimator, float32_t *pAngles)
 {
   filter_status_t status = FILTER_OK;
 
@@ -45,10 +171,11 @@ filter_status_t estimator_notFilterAngles(float32_t *pAngles)
   float32_t *pAccelerometer   = &aAccelerometer[0];
   float32_t *pGyroscope       = &aGyroscope[0];
 
-  if(mpu9250_readData_float(pAccelerometer, pGyroscope) != MPU9250_OK)
+  if(mpu9250_readData_float(pEstimator->pDevice, pAccelerometer, pGyroscope)
+      != MPU9250_OK)
     status = FILTER_ERROR;
 
-  eCalc_Angles(pAccelerometer, pGyroscope, pAngles);
+  eCalc_Angles(pEstimator, pAccelerometer, pGyroscope, pAngles);
   return status;
 }
 
@@ -59,59 +186,329 @@ filter_status_t estimator_notFilterAngles(float32_t *pAngles)
 *-------------------------------------------------------------------------------
 *
 ==============================================================================*/
-filter_status_t estimator_filteredAngles(float32_t *pAngles)
+filter_status_t estimator_filteredAngles(estimator_t *pEstimator, float32_t *pAngles)
 {
   filter_status_t status = FILTER_OK;
 
   float32_t aAccelerometer[3] = { 0.0f };
   float32_t aGyroscope[3]     = { 0.0f };
-  float32_t aMeasures[6]      = { 0.0f };
 
   float32_t *pAccelerometer   = &aAccelerometer[0];
   float32_t *pGyroscope       = &aGyroscope[0];
-  float32_t *pMeasures        = &aMeasures[0];
 
-  if(mpu9250_readData_float(pAccelerometer, pGyroscope) != MPU9250_OK)
+  if(mpu9250_readData_float(pEstimator->pDevice, pAccelerometer, pGyroscope)
+      != MPU9250_OK)
     status = FILTER_ERROR;
 
-  eCalc_Angles(pAccelerometer, pGyroscope, pMeasures);
-  eCalc_ComplementaryFilter(pGyroscope, pAngles);
+  estimator_update(pEstimator, pAccelerometer, pGyroscope, pAngles);
+
+  return status;
+}
+
+/*==============================================================================
+* Same as estimator_filteredAngles() with an already acquired sample
+* (e.g. from mpu9250_readRawData_async()). pAccelerometer is normalized in place.
+==============================================================================*/
+filter_status_t estimator_update(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope, float32_t *pAngles)
+{
+  filter_status_t status = FILTER_OK;
+
+  float32_t aMeasures[6]      = { 0.0f };
+  float32_t *pMeasures        = &aMeasures[0];
+
+  if(pEstimator->Type == FILTER_EKF)
+  {
+    eEkf_Predict(pEstimator, pGyroscope, pEstimator->Dt);
+    eEkf_Correct(pEstimator, pAccelerometer);
+    eQuat_Angles(&pEstimator->Ekf.Quat, pAngles);
+    return status;
+  }
+
+  if(pEstimator->Type != FILTER_COMPLEMENTARY)
+  {
+    eQuat_Update(pEstimator, pAccelerometer, pGyroscope, pEstimator->Dt);
+    eQuat_Angles(&pEstimator->Quat, pAngles);
+    return status;
+  }
+
+  /*!< Before eCalc_Angles(): it normalizes pAccelerometer */
+  if(pEstimator->Adaptive == 1)
+    pEstimator->Gain = eCalc_AdaptiveGain(pEstimator, pAccelerometer, pGyroscope);
+
+  eCalc_Angles(pEstimator, pAccelerometer, pGyroscope, pMeasures);
+
+  if(pEstimator->Adaptive == 1)
+    eCalc_AdaptiveFilter(pEstimator, pMeasures, pGyroscope, pAngles);
+  else
+    eCalc_ComplementaryFilter(pEstimator, pGyroscope, pAngles);
+
   pAngles[2] = pMeasures[2];
 
   for(uint8_t i = 0; i < 2; i++)
-    aPastAccel_Angle[i] = pMeasures[i];
+    pEstimator->PastAccelAngle[i] = pMeasures[i];
 
   return status;
 }
 
-// =============================================================================
-static void eCalc_NormalizeMeasure(float32_t *pMeasure, uint8_t len)
+/*==============================================================================
+* Block of count samples acquired during one control period (FIFO drain),
+* XYZ interleaved. The block mean is a boxcar anti-alias filter for the
+* accelerometer, and mean(gyro)*dt integrates every gyro sample of the period.
+* timestamp [us] is the newest sample of the block: dt is the measured
+* interval to the previous block, so late or dropped samples are integrated
+* over the time they actually cover instead of the nominal period.
+==============================================================================*/
+filter_status_t estimator_updateBlock(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope, uint8_t count, uint64_t timestamp, float32_t *pAngles)
 {
-  float32_t tmp = 0.0f;
-  float32_t normG = 0.0f;
+  filter_status_t status = FILTER_OK;
 
-  arm_power_f32(pMeasure, len, &tmp);
-  normG = eCalc_FastInverse_Sqrt(tmp);
+  float32_t aAccelMean[3] = { 0.0f };
+  float32_t aGyroMean[3]  = { 0.0f };
+  float32_t interval      = pEstimator->DtNominal;
+  uint32_t startCycles    = 0;
 
-  for(uint8_t i = 0; i < len; i++)
-    pMeasure[i] *= normG;
+  /*!< The interval keeps running: the next block holds these samples too */
+  if(count == 0)
+    return FILTER_ERROR;
+
+  if((pEstimator->LastTimestamp != 0) && (timestamp > pEstimator->LastTimestamp))
+    interval = (float32_t)(timestamp - pEstimator->LastTimestamp)*1e-6f;
+
+  if(interval > ESTIMATOR_DT_MAX_RATIO*pEstimator->DtNominal)
+    interval = pEstimator->DtNominal;
+  else if(interval > ESTIMATOR_GAP_RATIO*pEstimator->DtNominal)
+    pEstimator->DtGaps++;
+
+  pEstimator->LastTimestamp = timestamp;
+  pEstimator->DtMeasured = interval;
+
+  /*!< Multi-rate: every sample propagated, the accelerometer batched */
+  if(pEstimator->CorrectPeriod > 0.0f)
+  {
+    startCycles = DWT->CYCCNT;
+    for(uint8_t i = 0; i < count; i++)
+    {
+      estimator_propagate(pEstimator, &pGyroscope[3*i], interval/count);
+
+      for(uint8_t j = 0; j < 3; j++)
+      {
+        pEstimator->AccelSum[j] += pAccelerometer[3*i + j];
+        pEstimator->GyroSum[j]  += pGyroscope[3*i + j];
+      }
+    }
+    pEstimator->SumCount += count;
+    pEstimator->CorrectElapsed += interval;
+    pEstimator->PropagateCycles = DWT->CYCCNT - startCycles;
+
+    /*!< Half a sample of slack: a period of jitter does not skip a turn */
+    if(pEstimator->CorrectElapsed + 0.5f*interval/count >= pEstimator->CorrectPeriod)
+    {
+      for(uint8_t j = 0; j < 3; j++)
+      {
+        aAccelMean[j] = pEstimator->AccelSum[j]/pEstimator->SumCount;
+        aGyroMean[j]  = pEstimator->GyroSum[j]/pEstimator->SumCount;
+        pEstimator->AccelSum[j] = 0.0f;
+        pEstimator->GyroSum[j] = 0.0f;
+      }
+
+      startCycles = DWT->CYCCNT;
+      estimator_correct(pEstimator, &aAccelMean[0], &aGyroMean[0], pEstimator->CorrectElapsed);
+      pEstimator->CorrectCycles = DWT->CYCCNT - startCycles;
+
+      pEstimator->CorrectElapsed = 0.0f;
+      pEstimator->SumCount = 0;
+    }
+
+    estimator_getAngles(pEstimator, pAngles);
+    return status;
+  }
+
+  /*!< Quaternion backends propagate every sample of the block */
+  if((pEstimator->Type == FILTER_MAHONY) || (pEstimator->Type == FILTER_MADGWICK))
+  {
+    for(uint8_t i = 0; i < count; i++)
+      eQuat_Update(pEstimator, &pAccelerometer[3*i], &pGyroscope[3*i], interval/count);
+
+    eQuat_Angles(&pEstimator->Quat, pAngles);
+    return status;
+  }
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    for(uint8_t j = 0; j < 3; j++)
+    {
+      aAccelMean[j] += pAccelerometer[3*i + j];
+      aGyroMean[j]  += pGyroscope[3*i + j];
+    }
+  }
+
+  for(uint8_t j = 0; j < 3; j++)
+  {
+    aAccelMean[j] /= count;
+    aGyroMean[j]  /= count;
+  }
+
+  /*!< EKF: predicted on every sample, one update with the block mean */
+  if(pEstimator->Type == FILTER_EKF)
+  {
+    for(uint8_t i = 0; i < count; i++)
+      eEkf_Predict(pEstimator, &pGyroscope[3*i], interval/count);
+
+    eEkf_Correct(pEstimator, &aAccelMean[0]);
+    eQuat_Angles(&pEstimator->Ekf.Quat, pAngles);
+    return status;
+  }
+
+  pEstimator->Dt = interval;
+  status = estimator_update(pEstimator, &aAccelMean[0], &aGyroMean[0], pAngles);
+  pEstimator->Dt = pEstimator->DtNominal;
+
+  return status;
 }
 
-static float32_t eCalc_FastInverse_Sqrt(float32_t x)
+/*==============================================================================
+* Multi-rate, high rate step: one gyro sample pGyroscope [dps] over step [s].
+* Gyroscope only: no trigonometry, no accelerometer.
+==============================================================================*/
+filter_status_t estimator_propagate(estimator_t *pEstimator, float32_t *pGyroscope, float32_t step)
+{
+  if(pEstimator->Type == FILTER_EKF)
+    eEkf_Predict(pEstimator, pGyroscope, step);
+  else if(pEstimator->Type != FILTER_COMPLEMENTARY)
+    eQuat_Propagate(pEstimator, pGyroscope, step);
+  else
+  {
+    pEstimator->PastEstimatedAccel[0] += pGyroscope[1]*step;
+    pEstimator->PastEstimatedAccel[1] += pGyroscope[0]*step;
+  }
+
+  return FILTER_OK;
+}
+
+/*==============================================================================
+* Multi-rate, low rate step: pAccelerometer [g] and pGyroscope [dps] are the
+* means of the samples propagated since the last correction, interval [s]
+* their span. pAccelerometer is normalized in place.
+* FILTER_COMPLEMENTARY: alpha = (1 - weight)*Gain*interval/dt, at most 1
+* (first order in interval, weight is given per control period).
+==============================================================================*/
+filter_status_t estimator_correct(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope, float32_t interval)
 {
-  float32_t xhalf = 0.5f * x;
-  int32_t i = *(int32_t *) &x;
+  float32_t aMeasures[3] = { 0.0f };
+  float32_t alpha        = 0.0f;
+
+  if(pEstimator->Type == FILTER_EKF)
+  {
+    eEkf_Correct(pEstimator, pAccelerometer);
+    return FILTER_OK;
+  }
+
+  if(pEstimator->Type != FILTER_COMPLEMENTARY)
+  {
+    eQuat_Correct(pEstimator, pAccelerometer, interval);
+    return FILTER_OK;
+  }
+
+  pEstimator->Gain = 1.0f;
+  if(pEstimator->Adaptive == 1)
+    pEstimator->Gain = eCalc_AdaptiveGain(pEstimator, pAccelerometer, pGyroscope);
+
+  eCalc_AccelAngles(pEstimator, pAccelerometer, &aMeasures[0]);
+  pEstimator->Tilt = aMeasures[2];
+
+  alpha = (1.0f - pEstimator->Weight)*pEstimator->Gain*interval/pEstimator->DtNominal;
+  if(alpha > 1.0f)
+    alpha = 1.0f;
+
+  for(uint8_t i = 0; i < 2; i++)
+    pEstimator->PastEstimatedAccel[i] += alpha*(aMeasures[i] - pEstimator->PastEstimatedAccel[i]);
+
+  return FILTER_OK;
+}
+
+/*==============================================================================
+* Current attitude, multi-rate: pitch, roll and yaw (quaternion backends) or
+* tilt (FILTER_COMPLEMENTARY) [deg].
+==============================================================================*/
+void estimator_getAngles(estimator_t *pEstimator, float32_t *pAngles)
+{
+  if(pEstimator->Type == FILTER_EKF)
+    eQuat_Angles(&pEstimator->Ekf.Quat, pAngles);
+  else if(pEstimator->Type != FILTER_COMPLEMENTARY)
+    eQuat_Angles(&pEstimator->Quat, pAngles);
+  else
+  {
+    pAngles[0] = pEstimator->PastEstimatedAccel[0];
+    pAngles[1] = pEstimator->PastEstimatedAccel[1];
+    pAngles[2] = pEstimator->Tilt;
+  }
+}
+
+/*==============================================================================
+* DWT cycles of one sample update, mean of ESTIMATOR_BENCH_RUNS updates on a
+* copy of pEstimator (its state is not modified). DWT->CYCCNT must be enabled.
+* pCycles[0] --> FILTER_MAHONY.
+* pCycles[1] --> FILTER_MADGWICK.
+* pCycles[2] --> FILTER_EKF, predict and update.
+* pCycles[3] --> FILTER_COMPLEMENTARY filter step, estimator_t state.
+* pCycles[4] --> Same step on volatile globals: pCycles[4] - pCycles[3] is
+*                the saving of the context per call.
+==============================================================================*/
+filter_status_t estimator_benchmark(estimator_t *pEstimator, uint32_t *pCycles)
+{
+  float32_t aAccelerometer[3] = { 0.05f, -0.10f, 0.99f };
+  float32_t aGyroscope[3]     = { 1.50f, -2.00f, 0.50f };
+  float32_t aAngles[2]        = { 0.0f };
+  static estimator_t bench;
+  uint32_t startCycles = 0;
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    bench = *pEstimator;
+    bench.Type = (filter_type_t)(FILTER_MAHONY + i);
+    bench.Quat.Aligned = 1;
+
+    startCycles = DWT->CYCCNT;
+    for(uint8_t n = 0; n < ESTIMATOR_BENCH_RUNS; n++)
+      eQuat_Update(&bench, &aAccelerometer[0], &aGyroscope[0], bench.DtNominal);
+    pCycles[i] = (DWT->CYCCNT - startCycles)/ESTIMATOR_BENCH_RUNS;
+  }
+
+  bench = *pEstimator;
+  if(bench.Ekf.Quat.Aligned == 0)
+    eEkf_Correct(&bench, &aAccelerometer[0]);
+
+  startCycles = DWT->CYCCNT;
+  for(uint8_t n = 0; n < ESTIMATOR_BENCH_RUNS; n++)
+  {
+    eEkf_Predict(&bench, &aGyroscope[0], bench.DtNominal);
+    eEkf_Correct(&bench, &aAccelerometer[0]);
+  }
+  pCycles[2] = (DWT->CYCCNT - startCycles)/ESTIMATOR_BENCH_RUNS;
 
-  i = 0x5F3759DF - (i >> 1);    // Magic number!!! RTFpaper.
-  x = *(float32_t *) &i;
+  bench = *pEstimator;
+  startCycles = DWT->CYCCNT;
+  for(uint8_t n = 0; n < ESTIMATOR_BENCH_RUNS; n++)
+    eCalc_ComplementaryFilter(&bench, &aGyroscope[0], &aAngles[0]);
+  pCycles[3] = (DWT->CYCCNT - startCycles)/ESTIMATOR_BENCH_RUNS;
 
-  x = x * (1.5f - (xhalf * x * x));
-  x = x * (1.5f - (xhalf * x * x));
-  x = x * (1.5f - (xhalf * x * x));
-  x = x * (1.5f - (xhalf * x * x));
-  x = x * (1.5f - (xhalf * x * x));
+  benchDt = pEstimator->Dt;
+  benchWeight = pEstimator->Weight;
+  startCycles = DWT->CYCCNT;
+  for(uint8_t n = 0; n < ESTIMATOR_BENCH_RUNS; n++)
+    eBench_VolatileFilter(&aGyroscope[0], &aAngles[0]);
+  pCycles[4] = (DWT->CYCCNT - startCycles)/ESTIMATOR_BENCH_RUNS;
 
-  return x;
+  return FILTER_OK;
+}
+
+// =============================================================================
+static void eCalc_NormalizeMeasure(float32_t *pMeasure, uint8_t len)
+{
+  float32_t normG = fastMath_invNorm(pMeasure, len);
+
+  for(uint8_t i = 0; i < len; i++)
+    pMeasure[i] *= normG;
 }
 
 /*==============================================================================
@@ -119,29 +516,37 @@ pResult[0] = Pitch angle Accelerometer  |   pResult[3] = X axis angle gyroscope
 pResult[1] = Roll angle Accelerometer   |   pResult[4] = X axis angle gyroscope
 pResult[2] = Tilt z angle Accelerometer |   pResult[5] = Yaw angle gyroscope
 ==============================================================================*/
-static void eCalc_Angles(float32_t *pAccelerometer, float32_t *pGyroscope, float32_t *pResult)
+static void eCalc_Angles(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope, float32_t *pResult)
 {
-  float32_t tmp = 0.0f;
+  eCalc_AccelAngles(pEstimator, pAccelerometer, pResult);
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pResult[i + 3] = pEstimator->PastGyroscopeAngle[i] + pGyroscope[i]*pEstimator->Dt;
+    pEstimator->PastGyroscopeAngle[i] = pResult[i + 3];
+  }
+}
+
+/*!< pResult[0..2] of eCalc_Angles(), pAccelerometer is normalized in place */
+static void eCalc_AccelAngles(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pResult)
+{
+  float32_t aY[3] = { 0.0f };
+  float32_t aX[3] = { 0.0f };
+  float32_t *a = pAccelerometer;
 
   eCalc_NormalizeMeasure(pAccelerometer, 3);
 
-  tmp  = pAccelerometer[1]*pAccelerometer[1];
-  tmp += pAccelerometer[2]*pAccelerometer[2];
-  pResult[0] = atan2f(-pAccelerometer[0], sqrtf(tmp))*(180.0f/PI);
+  /*!< The three atan2 in one block call */
+  aY[0] = -a[0];
+  arm_sqrt_f32(a[1]*a[1] + a[2]*a[2], &aX[0]);
 
-  tmp  = pAccelerometer[0]*pAccelerometer[0];
-  tmp += pAccelerometer[2]*pAccelerometer[2];
-  pResult[1] = atan2f(pAccelerometer[1], sqrtf(tmp))*(180.0f/PI);
+  aY[1] = a[1];
+  arm_sqrt_f32(a[0]*a[0] + a[2]*a[2], &aX[1]);
 
-  tmp  = pAccelerometer[0]*pAccelerometer[0];
-  tmp += pAccelerometer[1]*pAccelerometer[1];
-  pResult[2] = atan2f(sqrtf(tmp), pAccelerometer[2])*(180.0f/PI);
+  arm_sqrt_f32(a[0]*a[0] + a[1]*a[1], &aY[2]);
+  aX[2] = a[2];
 
-  for(uint8_t i = 0; i < 3; i++)
-  {
-    pResult[i + 3] = aPastGyroscope_Angle[i] + pGyroscope[i]*dt;
-    aPastGyroscope_Angle[i] = pResult[i + 3];
-  }
+  fastMath_atan2Deg_f32(&aY[0], &aX[0], pResult, 3, pEstimator->Accuracy);
 }
 
 /*==============================================================================
@@ -150,25 +555,551 @@ pFilteredAngles[0] = filtered Pitch   |   pFilteredAngles[1] = filtered Roll
 aEstimatedGyro[i]  = weight*aPastEstimatedGyro[i] + (1 - weight)*pGyroscope[i]*dt
 aEstimatedAccel[i] = weight*aPastEstimatedAccel[i] + (1 - weight)*aPastAccel_Angle[i]
 ==============================================================================*/
-static void eCalc_ComplementaryFilter(float32_t *pGyroscope, float32_t *pFilteredAngles)
+static void eCalc_ComplementaryFilter(estimator_t *pEstimator, float32_t *pGyroscope, float32_t *pFilteredAngles)
 {
   float32_t aEstimatedAccel[2] = { 0.0f };
   float32_t aEstimatedGyro[2]  = { 0.0f };
+  float32_t weight = pEstimator->Weight;
+  float32_t dt = pEstimator->Dt;
 
   for(uint8_t i = 0; i < 2; i++)
   {
-    aEstimatedAccel[i]  = weight*aPastEstimatedAccel[i];
-    aEstimatedAccel[i] += (1 - weight)*aPastAccel_Angle[i];
-    aPastEstimatedAccel[i] = aEstimatedAccel[i];
+    aEstimatedAccel[i]  = weight*pEstimator->PastEstimatedAccel[i];
+    aEstimatedAccel[i] += (1 - weight)*pEstimator->PastAccelAngle[i];
+    pEstimator->PastEstimatedAccel[i] = aEstimatedAccel[i];
   }
 
   for(uint8_t i = 0; i < 2; i++)
   {
-    aEstimatedGyro[i]  = weight*aPastEstimatedGyro[i];
+    aEstimatedGyro[i]  = weight*pEstimator->PastEstimatedGyro[i];
     aEstimatedGyro[i] += (1 - weight)*pGyroscope[i]*dt;
-    aPastEstimatedGyro[i] = aEstimatedGyro[i];
+    pEstimator->PastEstimatedGyro[i] = aEstimatedGyro[i];
+  }
+
+  pFilteredAngles[0] = aEstimatedAccel[0] + aEstimatedGyro[1];
+  pFilteredAngles[1] = aEstimatedAccel[1] + aEstimatedGyro[0];
+}
+
+/*==============================================================================
+* Accelerometer trust, 0..1: product of two ramps, from 1 at the Low
+* breakpoint to 0 at the High one.
+* ||a| - 1 g|: linear acceleration, the accelerometer is not gravity only.
+* |w|: fast rotation, centripetal acceleration and gyro scale errors.
+==============================================================================*/
+static float32_t eCalc_AdaptiveGain(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope)
+{
+  float32_t accelNorm = 0.0f;
+  float32_t rateNorm  = 0.0f;
+  float32_t gain      = 0.0f;
+
+  arm_sqrt_f32(pAccelerometer[0]*pAccelerometer[0]
+      + pAccelerometer[1]*pAccelerometer[1]
+      + pAccelerometer[2]*pAccelerometer[2], &accelNorm);
+
+  gain = eCalc_Ramp((accelNorm > 1.0f) ? (accelNorm - 1.0f) : (1.0f - accelNorm),
+                    pEstimator->AccelLow, pEstimator->AccelHigh);
+  if(gain == 0.0f)
+    return gain;
+
+  arm_sqrt_f32(pGyroscope[0]*pGyroscope[0] + pGyroscope[1]*pGyroscope[1]
+      + pGyroscope[2]*pGyroscope[2], &rateNorm);
+
+  return gain*eCalc_Ramp(rateNorm, pEstimator->RateLow, pEstimator->RateHigh);
+}
+
+/*!< 1 up to low, 0 from high, linear in between. high <= low: step at low */
+static float32_t eCalc_Ramp(float32_t x, float32_t low, float32_t high)
+{
+  if(x <= low)
+    return 1.0f;
+
+  if(x >= high)
+    return 0.0f;
+
+  return (high - x)/(high - low);
+}
+
+/*==============================================================================
+pFilteredAngles[0] = filtered Pitch   |   pFilteredAngles[1] = filtered Roll
+--------------------------------------------------------------------------------
+alpha = (1 - weight)*Gain
+angle[i] = (1 - alpha)*(angle[i] + gyro*dt) + alpha*accelAngle[i]
+The gyro integral carries the attitude while the accelerometer is not
+trusted (Gain = 0). Same axes as eCalc_ComplementaryFilter().
+==============================================================================*/
+static void eCalc_AdaptiveFilter(estimator_t *pEstimator, float32_t *pMeasures, float32_t *pGyroscope, float32_t *pFilteredAngles)
+{
+  float32_t *pAngle = &pEstimator->PastEstimatedAccel[0];
+  float32_t alpha = (1.0f - pEstimator->Weight)*pEstimator->Gain;
+
+  pAngle[0] += pGyroscope[1]*pEstimator->Dt;
+  pAngle[1] += pGyroscope[0]*pEstimator->Dt;
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    pAngle[i] += alpha*(pMeasures[i] - pAngle[i]);
+    pFilteredAngles[i] = pAngle[i];
+  }
+}
+
+/*!< eCalc_ComplementaryFilter() on the volatile reference state: every
+ *   access is a load or a store (estimator_benchmark() only) */
+static void eBench_VolatileFilter(float32_t *pGyroscope, float32_t *pFilteredAngles)
+{
+  float32_t aEstimatedAccel[2] = { 0.0f };
+  float32_t aEstimatedGyro[2]  = { 0.0f };
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    aEstimatedAccel[i]  = benchWeight*aBenchPastEstimatedAccel[i];
+    aEstimatedAccel[i] += (1 - benchWeight)*aBenchPastAccel_Angle[i];
+    aBenchPastEstimatedAccel[i] = aEstimatedAccel[i];
+  }
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    aEstimatedGyro[i]  = benchWeight*aBenchPastEstimatedGyro[i];
+    aEstimatedGyro[i] += (1 - benchWeight)*pGyroscope[i]*benchDt;
+    aBenchPastEstimatedGyro[i] = aEstimatedGyro[i];
   }
 
   pFilteredAngles[0] = aEstimatedAccel[0] + aEstimatedGyro[1];
   pFilteredAngles[1] = aEstimatedAccel[1] + aEstimatedGyro[0];
 }
+
+/*==============================================================================
+* One sample: pAccelerometer [g] (any norm), pGyroscope [dps], step [s].
+* The first sample after init aligns pitch and roll with the accelerometer,
+* yaw starts at 0.
+==============================================================================*/
+static void eQuat_Update(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t *pGyroscope, float32_t step)
+{
+  estimator_quat_t *pQuat = &pEstimator->Quat;
+  float32_t aAccel[3] = { 0.0f };
+  float32_t aOmega[3] = { 0.0f };
+  float32_t aQDot[4]  = { 0.0f };
+  float32_t norm      = 0.0f;
+
+  if(pQuat->Aligned == 0)
+  {
+    eQuat_Align(pQuat, pAccelerometer);
+    return;
+  }
+
+  arm_scale_f32(pGyroscope, PI/180.0f, &aOmega[0], 3);
+
+  /*!< Free fall (no gravity reference): gyroscope only */
+  arm_power_f32(pAccelerometer, 3, &norm);
+  if(norm > 0.0f)
+  {
+    arm_sqrt_f32(norm, &norm);
+    arm_scale_f32(pAccelerometer, 1.0f/norm, &aAccel[0], 3);
+  }
+
+  if(pEstimator->Type == FILTER_MAHONY)
+  {
+    if(norm > 0.0f)
+      eQuat_Mahony(pEstimator, &aAccel[0], &aOmega[0], step);
+
+    eQuat_Derivative(&pQuat->q[0], &aOmega[0], &aQDot[0]);
+  }
+  else
+  {
+    eQuat_Derivative(&pQuat->q[0], &aOmega[0], &aQDot[0]);
+
+    if(norm > 0.0f)
+      eQuat_Madgwick(pEstimator, &aAccel[0], &aQDot[0]);
+  }
+
+  eQuat_Integrate(&pQuat->q[0], &aQDot[0], step);
+}
+
+/*!< Multi-rate propagation: gyroscope plus the Mahony integral (bias), 0
+ *   for Madgwick */
+static void eQuat_Propagate(estimator_t *pEstimator, float32_t *pGyroscope, float32_t step)
+{
+  estimator_quat_t *pQuat = &pEstimator->Quat;
+  float32_t aOmega[3] = { 0.0f };
+  float32_t aQDot[4]  = { 0.0f };
+
+  if(pQuat->Aligned == 0)
+    return;
+
+  arm_scale_f32(pGyroscope, PI/180.0f, &aOmega[0], 3);
+  arm_add_f32(&aOmega[0], &pQuat->Integral[0], &aOmega[0], 3);
+
+  eQuat_Derivative(&pQuat->q[0], &aOmega[0], &aQDot[0]);
+  eQuat_Integrate(&pQuat->q[0], &aQDot[0], step);
+}
+
+/*==============================================================================
+* Multi-rate correction with the accelerometer mean, over step [s]:
+* Mahony: rotation Kp*e*step, Integral += Ki*e*step (applied by propagation).
+* Madgwick: q -= Beta*s*step.
+* The first call aligns pitch and roll.
+==============================================================================*/
+static void eQuat_Correct(estimator_t *pEstimator, float32_t *pAccelerometer, float32_t step)
+{
+  estimator_quat_t *pQuat = &pEstimator->Quat;
+  float32_t aAccel[3] = { 0.0f };
+  float32_t aOmega[3] = { 0.0f };
+  float32_t aQDot[4]  = { 0.0f };
+  float32_t norm      = 0.0f;
+
+  if(pQuat->Aligned == 0)
+  {
+    eQuat_Align(pQuat, pAccelerometer);
+    return;
+  }
+
+  arm_power_f32(pAccelerometer, 3, &norm);
+  if(norm == 0.0f)
+    return;
+
+  arm_sqrt_f32(norm, &norm);
+  arm_scale_f32(pAccelerometer, 1.0f/norm, &aAccel[0], 3);
+
+  if(pEstimator->Type == FILTER_MAHONY)
+  {
+    eQuat_Mahony(pEstimator, &aAccel[0], &aOmega[0], step);
+    arm_sub_f32(&aOmega[0], &pQuat->Integral[0], &aOmega[0], 3);
+    eQuat_Derivative(&pQuat->q[0], &aOmega[0], &aQDot[0]);
+  }
+  else
+    eQuat_Madgwick(pEstimator, &aAccel[0], &aQDot[0]);
+
+  eQuat_Integrate(&pQuat->q[0], &aQDot[0], step);
+}
+
+/*==============================================================================
+* Pitch and roll from the accelerometer (same as eCalc_Angles()), yaw = 0:
+* q = [cos(r/2)cos(p/2), sin(r/2)cos(p/2), cos(r/2)sin(p/2), -sin(r/2)sin(p/2)]
+==============================================================================*/
+static void eQuat_Align(estimator_quat_t *pQuat, float32_t *pAccelerometer)
+{
+  float32_t pitch = 0.0f;
+  float32_t roll  = 0.0f;
+  float32_t sinPitch = 0.0f, cosPitch = 0.0f;
+  float32_t sinRoll  = 0.0f, cosRoll  = 0.0f;
+  float32_t tmp = 0.0f;
+
+  tmp  = pAccelerometer[1]*pAccelerometer[1];
+  tmp += pAccelerometer[2]*pAccelerometer[2];
+  if((tmp == 0.0f) && (pAccelerometer[0] == 0.0f))
+    return;
+
+  pitch = atan2f(-pAccelerometer[0], sqrtf(tmp))*(180.0f/PI);
+  roll  = atan2f(pAccelerometer[1], pAccelerometer[2])*(180.0f/PI);
+
+  arm_sin_cos_f32(0.5f*pitch, &sinPitch, &cosPitch);
+  arm_sin_cos_f32(0.5f*roll, &sinRoll, &cosRoll);
+
+  pQuat->q[0] =  cosRoll*cosPitch;
+  pQuat->q[1] =  sinRoll*cosPitch;
+  pQuat->q[2] =  cosRoll*sinPitch;
+  pQuat->q[3] = -sinRoll*sinPitch;
+
+  for(uint8_t i = 0; i < 3; i++)
+    pQuat->Integral[i] = 0.0f;
+
+  pQuat->Aligned = 1;
+}
+
+/*==============================================================================
+* Mahony, Hamel, Pflimlin (2008), explicit complementary filter:
+* v = gravity direction estimated by q, e = a x v
+* Integral += Ki*e*step, Omega += Kp*e + Integral
+==============================================================================*/
+static void eQuat_Mahony(estimator_t *pEstimator, float32_t *pAccel, float32_t *pOmega, float32_t step)
+{
+  estimator_quat_t *pQuat = &pEstimator->Quat;
+  float32_t *q = &pQuat->q[0];
+  float32_t aGravity[3] = { 0.0f };
+  float32_t aError[3]   = { 0.0f };
+
+  aGravity[0] = 2.0f*(q[1]*q[3] - q[0]*q[2]);
+  aGravity[1] = 2.0f*(q[0]*q[1] + q[2]*q[3]);
+  aGravity[2] = q[0]*q[0] - q[1]*q[1] - q[2]*q[2] + q[3]*q[3];
+
+  aError[0] = pAccel[1]*aGravity[2] - pAccel[2]*aGravity[1];
+  aError[1] = pAccel[2]*aGravity[0] - pAccel[0]*aGravity[2];
+  aError[2] = pAccel[0]*aGravity[1] - pAccel[1]*aGravity[0];
+
+  if(pEstimator->Ki > 0.0f)
+  {
+    for(uint8_t i = 0; i < 3; i++)
+      pQuat->Integral[i] += pEstimator->Ki*aError[i]*step;
+
+    arm_add_f32(pOmega, &pQuat->Integral[0], pOmega, 3);
+  }
+
+  arm_scale_f32(&aError[0], pEstimator->Kp, &aError[0], 3);
+  arm_add_f32(pOmega, &aError[0], pOmega, 3);
+}
+
+/*==============================================================================
+* Madgwick (2010), one gradient descent step towards the accelerometer:
+* s = J'f / |J'f|, f = v - a (gravity error), qDot -= Beta*s
+==============================================================================*/
+static void eQuat_Madgwick(estimator_t *pEstimator, float32_t *pAccel, float32_t *pQDot)
+{
+  float32_t *q = &pEstimator->Quat.q[0];
+  float32_t aStep[4] = { 0.0f };
+  float32_t aF[3]    = { 0.0f };
+  float32_t norm     = 0.0f;
+
+  aF[0] = 2.0f*(q[1]*q[3] - q[0]*q[2]) - pAccel[0];
+  aF[1] = 2.0f*(q[0]*q[1] + q[2]*q[3]) - pAccel[1];
+  aF[2] = 2.0f*(0.5f - q[1]*q[1] - q[2]*q[2]) - pAccel[2];
+
+  aStep[0] = -2.0f*q[2]*aF[0] + 2.0f*q[1]*aF[1];
+  aStep[1] =  2.0f*q[3]*aF[0] + 2.0f*q[0]*aF[1] - 4.0f*q[1]*aF[2];
+  aStep[2] = -2.0f*q[0]*aF[0] + 2.0f*q[3]*aF[1] - 4.0f*q[2]*aF[2];
+  aStep[3] =  2.0f*q[1]*aF[0] + 2.0f*q[2]*aF[1];
+
+  arm_power_f32(&aStep[0], 4, &norm);
+  if(norm == 0.0f)
+    return;
+
+  arm_sqrt_f32(norm, &norm);
+  arm_scale_f32(&aStep[0], pEstimator->Beta/norm, &aStep[0], 4);
+  arm_sub_f32(pQDot, &aStep[0], pQDot, 4);
+}
+
+/*!< qDot = 0.5*q x [0, Omega] */
+static void eQuat_Derivative(float32_t *pQ, float32_t *pOmega, float32_t *pQDot)
+{
+  pQDot[0] = 0.5f*(-pQ[1]*pOmega[0] - pQ[2]*pOmega[1] - pQ[3]*pOmega[2]);
+  pQDot[1] = 0.5f*( pQ[0]*pOmega[0] + pQ[2]*pOmega[2] - pQ[3]*pOmega[1]);
+  pQDot[2] = 0.5f*( pQ[0]*pOmega[1] - pQ[1]*pOmega[2] + pQ[3]*pOmega[0]);
+  pQDot[3] = 0.5f*( pQ[0]*pOmega[2] + pQ[1]*pOmega[1] - pQ[2]*pOmega[0]);
+}
+
+/*!< q += qDot*step, then back to unit norm */
+static void eQuat_Integrate(float32_t *pQ, float32_t *pQDot, float32_t step)
+{
+  float32_t norm = 0.0f;
+
+  arm_scale_f32(pQDot, step, pQDot, 4);
+  arm_add_f32(pQ, pQDot, pQ, 4);
+
+  arm_power_f32(pQ, 4, &norm);
+  arm_sqrt_f32(norm, &norm);
+  arm_scale_f32(pQ, 1.0f/norm, pQ, 4);
+}
+
+/*==============================================================================
+pAngles[0] = Pitch  |  pAngles[1] = Roll  |  pAngles[2] = Yaw   [deg]
+--------------------------------------------------------------------------------
+Same axes as the complementary filter: Roll about X, Pitch about Y.
+==============================================================================*/
+static void eQuat_Angles(estimator_quat_t *pQuat, float32_t *pAngles)
+{
+  float32_t *q = &pQuat->q[0];
+  float32_t sinPitch = 2.0f*(q[0]*q[2] - q[1]*q[3]);
+
+  if(sinPitch > 1.0f)
+    sinPitch = 1.0f;
+  else if(sinPitch < -1.0f)
+    sinPitch = -1.0f;
+
+  pAngles[0] = asinf(sinPitch)*(180.0f/PI);
+  pAngles[1] = atan2f(2.0f*(q[0]*q[1] + q[2]*q[3]),
+                      1.0f - 2.0f*(q[1]*q[1] + q[2]*q[2]))*(180.0f/PI);
+  pAngles[2] = atan2f(2.0f*(q[0]*q[3] + q[1]*q[2]),
+                      1.0f - 2.0f*(q[2]*q[2] + q[3]*q[3]))*(180.0f/PI);
+}
+
+/*!< Bias to 0, P diagonal: attitude from the alignment, bias unknown */
+static void eEkf_Reset(estimator_t *pEstimator)
+{
+  const float32_t bias0 = ESTIMATOR_EKF_BIAS0_DPS*(PI/180.0f);
+  estimator_ekf_t *pEkf = &pEstimator->Ekf;
+
+  for(uint8_t i = 0; i < EKF_N*EKF_N; i++)
+    pEkf->P[i] = 0.0f;
+
+  for(uint8_t i = 0; i < 4; i++)
+    pEkf->P[i*EKF_N + i] = pEstimator->AccelNoise*pEstimator->AccelNoise;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pEkf->Bias[i] = 0.0f;
+    pEkf->P[(i + 4)*EKF_N + i + 4] = bias0*bias0;
+  }
+}
+
+/*==============================================================================
+* Predict, pGyroscope [dps], step [s]. Omega = gyro - bias:
+* q(k+1) = q + 0.5*step*Xi(q)*Omega          Xi(q)*Omega = q x [0, Omega]
+* F = | I4 + 0.5*step*W(Omega)   -0.5*step*Xi(q) |
+*     | 0                         I3             |
+* P = F*P*F' + Q, Q = diag((0.5*step*GyroNoise)^2*Xi*Xi', BiasNoise^2*step*I3)
+==============================================================================*/
+static void eEkf_Predict(estimator_t *pEstimator, float32_t *pGyroscope, float32_t step)
+{
+  estimator_ekf_t *pEkf = &pEstimator->Ekf;
+  arm_matrix_instance_f32 matP;
+  float32_t *q = &pEkf->Quat.q[0];
+  float32_t aOmega[3] = { 0.0f };
+  float32_t aQDot[4]  = { 0.0f };
+  float32_t halfStep  = 0.5f*step;
+  float32_t tmp       = 0.0f;
+  uint32_t startCycles = DWT->CYCCNT;
+
+  if(pEkf->Quat.Aligned == 0)
+    return;
+
+  arm_mat_init_f32(&matP, EKF_N, EKF_N, &pEkf->P[0]);
+
+  for(uint8_t i = 0; i < 3; i++)
+    aOmega[i] = pGyroscope[i]*(PI/180.0f) - pEkf->Bias[i];
+
+  /*!< Xi(q), 4x3 */
+  aEkfXi[0]  = -q[1];  aEkfXi[1]  = -q[2];  aEkfXi[2]  = -q[3];
+  aEkfXi[3]  =  q[0];  aEkfXi[4]  = -q[3];  aEkfXi[5]  =  q[2];
+  aEkfXi[6]  =  q[3];  aEkfXi[7]  =  q[0];  aEkfXi[8]  = -q[1];
+  aEkfXi[9]  = -q[2];  aEkfXi[10] =  q[1];  aEkfXi[11] =  q[0];
+
+  for(uint8_t i = 0; i < EKF_N*EKF_N; i++)
+    aEkfF[i] = 0.0f;
+
+  for(uint8_t i = 0; i < EKF_N; i++)
+    aEkfF[i*EKF_N + i] = 1.0f;
+
+  /*!< W(Omega), 4x4 skew */
+  aEkfF[0*EKF_N + 1] = -halfStep*aOmega[0];
+  aEkfF[0*EKF_N + 2] = -halfStep*aOmega[1];
+  aEkfF[0*EKF_N + 3] = -halfStep*aOmega[2];
+  aEkfF[1*EKF_N + 0] =  halfStep*aOmega[0];
+  aEkfF[1*EKF_N + 2] =  halfStep*aOmega[2];
+  aEkfF[1*EKF_N + 3] = -halfStep*aOmega[1];
+  aEkfF[2*EKF_N + 0] =  halfStep*aOmega[1];
+  aEkfF[2*EKF_N + 1] = -halfStep*aOmega[2];
+  aEkfF[2*EKF_N + 3] =  halfStep*aOmega[0];
+  aEkfF[3*EKF_N + 0] =  halfStep*aOmega[2];
+  aEkfF[3*EKF_N + 1] =  halfStep*aOmega[1];
+  aEkfF[3*EKF_N + 2] = -halfStep*aOmega[0];
+
+  for(uint8_t i = 0; i < 4; i++)
+  {
+    for(uint8_t j = 0; j < 3; j++)
+      aEkfF[i*EKF_N + 4 + j] = -halfStep*aEkfXi[3*i + j];
+  }
+
+  eQuat_Derivative(q, &aOmega[0], &aQDot[0]);
+  eQuat_Integrate(q, &aQDot[0], step);
+
+  arm_mat_mult_f32(&matF, &matP, &matNN);
+  arm_mat_trans_f32(&matF, &matFt);
+  arm_mat_mult_f32(&matNN, &matFt, &matP);
+
+  arm_mat_trans_f32(&matXi, &matXit);
+  arm_mat_mult_f32(&matXi, &matXit, &matQ);
+
+  tmp = halfStep*pEstimator->GyroNoise;
+  tmp *= tmp;
+  for(uint8_t i = 0; i < 4; i++)
+  {
+    for(uint8_t j = 0; j < 4; j++)
+      pEkf->P[i*EKF_N + j] += tmp*aEkfQ[4*i + j];
+  }
+
+  tmp = pEstimator->BiasNoise*pEstimator->BiasNoise*step;
+  for(uint8_t i = 4; i < EKF_N; i++)
+    pEkf->P[i*EKF_N + i] += tmp;
+
+  pEstimator->EkfPredictCycles = DWT->CYCCNT - startCycles;
+}
+
+/*==============================================================================
+* Update with the gravity direction, z = a/|a|:
+* h(q) = [2(q1q3 - q0q2), 2(q0q1 + q2q3), q0^2 - q1^2 - q2^2 + q3^2]
+* S = H*P*H' + R, K = P*H'*inv(S), x += K*(z - h), P -= K*H*P
+* The first sample aligns pitch and roll (eQuat_Align()) and resets P.
+==============================================================================*/
+static void eEkf_Correct(estimator_t *pEstimator, float32_t *pAccelerometer)
+{
+  estimator_ekf_t *pEkf = &pEstimator->Ekf;
+  arm_matrix_instance_f32 matP;
+  float32_t *q = &pEkf->Quat.q[0];
+  float32_t aAccel[3] = { 0.0f };
+  float32_t norm      = 0.0f;
+  float32_t tmp       = 0.0f;
+  uint32_t startCycles = DWT->CYCCNT;
+
+  if(pEkf->Quat.Aligned == 0)
+  {
+    eQuat_Align(&pEkf->Quat, pAccelerometer);
+    if(pEkf->Quat.Aligned == 1)
+      eEkf_Reset(pEstimator);
+    return;
+  }
+
+  arm_power_f32(pAccelerometer, 3, &norm);
+  arm_sqrt_f32(norm, &norm);
+  if((norm < (1.0f - ESTIMATOR_EKF_ACCEL_GATE))
+      || (norm > (1.0f + ESTIMATOR_EKF_ACCEL_GATE)))
+  {
+    pEstimator->EkfRejected++;
+    return;
+  }
+
+  arm_mat_init_f32(&matP, EKF_N, EKF_N, &pEkf->P[0]);
+  arm_scale_f32(pAccelerometer, 1.0f/norm, &aAccel[0], 3);
+
+  aEkfY[0] = aAccel[0] - 2.0f*(q[1]*q[3] - q[0]*q[2]);
+  aEkfY[1] = aAccel[1] - 2.0f*(q[0]*q[1] + q[2]*q[3]);
+  aEkfY[2] = aAccel[2] - (q[0]*q[0] - q[1]*q[1] - q[2]*q[2] + q[3]*q[3]);
+
+  for(uint8_t i = 0; i < EKF_M*EKF_N; i++)
+    aEkfH[i] = 0.0f;
+
+  aEkfH[0*EKF_N + 0] = -2.0f*q[2];
+  aEkfH[0*EKF_N + 1] =  2.0f*q[3];
+  aEkfH[0*EKF_N + 2] = -2.0f*q[0];
+  aEkfH[0*EKF_N + 3] =  2.0f*q[1];
+  aEkfH[1*EKF_N + 0] =  2.0f*q[1];
+  aEkfH[1*EKF_N + 1] =  2.0f*q[0];
+  aEkfH[1*EKF_N + 2] =  2.0f*q[3];
+  aEkfH[1*EKF_N + 3] =  2.0f*q[2];
+  aEkfH[2*EKF_N + 0] =  2.0f*q[0];
+  aEkfH[2*EKF_N + 1] = -2.0f*q[1];
+  aEkfH[2*EKF_N + 2] = -2.0f*q[2];
+  aEkfH[2*EKF_N + 3] =  2.0f*q[3];
+
+  arm_mat_mult_f32(&matH, &matP, &matHP);
+  arm_mat_trans_f32(&matH, &matHt);
+  arm_mat_mult_f32(&matHP, &matHt, &matS);
+
+  tmp = pEstimator->AccelNoise*pEstimator->AccelNoise;
+  for(uint8_t i = 0; i < EKF_M; i++)
+    aEkfS[i*EKF_M + i] += tmp;
+
+  /*!< matS is overwritten by the inversion */
+  if(arm_mat_inverse_f32(&matS, &matSinv) != ARM_MATH_SUCCESS)
+    return;
+
+  arm_mat_trans_f32(&matHP, &matPHt);
+  arm_mat_mult_f32(&matPHt, &matSinv, &matK);
+  arm_mat_mult_f32(&matK, &matY, &matDx);
+
+  for(uint8_t i = 0; i < 4; i++)
+    q[i] += aEkfDx[i];
+
+  for(uint8_t i = 0; i < 3; i++)
+    pEkf->Bias[i] += aEkfDx[i + 4];
+
+  arm_power_f32(q, 4, &norm);
+  arm_sqrt_f32(norm, &norm);
+  arm_scale_f32(q, 1.0f/norm, q, 4);
+
+  /*!< P -= K*H*P, kept symmetric */
+  arm_mat_mult_f32(&matK, &matHP, &matNN);
+  arm_mat_sub_f32(&matP, &matNN, &matP);
+  arm_mat_trans_f32(&matP, &matNN);
+  arm_mat_add_f32(&matP, &matNN, &matP);
+  arm_mat_scale_f32(&matP, 0.5f, &matP);
+
+  pEstimator->EkfCorrectCycles = DWT->CYCCNT - startCycles;
+}
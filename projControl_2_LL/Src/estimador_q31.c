@@ -0,0 +1,212 @@
+// Includes ====================================================================
+#include "estimador_q31.h"
+#include "arm_math.h"
+
+// =============================================================================
+/*!< atan(2^-i) [Q31 of 180 deg] */
+static const q31_t CORDIC_ATAN[24] =
+{
+  0x20000000, 0x12E4051E, 0x09FB385B, 0x051111D4, 0x028B0D43, 0x0145D7E1,
+  0x00A2F61E, 0x00517C55, 0x0028BE53, 0x00145F2F, 0x000A2F98, 0x000517CC,
+  0x00028BE6, 0x000145F3, 0x0000A2FA, 0x0000517D, 0x000028BE, 0x0000145F,
+  0x00000A30, 0x00000518, 0x0000028C, 0x00000146, 0x000000A3, 0x00000051
+};
+
+static q31_t weightQ31 = 0;
+static q31_t oneMinusWeightQ31 = 0;
+static int64_t gyroStepPerUs = 0;   /*!< FS/180 per us of interval, Q47 */
+static uint32_t nominalUs = 0;
+static uint32_t gapUs = 0;
+static uint32_t maxUs = 0;
+static uint64_t lastTimestampQ31 = 0;
+
+static q31_t aEstimatedAccelQ31[2] = { 0 };
+static q31_t aEstimatedGyroQ31[2]  = { 0 };
+static q31_t aPastAccelQ31[2]      = { 0 };
+
+volatile uint32_t dtGapsQ31 = 0;
+
+// Private functions prototypes ================================================
+static q31_t eQ31_Norm(int16_t a, int16_t b);
+static q31_t eQ31_Atan2(q31_t y, q31_t x);
+static int16_t eQ31_Mean(int32_t sum, uint8_t count);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the fixed point filter. Weight and SampleRate are used, the
+ *          gyro full scale is read from the driver handle 0.
+ * @param   filter_InitStruct: same settings as estimator_init().
+ * @retval  FILTER_OK if successful. FILTER_ERROR if Weight is not in [0, 1).
+ ******************************************************************************/
+filter_status_t estimatorQ31_init(filter_init_t *filter_InitStruct)
+{
+  float32_t fullScale = 0.0f;
+
+  if((filter_InitStruct->Weight < 0.0f) || (filter_InitStruct->Weight >= 1.0f))
+    return FILTER_ERROR;
+
+  arm_float_to_q31(&filter_InitStruct->Weight, &weightQ31, 1);
+  oneMinusWeightQ31 = (q31_t)(0x7FFFFFFF - weightQ31);
+
+  /*!< Raw Q15 full scale [dps] */
+  fullScale = 32768.0f/mpu9250_getHandle(0)->GyroResolution;
+  gyroStepPerUs = (int64_t)((fullScale/180.0f)*1e-6f*140737488355328.0f);
+
+  nominalUs = 1000000/filter_InitStruct->SampleRate;
+  gapUs = (uint32_t)(ESTIMATOR_GAP_RATIO*nominalUs);
+  maxUs = (uint32_t)(ESTIMATOR_DT_MAX_RATIO*nominalUs);
+  lastTimestampQ31 = 0;
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    aEstimatedAccelQ31[i] = 0;
+    aEstimatedGyroQ31[i] = 0;
+    aPastAccelQ31[i] = 0;
+  }
+
+  return FILTER_OK;
+}
+
+/*******************************************************************************
+ * @brief   Update with a raw FIFO block.
+ * @param   pBlock: block of one unit, gyro bias already removed.
+ * @param   timestamp: newest sample of the block [us].
+ * @param   pAngles: pitch, roll, tilt z [Q31 of 180 deg]. Held if the block
+ *          is empty.
+ * @retval  FILTER_OK if successful. FILTER_ERROR if the block is empty.
+ ******************************************************************************/
+filter_status_t estimatorQ31_updateBlock(mpu9250_fifoBlock_t *pBlock,
+                                         uint64_t timestamp, q31_t *pAngles)
+{
+  int32_t aSumAccel[3] = { 0 };
+  int32_t aSumGyro[3]  = { 0 };
+  int16_t aAccel[3]    = { 0 };
+  q31_t aGyro[3]       = { 0 };
+  q31_t aMeasured[2]   = { 0 };
+  q31_t aTmp[2]        = { 0 };
+  q31_t gyroStep       = 0;
+  uint32_t interval    = nominalUs;
+  uint8_t count        = pBlock->Count;
+
+  /*!< The interval keeps running: the next block holds these samples too */
+  if(count == 0)
+    return FILTER_ERROR;
+
+  if((lastTimestampQ31 != 0) && (timestamp > lastTimestampQ31)
+      && ((timestamp - lastTimestampQ31) <= maxUs))
+    interval = (uint32_t)(timestamp - lastTimestampQ31);
+
+  if(interval > gapUs)
+    dtGapsQ31++;
+
+  lastTimestampQ31 = timestamp;
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    for(uint8_t j = 0; j < 3; j++)
+    {
+      aSumAccel[j] += pBlock->Samples[i].Accel[j];
+      aSumGyro[j]  += pBlock->Samples[i].Gyro[j];
+    }
+  }
+
+  /*!< Gyro mean [Q31 of full scale], 1/2048 LSB resolution */
+  for(uint8_t j = 0; j < 3; j++)
+  {
+    aAccel[j] = eQ31_Mean(aSumAccel[j], count);
+    aGyro[j]  = ((aSumGyro[j]*2048)/count)*32;
+  }
+
+  /*!< Accelerometer angles, atan2 does not need the norm in g */
+  pAngles[2]   = eQ31_Atan2(eQ31_Norm(aAccel[0], aAccel[1]),
+                            (q31_t)aAccel[2]*32768);
+  aMeasured[0] = eQ31_Atan2(-(q31_t)aAccel[0]*32768,
+                            eQ31_Norm(aAccel[1], aAccel[2]));
+  aMeasured[1] = eQ31_Atan2((q31_t)aAccel[1]*32768,
+                            eQ31_Norm(aAccel[0], aAccel[2]));
+
+  /*!< Gyro integral over the interval [Q31 of 180 deg]. FS*dt/180 is over 1
+   *   at 2000 dps and 10 periods: Q30 and a shift of 1 */
+  gyroStep = (q31_t)((gyroStepPerUs*interval) >> 17);
+  arm_scale_q31(&aGyro[0], gyroStep, 1, &aGyro[0], 3);
+
+  /*!< estimated = Weight*estimated + (1 - Weight)*measured. As the float
+   *   filter, the accelerometer term is the previous block's angle */
+  arm_scale_q31(&aEstimatedAccelQ31[0], weightQ31, 0, &aEstimatedAccelQ31[0], 2);
+  arm_scale_q31(&aPastAccelQ31[0], oneMinusWeightQ31, 0, &aTmp[0], 2);
+  arm_add_q31(&aEstimatedAccelQ31[0], &aTmp[0], &aEstimatedAccelQ31[0], 2);
+  arm_copy_q31(&aMeasured[0], &aPastAccelQ31[0], 2);
+
+  arm_scale_q31(&aEstimatedGyroQ31[0], weightQ31, 0, &aEstimatedGyroQ31[0], 2);
+  arm_scale_q31(&aGyro[0], oneMinusWeightQ31, 0, &aTmp[0], 2);
+  arm_add_q31(&aEstimatedGyroQ31[0], &aTmp[0], &aEstimatedGyroQ31[0], 2);
+
+  pAngles[0] = __QADD(aEstimatedAccelQ31[0], aEstimatedGyroQ31[1]);
+  pAngles[1] = __QADD(aEstimatedAccelQ31[1], aEstimatedGyroQ31[0]);
+
+  return FILTER_OK;
+}
+
+// Private functions ===========================================================
+/*!< sqrt(a^2 + b^2)*2^15: SMUAD adds both squares in one instruction */
+static q31_t eQ31_Norm(int16_t a, int16_t b)
+{
+  q31_t packed = (q31_t)__PKHBT(a, b, 16);
+  q31_t norm = 0;
+
+  arm_sqrt_q31((q31_t)(__SMUAD(packed, packed) >> 1), &norm);
+
+  return norm;
+}
+
+/*!< CORDIC vectoring. |x|, |y| < 2^31: the gain (1.647) is absorbed by the
+ *   shift. The angle is accumulated modulo 2^32, so +/-180 wraps */
+static q31_t eQ31_Atan2(q31_t y, q31_t x)
+{
+  uint32_t angle = 0;
+  q31_t tmp = 0;
+
+  y >>= 2;
+  x >>= 2;
+
+  /*!< Left half plane: rotate by 180 deg */
+  if(x < 0)
+  {
+    x = -x;
+    y = -y;
+    angle = 0x80000000;
+  }
+
+  for(uint8_t i = 0; i < 24; i++)
+  {
+    tmp = x;
+
+    if(y > 0)
+    {
+      x += y >> i;
+      y -= tmp >> i;
+      angle += (uint32_t)CORDIC_ATAN[i];
+    }
+    else
+    {
+      x -= y >> i;
+      y += tmp >> i;
+      angle -= (uint32_t)CORDIC_ATAN[i];
+    }
+  }
+
+  return (q31_t)angle;
+}
+
+/*!< Rounded block mean. -32768 is left out: SMUAD of two would overflow */
+static int16_t eQ31_Mean(int32_t sum, uint8_t count)
+{
+  int32_t mean = (sum >= 0) ? ((sum + count/2)/count) : ((sum - count/2)/count);
+
+  if(mean < -32767)
+    mean = -32767;
+
+  return (int16_t)mean;
+}
+
+// EOF =========================================================================
@@ -0,0 +1,184 @@
+// Includes ====================================================================
+#include "fast_math.h"
+#include "arm_math.h"
+
+// =============================================================================
+/*!< atan(r) [deg], r in [0, 1]: odd minimax polynomials, c1*r + c3*r^3 ... */
+#define ATAN_FINE_C1      57.25072806f
+#define ATAN_FINE_C3     -18.40190393f
+#define ATAN_FINE_C5       8.38017041f
+#define ATAN_FINE_C7      -2.23364842f
+
+#define ATAN_COARSE_C1    57.02978656f
+#define ATAN_COARSE_C3   -16.54059715f
+#define ATAN_COARSE_C5     4.54564931f
+
+/*!< Keeps the benchmark results alive */
+static volatile float32_t benchSink = 0.0f;
+
+// Private functions prototypes ================================================
+static inline float32_t fastMath_atan2Poly(float32_t y, float32_t x,
+                                           uint8_t fine);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Four quadrant arctangent.
+ * @param   y, x: any scale, the ratio is used.
+ * @param   accuracy: kernel.
+ * @retval  atan2(y, x) [deg].
+ ******************************************************************************/
+float32_t fastMath_atan2Deg(float32_t y, float32_t x,
+                            fastMath_accuracy_t accuracy)
+{
+  if(accuracy == FAST_MATH_FINE)
+    return fastMath_atan2Poly(y, x, 1);
+
+  if(accuracy == FAST_MATH_COARSE)
+    return fastMath_atan2Poly(y, x, 0);
+
+  return atan2f(y, x)*(180.0f/PI);
+}
+
+/*******************************************************************************
+ * @brief   Four quadrant arctangent of a block.
+ * @param   pY, pX: blockSize values each.
+ * @param   pDst: atan2(pY[i], pX[i]) [deg]. May be pY or pX.
+ * @param   blockSize: values.
+ * @param   accuracy: kernel.
+ * @retval  None.
+ ******************************************************************************/
+void fastMath_atan2Deg_f32(const float32_t *pY, const float32_t *pX,
+                           float32_t *pDst, uint16_t blockSize,
+                           fastMath_accuracy_t accuracy)
+{
+  if(accuracy == FAST_MATH_FINE)
+  {
+    for(uint16_t i = 0; i < blockSize; i++)
+      pDst[i] = fastMath_atan2Poly(pY[i], pX[i], 1);
+  }
+  else if(accuracy == FAST_MATH_COARSE)
+  {
+    for(uint16_t i = 0; i < blockSize; i++)
+      pDst[i] = fastMath_atan2Poly(pY[i], pX[i], 0);
+  }
+  else
+  {
+    for(uint16_t i = 0; i < blockSize; i++)
+      pDst[i] = atan2f(pY[i], pX[i])*(180.0f/PI);
+  }
+}
+
+/*******************************************************************************
+ * @brief   Inverse euclidean norm.
+ * @param   pSrc: vector.
+ * @param   len: elements.
+ * @retval  1/|pSrc|. 0 for a null vector.
+ ******************************************************************************/
+float32_t fastMath_invNorm(const float32_t *pSrc, uint8_t len)
+{
+  float32_t power = 0.0f;
+
+  for(uint8_t i = 0; i < len; i++)
+    power += pSrc[i]*pSrc[i];
+
+  if(power <= 0.0f)
+    return 0.0f;
+
+  arm_sqrt_f32(power, &power);
+
+  return 1.0f/power;
+}
+
+/*******************************************************************************
+ * @brief   DWT cycles per call, mean of FAST_MATH_BENCH_RUNS sweeps of
+ *          FAST_MATH_BENCH_SIZE angles around the circle.
+ * @param   pCycles: [0] atan2f(), [1] FAST_MATH_FINE, [2] FAST_MATH_COARSE,
+ *          [3] FAST_MATH_FINE per value of a block, [4] fastMath_invNorm()
+ *          of a 3 vector.
+ * @retval  None.
+ ******************************************************************************/
+void fastMath_benchmark(uint32_t *pCycles)
+{
+  static float32_t aY[FAST_MATH_BENCH_SIZE];
+  static float32_t aX[FAST_MATH_BENCH_SIZE];
+  static float32_t aDst[FAST_MATH_BENCH_SIZE];
+  const uint32_t calls = FAST_MATH_BENCH_RUNS*FAST_MATH_BENCH_SIZE;
+  float32_t sum = 0.0f;
+  uint32_t startCycles = 0;
+
+  for(uint16_t i = 0; i < FAST_MATH_BENCH_SIZE; i++)
+    arm_sin_cos_f32(-180.0f + (360.0f*i)/FAST_MATH_BENCH_SIZE, &aY[i], &aX[i]);
+
+  for(uint8_t k = 0; k < 3; k++)
+  {
+    startCycles = DWT->CYCCNT;
+    for(uint8_t n = 0; n < FAST_MATH_BENCH_RUNS; n++)
+    {
+      for(uint16_t i = 0; i < FAST_MATH_BENCH_SIZE; i++)
+        sum += fastMath_atan2Deg(aY[i], aX[i], (fastMath_accuracy_t)k);
+    }
+    pCycles[k] = (DWT->CYCCNT - startCycles)/calls;
+  }
+
+  startCycles = DWT->CYCCNT;
+  for(uint8_t n = 0; n < FAST_MATH_BENCH_RUNS; n++)
+  {
+    fastMath_atan2Deg_f32(&aY[0], &aX[0], &aDst[0], FAST_MATH_BENCH_SIZE,
+                          FAST_MATH_FINE);
+    sum += aDst[n];
+  }
+  pCycles[3] = (DWT->CYCCNT - startCycles)/calls;
+
+  startCycles = DWT->CYCCNT;
+  for(uint8_t n = 0; n < FAST_MATH_BENCH_RUNS; n++)
+  {
+    for(uint16_t i = 0; i < FAST_MATH_BENCH_SIZE - 2; i++)
+      sum += fastMath_invNorm(&aY[i], 3);
+  }
+  pCycles[4] = (DWT->CYCCNT - startCycles)
+      /(FAST_MATH_BENCH_RUNS*(FAST_MATH_BENCH_SIZE - 2));
+
+  benchSink = sum;
+}
+
+// Private functions ===========================================================
+/*!< |r| <= 1 by octant: r = min/max of |y|, |x|, then the quadrant from the
+ *   sign bits, so a signed zero lands where atan2f() puts it (x = -0: 180,
+ *   y = -0: negative). fine is a constant at every call, the branch is
+ *   folded */
+static inline float32_t fastMath_atan2Poly(float32_t y, float32_t x,
+                                           uint8_t fine)
+{
+  float32_t absX = fabsf(x);
+  float32_t absY = fabsf(y);
+  float32_t r = 0.0f, r2 = 0.0f;
+  float32_t angle = 0.0f;
+
+  if(absX >= absY)
+  {
+    if(absX == 0.0f)
+      r = 0.0f;
+    else
+      r = absY/absX;
+  }
+  else
+    r = absX/absY;
+
+  r2 = r*r;
+
+  if(fine == 1)
+    angle = r*(ATAN_FINE_C1 + r2*(ATAN_FINE_C3
+        + r2*(ATAN_FINE_C5 + r2*ATAN_FINE_C7)));
+  else
+    angle = r*(ATAN_COARSE_C1 + r2*(ATAN_COARSE_C3 + r2*ATAN_COARSE_C5));
+
+  if(absX < absY)
+    angle = 90.0f - angle;
+
+  if(signbit(x) != 0)
+    angle = 180.0f - angle;
+
+  return (signbit(y) != 0) ? -angle : angle;
+}
+
+// EOF =========================================================================
@@ -0,0 +1,314 @@
+// Includes ====================================================================
+#include "gyro_bias.h"
+#include "arm_math.h"
+
+// =============================================================================
+typedef struct
+{
+  gyroBias_model_t Model;
+  gyroBias_stats_t Stats;
+  float32_t MeanTemp;                 /*!< Weighted means of the still blocks */
+  float32_t MeanGyro[3];
+  float32_t VarTemp;
+  float32_t CovGyro[3];               /*!< cov(temperature, gyro) */
+} gyroBias_unit_t;
+
+static gyroBias_unit_t units[MPU9250_MAX_DEVICES];
+static uint8_t unitCount = 0;
+
+// Private functions prototypes ================================================
+static uint8_t gyroBias_isStill(gyroBias_unit_t *pUnit,
+                                mpu9250_fifoBlock_t *pBlock, float32_t res,
+                                float32_t *pTemp, float32_t *pGyro);
+static void gyroBias_learn(gyroBias_unit_t *pUnit, float32_t temp,
+                           float32_t *pGyro);
+static float32_t gyroBias_eval(gyroBias_model_t *pModel, uint8_t axis,
+                               float32_t temp);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the estimator. Every unit starts without a model.
+ * @param   count: devices to compensate, 1..MPU9250_MAX_DEVICES.
+ * @retval  1 if successful. 0 if count is out of range.
+ ******************************************************************************/
+uint8_t gyroBias_init(uint8_t count)
+{
+  if((count == 0) || (count > MPU9250_MAX_DEVICES))
+    return 0;
+
+  for(uint8_t i = 0; i < MPU9250_MAX_DEVICES; i++)
+  {
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      units[i].Model.Offset[axis] = 0.0f;
+      units[i].Model.Slope[axis] = 0.0f;
+      units[i].MeanGyro[axis] = 0.0f;
+      units[i].CovGyro[axis] = 0.0f;
+    }
+
+    units[i].Model.TempRef = 0.0f;
+    units[i].Model.Valid = 0;
+    units[i].MeanTemp = 0.0f;
+    units[i].VarTemp = 0.0f;
+    units[i].Stats.StillTicks = 0;
+    units[i].Stats.Points = 0;
+    units[i].Stats.SlopeFits = 0;
+    units[i].Stats.TempSpread = 0.0f;
+  }
+
+  unitCount = count;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Learn from a raw (not yet corrected) block if the unit is still.
+ * @param   index: unit (driver handle index).
+ * @param   pBlock: FIFO block, as read.
+ * @retval  1 if the block updated the model. 0 if not.
+ ******************************************************************************/
+uint8_t gyroBias_update(uint8_t index, mpu9250_fifoBlock_t *pBlock)
+{
+  gyroBias_unit_t *pUnit = 0;
+  float32_t temp = 0.0f;
+  float32_t gyro[3] = { 0.0f };
+
+  if(index >= unitCount)
+    return 0;
+
+  pUnit = &units[index];
+
+  if(gyroBias_isStill(pUnit, pBlock, mpu9250_getHandle(index)->GyroResolution,
+                      &temp, &gyro[0]) == 0)
+  {
+    pUnit->Stats.StillTicks = 0;
+    return 0;
+  }
+
+  if(pUnit->Stats.StillTicks < GYRO_BIAS_STILL_TICKS)
+  {
+    pUnit->Stats.StillTicks++;
+    return 0;
+  }
+
+  gyroBias_learn(pUnit, temp, &gyro[0]);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Remove the modelled bias from the gyro samples, in place.
+ * @param   index: unit (driver handle index).
+ * @param   pBlock: FIFO block. Each sample is corrected at its own
+ *          temperature.
+ * @retval  None.
+ ******************************************************************************/
+void gyroBias_correctBlock(uint8_t index, mpu9250_fifoBlock_t *pBlock)
+{
+  gyroBias_model_t *pModel = 0;
+  mpu9250_rawData_t *pSample = 0;
+  float32_t deltaTemp = 0.0f;
+  float32_t value = 0.0f;
+
+  if(index >= unitCount)
+    return;
+
+  pModel = &units[index].Model;
+  if(pModel->Valid == 0)
+    return;
+
+  for(uint8_t i = 0; i < pBlock->Count; i++)
+  {
+    pSample = &pBlock->Samples[i];
+    deltaTemp = (float32_t)pSample->Temperature - pModel->TempRef;
+
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      if((pSample->Gyro[axis] == INT16_MAX) || (pSample->Gyro[axis] == INT16_MIN))
+        continue;
+
+      value = (float32_t)pSample->Gyro[axis]
+          - (pModel->Offset[axis] + pModel->Slope[axis]*deltaTemp);
+
+      /*!< Rounded, and never at full scale: that reads as saturation */
+      if(value > (float32_t)(INT16_MAX - 1))
+        value = (float32_t)(INT16_MAX - 1);
+      else if(value < (float32_t)(INT16_MIN + 1))
+        value = (float32_t)(INT16_MIN + 1);
+
+      pSample->Gyro[axis] = (int16_t)((value >= 0.0f) ? (value + 0.5f)
+                                                      : (value - 0.5f));
+    }
+  }
+}
+
+/*******************************************************************************
+ * @brief   Current model of a unit, to be stored.
+ * @param   index: unit (driver handle index).
+ * @param   pModel: model copy.
+ * @retval  1 if successful. 0 if index is out of range.
+ ******************************************************************************/
+uint8_t gyroBias_getModel(uint8_t index, gyroBias_model_t *pModel)
+{
+  if(index >= unitCount)
+    return 0;
+
+  *pModel = units[index].Model;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Restore a stored model. Learning goes on from it: the stored
+ *          point weighs as a single block.
+ * @param   index: unit (driver handle index).
+ * @param   pModel: stored model.
+ * @retval  1 if successful. 0 if index is out of range.
+ ******************************************************************************/
+uint8_t gyroBias_setModel(uint8_t index, const gyroBias_model_t *pModel)
+{
+  gyroBias_unit_t *pUnit = 0;
+
+  if(index >= unitCount)
+    return 0;
+
+  pUnit = &units[index];
+  pUnit->Model = *pModel;
+  pUnit->MeanTemp = pModel->TempRef;
+  pUnit->VarTemp = 0.0f;
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+  {
+    pUnit->MeanGyro[axis] = pModel->Offset[axis];
+    pUnit->CovGyro[axis] = 0.0f;
+  }
+
+  pUnit->Stats.Points = (pModel->Valid == 1) ? 1 : 0;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Learning counters of a unit.
+ * @param   index: unit (driver handle index).
+ * @retval  Statistics. 0 if index is out of range.
+ ******************************************************************************/
+const gyroBias_stats_t *gyroBias_getStats(uint8_t index)
+{
+  if(index >= unitCount)
+    return 0;
+
+  return &units[index].Stats;
+}
+
+// Private functions ===========================================================
+/*!< res: gyro LSB/dps. pTemp, pGyro: block means, raw units. A block with
+ *   every frame identical is a stuck sensor, not a still one */
+static uint8_t gyroBias_isStill(gyroBias_unit_t *pUnit,
+                                mpu9250_fifoBlock_t *pBlock, float32_t res,
+                                float32_t *pTemp, float32_t *pGyro)
+{
+  int16_t min[3] = { INT16_MAX, INT16_MAX, INT16_MAX };
+  int16_t max[3] = { INT16_MIN, INT16_MIN, INT16_MIN };
+  int32_t sumGyro[3] = { 0 };
+  int32_t sumTemp = 0;
+  mpu9250_rawData_t *pSample = 0;
+  uint8_t alive = 0;
+  float32_t residual = 0.0f;
+
+  if(pBlock->Count < 2)
+    return 0;
+
+  for(uint8_t i = 0; i < pBlock->Count; i++)
+  {
+    pSample = &pBlock->Samples[i];
+    sumTemp += pSample->Temperature;
+
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      sumGyro[axis] += pSample->Gyro[axis];
+
+      if(pSample->Gyro[axis] < min[axis])
+        min[axis] = pSample->Gyro[axis];
+      if(pSample->Gyro[axis] > max[axis])
+        max[axis] = pSample->Gyro[axis];
+    }
+  }
+
+  *pTemp = (float32_t)sumTemp/(float32_t)pBlock->Count;
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+  {
+    if((float32_t)(max[axis] - min[axis]) > GYRO_BIAS_NOISE_DPS*res)
+      return 0;
+
+    if(max[axis] != min[axis])
+      alive = 1;
+
+    pGyro[axis] = (float32_t)sumGyro[axis]/(float32_t)pBlock->Count;
+    residual = pGyro[axis] - gyroBias_eval(&pUnit->Model, axis, *pTemp);
+
+    if((residual > GYRO_BIAS_STILL_DPS*res)
+        || (residual < -GYRO_BIAS_STILL_DPS*res))
+      return 0;
+  }
+
+  return alive;
+}
+
+/*!< Exponentially weighted mean and covariance: plain average until
+ *   GYRO_BIAS_MEMORY points, then a sliding memory */
+static void gyroBias_learn(gyroBias_unit_t *pUnit, float32_t temp,
+                           float32_t *pGyro)
+{
+  const float32_t minVar = (GYRO_BIAS_MIN_SPAN*GYRO_BIAS_TEMP_SENSITIVITY)
+      *(GYRO_BIAS_MIN_SPAN*GYRO_BIAS_TEMP_SENSITIVITY);
+  gyroBias_model_t *pModel = &pUnit->Model;
+  float32_t alpha = 0.0f;
+  float32_t deltaTemp = 0.0f;
+  float32_t deltaGyro = 0.0f;
+  uint8_t fitSlope = 0;
+
+  if(pUnit->Stats.Points < GYRO_BIAS_MEMORY)
+    pUnit->Stats.Points++;
+
+  alpha = 1.0f/(float32_t)pUnit->Stats.Points;
+  deltaTemp = temp - pUnit->MeanTemp;
+  pUnit->MeanTemp += alpha*deltaTemp;
+  pUnit->VarTemp = (1.0f - alpha)*(pUnit->VarTemp + alpha*deltaTemp*deltaTemp);
+
+  fitSlope = (pUnit->VarTemp >= minVar) ? 1 : 0;
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+  {
+    deltaGyro = pGyro[axis] - pUnit->MeanGyro[axis];
+    pUnit->MeanGyro[axis] += alpha*deltaGyro;
+    pUnit->CovGyro[axis] = (1.0f - alpha)*(pUnit->CovGyro[axis]
+        + alpha*deltaTemp*deltaGyro);
+
+    /*!< Too narrow a spread: the slope (fitted or stored) is kept */
+    if(fitSlope == 1)
+      pModel->Slope[axis] = pUnit->CovGyro[axis]/pUnit->VarTemp;
+
+    pModel->Offset[axis] = pUnit->MeanGyro[axis];
+  }
+
+  pModel->TempRef = pUnit->MeanTemp;
+  pModel->Valid = 1;
+
+  if(fitSlope == 1)
+    pUnit->Stats.SlopeFits++;
+
+  pUnit->Stats.TempSpread = sqrtf(pUnit->VarTemp)/GYRO_BIAS_TEMP_SENSITIVITY;
+}
+
+static float32_t gyroBias_eval(gyroBias_model_t *pModel, uint8_t axis,
+                               float32_t temp)
+{
+  if(pModel->Valid == 0)
+    return 0.0f;
+
+  return pModel->Offset[axis] + pModel->Slope[axis]*(temp - pModel->TempRef);
+}
+
+// EOF =========================================================================
@@ -0,0 +1,358 @@
+// Includes ====================================================================
+#include "imu_redundant.h"
+#include "arm_math.h"
+
+// =============================================================================
+static imu_unit_t units[MPU9250_MAX_DEVICES];
+static imu_redundantStats_t stats;
+
+/*!< Scaled blocks of every unit, XYZ interleaved */
+static float32_t unitAccel[MPU9250_MAX_DEVICES][3*MPU9250_FIFO_BLOCK_SIZE];
+static float32_t unitGyro[MPU9250_MAX_DEVICES][3*MPU9250_FIFO_BLOCK_SIZE];
+
+// Private functions prototypes ================================================
+static imu_fault_t imuRedundant_check(mpu9250_fifoBlock_t *pBlock,
+                                      uint8_t readOk);
+static void imuRedundant_updateHealth(imu_unit_t *pUnit, imu_fault_t fault);
+static uint8_t imuRedundant_deviates(uint8_t unit, uint8_t unitCount,
+                                     const float32_t *pAccel,
+                                     const float32_t *pGyro, uint8_t count,
+                                     float32_t scale);
+static float32_t imuRedundant_combine(float32_t *pValues, uint8_t count);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the health monitor. Every unit starts healthy.
+ * @param   count: devices to fuse, 1..MPU9250_MAX_DEVICES.
+ * @retval  1 if successful. 0 if count is out of range.
+ ******************************************************************************/
+uint8_t imuRedundant_init(uint8_t count)
+{
+  if((count == 0) || (count > MPU9250_MAX_DEVICES))
+    return 0;
+
+  for(uint8_t i = 0; i < MPU9250_MAX_DEVICES; i++)
+  {
+    units[i].Healthy = (i < count) ? 1 : 0;
+    units[i].LastFault = IMU_FAULT_NONE;
+    units[i].FaultTicks = 0;
+    units[i].GoodTicks = 0;
+    units[i].Faults = 0;
+    units[i].Failures = 0;
+  }
+
+  stats.Units = count;
+  stats.Used = 0;
+  stats.Disagreements = 0;
+  stats.NoData = 0;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Check and fuse the blocks read in one tick.
+ * @param   pBlocks: one FIFO block per unit.
+ * @param   pReadOk: per unit, 1 if its read succeeded.
+ * @param   pAccel: fused accelerometer [g], XYZ interleaved.
+ * @param   pGyro: fused gyroscope [dps], XYZ interleaved.
+ * @retval  Fused samples. 0 if no unit was usable.
+ ******************************************************************************/
+uint8_t imuRedundant_fuse(mpu9250_fifoBlock_t *pBlocks, const uint8_t *pReadOk,
+                          float32_t *pAccel, float32_t *pGyro)
+{
+  uint8_t used[MPU9250_MAX_DEVICES] = { 0 };
+  uint8_t offset[MPU9250_MAX_DEVICES] = { 0 };
+  imu_fault_t fault[MPU9250_MAX_DEVICES] = { IMU_FAULT_NONE };
+  uint8_t outlier[MPU9250_MAX_DEVICES] = { 0 };
+  float32_t accelValues[MPU9250_MAX_DEVICES] = { 0.0f };
+  float32_t gyroValues[MPU9250_MAX_DEVICES] = { 0.0f };
+  uint8_t nUsed = 0;
+  uint8_t nOutliers = 0;
+  uint8_t count = MPU9250_FIFO_BLOCK_SIZE;
+  uint8_t agree = 1;
+
+  /*!< Healthy units are fused, recovering ones only checked against them */
+  for(uint8_t u = 0; u < stats.Units; u++)
+  {
+    fault[u] = imuRedundant_check(&pBlocks[u], pReadOk[u]);
+
+    if(fault[u] != IMU_FAULT_NONE)
+      continue;
+
+    mpu9250_convertBlock_float(mpu9250_getHandle(u), &pBlocks[u],
+                               &unitAccel[u][0], &unitGyro[u][0]);
+
+    if(units[u].Healthy == 0)
+      continue;
+
+    used[nUsed++] = u;
+
+    if(pBlocks[u].Count < count)
+      count = pBlocks[u].Count;
+  }
+
+  stats.Used = nUsed;
+
+  if(nUsed == 0)
+  {
+    for(uint8_t u = 0; u < stats.Units; u++)
+      imuRedundant_updateHealth(&units[u], fault[u]);
+
+    stats.NoData++;
+    return 0;
+  }
+
+  /*!< Newest samples line up: drop the oldest of the longer blocks */
+  for(uint8_t j = 0; j < nUsed; j++)
+    offset[j] = 3*(pBlocks[used[j]].Count - count);
+
+  for(uint16_t i = 0; i < 3*count; i++)
+  {
+    for(uint8_t j = 0; j < nUsed; j++)
+    {
+      accelValues[j] = unitAccel[used[j]][offset[j] + i];
+      gyroValues[j] = unitGyro[used[j]][offset[j] + i];
+    }
+
+    pAccel[i] = imuRedundant_combine(&accelValues[0], nUsed);
+    pGyro[i] = imuRedundant_combine(&gyroValues[0], nUsed);
+  }
+
+  /*!< Two units: the mean sits halfway, twice the distance to it is the
+   *   difference between them. Nothing says which one is wrong */
+  if(nUsed == 2)
+    agree = (imuRedundant_deviates(used[0], pBlocks[used[0]].Count, pAccel,
+                                   pGyro, count, 2.0f) == 0) ? 1 : 0;
+
+  /*!< Three or more: every unit against the median. Voted out only while
+   *   the units that agree are the majority */
+  if(nUsed > 2)
+  {
+    for(uint8_t j = 0; j < nUsed; j++)
+    {
+      outlier[used[j]] = imuRedundant_deviates(used[j], pBlocks[used[j]].Count,
+                                               pAccel, pGyro, count, 1.0f);
+      nOutliers += outlier[used[j]];
+    }
+
+    agree = (nOutliers == 0) ? 1 : 0;
+
+    if((2*nOutliers) >= nUsed)
+    {
+      for(uint8_t j = 0; j < nUsed; j++)
+        outlier[used[j]] = 0;
+    }
+  }
+
+  if(agree == 0)
+    stats.Disagreements++;
+
+  for(uint8_t u = 0; u < stats.Units; u++)
+  {
+    /*!< A recovering unit has to agree with healthy units that agree */
+    if((fault[u] == IMU_FAULT_NONE) && (units[u].Healthy == 0)
+        && (nUsed > 1) && (agree == 1))
+      outlier[u] = imuRedundant_deviates(u, pBlocks[u].Count, pAccel, pGyro,
+                                         count, 1.0f);
+
+    if(outlier[u] == 1)
+      fault[u] = IMU_FAULT_DISAGREE;
+
+    imuRedundant_updateHealth(&units[u], fault[u]);
+  }
+
+  return count;
+}
+
+/*******************************************************************************
+ * @brief   Check the blocks read in one tick and pick the first usable unit,
+ *          without scaling (fixed point pipeline). Health is updated as in
+ *          imuRedundant_fuse(), without the agreement check.
+ * @param   pBlocks: one FIFO block per unit.
+ * @param   pReadOk: per unit, 1 if its read succeeded.
+ * @retval  Unit index. MPU9250_MAX_DEVICES if no unit was usable.
+ ******************************************************************************/
+uint8_t imuRedundant_select(mpu9250_fifoBlock_t *pBlocks,
+                            const uint8_t *pReadOk)
+{
+  uint8_t selected = MPU9250_MAX_DEVICES;
+  imu_fault_t fault = IMU_FAULT_NONE;
+
+  for(uint8_t u = 0; u < stats.Units; u++)
+  {
+    fault = imuRedundant_check(&pBlocks[u], pReadOk[u]);
+    imuRedundant_updateHealth(&units[u], fault);
+
+    if((selected == MPU9250_MAX_DEVICES) && (fault == IMU_FAULT_NONE)
+        && (units[u].Healthy == 1))
+      selected = u;
+  }
+
+  stats.Used = (selected != MPU9250_MAX_DEVICES) ? 1 : 0;
+
+  if(selected == MPU9250_MAX_DEVICES)
+    stats.NoData++;
+
+  return selected;
+}
+
+/*******************************************************************************
+ * @brief   Health of a unit.
+ * @param   index: unit (driver handle index).
+ * @retval  Unit state. 0 if index is out of range.
+ ******************************************************************************/
+const imu_unit_t *imuRedundant_getUnit(uint8_t index)
+{
+  if(index >= stats.Units)
+    return 0;
+
+  return &units[index];
+}
+
+/*******************************************************************************
+ * @brief   Fusion counters.
+ * @retval  Statistics.
+ ******************************************************************************/
+const imu_redundantStats_t *imuRedundant_getStats(void)
+{
+  return &stats;
+}
+
+// Private functions ===========================================================
+/*!< A live sensor never repeats all six axes over a whole block: noise
+ *   alone moves the LSBs */
+static imu_fault_t imuRedundant_check(mpu9250_fifoBlock_t *pBlock,
+                                      uint8_t readOk)
+{
+  mpu9250_rawData_t *pFirst = &pBlock->Samples[0];
+  mpu9250_rawData_t *pSample = 0;
+  uint8_t stuck = 1;
+
+  if(readOk != 1)
+    return IMU_FAULT_READ;
+
+  if(pBlock->Count == 0)
+    return IMU_FAULT_EMPTY;
+
+  for(uint8_t i = 0; i < pBlock->Count; i++)
+  {
+    pSample = &pBlock->Samples[i];
+
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      if((pSample->Accel[axis] == INT16_MAX) || (pSample->Accel[axis] == INT16_MIN)
+          || (pSample->Gyro[axis] == INT16_MAX) || (pSample->Gyro[axis] == INT16_MIN))
+        return IMU_FAULT_SATURATED;
+
+      if((pSample->Accel[axis] != pFirst->Accel[axis])
+          || (pSample->Gyro[axis] != pFirst->Gyro[axis]))
+        stuck = 0;
+    }
+  }
+
+  if((stuck == 1) && (pBlock->Count > 1))
+    return IMU_FAULT_STUCK;
+
+  return IMU_FAULT_NONE;
+}
+
+static void imuRedundant_updateHealth(imu_unit_t *pUnit, imu_fault_t fault)
+{
+  pUnit->LastFault = fault;
+
+  if(fault != IMU_FAULT_NONE)
+  {
+    pUnit->Faults++;
+    pUnit->GoodTicks = 0;
+
+    if(pUnit->FaultTicks < IMU_REDUNDANT_FAULT_TICKS)
+      pUnit->FaultTicks++;
+
+    if((pUnit->Healthy == 1) && (pUnit->FaultTicks >= IMU_REDUNDANT_FAULT_TICKS))
+    {
+      pUnit->Healthy = 0;
+      pUnit->Failures++;
+    }
+    return;
+  }
+
+  pUnit->FaultTicks = 0;
+
+  if(pUnit->Healthy == 0)
+  {
+    if(++pUnit->GoodTicks >= IMU_REDUNDANT_RECOVER_TICKS)
+    {
+      pUnit->Healthy = 1;
+      pUnit->GoodTicks = 0;
+    }
+  }
+}
+
+/*!< Per axis mean absolute difference between the unit and the fused block,
+ *   newest samples aligned, times scale. 1 if any axis is beyond the
+ *   tolerances */
+static uint8_t imuRedundant_deviates(uint8_t unit, uint8_t unitCount,
+                                     const float32_t *pAccel,
+                                     const float32_t *pGyro, uint8_t count,
+                                     float32_t scale)
+{
+  float32_t accelDiff[3] = { 0.0f };
+  float32_t gyroDiff[3] = { 0.0f };
+  uint8_t n = (unitCount < count) ? unitCount : count;
+  const float32_t *pUnitAccel = &unitAccel[unit][3*(unitCount - n)];
+  const float32_t *pUnitGyro = &unitGyro[unit][3*(unitCount - n)];
+
+  if(n == 0)
+    return 0;
+
+  pAccel += 3*(count - n);
+  pGyro += 3*(count - n);
+
+  for(uint8_t i = 0; i < n; i++)
+  {
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      accelDiff[axis] += fabsf(pUnitAccel[3*i + axis] - pAccel[3*i + axis]);
+      gyroDiff[axis] += fabsf(pUnitGyro[3*i + axis] - pGyro[3*i + axis]);
+    }
+  }
+
+  scale /= (float32_t)n;
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+  {
+    if((scale*accelDiff[axis] > IMU_REDUNDANT_ACCEL_TOL)
+        || (scale*gyroDiff[axis] > IMU_REDUNDANT_GYRO_TOL))
+      return 1;
+  }
+
+  return 0;
+}
+
+/*!< 1: as is, 2: mean, 3 or more: median (pValues is reordered) */
+static float32_t imuRedundant_combine(float32_t *pValues, uint8_t count)
+{
+  float32_t tmp = 0.0f;
+  int8_t j = 0;
+
+  if(count == 1)
+    return pValues[0];
+
+  if(count == 2)
+    return 0.5f*(pValues[0] + pValues[1]);
+
+  for(uint8_t i = 1; i < count; i++)
+  {
+    tmp = pValues[i];
+    for(j = i - 1; (j >= 0) && (pValues[j] > tmp); j--)
+      pValues[j + 1] = pValues[j];
+    pValues[j + 1] = tmp;
+  }
+
+  if((count & 0x01) == 0)
+    return 0.5f*(pValues[count/2 - 1] + pValues[count/2]);
+
+  return pValues[count/2];
+}
+
+// EOF =========================================================================
@@ -5,10 +5,16 @@ static void initHardware_Nvic(void);
 static void initHardware_SystemClock(void);
 static void initHardware_GPIO(void);
 static void initHardware_COM(void);
+static void initHardware_I2C(I2C_TypeDef *I2Cx);
 static void initHardware_PWM(void);
 static void initHardware_Sampler(void);
+static void initHardware_Uptime(void);
 static void initHardware_Platform(void);
 
+/*!< DWT->CYCCNT extended to 64 bits */
+static uint64_t timestampCycles = 0;
+static uint32_t timestampLast = 0;
+
 // Public functions ============================================================
 /*******************************************************************************
  * @brief   Init System.
@@ -22,6 +28,7 @@ void initHardware_InitSystem(void)
   initHardware_COM();
   initHardware_PWM();
   initHardware_Sampler();
+  initHardware_Uptime();
   initHardware_Platform();
 }
 
@@ -46,6 +53,65 @@ void initHardware_TestOutput(void)
   }
 }
 
+/*******************************************************************************
+ * @brief   Time since boot, keeps counting in sleep (__WFI).
+ * @retval  Uptime [1/UPTIME_FREQ s]. Wraps after ~119 h.
+ ******************************************************************************/
+uint32_t initHardware_getUptime(void)
+{
+  return LL_TIM_GetCounter(TIM2);
+}
+
+/*******************************************************************************
+ * @brief   Monotonic time base: DWT->CYCCNT extended to 64 bits. Must be
+ *          called at least once per CYCCNT wrap (25.6 s at 168 MHz): the
+ *          data-ready interrupt does it while sampling, initHardware_
+ *          syncTimestamp() after idle. Any context.
+ * @retval  Timestamp [us].
+ ******************************************************************************/
+uint64_t initHardware_getTimestamp(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  uint32_t now = 0;
+  uint64_t cycles = 0;
+
+  __disable_irq();
+  now = DWT->CYCCNT;
+  timestampCycles += (uint32_t)(now - timestampLast);
+  timestampLast = now;
+  cycles = timestampCycles;
+  __set_PRIMASK(primask);
+
+  return cycles/(SystemCoreClock/1000000);
+}
+
+/*******************************************************************************
+ * @brief   Catch up with the CYCCNT wraps missed during a long sleep. The
+ *          uptime timer (TIM2) tells how many there were.
+ * @param   sleepTicks: sleep length [1/UPTIME_FREQ s].
+ * @retval  None.
+ ******************************************************************************/
+void initHardware_syncTimestamp(uint32_t sleepTicks)
+{
+  uint32_t primask = __get_PRIMASK();
+  uint64_t sleepCycles = (uint64_t)sleepTicks*(SystemCoreClock/UPTIME_FREQ);
+  uint32_t now = 0;
+  uint32_t delta = 0;
+  uint64_t wraps = 0;
+
+  __disable_irq();
+  now = DWT->CYCCNT;
+  delta = now - timestampLast;
+
+  /*!< Rounded: the uptime resolution is far below a wrap */
+  if(sleepCycles > delta)
+    wraps = (sleepCycles - delta + 0x80000000ULL) >> 32;
+
+  timestampCycles += delta + (wraps << 32);
+  timestampLast = now;
+  __set_PRIMASK(primask);
+}
+
 /*******************************************************************************
  * @brief   Infinite Loop.
  * @retval  None.
@@ -174,10 +240,50 @@ static void initHardware_GPIO(void)
 
 static void initHardware_COM(void)
 {
-  cncI2C_Init(I2C1, 400000);
+  LL_GPIO_InitTypeDef GPIO_InitStruct;
+
+  if(IMU_INTERFACE == MPU9250_INTERFACE_SPI)
+  {
+    /*!< SPI1 is shared with the on-board accelerometer: keep it deselected */
+    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_GPIOE);
+    LL_GPIO_SetOutputPin(MEMS_CS.GPIO_Port, MEMS_CS.GPIO_Pin);
+    GPIO_InitStruct.Pin = MEMS_CS.GPIO_Pin;
+    GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
+    GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+    GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
+    GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_LOW;
+    LL_GPIO_Init(MEMS_CS.GPIO_Port, &GPIO_InitStruct);
+
+    cncSPI_Init(SPI1, SPI_PRESCALER_128);
+    cncSPI_InitDMA(SPI1);
+  }
+
+  if(IMU_INTERFACE == MPU9250_INTERFACE_I2C)
+    initHardware_I2C(IMU_I2C);
+
+  if((IMU_COUNT > 1) &&
+     ((IMU_INTERFACE != MPU9250_INTERFACE_I2C) || (IMU_AUX_I2C != IMU_I2C)))
+    initHardware_I2C(IMU_AUX_I2C);
+
+  if((IMU_COUNT > 2) && (IMU_AUX2_I2C != IMU_AUX_I2C) &&
+     ((IMU_INTERFACE != MPU9250_INTERFACE_I2C) || (IMU_AUX2_I2C != IMU_I2C)))
+    initHardware_I2C(IMU_AUX2_I2C);
+
   cncUSART_init(UART5);
 }
 
+/*******************************************************************************
+ * @brief IMU bus: 400 kHz, DMA transfers and its transaction queue.
+ * @param I2Cx: I2C instance.
+ * @retval None.
+ ******************************************************************************/
+static void initHardware_I2C(I2C_TypeDef *I2Cx)
+{
+  cncI2C_Init(I2Cx, 400000);
+  cncI2C_InitDMA(I2Cx);
+  cncI2CQueue_init(I2Cx);
+}
+
 /*******************************************************************************
  * @brief Config Timer4 for PWM output. Period: 50 Hz.
  * @retval None.
@@ -246,59 +352,141 @@ static void initHardware_PWM(void)
 }
 
 /*******************************************************************************
- * @brief Init Timer 7 for sampling. 100 Hz
- * @retval None.
+ * @brief   Sampler: MPU9250 data-ready pulses (INT pin) on EXTI. The sensor
+ *          clock paces the control loop. The interrupt is enabled by the
+ *          application once the platform is ready.
+ * @retval  None.
  ******************************************************************************/
 static void initHardware_Sampler(void)
 {
-  const uint32_t TIMER_CLOCK = (SystemCoreClock / 2);
   uint32_t nvic_priority = 0;
-  uint32_t prescaler_val  = 0;
-  uint32_t autoreload_val = 0;
 
-  LL_TIM_InitTypeDef TIM_InitStruct;
+  LL_EXTI_InitTypeDef EXTI_InitStruct;
 
-  /*!< Timer 7 configuration */
-  if(LL_APB1_GRP1_IsEnabledClock(LL_APB1_GRP1_PERIPH_TIM7) != 1)
-    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM7);
+  LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_SYSCFG);
+  LL_SYSCFG_SetEXTISource(LL_SYSCFG_EXTI_PORTD, LL_SYSCFG_EXTI_LINE1);
 
-  /*!< Event frequency = TIMER_CLOCK / [(1 + PSR)(1 + ARR)]*/
-  prescaler_val  = 83;
-  autoreload_val = 9999;
+  LL_GPIO_SetPinPull(IMU_INT.GPIO_Port, IMU_INT.GPIO_Pin, LL_GPIO_PULL_DOWN);
+  LL_GPIO_SetPinMode(IMU_INT.GPIO_Port, IMU_INT.GPIO_Pin, LL_GPIO_MODE_INPUT);
 
-  TIM_InitStruct.Prescaler = prescaler_val;
-  TIM_InitStruct.Autoreload = autoreload_val;
+  /*!< 50 us active high pulse per sample */
+  EXTI_InitStruct.Line_0_31 = LL_EXTI_LINE_1;
+  EXTI_InitStruct.LineCommand = ENABLE;
+  EXTI_InitStruct.Mode = LL_EXTI_MODE_IT;
+  EXTI_InitStruct.Trigger = LL_EXTI_TRIGGER_RISING;
+  LL_EXTI_Init(&EXTI_InitStruct);
+
+  /*!> Lower preemption level than I2C1/DMA1 transfers started from here */
+  nvic_priority = NVIC_EncodePriority(NVIC_PRIORITYGROUP_1, 1, 0);
+  NVIC_ClearPendingIRQ(EXTI1_IRQn);
+  NVIC_SetPriority(EXTI1_IRQn, nvic_priority);
+}
+
+/*******************************************************************************
+ * @brief Timer 2 (32 bits) free running at UPTIME_FREQ. No interrupts.
+ * @retval None.
+ ******************************************************************************/
+static void initHardware_Uptime(void)
+{
+  const uint32_t TIMER_CLOCK = (SystemCoreClock / 2);
+  LL_TIM_InitTypeDef TIM_InitStruct;
+
+  LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM2);
+
+  TIM_InitStruct.Prescaler = (uint16_t)((TIMER_CLOCK / UPTIME_FREQ) - 1);
+  TIM_InitStruct.Autoreload = 0xFFFFFFFF;
   TIM_InitStruct.CounterMode = LL_TIM_COUNTERMODE_UP;
   TIM_InitStruct.ClockDivision = LL_TIM_CLOCKDIVISION_DIV1;
   TIM_InitStruct.RepetitionCounter = 0;
 
-  if(LL_TIM_Init(TIM7, &TIM_InitStruct) != SUCCESS)
+  if(LL_TIM_Init(TIM2, &TIM_InitStruct) != SUCCESS)
     Error_Handler();
 
-  /*!> Enable Timer7 interrupt */
-  nvic_priority = NVIC_EncodePriority(NVIC_PRIORITYGROUP_1, 0, 3);
-  NVIC_ClearPendingIRQ(TIM7_IRQn);
-  NVIC_SetPriority(TIM7_IRQn, nvic_priority);
-  NVIC_EnableIRQ(TIM7_IRQn);
+  LL_TIM_SetClockSource(TIM2, LL_TIM_CLOCKSOURCE_INTERNAL);
+  LL_TIM_EnableCounter(TIM2);
 }
 
 static void initHardware_Platform(void)
 {
+  mpu9250_offsets_t mpu9250_Offsets;
+  mpu9250_selfTest_t mpu9250_SelfTest;
+  mpu9250_handle_t *pImu = 0;
+  uint8_t imuHealthy = 1;
   mpu9250_InitStruct_t mpu9250_InitStruct;
   mpu9250_InitStruct.SampleRate = 100;
-  mpu9250_InitStruct.Interface = MPU9250_INTERFACE_I2C;
   mpu9250_InitStruct.Accel_Axes = MPU9250_ACCEL_XYZ_ENABLE;
   mpu9250_InitStruct.Accel_LPF = MPU9250_ACCEL_LPF_99HZ;
   mpu9250_InitStruct.Accel_Scale = MPU9250_ACCEL_FULLSCALE_2G;
   mpu9250_InitStruct.Gyro_Axes = MPU9250_GYRO_XYZ_ENABLE;
   mpu9250_InitStruct.Gyro_LPF = MPU9250_GYRO_LPF_92HZ;
   mpu9250_InitStruct.Gyro_Scale = MPU9250_GYRO_FULLSCALE_250DPS;
-  mpu9250_init(&mpu9250_InitStruct);
+
+  for(uint8_t i = 0; i < IMU_COUNT; i++)
+  {
+    pImu = mpu9250_getHandle(i);
+    mpu9250_InitStruct.Interface =
+        (i == 0) ? IMU_INTERFACE : MPU9250_INTERFACE_I2C;
+    mpu9250_InitStruct.Address = (i == 1) ? IMU_AUX_ADDRESS : 0;
+    mpu9250_InitStruct.I2Cx =
+        (i == 0) ? IMU_I2C : ((i == 1) ? IMU_AUX_I2C : IMU_AUX2_I2C);
+    mpu9250_init(pImu, &mpu9250_InitStruct);
+
+    /*!< Before calibration: the offset registers do not change the response */
+    if(mpu9250_selfTest(pImu, &mpu9250_SelfTest) != MPU9250_OK)
+      imuHealthy = 0;
+
+    mpu9250_calibrate(pImu, IMU_CALIB_SAMPLES, &mpu9250_Offsets);
+    mpu9250_initMag(pImu);
+    mpu9250_initFifo(pImu, IMU_FIFO_FREQ);
+    mpu9250_initInterrupt(pImu, IMU_FIFO_FREQ);
+  }
+
+  imuRedundant_init(IMU_COUNT);
+  gyroBias_init(IMU_COUNT);
+
+  /*!< Bypass: sections are set where the vibration is known */
+  prefilter_init((float32_t)IMU_FIFO_FREQ);
+
+  /*!< Peaks above the control band. AutoNotch 1: the notch follows the
+   *   strongest one in the first gyro section */
+  vibration_init_t vibration_InitStruct;
+  vibration_InitStruct.SampleRate = (float32_t)IMU_FIFO_FREQ;
+  vibration_InitStruct.MinFrequency = 20.0f;
+  vibration_InitStruct.Threshold = 0.5f;
+  vibration_InitStruct.AutoNotch = 0;
+  vibration_InitStruct.NotchSection = 0;
+  vibration_InitStruct.NotchQ = 3.0f;
+  vibration_init(&vibration_InitStruct);
 
   filter_init_t filter_InitStruct;
   filter_InitStruct.SampleRate = (uint16_t)SAMPLER_FREQ;
   filter_InitStruct.Weight = 0.90f;
-  estimator_init(&filter_InitStruct);
+  filter_InitStruct.Type = FILTER_COMPLEMENTARY;
+  filter_InitStruct.Kp = 1.0f;
+  filter_InitStruct.Ki = 0.05f;
+  filter_InitStruct.Beta = 0.1f;
+  filter_InitStruct.GyroNoise = 0.1f;
+  filter_InitStruct.BiasNoise = 0.01f;
+  filter_InitStruct.AccelNoise = 0.02f;
+  filter_InitStruct.Device = 0;
+  filter_InitStruct.Accuracy = FAST_MATH_FINE;
+  filter_InitStruct.Adaptive = 0;
+  filter_InitStruct.AccelLow = 0.02f;
+  filter_InitStruct.AccelHigh = 0.1f;
+  filter_InitStruct.RateLow = 100.0f;
+  filter_InitStruct.RateHigh = 400.0f;
+  filter_InitStruct.CorrectRate = 0.0f;
+  estimator_init(estimator_getHandle(0), &filter_InitStruct);
+#if PIPELINE_Q31
+  estimatorQ31_init(&filter_InitStruct);
+#endif
+
+  /*!< Degraded IMU: servos are not armed. Blue LED: the others are PWM */
+  if(imuHealthy == 0)
+  {
+    LL_GPIO_SetOutputPin(LED_BLUE.GPIO_Port, LED_BLUE.GPIO_Pin);
+    return;
+  }
 
   servo_initStruct_t servo_InitStruct;
   servo_InitStruct.Max_Angle = 90;
@@ -4,10 +4,61 @@
 // =============================================================================
 __IO uint8_t state = 0;
 __IO uint32_t cycles_count = 0;
+__IO uint32_t fifoOverflows = 0;
+__IO uint32_t pipelineCycles = 0;   /*!< Estimator + controller, last tick */
+
+/*!< Data-ready pacing: one control tick every IMU_FIFO_FREQ/SAMPLER_FREQ
+ *   sensor samples */
+__IO uint32_t drdyTimestamp = 0;    /*!< DWT->CYCCNT of the last data-ready */
+__IO uint32_t drdyMissed = 0;       /*!< Data-ready pulses never seen */
+__IO uint32_t drdyLate = 0;         /*!< Ticks with the previous drain on the bus */
+__IO uint32_t drdyStalled = 0;      /*!< Ticks with the drain queued, bus idle */
+__IO uint64_t drdyTime = 0;         /*!< Timestamp of the last data-ready [us] */
+__IO uint64_t sampleTimestamp = 0;  /*!< Capture time of the processed block [us] */
+static __IO uint32_t drdyCount = 0;
+
+/*!< Double buffer: FIFO blocks k are processed while blocks k+1 are
+ *   transferred. One block per IMU, all drained in the same tick */
+static mpu9250_fifoBlock_t fifoBlock[2][IMU_COUNT];
+static uint8_t blockOk[2][IMU_COUNT];
+static uint64_t blockTimestamp[2];  /*!< Data-ready of the newest frame [us] */
+static __IO uint8_t sampleIndex = 0;
+static __IO uint8_t sampleReady = 0;
+static __IO uint8_t samplePending = 0;  /*!< IMUs still on the bus */
+
+/*!< Wake-on-motion idle */
+__IO uint32_t wakeLatency = 0;      /*!< WOM pulse to first control tick [DWT cycles] */
+__IO float32_t dutyCycle = 100.0f;  /*!< Time at full rate control [%] */
+static __IO uint8_t idleMode = 0;
+static __IO uint8_t idleRequest = 0;
+static __IO uint8_t wakeRequest = 0;
+static __IO uint8_t wakeMeasure = 0;
+static __IO uint32_t wakeTimestamp = 0;
+static uint16_t stillTicks = 0;
+static uint32_t modeStart = 0;      /*!< Uptime of the last mode change */
+static uint32_t activeTime = 0;
+static uint32_t idleTime = 0;
+
+/*!< Vibration analyzer telemetry: free part of the control period */
+static __IO uint8_t telemetrySlot = 0;
+static __IO uint32_t tickCycles = 0;  /*!< DWT->CYCCNT at the last tick start */
 
 // =============================================================================
 static void initApp(void);
 static void updateData(void);
+static void startSample(void);
+static void sampleDone(mpu9250_handle_t *pDevice, mpu9250_status_t status);
+static void sampleFinish(uint8_t index, mpu9250_status_t status);
+#if PIPELINE_Q31
+static uint8_t isStillRaw(mpu9250_fifoBlock_t *pBlock);
+#else
+static uint8_t isStill(float32_t *pGyro, uint8_t count);
+#endif
+static void enterIdle(void);
+static void exitIdle(void);
+static void updateDutyCycle(uint8_t idle);
+static void publishVibration(void);
+static uint8_t sendVibrationLine(uint8_t *pTag, float32_t *pData, uint8_t len);
 
 // Main function ===============================================================
 int main(void)
@@ -19,7 +70,27 @@ int main(void)
   cncUSART_send2Bash(UART5, bash_ClearScreen, (uint8_t *)"\r");
 
   while (1)
-    __WFI();
+  {
+    if(idleRequest == 1)
+      enterIdle();
+    else if(wakeRequest == 1)
+      exitIdle();
+    else
+    {
+      /*!< Background work, preempted by the control tick at any point */
+      if(telemetrySlot == 1)
+        publishVibration();
+
+      vibration_process();
+    }
+
+    /*!< A request raised after the checks still wakes the core */
+    __disable_irq();
+    if((idleRequest == 0) && (wakeRequest == 0) && (telemetrySlot == 0)
+        && (vibration_isReady() == 0))
+      __WFI();
+    __enable_irq();
+  }
 
   updateData();
   return 0;
@@ -29,16 +100,69 @@ int main(void)
 static void initApp(void)
 {
   uint8_t helloMsg[35] = "\t\t\tSTM32F4 Discovery - Carlosnc\n\r";
+  uint32_t readCycles[2] = { 0 };
+  float32_t readTime[3] = { 0.0f };
+  uint32_t filterCycles[5] = { 0 };
+  float32_t filterLoad[5] = { 0.0f };
+  uint32_t mathCycles[5] = { 0 };
+  float32_t mathTime[5] = { 0.0f };
+
   cncUSART_send2Bash(UART5, bash_Cursor2Home, (uint8_t *)"\r");
   cncUSART_send2Bash(UART5, bash_LightBlue, helloMsg);
 
-  if(MPU9250_DEVICE_ID == mpu9250_readID())
+  if(MPU9250_DEVICE_ID == mpu9250_readID(mpu9250_getHandle(0)))
   {
     cncUSART_send2Bash(UART5, bash_LightGreen, (uint8_t *)"MPU9250 conectado\n\n\r");
-    cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"iPitch\toPitch\tiRoll\toRoll\n\r");
-    LL_TIM_EnableCounter(TIM7);
-    LL_TIM_GenerateEvent_UPDATE(TIM7);
-    LL_TIM_EnableIT_UPDATE(TIM7);
+
+    /*!< Sample read time [us]: register by register vs burst */
+    if(mpu9250_benchmarkRead(mpu9250_getHandle(0), &readCycles[0]) == MPU9250_OK)
+    {
+      for(uint8_t i = 0; i < 2; i++)
+        readTime[i] = (float32_t)readCycles[i]/(SystemCoreClock/1000000);
+
+      /*!< Boot to first sample [us] */
+      readTime[2] = (float32_t)mpu9250_getBootCycles(mpu9250_getHandle(0))
+          /(SystemCoreClock/1000000);
+
+      cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"tRegs[us]\ttBurst[us]\ttBoot[us]\n\r");
+      cncUSART_sendData_float(UART5, &readTime[0], 3, (UART_DATA_LOG | UART_DATA_FORMAT_TAB));
+    }
+
+    /*!< Quaternion backends: CPU load of one update per sample [%] */
+    if(estimator_benchmark(estimator_getHandle(0), &filterCycles[0]) == FILTER_OK)
+    {
+      for(uint8_t i = 0; i < 3; i++)
+        filterLoad[i] = 100.0f*(float32_t)filterCycles[i]*IMU_FIFO_FREQ/SystemCoreClock;
+
+      cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"Mahony[%]\tMadgwick[%]\tEKF[%]\n\r");
+      cncUSART_sendData_float(UART5, &filterLoad[0], 3, (UART_DATA_LOG | UART_DATA_FORMAT_TAB));
+
+      /*!< Complementary step [cycles]: estimator_t vs volatile globals */
+      for(uint8_t i = 3; i < 5; i++)
+        filterLoad[i] = (float32_t)filterCycles[i];
+
+      cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"Context[cyc]\tVolatile[cyc]\n\r");
+      cncUSART_sendData_float(UART5, &filterLoad[3], 2, (UART_DATA_LOG | UART_DATA_FORMAT_TAB));
+    }
+
+    /*!< Estimator math kernels [cycles per call] */
+    fastMath_benchmark(&mathCycles[0]);
+    for(uint8_t i = 0; i < 5; i++)
+      mathTime[i] = (float32_t)mathCycles[i];
+
+    cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"atan2f\tFine\tCoarse\tBlock\tInvNorm [cyc]\n\r");
+    cncUSART_sendData_float(UART5, &mathTime[0], 5, (UART_DATA_LOG | UART_DATA_FORMAT_TAB));
+
+    cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"PK\tAxis\tNotch[Hz]\tf[Hz]\tA[dps]...\n\r");
+#if VIBRATION_SPECTRUM
+    cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"SP\tAxis\tBin\tA[dps]...\n\r");
+#endif
+    cncUSART_send2Bash(UART5, bash_White, (uint8_t *)"t[us]\tiPitch\toPitch\tiRoll\toRoll\n\r");
+    drdyTimestamp = 0;
+    drdyCount = 0;
+    modeStart = initHardware_getUptime();
+    LL_EXTI_ClearFlag_0_31(LL_EXTI_LINE_1);
+    NVIC_EnableIRQ(EXTI1_IRQn);
 
   }
   else
@@ -47,16 +171,129 @@ static void initApp(void)
 
 static void updateData(void)
 {
-  DWT->CYCCNT = 0;
+  uint8_t k = 0;
+  uint8_t count = 0;
+  uint8_t still = 0;
+  uint32_t startCycles = 0;
+  uint32_t pipelineStart = 0;
   float32_t outputs[2] = { 0.0f };
   float32_t serialData[4] = { 0.0f };
+  uint8_t stalled = 0;
 
-  float32_t filteredAngles[2] = { 0.0f };
+  /*!< Held when a tick brings no new samples */
+  static float32_t filteredAngles[3] = { 0.0f };
+#if PIPELINE_Q31
+  static q31_t anglesQ31[3] = { 0 };
+  q31_t outputsQ31[2] = { 0 };
+  uint8_t unit = 0;
+#else
+  float32_t accelerometer[3*MPU9250_FIFO_BLOCK_SIZE] = { 0.0f };
+  float32_t gyroscope[3*MPU9250_FIFO_BLOCK_SIZE] = { 0.0f };
   float32_t *pFilteredAngles = &filteredAngles[0];
+#endif
+
+  /*!< Retry transactions left pending by a busy bus. A drain that waited
+   *   here was not chained on completion: not late sensor data */
+  stalled = cncI2CQueue_isStalled(IMU_I2C) | cncI2CQueue_isStalled(IMU_AUX_I2C);
+  cncI2CQueue_process(IMU_I2C);
+  if(IMU_AUX_I2C != IMU_I2C)
+    cncI2CQueue_process(IMU_AUX_I2C);
+
+  /*!< Previous drain not finished: skip this tick, never reuse data */
+  if(samplePending != 0)
+  {
+    if(stalled == 1)
+      drdyStalled++;
+    else
+      drdyLate++;
+    return;
+  }
+
+  /*!< No block yet (first tick or bus error): only start the transfer */
+  if(sampleReady != 1)
+  {
+    startSample();
+    return;
+  }
+
+  /*!< CYCCNT is free running: drivers use it for transfer deadlines */
+  startCycles = DWT->CYCCNT;
+  k = sampleIndex;
+  sampleIndex ^= 0x01;
+  sampleReady = 0;
+  startSample();
+
+  for(uint8_t i = 0; i < IMU_COUNT; i++)
+  {
+    if(fifoBlock[k][i].Overflow == 1)
+      fifoOverflows++;
+
+    /*!< Bias learnt from the raw block, then removed at each sample's
+     *   temperature */
+    if(blockOk[k][i] == 1)
+    {
+      gyroBias_update(i, &fifoBlock[k][i]);
+      gyroBias_correctBlock(i, &fifoBlock[k][i]);
+    }
+  }
+
+  sampleTimestamp = blockTimestamp[k];
+  pipelineStart = DWT->CYCCNT;
+
+#if PIPELINE_Q31
+  /*!< Raw samples of the first usable unit, no float conversion */
+  unit = imuRedundant_select(&fifoBlock[k][0], &blockOk[k][0]);
+  if(unit < IMU_COUNT)
+    count = fifoBlock[k][unit].Count;
+
+  if(count != 0)
+    estimatorQ31_updateBlock(&fifoBlock[k][unit], sampleTimestamp,
+                             &anglesQ31[0]);
+
+  outputsQ31[0] = controlador_planta_q31(anglesQ31[0], 0);
+  outputsQ31[1] = controlador_planta_q31(anglesQ31[1], 1);
+  pipelineCycles = DWT->CYCCNT - pipelineStart;
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    filteredAngles[i] = ESTIMATOR_Q31_TO_DEG(anglesQ31[i]);
+    outputs[i] = ESTIMATOR_Q31_TO_DEG(outputsQ31[i]);
+  }
+
+  if(count != 0)
+    still = isStillRaw(&fifoBlock[k][unit]);
+#else
+  /*!< Failed or faulty units are left out. No usable unit: angles held */
+  count = imuRedundant_fuse(&fifoBlock[k][0], &blockOk[k][0],
+                            &accelerometer[0], &gyroscope[0]);
+  /*!< Before the prefilter: a notch does not hide its own peak */
+  vibration_addBlock(&gyroscope[0], count);
+  prefilter_processBlock(&accelerometer[0], &gyroscope[0], count);
+  estimator_updateBlock(estimator_getHandle(0), &accelerometer[0],
+                        &gyroscope[0], count, sampleTimestamp,
+                        pFilteredAngles);
 
-  estimator_filteredAngles(pFilteredAngles);
   outputs[0] = controlador_planta(filteredAngles[0], 0);
   outputs[1] = controlador_planta(filteredAngles[1], 1);
+  pipelineCycles = DWT->CYCCNT - pipelineStart;
+
+  still = isStill(&gyroscope[0], count);
+#endif
+
+  if(wakeMeasure == 1)
+  {
+    wakeLatency = DWT->CYCCNT - wakeTimestamp;
+    wakeMeasure = 0;
+  }
+
+  /*!< Still long enough: idle until motion (from main loop) */
+  if(still == 1)
+  {
+    if(++stillTicks >= IDLE_TICKS)
+      idleRequest = 1;
+  }
+  else
+    stillTicks = 0;
 
   cncServo_updatePosition(outputs[0], SERVO_CHANNEL_1);
   cncServo_updatePosition(outputs[0], SERVO_CHANNEL_2);
@@ -68,11 +305,256 @@ static void updateData(void)
     serialData[2*i + 1] = outputs[i];
   }
 
+  cncUSART_sendTimestamp(UART5, sampleTimestamp, (UART_DATA_LOG | UART_DATA_FORMAT_TAB));
   cncUSART_sendData_float(UART5, &serialData[0], 4, (UART_DATA_LOG | UART_DATA_FORMAT_TAB));
-  cycles_count = DWT->CYCCNT;
+  cycles_count = DWT->CYCCNT - startCycles;
+  tickCycles = startCycles;
+  telemetrySlot = 1;
   __NOP();
 }
 
+/*!< Every IMU drain is queued back-to-back: one bus burst per tick. Each
+ *   completion starts the next transfer from the bus interrupt, which relies
+ *   on cncI2C_StartAsync() waiting for the previous STOP */
+static void startSample(void)
+{
+  samplePending = IMU_COUNT;
+  /*!< No data-ready seen yet: transfer start */
+  if(drdyTimestamp != 0)
+    blockTimestamp[sampleIndex] = drdyTime;
+  else
+    blockTimestamp[sampleIndex] = initHardware_getTimestamp();
+
+  for(uint8_t i = 0; i < IMU_COUNT; i++)
+  {
+    if(mpu9250_readFifo_async(mpu9250_getHandle(i), &fifoBlock[sampleIndex][i],
+                              &sampleDone) != MPU9250_OK)
+    {
+      /*!< Same counter as the bus interrupts */
+      __disable_irq();
+      sampleFinish(i, MPU9250_ERROR);
+      __enable_irq();
+    }
+  }
+}
+
+static void sampleDone(mpu9250_handle_t *pDevice, mpu9250_status_t status)
+{
+  for(uint8_t i = 0; i < IMU_COUNT; i++)
+  {
+    if(mpu9250_getHandle(i) == pDevice)
+      sampleFinish(i, status);
+  }
+}
+
+/*!< Blocks are ready when every IMU is done and at least one read succeeded */
+static void sampleFinish(uint8_t index, mpu9250_status_t status)
+{
+  uint8_t anyOk = 0;
+
+  blockOk[sampleIndex][index] = (status == MPU9250_OK) ? 1 : 0;
+
+  if(--samplePending != 0)
+    return;
+
+  for(uint8_t i = 0; i < IMU_COUNT; i++)
+    anyOk |= blockOk[sampleIndex][i];
+
+  if(anyOk == 1)
+    sampleReady = 1;
+}
+
+#if PIPELINE_Q31
+/*!< isStill() on raw samples: IDLE_GYRO_DPS in LSB */
+static uint8_t isStillRaw(mpu9250_fifoBlock_t *pBlock)
+{
+  const int16_t threshold =
+      (int16_t)(IDLE_GYRO_DPS*mpu9250_getHandle(0)->GyroResolution);
+
+  for(uint8_t i = 0; i < pBlock->Count; i++)
+  {
+    for(uint8_t j = 0; j < 3; j++)
+    {
+      if((pBlock->Samples[i].Gyro[j] > threshold)
+          || (pBlock->Samples[i].Gyro[j] < -threshold))
+        return 0;
+    }
+  }
+
+  return 1;
+}
+#else
+static uint8_t isStill(float32_t *pGyro, uint8_t count)
+{
+  if(count == 0)
+    return 0;
+
+  for(uint16_t i = 0; i < 3*count; i++)
+  {
+    if((pGyro[i] > IDLE_GYRO_DPS) || (pGyro[i] < -IDLE_GYRO_DPS))
+      return 0;
+  }
+
+  return 1;
+}
+#endif
+
+static void enterIdle(void)
+{
+  const uint32_t timeout = SystemCoreClock/100;
+  uint32_t startCycles = DWT->CYCCNT;
+
+  NVIC_DisableIRQ(EXTI1_IRQn);
+  idleRequest = 0;
+  stillTicks = 0;
+
+  /*!< Let the FIFO drain on the bus finish (10 ms max.) */
+  while((samplePending != 0) && ((DWT->CYCCNT - startCycles) < timeout))
+    ;
+
+  /*!< The first IMU drives the INT pin. The others only save power (and
+   *   stop filling their FIFO with samples that would be stale on wake) */
+  if((samplePending == 0)
+      && (mpu9250_enterWakeOnMotion(mpu9250_getHandle(0), IMU_WOM_THRESHOLD,
+                                    IMU_WOM_ODR) == MPU9250_OK))
+  {
+    for(uint8_t i = 1; i < IMU_COUNT; i++)
+      mpu9250_enterWakeOnMotion(mpu9250_getHandle(i), IMU_WOM_THRESHOLD,
+                                IMU_WOM_ODR);
+
+    updateDutyCycle(0);
+    idleMode = 1;
+  }
+
+  LL_EXTI_ClearFlag_0_31(LL_EXTI_LINE_1);
+  NVIC_ClearPendingIRQ(EXTI1_IRQn);
+  NVIC_EnableIRQ(EXTI1_IRQn);
+}
+
+static void exitIdle(void)
+{
+  NVIC_DisableIRQ(EXTI1_IRQn);
+  wakeRequest = 0;
+
+  /*!< Already awake units return at once: retries are safe */
+  for(uint8_t i = 1; i < IMU_COUNT; i++)
+    mpu9250_exitWakeOnMotion(mpu9250_getHandle(i));
+
+  /*!< Still idle on failure: the next motion pulse retries */
+  if(mpu9250_exitWakeOnMotion(mpu9250_getHandle(0)) == MPU9250_OK)
+  {
+    /*!< CYCCNT may have wrapped while asleep */
+    initHardware_syncTimestamp(initHardware_getUptime() - modeStart);
+    prefilter_reset();
+    vibration_reset();
+    updateDutyCycle(1);
+    idleMode = 0;
+    sampleReady = 0;
+    drdyTimestamp = 0;
+    drdyCount = 0;
+    wakeMeasure = 1;
+  }
+
+  LL_EXTI_ClearFlag_0_31(LL_EXTI_LINE_1);
+  NVIC_ClearPendingIRQ(EXTI1_IRQn);
+  NVIC_EnableIRQ(EXTI1_IRQn);
+}
+
+/*!< idle: 1 if the mode that ends now was the idle one */
+static void updateDutyCycle(uint8_t idle)
+{
+  uint32_t now = initHardware_getUptime();
+
+  if(idle == 1)
+    idleTime += now - modeStart;
+  else
+    activeTime += now - modeStart;
+
+  modeStart = now;
+
+  if((activeTime + idleTime) > 0)
+    dutyCycle = 100.0f*(float32_t)activeTime/(float32_t)(activeTime + idleTime);
+}
+
+/*!< At most one line per control period: "PK" axis, notch [Hz], frequency
+ *   [Hz] and amplitude [dps] of each peak, at every window. Then "SP" axis,
+ *   first bin, amplitudes [dps] of the held spectrum */
+static void publishVibration(void)
+{
+  static const float32_t *pSpectrum = 0;
+  static uint16_t spectrumBin = 0;
+  static uint8_t spectrumAxis = 0;
+  static uint32_t peaksWindow = 0;
+  const vibration_stats_t *pStats = vibration_getStats();
+  float32_t line[2 + 2*VIBRATION_MAX_PEAKS] = { 0.0f };
+  uint8_t count = 0;
+
+  telemetrySlot = 0;
+
+  if(pStats->Windows != peaksWindow)
+  {
+    line[0] = (float32_t)pStats->Axis;
+    line[1] = pStats->NotchFrequency;
+    for(uint8_t i = 0; i < VIBRATION_MAX_PEAKS; i++)
+    {
+      line[2 + 2*i] = pStats->Peaks[pStats->Axis][i].Frequency;
+      line[3 + 2*i] = pStats->Peaks[pStats->Axis][i].Amplitude;
+    }
+
+    if(sendVibrationLine((uint8_t *)"PK\t", &line[0], 2 + 2*VIBRATION_MAX_PEAKS) == 1)
+      peaksWindow = pStats->Windows;
+
+    return;
+  }
+
+#if VIBRATION_SPECTRUM
+  if(pSpectrum == 0)
+  {
+    pSpectrum = vibration_holdSpectrum(&spectrumAxis);
+    spectrumBin = 0;
+
+    if(pSpectrum == 0)
+      return;
+  }
+
+  count = 2*VIBRATION_MAX_PEAKS;
+  if((VIBRATION_BINS - spectrumBin) < count)
+    count = VIBRATION_BINS - spectrumBin;
+
+  line[0] = (float32_t)spectrumAxis;
+  line[1] = (float32_t)spectrumBin;
+  for(uint8_t i = 0; i < count; i++)
+    line[2 + i] = pSpectrum[spectrumBin + i];
+
+  if(sendVibrationLine((uint8_t *)"SP\t", &line[0], 2 + count) == 1)
+  {
+    spectrumBin += count;
+
+    if(spectrumBin >= VIBRATION_BINS)
+    {
+      vibration_releaseSpectrum();
+      pSpectrum = 0;
+    }
+  }
+#endif
+}
+
+/*!< The whole line ends before the next tick or it is not sent: the tick's
+ *   telemetry never lands inside it. Up to 8 bytes per value */
+static uint8_t sendVibrationLine(uint8_t *pTag, float32_t *pData, uint8_t len)
+{
+  const uint32_t period = SystemCoreClock/SAMPLER_FREQ;
+  uint32_t lineCycles = (5 + 8*len)*(SystemCoreClock/UART_BYTE_RATE);
+
+  if(((DWT->CYCCNT - tickCycles) + lineCycles) >= period)
+    return 0;
+
+  cncUSART_putString(UART5, pTag, 3);
+  cncUSART_sendData_float(UART5, pData, len, (UART_DATA_LOG | UART_DATA_FORMAT_TAB));
+
+  return 1;
+}
+
 // =============================================================================
 void EXTI0_IRQHandler(void)
 {
@@ -86,11 +568,40 @@ void EXTI0_IRQHandler(void)
   }
 }
 
-void TIM7_IRQHandler(void)
+/*!< MPU9250 data-ready */
+void EXTI1_IRQHandler(void)
 {
-  if(LL_TIM_IsActiveFlag_UPDATE(TIM7) == 1)
-    LL_TIM_ClearFlag_UPDATE(TIM7);
+  const uint32_t period = SystemCoreClock/IMU_FIFO_FREQ;
+  const uint32_t decimation = IMU_FIFO_FREQ/SAMPLER_FREQ;
+  uint32_t now = DWT->CYCCNT;
+  uint32_t missed = 0;
 
-  updateData();
+  LL_EXTI_ClearFlag_0_31(LL_EXTI_LINE_1);
+
+  /*!< Wake-on-motion pulse: back to full rate from main loop */
+  if(idleMode == 1)
+  {
+    wakeTimestamp = now;
+    wakeRequest = 1;
+    return;
+  }
+
+  /*!< More than 1.5 periods since the last pulse: count the lost ones and
+   *   keep the tick phase locked to the sensor samples */
+  if((drdyTimestamp != 0) && ((now - drdyTimestamp) > (period + period/2)))
+  {
+    missed = ((now - drdyTimestamp) + period/2)/period - 1;
+    drdyMissed += missed;
+  }
+
+  drdyTimestamp = now;
+  drdyTime = initHardware_getTimestamp();
+  drdyCount += (1 + missed);
+
+  if(drdyCount >= decimation)
+  {
+    drdyCount %= decimation;
+    updateData();
+  }
 }
 // EOF =========================================================================
@@ -197,7 +197,7 @@ static const uint8_t MPU9250_ACCEL_CONFIG2_ADDR = 0x1D;
  *              |  7 | 0 | 1 | 1 | 1 |      31.25       |
  *              |  8 | 1 | 0 | 0 | 0 |      62.50       |
  *              |  9 | 1 | 0 | 0 | 1 |      125         |
- *              | 10 | 1 | 0 | 1 | 0 |      200         |
+ *              | 10 | 1 | 0 | 1 | 0 |      250         |
  *              | 11 | 1 | 0 | 1 | 1 |      500         |
  *              -----------------------------------------
  *
@@ -350,13 +350,13 @@ static const uint8_t MPU9250_I2C_SLV1_ADDRESS_ADDR = 0x28;
 static const uint8_t MPU9250_I2C_SLV1_REG_ADDR = 0x29;
 static const uint8_t MPU9250_I2C_SLV1_CTRL_ADDR = 0x2A;
 
-static const uint8_t MPU9250_I2C_SLV2_ADDRESS_ADDR = 0x28;
-static const uint8_t MPU9250_I2C_SLV2_REG_ADDR = 0x29;
-static const uint8_t MPU9250_I2C_SLV2_CTRL_ADDR = 0x2A;
+static const uint8_t MPU9250_I2C_SLV2_ADDRESS_ADDR = 0x2B;
+static const uint8_t MPU9250_I2C_SLV2_REG_ADDR = 0x2C;
+static const uint8_t MPU9250_I2C_SLV2_CTRL_ADDR = 0x2D;
 
-static const uint8_t MPU9250_I2C_SLV3_ADDRESS_ADDR = 0x28;
-static const uint8_t MPU9250_I2C_SLV3_REG_ADDR = 0x29;
-static const uint8_t MPU9250_I2C_SLV3_CTRL_ADDR = 0x2A;
+static const uint8_t MPU9250_I2C_SLV3_ADDRESS_ADDR = 0x2E;
+static const uint8_t MPU9250_I2C_SLV3_REG_ADDR = 0x2F;
+static const uint8_t MPU9250_I2C_SLV3_CTRL_ADDR = 0x30;
 
 /*******************************************************************************
  * I2C Slave 4 Address - RW - Reset Value 0x00
@@ -776,169 +776,709 @@ static const uint8_t MPU9250_ZA_OFFSET_L_ADDR = 0x7E;
  *                            END REGISTER MAPPING
  *============================================================================*/
 
+/*==============================================================================
+ *              AK8963 REGISTER MAPPING (MPU9250 auxiliary I2C bus)
+ *============================================================================*/
+static const uint8_t AK8963_ADDR = 0x0C;
+
+/*******************************************************************************
+ * Device ID - Read Only - Value 0x48
+ ******************************************************************************/
+static const uint8_t AK8963_WIA_ADDR = 0x00;
+
+/*******************************************************************************
+ * Status 1 - Read Only
+ * [1] - DOR: Data overrun, a sample was skipped.
+ * [0] - DRDY: Data ready.
+ ******************************************************************************/
+static const uint8_t AK8963_ST1_ADDR = 0x02;
+
+/*******************************************************************************
+ * Measurement Data - Read Only - Two's complement, little endian
+ * HXL, HXH, HYL, HYH, HZL, HZH
+ ******************************************************************************/
+static const uint8_t AK8963_HXL_ADDR = 0x03;
+
+/*******************************************************************************
+ * Status 2 - Read Only
+ * [4] - BITM: Output bit setting (mirror of CNTL1 BIT).
+ * [3] - HOFL: Magnetic sensor overflow, data is not valid.
+ * Note: ST2 must be read after the measurement data to release the next one.
+ ******************************************************************************/
+static const uint8_t AK8963_ST2_ADDR = 0x09;
+
+/*******************************************************************************
+ * Control 1 - RW - Reset Value 0x00
+ * [4] - BIT: 0 - 14 bits output (0.6 uT/LSB).
+ *            1 - 16 bits output (0.15 uT/LSB).
+ * [3:0] - MODE: 0x0 Power down, 0x1 Single measurement, 0x2 Continuous 8 Hz,
+ *               0x6 Continuous 100 Hz, 0x4 External trigger, 0x8 Self-test,
+ *               0xF Fuse ROM access.
+ * Note: Go through power down (100 us) between any two modes.
+ ******************************************************************************/
+static const uint8_t AK8963_CNTL1_ADDR = 0x0A;
+
+/*******************************************************************************
+ * Control 2 - RW - Reset Value 0x00
+ * [0] - SRST: Soft reset.
+ ******************************************************************************/
+static const uint8_t AK8963_CNTL2_ADDR = 0x0B;
+
+/*******************************************************************************
+ * Sensitivity Adjustment Values - Fuse ROM - Read in Fuse ROM access mode
+ * H_adj = H * [((ASA - 128) / 256) + 1]
+ ******************************************************************************/
+static const uint8_t AK8963_ASAX_ADDR = 0x10;
+
+// Constants ===================================================================
+static const uint32_t MPU9250_READ_TIMEOUT_US = 1000;
+static const uint32_t MPU9250_BYTE_TIMEOUT_US = 25;   /*!< 9 bits at 400kHz */
+static const uint8_t MPU9250_RAW_DATA_LEN = 14; /*!< ACCEL_XOUT_H..GYRO_ZOUT_L */
+
+static const uint8_t MPU9250_CONFIG_FIFO_MODE_MSK = 0x40;
+static const uint8_t MPU9250_USER_FIFO_EN_MSK = 0x40;
+static const uint8_t MPU9250_USER_FIFO_RST_MSK = 0x04;
+/*!< TEMP, GYRO_X/Y/Z, ACCEL: frame = ACCEL, TEMP, GYRO (as rawData_t) */
+static const uint8_t MPU9250_FIFO_SENSORS = 0xF8;
+static const uint16_t MPU9250_FIFO_SIZE = 512;
+static const uint8_t MPU9250_USER_I2C_IF_DIS_MSK = 0x10;
+
+/*!< Auxiliary I2C master (AK8963) */
+static const uint8_t MPU9250_USER_I2C_MST_EN_MSK = 0x20;
+static const uint8_t MPU9250_I2C_MST_CLK_400KHZ = 0x0D;
+static const uint8_t MPU9250_I2C_SLV_EN_MSK = 0x80;
+static const uint8_t MPU9250_I2C_SLV_READ_MSK = 0x80;
+static const uint8_t MPU9250_I2C_SLV4_DONE_MSK = 0x40;
+static const uint8_t MPU9250_I2C_SLV4_NACK_MSK = 0x10;
+static const uint32_t MPU9250_MAG_TIMEOUT_US = 5000;
+static const uint8_t MPU9250_MAG_DATA_LEN = 7;      /*!< HXL..ST2 */
+/*!< ACCEL_XOUT_H..GYRO_ZOUT_L + EXT_SENS_DATA_00..06 */
+static const uint8_t MPU9250_RAW_DATA9_LEN = 21;
+
+static const uint8_t AK8963_CNTL1_POWER_DOWN = 0x00;
+static const uint8_t AK8963_CNTL1_FUSE_ROM = 0x0F;
+static const uint8_t AK8963_CNTL1_16BIT_100HZ = 0x16;
+static const uint8_t AK8963_CNTL2_SRST = 0x01;
+static const uint8_t AK8963_ST2_HOFL_MSK = 0x08;
+static const float32_t AK8963_RESOLUTION = 0.15f;   /*!< uT/LSB, 16 bits */
+
+/*!< Offset registers: gyro 32.8 LSB/dps (OFFS_USR*4 at FS_SEL = 0), accel
+ *   0.98 mg/bit in [15:1] (2048 LSB/g 16 bit word), bit 0 reserved */
+static const uint8_t MPU9250_XA_OFFSET_ADDR[3] = { 0x77, 0x7A, 0x7D };
+static const int32_t MPU9250_ACCEL_OFFSET_LSB_G = 2048;
+static const int16_t MPU9250_ACCEL_OFFSET_TEMP_MSK = 0x0001;
+static const uint32_t MPU9250_CALIB_PERIOD_US = 1000;  /*!< 1kHz internal rate */
+
+/*!< Self-test (MPU-9250 self-test application note): 250 dps / 2 g, 92 Hz /
+ *   99 Hz LPF, 200 samples per average, 20 ms to settle after a change */
+static const uint16_t MPU9250_SELFTEST_SAMPLES = 200;
+static const uint32_t MPU9250_SELFTEST_SETTLE_US = 20000;
+static const uint32_t MPU9250_SELFTEST_TIMEOUT_US = 1000000;
+static const uint8_t MPU9250_SELFTEST_ENABLE_MSK = 0xE0;   /*!< X/Y/Z_ST_EN */
+static const float32_t MPU9250_SELFTEST_OTP_BASE = 2620.0f; /*!< At 250dps/2g */
+static const float32_t MPU9250_SELFTEST_GYRO_MIN_RATIO = 0.5f;
+static const float32_t MPU9250_SELFTEST_ACCEL_MIN_RATIO = 0.5f;
+static const float32_t MPU9250_SELFTEST_ACCEL_MAX_RATIO = 1.5f;
+/*!< Limits without factory trim: gyro 60 dps, accel 225..675 mg */
+static const int32_t MPU9250_SELFTEST_GYRO_MIN_LSB = 7860;
+static const int32_t MPU9250_SELFTEST_ACCEL_MIN_LSB = 3686;
+static const int32_t MPU9250_SELFTEST_ACCEL_MAX_LSB = 11059;
+static const int32_t MPU9250_SELFTEST_GYRO_OFFSET_LSB = 2620;  /*!< 20 dps */
+
+/*!< Wake-on-motion: gyro off, accel duty cycled at LP_ACCEL_ODR, WOM pulse
+ *   on INT when any axis changes more than WOM_THR (4 mg/LSB) */
+static const uint8_t MPU9250_WOM_ADDR[MPU9250_WOM_SIZE] =
+    { 0x1D, 0x1E, 0x1F, 0x38, 0x69, 0x6B, 0x6C };
+static const uint8_t MPU9250_WOM_ACCEL_DLPF = 0x01;     /*!< 218 Hz */
+static const uint8_t MPU9250_INT_WOM_MSK = 0x40;
+static const uint8_t MPU9250_ACCEL_INTEL_WOM = 0xC0;    /*!< EN, compare mode */
+static const uint8_t MPU9250_PWR_CYCLE_MSK = 0x20;
+static const uint8_t MPU9250_PWR2_GYRO_DISABLE = 0x07;
+static const uint16_t MPU9250_WOM_LSB_MG = 4;
+static const uint32_t MPU9250_GYRO_STARTUP_US = 35000;
+
+/*!< Writable configuration registers kept in RAM (ascending addresses).
+ *   Self-clearing command bits are never stored. */
+static const uint8_t MPU9250_SHADOW_ADDR[MPU9250_SHADOW_SIZE] = {
+    0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,   /*!< SMPLRT_DIV..WOM_THR */
+    0x23, 0x24,                                 /*!< FIFO_EN, I2C_MST_CTRL */
+    0x37, 0x38,                                 /*!< INT_PIN_CFG, INT_ENABLE */
+    0x69, 0x6A, 0x6B, 0x6C };                   /*!< ACCEL_INTEL..PWR_MGMT2 */
+static const uint8_t MPU9250_USER_RST_MSK = 0x07;   /*!< FIFO/MST/SIG_RST */
+static const uint8_t MPU9250_PWR_RESET_MSK = 0x80;
+static const uint8_t MPU9250_CONFIG_DLPF_MSK = 0x07;
+static const uint8_t MPU9250_GYRO_FS_MSK = 0x18;
+static const uint8_t MPU9250_GYRO_FCHOICE_B_MSK = 0x03;
+static const uint8_t MPU9250_GYRO_FCHOICE_B_BYPASS = 0x01;  /*!< 8800 Hz BW */
+static const uint8_t MPU9250_ACCEL_FS_MSK = 0x18;
+static const uint8_t MPU9250_ACCEL_DLPF_MSK = 0x0F;     /*!< fchoice_b + DLPF */
+static const uint8_t MPU9250_ACCEL_FCHOICE_B_MSK = 0x08;    /*!< 1046 Hz BW */
+static const uint8_t MPU9250_PWR_CLK_AUTO = 0x01;
+
+/*!< Readiness polling. Gyro start-up is 35 ms, plus the LPF delay. */
+static const uint32_t MPU9250_RESET_TIMEOUT_US = 100000;
+static const uint32_t MPU9250_BOOT_TIMEOUT_US = 150000;
+static const uint32_t AK8963_MODE_DELAY_US = 100;   /*!< After power down */
+
+/*!< LSB/dps and LSB/g by FS_SEL */
+static const float32_t MPU9250_GYRO_RESOLUTION[4] =
+    { 131.0f, 65.5f, 32.8f, 16.4f };
+static const uint16_t MPU9250_ACCEL_RESOLUTION[4] =
+    { 16384, 8192, 4096, 2048 };
+
+/*!< Buses. I2C: default when mpu9250_InitStruct_t.I2Cx is 0. SPI: 1 MHz
+ *   max. for every register, 20 MHz max. for sensor, interrupt and FIFO
+ *   registers (APB2 = 84 MHz) */
+#define MPU9250_I2C                 I2C1
+#define MPU9250_SPI                 SPI1
+static const spi_prescaler_t MPU9250_SPI_PRESCALER_CONFIG = SPI_PRESCALER_128;
+static const spi_prescaler_t MPU9250_SPI_PRESCALER_DATA = SPI_PRESCALER_8;
+
+// Structures ==================================================================
+/*!< Register access backend, selected by mpu9250_InitStruct_t.Interface */
+struct mpu9250_transport_s
+{
+    mpu9250_status_t (*probe)(mpu9250_handle_t *pDevice);
+    mpu9250_status_t (*write)(mpu9250_handle_t *pDevice,
+        const uint8_t regAddr, uint8_t *pData, uint8_t count);
+    mpu9250_status_t (*read)(mpu9250_handle_t *pDevice,
+        const uint8_t regAddr, uint8_t *pData, uint8_t count);
+    mpu9250_status_t (*submit)(mpu9250_handle_t *pDevice,
+        const uint8_t regAddr, uint8_t *pData, uint8_t count,
+        i2c_direction_t direction, mpu9250_busCallback_t done);
+};
+
 // Global Variables ============================================================
-static volatile uint8_t mpuAddr = 0x00;
-static volatile float32_t gResolution = 0.0f;
-static volatile uint16_t aResolution = 0;
+static mpu9250_handle_t mpu9250_devices[MPU9250_MAX_DEVICES];
+
+/*!< SPI1 has a single chip select: owned by the first device that answers */
+static mpu9250_handle_t *pSpiDevice = 0;
 
 // Private functions ===========================================================
-static mpu9250_status_t mpu9250_isReady(void);
-static mpu9250_status_t mpu9250_getStatus(void);
-static mpu9250_status_t mpu9250_writeReg(const uint8_t regAddr, uint8_t data);
-static mpu9250_status_t mpu9250_readReg(const uint8_t regAddr, uint8_t *pData);
-static mpu9250_status_t mpu9250_readBytes(
+static mpu9250_status_t mpu9250_isReady(mpu9250_handle_t *pDevice);
+static mpu9250_status_t mpu9250_getStatus(mpu9250_handle_t *pDevice);
+static mpu9250_status_t mpu9250_writeReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t data);
+static mpu9250_status_t mpu9250_readReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData);
+static mpu9250_status_t mpu9250_readBytes(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static mpu9250_status_t mpu9250_readRegs(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static mpu9250_status_t mpu9250_writeBytes(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static int16_t mpu9250_saturate(int32_t value);
+static int8_t mpu9250_shadowIndex(const uint8_t regAddr);
+static void mpu9250_shadowStore(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static mpu9250_status_t mpu9250_shadowLoad(mpu9250_handle_t *pDevice);
+static mpu9250_status_t mpu9250_shadowSet(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t data);
+static uint8_t mpu9250_shadowGet(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr);
+static void mpu9250_updateResolution(mpu9250_handle_t *pDevice);
+static void mpu9250_delayUs(uint32_t delay);
+static uint16_t mpu9250_sampleSum(mpu9250_handle_t *pDevice,
+    uint16_t samples, int32_t *pAccelSum, int32_t *pGyroSum);
+static mpu9250_status_t mpu9250_selfTestAverage(mpu9250_handle_t *pDevice,
+    int16_t *pAccel, int16_t *pGyro);
+static float32_t mpu9250_selfTestOtp(uint8_t code);
+static void mpu9250_parseRawData(uint8_t *pRawBytes, mpu9250_rawData_t *pRawData);
+static mpu9250_status_t mpu9250_magWait(mpu9250_handle_t *pDevice);
+static mpu9250_status_t mpu9250_magWriteReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t data);
+static mpu9250_status_t mpu9250_magReadReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData);
+static void mpu9250_readDone(mpu9250_handle_t *pDevice, uint8_t busStatus);
+static mpu9250_status_t mpu9250_submitRead(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count,
+    mpu9250_busCallback_t done);
+static uint8_t mpu9250_fifoFrames(uint8_t *pCount, uint8_t *pOverflow);
+static void mpu9250_parseFifo(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock);
+static void mpu9250_fifoCountDone(mpu9250_handle_t *pDevice, uint8_t busStatus);
+static void mpu9250_fifoDataDone(mpu9250_handle_t *pDevice, uint8_t busStatus);
+
+static mpu9250_status_t mpu9250_i2cProbe(mpu9250_handle_t *pDevice);
+static mpu9250_status_t mpu9250_i2cWrite(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static mpu9250_status_t mpu9250_i2cRead(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static mpu9250_status_t mpu9250_i2cSubmit(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count,
+    i2c_direction_t direction, mpu9250_busCallback_t done);
+static void mpu9250_i2cDone(void *pContext, uint8_t i2cStatus);
+static void mpu9250_asyncDone(mpu9250_handle_t *pDevice,
+    mpu9250_status_t status);
+
+static spi_prescaler_t mpu9250_spiPrescaler(const uint8_t regAddr);
+static mpu9250_status_t mpu9250_spiProbe(mpu9250_handle_t *pDevice);
+static mpu9250_status_t mpu9250_spiWrite(mpu9250_handle_t *pDevice,
     const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static mpu9250_status_t mpu9250_spiRead(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count);
+static mpu9250_status_t mpu9250_spiSubmit(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count,
+    i2c_direction_t direction, mpu9250_busCallback_t done);
+static void mpu9250_spiDone(void *pContext, uint8_t spiStatus);
+
+// Transports ==================================================================
+static const mpu9250_transport_t mpu9250_i2cTransport = { &mpu9250_i2cProbe,
+    &mpu9250_i2cWrite, &mpu9250_i2cRead, &mpu9250_i2cSubmit };
+static const mpu9250_transport_t mpu9250_spiTransport = { &mpu9250_spiProbe,
+    &mpu9250_spiWrite, &mpu9250_spiRead, &mpu9250_spiSubmit };
 
 // Public Functions ============================================================
+/*******************************************************************************
+ * Device contexts are owned by the driver, one per MPU9250 on the board.
+ ******************************************************************************/
+mpu9250_handle_t *mpu9250_getHandle(uint8_t index)
+{
+  if(index >= MPU9250_MAX_DEVICES)
+    return 0;
+
+  return &mpu9250_devices[index];
+}
+
 /*******************************************************************************
  * Configure and init MPU9250 IMU (Accelerometer and Gyroscope)
- * ToDo:
- *      implement SPI protocol.
+ * Interface selects the bus: I2Cx (400 kHz, transaction queue of that bus)
+ * or SPI1 (config registers at 656 kHz, data registers at 10.5 MHz, DMA).
+ * The bus must be initialized first.
  ******************************************************************************/
-mpu9250_status_t mpu9250_init(mpu9250_InitStruct_t* mpu9250_Init)
+mpu9250_status_t mpu9250_init(mpu9250_handle_t *pDevice,
+    mpu9250_InitStruct_t* mpu9250_Init)
 {
   mpu9250_status_t status = MPU9250_ERROR;
-  uint8_t tmpData = 0x00;
+  uint32_t startCycles = DWT->CYCCNT;
+  uint32_t timeoutCycles = MPU9250_BOOT_TIMEOUT_US*(SystemCoreClock/1000000);
+
+  pDevice->Ready = 0;
+  pDevice->Interface = mpu9250_Init->Interface;
+  pDevice->I2Cx = (mpu9250_Init->I2Cx != 0) ? mpu9250_Init->I2Cx : MPU9250_I2C;
+  pDevice->Address = mpu9250_Init->Address;
+  pDevice->BootCycles = 0;
+  pDevice->AsyncPending = 0;
+  pDevice->ReadCycles = 0;
+  pDevice->MaxReadCycles = 0;
+  pDevice->ReadErrors = 0;
+  pDevice->MagReady = 0;
+  pDevice->WomActive = 0;
+
+  for(uint8_t i = 0; i < 3; i++)
+    pDevice->MagResolution[i] = AK8963_RESOLUTION;
+
+  switch(mpu9250_Init->Interface)
+  {
+    case MPU9250_INTERFACE_I2C:
+      pDevice->pTransport = &mpu9250_i2cTransport;
+      break;
+    case MPU9250_INTERFACE_SPI:
+      pDevice->pTransport = &mpu9250_spiTransport;
+      break;
+    default:
+      return status;
+  }
+
+  if(mpu9250_isReady(pDevice) != MPU9250_OK)
+    return status;
 
-  if(mpu9250_isReady() != MPU9250_OK)
+  if(mpu9250_reset(pDevice) != MPU9250_OK)
     return status;
 
-  mpu9250_reset();
-  LL_mDelay(1000);
+  /*!< SPI only: keep the I2C slave from decoding SPI traffic */
+  if(mpu9250_Init->Interface == MPU9250_INTERFACE_SPI)
+    mpu9250_shadowSet(pDevice, MPU9250_USER_CTRL_ADDR,
+                      MPU9250_USER_I2C_IF_DIS_MSK);
+
+  mpu9250_shadowSet(pDevice, MPU9250_PWR_MGMT1_ADDR, MPU9250_PWR_CLK_AUTO);
 
-  if(mpu9250_writeReg(MPU9250_PWR_MGMT1_ADDR, 0x01) != MPU9250_OK)
+  if(mpu9250_setGyroScale(pDevice, mpu9250_Init->Gyro_Scale) != MPU9250_OK)
     return status;
 
-  tmpData = mpu9250_Init->Gyro_LPF;
-  if(mpu9250_writeReg(MPU9250_CONFIG_ADDR, tmpData) != MPU9250_OK)
+  if(mpu9250_setGyroLPF(pDevice, mpu9250_Init->Gyro_LPF) != MPU9250_OK)
     return status;
 
-  if(mpu9250_readReg(MPU9250_GYRO_CONFIG_ADDR, &tmpData) != MPU9250_OK)
+  if(mpu9250_setAccelScale(pDevice, mpu9250_Init->Accel_Scale) != MPU9250_OK)
     return status;
 
-  tmpData &= ~0x03;
-  tmpData &= ~0x18;
-  tmpData |= (mpu9250_Init->Gyro_Scale << 3);
-  if(mpu9250_writeReg(MPU9250_GYRO_CONFIG_ADDR, tmpData) != MPU9250_OK)
+  if(mpu9250_setAccelLPF(pDevice, mpu9250_Init->Accel_LPF) != MPU9250_OK)
     return status;
 
-  if(mpu9250_readReg(MPU9250_ACCEL_CONFIG_ADDR, &tmpData) != MPU9250_OK)
+  /*!< Data ready status, the INT pin is set up by mpu9250_initInterrupt() */
+  mpu9250_shadowSet(pDevice, MPU9250_INT_ENABLE_ADDR,
+                    MPU9250_INT_DATA_READY_MSK);
+
+  if(mpu9250_flush(pDevice) != MPU9250_OK)
     return status;
 
-  tmpData &= ~0x18;
-  tmpData = (mpu9250_Init->Accel_Scale << 3);
-  if(mpu9250_writeReg(MPU9250_ACCEL_CONFIG_ADDR, tmpData) != MPU9250_OK)
+  while(mpu9250_getStatus(pDevice) != MPU9250_OK)
+  {
+    if((DWT->CYCCNT - startCycles) >= timeoutCycles)
+      return status;
+  }
+
+  pDevice->BootCycles = DWT->CYCCNT - startCycles;
+  pDevice->Ready = 1;
+
+  status = MPU9250_OK;
+  return status;
+}
+/*******************************************************************************
+ * Data-ready pulse (50us, active high, push-pull) on INT pin at sampleRate
+ * [Hz]. Internal sample rate must be 1kHz (Gyro_LPF 5..184 Hz).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_initInterrupt(mpu9250_handle_t *pDevice,
+    uint16_t sampleRate)
+{
+  uint8_t sampleRate_Div = 0;
+
+  if((sampleRate == 0) || (sampleRate > 1000))
+    return MPU9250_ERROR;
+
+  sampleRate_Div = (uint8_t) ((1000 / sampleRate) - 1);
+
+  mpu9250_shadowSet(pDevice, MPU9250_SAMPLE_RATE_DIV_ADDR, sampleRate_Div);
+  mpu9250_shadowSet(pDevice, MPU9250_INT_PIN_CONFIG_ADDR, 0x00);
+  mpu9250_shadowSet(pDevice, MPU9250_INT_ENABLE_ADDR,
+                    MPU9250_INT_DATA_READY_MSK);
+
+  return mpu9250_flush(pDevice);
+}
+/*******************************************************************************
+ * AK8963 magnetometer through the auxiliary I2C master (400 kHz): 16 bits,
+ * continuous 100 Hz. I2C slave 0 copies HXL..ST2 into EXT_SENS_DATA_00..06
+ * every sample, right after GYRO_ZOUT_L. Reads the sensitivity adjustment
+ * (ASA) values from fuse ROM.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_initMag(mpu9250_handle_t *pDevice)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+  uint8_t tmpData = 0x00;
+  uint8_t asa[3] = { 0 };
+  uint8_t slv0[3] = { (AK8963_ADDR | MPU9250_I2C_SLV_READ_MSK), AK8963_HXL_ADDR,
+                      (MPU9250_I2C_SLV_EN_MSK | MPU9250_MAG_DATA_LEN) };
+  uint32_t startCycles = 0;
+  uint32_t timeoutCycles = MPU9250_MAG_TIMEOUT_US*(SystemCoreClock/1000000);
+
+  pDevice->MagReady = 0;
+
+  mpu9250_shadowSet(pDevice, MPU9250_USER_CTRL_ADDR,
+      mpu9250_shadowGet(pDevice, MPU9250_USER_CTRL_ADDR)
+          | MPU9250_USER_I2C_MST_EN_MSK);
+  mpu9250_shadowSet(pDevice, MPU9250_I2C_MST_CTRL_ADDR,
+                    MPU9250_I2C_MST_CLK_400KHZ);
+
+  if(mpu9250_flush(pDevice) != MPU9250_OK)
     return status;
 
-  if(mpu9250_readReg(MPU9250_ACCEL_CONFIG2_ADDR, &tmpData) != MPU9250_OK)
+  if(mpu9250_magWriteReg(pDevice, AK8963_CNTL2_ADDR,
+                         AK8963_CNTL2_SRST) != MPU9250_OK)
     return status;
 
-  tmpData &= ~0x0F;
-  tmpData |= mpu9250_Init->Accel_LPF;
-  if(mpu9250_writeReg(MPU9250_ACCEL_CONFIG2_ADDR, tmpData) != MPU9250_OK)
+  /*!< Back from soft reset when the device id reads back */
+  startCycles = DWT->CYCCNT;
+  while((mpu9250_magReadReg(pDevice, AK8963_WIA_ADDR, &tmpData) != MPU9250_OK)
+      || (tmpData != AK8963_DEVICE_ID))
+  {
+    if((DWT->CYCCNT - startCycles) >= timeoutCycles)
+      return status;
+  }
+
+  if(mpu9250_magWriteReg(pDevice, AK8963_CNTL1_ADDR,
+                         AK8963_CNTL1_FUSE_ROM) != MPU9250_OK)
     return status;
 
-  switch(mpu9250_Init->Gyro_Scale)
+  mpu9250_delayUs(AK8963_MODE_DELAY_US);
+
+  for(uint8_t i = 0; i < 3; i++)
   {
-    case MPU9250_GYRO_FULLSCALE_250DPS:
-      gResolution = 131.0f;
-      break;
-    case MPU9250_GYRO_FULLSCALE_500DPS:
-      gResolution = 65.5f;
-      break;
-    case MPU9250_GYRO_FULLSCALE_1000DPS:
-      gResolution = 32.8f;
-      break;
-    case MPU9250_GYRO_FULLSCALE_2000DPS:
-      gResolution = 16.4f;
-      break;
-    default:
-      gResolution = 131.0f;
-      break;
+    if(mpu9250_magReadReg(pDevice, AK8963_ASAX_ADDR + i, &asa[i]) != MPU9250_OK)
+      return status;
   }
 
-  switch(mpu9250_Init->Accel_Scale)
+  if(mpu9250_magWriteReg(pDevice, AK8963_CNTL1_ADDR,
+                         AK8963_CNTL1_POWER_DOWN) != MPU9250_OK)
+    return status;
+
+  mpu9250_delayUs(AK8963_MODE_DELAY_US);
+
+  if(mpu9250_magWriteReg(pDevice, AK8963_CNTL1_ADDR,
+                         AK8963_CNTL1_16BIT_100HZ) != MPU9250_OK)
+    return status;
+
+  for(uint8_t i = 0; i < 3; i++)
+    pDevice->MagResolution[i] =
+        ((((float32_t) asa[i] - 128.0f) / 256.0f) + 1.0f) * AK8963_RESOLUTION;
+
+  /*!< I2C_SLV0_ADDR, I2C_SLV0_REG, I2C_SLV0_CTRL */
+  if(mpu9250_writeBytes(pDevice, MPU9250_I2C_SLV0_ADDRESS_ADR,
+                        &slv0[0], 3) != MPU9250_OK)
+    return status;
+
+  pDevice->MagReady = 1;
+
+  status = MPU9250_OK;
+  return status;
+}
+/*******************************************************************************
+ * Reset device. Polls PWR_MGMT1 (H_RESET cleared) and WHO_AM_I until the
+ * device is back, then reloads the register shadow.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_reset(mpu9250_handle_t *pDevice)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+  uint8_t pwrMgmt = MPU9250_PWR_RESET_MSK;
+  uint8_t deviceId = 0x00;
+  uint32_t startCycles = 0;
+  uint32_t timeoutCycles = MPU9250_RESET_TIMEOUT_US*(SystemCoreClock/1000000);
+
+  /*!< The device may not acknowledge the write that resets it */
+  mpu9250_writeReg(pDevice, MPU9250_PWR_MGMT1_ADDR, MPU9250_CMD_RESET);
+
+  startCycles = DWT->CYCCNT;
+  while(((pwrMgmt & MPU9250_PWR_RESET_MSK) != 0)
+      || (deviceId != MPU9250_DEVICE_ID))
   {
-    case MPU9250_ACCEL_FULLSCALE_2G:
-      aResolution = 16384;
-      break;
-    case MPU9250_ACCEL_FULLSCALE_4G:
-      aResolution = 8192;
-      break;
-    case MPU9250_ACCEL_FULLSCALE_8G:
-      aResolution = 4096;
-      break;
-    case MPU9250_ACCEL_FULLSCALE_16G:
-      aResolution = 2048;
-      break;
-    default:
-      aResolution = 16384;
-      break;
+    if((DWT->CYCCNT - startCycles) >= timeoutCycles)
+      return status;
+
+    if(mpu9250_readReg(pDevice, MPU9250_PWR_MGMT1_ADDR, &pwrMgmt) != MPU9250_OK)
+    {
+      pwrMgmt = MPU9250_PWR_RESET_MSK;
+      continue;
+    }
+
+    if(mpu9250_readReg(pDevice, MPU9250_WHO_AM_I_ADDR, &deviceId) != MPU9250_OK)
+      deviceId = 0x00;
   }
 
+  /*!< Registers are back to their reset values */
+  if(mpu9250_shadowLoad(pDevice) != MPU9250_OK)
+    return status;
+
+  mpu9250_updateResolution(pDevice);
+
   status = MPU9250_OK;
   return status;
 }
 
 /*******************************************************************************
- * init interrupt pin only if internal sample rate == 1kHz
+ * Write the staged configuration registers. Dirty registers with contiguous
+ * addresses go in one burst (clean ones in between are written back
+ * unchanged).
  ******************************************************************************/
-mpu9250_status_t mpu9250_initInterrupt(uint16_t sampleRate)
+mpu9250_status_t mpu9250_flush(mpu9250_handle_t *pDevice)
 {
   mpu9250_status_t status = MPU9250_OK;
+  uint8_t first = 0;
+  uint8_t last = 0;
 
-  uint8_t tmpData[2] = { 0 };
-  uint8_t *ptmpData = &tmpData[0];
+  while(first < MPU9250_SHADOW_SIZE)
+  {
+    if((pDevice->ShadowDirty & (1u << first)) == 0)
+    {
+      first++;
+      continue;
+    }
 
-  uint8_t sampleRate_Div = 0;
+    /*!< Extend the burst up to the last dirty register of the block */
+    last = first;
+    for(uint8_t i = first + 1; i < MPU9250_SHADOW_SIZE; i++)
+    {
+      if(MPU9250_SHADOW_ADDR[i] != (MPU9250_SHADOW_ADDR[i - 1] + 1))
+        break;
 
-  if(mpu9250_readReg(MPU9250_GYRO_CONFIG_ADDR, ptmpData++) != MPU9250_OK)
-    status = MPU9250_ERROR;
+      if((pDevice->ShadowDirty & (1u << i)) != 0)
+        last = i;
+    }
 
-  if(mpu9250_readReg(MPU9250_CONFIG_ADDR, ptmpData) != MPU9250_OK)
-    status = MPU9250_ERROR;
+    if(pDevice->pTransport->write(pDevice, MPU9250_SHADOW_ADDR[first],
+                                  &pDevice->Shadow[first],
+                         last - first + 1) == MPU9250_OK)
+    {
+      for(uint8_t i = first; i <= last; i++)
+        pDevice->ShadowDirty &= ~(1u << i);
+    }
+    else
+      status = MPU9250_ERROR;
 
-  sampleRate_Div = (uint8_t) ((1000 / sampleRate) - 1);
+    first = last + 1;
+  }
 
-  sampleRate_Div = (sampleRate_Div < 3) ? (3) : (sampleRate_Div);
+  mpu9250_updateResolution(pDevice);
 
-  if(mpu9250_writeReg(MPU9250_SAMPLE_RATE_DIV_ADDR, sampleRate_Div)
-      != MPU9250_OK)
-    status = MPU9250_ERROR;
+  return status;
+}
 
-  tmpData[0] = 0x00;
-  if(mpu9250_writeReg(MPU9250_INT_PIN_CONFIG_ADDR, tmpData[0]) != MPU9250_OK)
-    status = MPU9250_ERROR;
+/*******************************************************************************
+ * Staged configuration setters (written by mpu9250_flush()).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_setGyroScale(mpu9250_handle_t *pDevice,
+    mpu9250_Gyro_Scale_t scale)
+{
+  uint8_t tmpData = mpu9250_shadowGet(pDevice, MPU9250_GYRO_CONFIG_ADDR);
 
-  tmpData[0] = 0x01;
-  if(mpu9250_writeReg(MPU9250_INT_ENABLE_ADDR, tmpData[0]) != MPU9250_OK)
-    status = MPU9250_ERROR;
+  if((uint8_t) scale > MPU9250_GYRO_FULLSCALE_2000DPS)
+    return MPU9250_ERROR;
 
-  return status;
+  tmpData &= ~MPU9250_GYRO_FS_MSK;
+  tmpData |= ((uint8_t) scale << 3);
+
+  return mpu9250_shadowSet(pDevice, MPU9250_GYRO_CONFIG_ADDR, tmpData);
+}
+
+mpu9250_status_t mpu9250_setGyroLPF(mpu9250_handle_t *pDevice,
+    mpu9250_Gyro_LowPassFilter_t lpf)
+{
+  uint8_t gyroConfig = mpu9250_shadowGet(pDevice, MPU9250_GYRO_CONFIG_ADDR);
+  uint8_t config = mpu9250_shadowGet(pDevice, MPU9250_CONFIG_ADDR);
+
+  gyroConfig &= ~MPU9250_GYRO_FCHOICE_B_MSK;
+
+  if(lpf == MPU9250_GYRO_LPF_DISABLE)
+    gyroConfig |= MPU9250_GYRO_FCHOICE_B_BYPASS;
+  else if((lpf >= MPU9250_GYRO_LPF_250HZ)
+      && (lpf <= MPU9250_GYRO_LPF_3600HZ))
+  {
+    config &= ~MPU9250_CONFIG_DLPF_MSK;
+    config |= (uint8_t) lpf;
+  }
+  else
+    return MPU9250_ERROR;
+
+  mpu9250_shadowSet(pDevice, MPU9250_CONFIG_ADDR, config);
+
+  return mpu9250_shadowSet(pDevice, MPU9250_GYRO_CONFIG_ADDR, gyroConfig);
+}
+
+mpu9250_status_t mpu9250_setAccelScale(mpu9250_handle_t *pDevice,
+    mpu9250_Accel_Scale_t scale)
+{
+  uint8_t tmpData = mpu9250_shadowGet(pDevice, MPU9250_ACCEL_CONFIG_ADDR);
+
+  if((uint8_t) scale > MPU9250_ACCEL_FULLSCALE_16G)
+    return MPU9250_ERROR;
+
+  tmpData &= ~MPU9250_ACCEL_FS_MSK;
+  tmpData |= ((uint8_t) scale << 3);
+
+  return mpu9250_shadowSet(pDevice, MPU9250_ACCEL_CONFIG_ADDR, tmpData);
+}
+
+mpu9250_status_t mpu9250_setAccelLPF(mpu9250_handle_t *pDevice,
+    mpu9250_Accel_LowPassFilter_t lpf)
+{
+  uint8_t tmpData = mpu9250_shadowGet(pDevice, MPU9250_ACCEL_CONFIG2_ADDR);
+
+  tmpData &= ~MPU9250_ACCEL_DLPF_MSK;
+
+  if(lpf == MPU9250_ACCEL_LPF_DISABLE)
+    tmpData |= MPU9250_ACCEL_FCHOICE_B_MSK;
+  else if((lpf >= MPU9250_ACCEL_LPF_218_1HZ)
+      && (lpf <= MPU9250_ACCEL_LPF_420HZ))
+    tmpData |= (uint8_t) lpf;
+  else
+    return MPU9250_ERROR;
+
+  return mpu9250_shadowSet(pDevice, MPU9250_ACCEL_CONFIG2_ADDR, tmpData);
 }
 
 /*******************************************************************************
- * Reset device
+ * DWT cycles from mpu9250_init() to the first sample.
  ******************************************************************************/
-mpu9250_status_t mpu9250_reset(void)
+uint32_t mpu9250_getBootCycles(mpu9250_handle_t *pDevice)
 {
-  mpu9250_status_t status = MPU9250_ERROR;
+  return pDevice->BootCycles;
+}
 
-  if(mpu9250_writeReg(MPU9250_PWR_MGMT1_ADDR, MPU9250_CMD_RESET) != MPU9250_OK)
-    status = MPU9250_OK;
+/*******************************************************************************
+ * Low-power idle: gyro disabled, accelerometer cycled at odr, one INT pulse
+ * (50us) when the acceleration changes more than threshold [mg] (4..1020).
+ * Data-ready pulses stop. The previous configuration is restored on failure.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_enterWakeOnMotion(mpu9250_handle_t *pDevice,
+    uint16_t threshold, mpu9250_LowPowerODR_t odr)
+{
+  uint16_t womThreshold = threshold / MPU9250_WOM_LSB_MG;
+
+  if((pDevice->WomActive == 1) || (odr > MPU9250_LP_ODR_500HZ))
+    return MPU9250_ERROR;
+
+  if(womThreshold > 0xFF)
+    womThreshold = 0xFF;
+
+  for(uint8_t i = 0; i < MPU9250_WOM_SIZE; i++)
+    pDevice->WomSaved[i] = mpu9250_shadowGet(pDevice, MPU9250_WOM_ADDR[i]);
+
+  mpu9250_shadowSet(pDevice, MPU9250_PWR_MGMT2_ADDR, MPU9250_PWR2_GYRO_DISABLE);
+  mpu9250_shadowSet(pDevice, MPU9250_ACCEL_CONFIG2_ADDR,
+      (mpu9250_shadowGet(pDevice, MPU9250_ACCEL_CONFIG2_ADDR)
+          & ~MPU9250_ACCEL_DLPF_MSK)
+      | MPU9250_WOM_ACCEL_DLPF);
+  mpu9250_shadowSet(pDevice, MPU9250_INT_ENABLE_ADDR, MPU9250_INT_WOM_MSK);
+  mpu9250_shadowSet(pDevice, MPU9250_ACCEL_INTEL_CTRL_ADDR,
+                    MPU9250_ACCEL_INTEL_WOM);
+  mpu9250_shadowSet(pDevice, MPU9250_WON_THR_ADDR, (uint8_t) womThreshold);
+  mpu9250_shadowSet(pDevice, MPU9250_LP_ACCCEL_ODR_ADDR, (uint8_t) odr);
+
+  /*!< Cycle mode last, once the motion logic is set up */
+  if(mpu9250_flush(pDevice) == MPU9250_OK)
+  {
+    mpu9250_shadowSet(pDevice, MPU9250_PWR_MGMT1_ADDR,
+        mpu9250_shadowGet(pDevice, MPU9250_PWR_MGMT1_ADDR)
+            | MPU9250_PWR_CYCLE_MSK);
+
+    if(mpu9250_flush(pDevice) == MPU9250_OK)
+    {
+      pDevice->WomActive = 1;
+      return MPU9250_OK;
+    }
+  }
 
-  LL_mDelay(100);
+  for(uint8_t i = 0; i < MPU9250_WOM_SIZE; i++)
+    mpu9250_shadowSet(pDevice, MPU9250_WOM_ADDR[i], pDevice->WomSaved[i]);
 
-  if(mpu9250_writeReg(MPU9250_PWR_MGMT1_ADDR, 0x00) != MPU9250_OK)
-    status = MPU9250_OK;
+  mpu9250_flush(pDevice);
 
-  return status;
+  return MPU9250_ERROR;
 }
 
+/*******************************************************************************
+ * Back to full rate: restore the configuration, wait for the gyro start-up
+ * (35 ms) and reset the FIFO (samples taken while idle are dropped).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_exitWakeOnMotion(mpu9250_handle_t *pDevice)
+{
+  uint8_t tmpData = 0x00;
+
+  if(pDevice->WomActive == 0)
+    return MPU9250_OK;
+
+  for(uint8_t i = 0; i < MPU9250_WOM_SIZE; i++)
+    mpu9250_shadowSet(pDevice, MPU9250_WOM_ADDR[i], pDevice->WomSaved[i]);
+
+  if(mpu9250_flush(pDevice) != MPU9250_OK)
+    return MPU9250_ERROR;
+
+  pDevice->WomActive = 0;
+
+  mpu9250_delayUs(MPU9250_GYRO_STARTUP_US);
+
+  tmpData = mpu9250_shadowGet(pDevice, MPU9250_USER_CTRL_ADDR);
+  if((tmpData & MPU9250_USER_FIFO_EN_MSK) != 0)
+  {
+    tmpData |= MPU9250_USER_FIFO_RST_MSK;
+    if(mpu9250_writeReg(pDevice, MPU9250_USER_CTRL_ADDR, tmpData) != MPU9250_OK)
+      return MPU9250_ERROR;
+  }
+
+  return MPU9250_OK;
+}
 /*******************************************************************************
  *
  ******************************************************************************/
-mpu9250_status_t mpu9250_getBias_int16(
+mpu9250_status_t mpu9250_getBias_int16(mpu9250_handle_t *pDevice,
     uint8_t samples, int16_t *pAccel, int16_t *pGyro)
 {
   mpu9250_status_t status = MPU9250_OK;
@@ -953,7 +1493,7 @@ mpu9250_status_t mpu9250_getBias_int16(
 
   for(uint8_t i = 0; i < samples; i++)
   {
-    if(mpu9250_readData_int16(pAccelData, pGyroData) == MPU9250_OK)
+    if(mpu9250_readData_int16(pDevice, pAccelData, pGyroData) == MPU9250_OK)
     {
       for(uint8_t u = 0; u < 3; u++)
       {
@@ -977,7 +1517,7 @@ mpu9250_status_t mpu9250_getBias_int16(
 /*******************************************************************************
  *
  ******************************************************************************/
-mpu9250_status_t mpu9250_getBias_float(
+mpu9250_status_t mpu9250_getBias_float(mpu9250_handle_t *pDevice,
     uint8_t samples, float32_t *pAccel, float32_t *pGyro)
 {
   mpu9250_status_t status = MPU9250_OK;
@@ -992,7 +1532,7 @@ mpu9250_status_t mpu9250_getBias_float(
 
   for(uint8_t i = 0; i < samples; i++)
   {
-    if(mpu9250_readData_float(pAccelData, pGyroData) == MPU9250_OK)
+    if(mpu9250_readData_float(pDevice, pAccelData, pGyroData) == MPU9250_OK)
     {
       for(uint8_t u = 0; u < 3; u++)
       {
@@ -1014,98 +1554,370 @@ mpu9250_status_t mpu9250_getBias_float(
 }
 
 /*******************************************************************************
- *
+ * Measure bias over samples (1 kHz, device still, Z axis up) and cancel it
+ * in the offset registers. Offsets already in the device are taken into
+ * account, so calibration can be repeated. pOffsets: new register values,
+ * to be stored and restored with mpu9250_setOffsets().
  ******************************************************************************/
-mpu9250_status_t mpu9250_getResolution_int16(int16_t *pResolution)
+mpu9250_status_t mpu9250_calibrate(mpu9250_handle_t *pDevice, uint16_t samples,
+    mpu9250_offsets_t *pOffsets)
 {
-  mpu9250_status_t status = MPU9250_OK;
+  mpu9250_status_t status = MPU9250_ERROR;
 
-  pResolution[0] = aResolution;
-  pResolution[1] = (int16_t) gResolution;
+  mpu9250_offsets_t offsets;
+  int32_t accelSum[3] = { 0 };
+  int32_t gyroSum[3] = { 0 };
+  int32_t accelBias = 0;
+  int32_t gyroBias = 0;
+  uint16_t n = 0;
 
-  return status;
-}
+  if((samples == 0) || (pDevice->AccelResolution == 0))
+    return status;
 
-/*******************************************************************************
- *
- ******************************************************************************/
-mpu9250_status_t mpu9250_getResolution_float(float32_t *pResolution)
-{
-  mpu9250_status_t status = MPU9250_OK;
+  if(mpu9250_getOffsets(pDevice, &offsets) != MPU9250_OK)
+    return status;
 
-  pResolution[1] = (float32_t) aResolution;
-  pResolution[2] = gResolution;
+  n = mpu9250_sampleSum(pDevice, samples, &accelSum[0], &gyroSum[0]);
 
-  return status;
-}
+  /*!< Less than half a window: bus errors, not a bias */
+  if(n < (samples / 2) + 1)
+    return status;
 
-/*******************************************************************************
- * Return device id --> MPU9250_DEVICE_ID == 0x71
- ******************************************************************************/
-uint8_t mpu9250_readID(void)
-{
-  uint8_t devID = 0x00;
-  uint8_t *pDevID = &devID;
+  /*!< Remove gravity */
+  accelSum[2] -= (int32_t) pDevice->AccelResolution * n;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    gyroBias = (int32_t) (((int64_t) gyroSum[i] << pDevice->GyroScale) /
+                          (4 * (int32_t) n));
+    offsets.Gyro[i] = mpu9250_saturate((int32_t) offsets.Gyro[i] - gyroBias);
+
+    accelBias = (int32_t) (((int64_t) accelSum[i] * MPU9250_ACCEL_OFFSET_LSB_G) /
+                           ((int32_t) pDevice->AccelResolution * n));
+    offsets.Accel[i] = mpu9250_saturate(((int32_t) offsets.Accel[i] - accelBias));
+  }
 
-  if(mpuAddr == 0x00)
-    mpu9250_isReady();
+  if(mpu9250_setOffsets(pDevice, &offsets) != MPU9250_OK)
+    return status;
 
-  mpu9250_readReg(MPU9250_WHO_AM_I_ADDR, pDevID);
+  *pOffsets = offsets;
 
-  return devID;
+  status = MPU9250_OK;
+  return status;
 }
 
 /*******************************************************************************
- * Read device's temperature: int16_t --> raw data.
- *  float32_t:
- *          temperature = [(rawData - RoomTemp_Offset)/ 333.87f] + 21.0f
+ * Datasheet self-test: sensor output with self-test off and on (200 samples
+ * each) against the factory trim in SELF_TEST_*. Device still. Takes ~0.5 s,
+ * MPU9250_ERROR past MPU9250_SELFTEST_TIMEOUT_US. The configuration is
+ * restored afterwards.
  ******************************************************************************/
-mpu9250_status_t mpu9250_readTemperature_int16(int16_t *pTemperature)
+mpu9250_status_t mpu9250_selfTest(mpu9250_handle_t *pDevice,
+    mpu9250_selfTest_t *pResult)
 {
   mpu9250_status_t status = MPU9250_ERROR;
+  mpu9250_selfTestData_t *pData = &pResult->Data;
+  uint8_t saved[5] = { 0 };
+  uint32_t startCycles = DWT->CYCCNT;
+  uint32_t timeoutCycles =
+      MPU9250_SELFTEST_TIMEOUT_US*(SystemCoreClock/1000000);
+
+  saved[0] = mpu9250_shadowGet(pDevice, MPU9250_SAMPLE_RATE_DIV_ADDR);
+  saved[1] = mpu9250_shadowGet(pDevice, MPU9250_CONFIG_ADDR);
+  saved[2] = mpu9250_shadowGet(pDevice, MPU9250_GYRO_CONFIG_ADDR);
+  saved[3] = mpu9250_shadowGet(pDevice, MPU9250_ACCEL_CONFIG_ADDR);
+  saved[4] = mpu9250_shadowGet(pDevice, MPU9250_ACCEL_CONFIG2_ADDR);
+
+  mpu9250_shadowSet(pDevice, MPU9250_SAMPLE_RATE_DIV_ADDR, 0x00);
+  mpu9250_setGyroLPF(pDevice, MPU9250_GYRO_LPF_92HZ);
+  mpu9250_setGyroScale(pDevice, MPU9250_GYRO_FULLSCALE_250DPS);
+  mpu9250_setAccelLPF(pDevice, MPU9250_ACCEL_LPF_99HZ);
+  mpu9250_setAccelScale(pDevice, MPU9250_ACCEL_FULLSCALE_2G);
+
+  if((mpu9250_flush(pDevice) == MPU9250_OK)
+      && (mpu9250_selfTestAverage(pDevice, &pData->AccelOff[0],
+                                  &pData->GyroOff[0])
+          == MPU9250_OK))
+  {
+    mpu9250_shadowSet(pDevice, MPU9250_GYRO_CONFIG_ADDR,
+        mpu9250_shadowGet(pDevice, MPU9250_GYRO_CONFIG_ADDR)
+        | MPU9250_SELFTEST_ENABLE_MSK);
+    mpu9250_shadowSet(pDevice, MPU9250_ACCEL_CONFIG_ADDR,
+        mpu9250_shadowGet(pDevice, MPU9250_ACCEL_CONFIG_ADDR)
+        | MPU9250_SELFTEST_ENABLE_MSK);
+
+    if((mpu9250_flush(pDevice) == MPU9250_OK)
+        && (mpu9250_selfTestAverage(pDevice, &pData->AccelOn[0],
+                                    &pData->GyroOn[0])
+            == MPU9250_OK))
+      status = MPU9250_OK;
+  }
 
-  uint8_t rawData[2] = { 0 };
-  uint8_t *pRawData = &rawData[0];
-
-  if(mpu9250_readBytes(MPU9250_TEMP_H_ADDR, pRawData, 2) == MPU9250_OK)
-    status = MPU9250_OK;
+  mpu9250_shadowSet(pDevice, MPU9250_SAMPLE_RATE_DIV_ADDR, saved[0]);
+  mpu9250_shadowSet(pDevice, MPU9250_CONFIG_ADDR, saved[1]);
+  mpu9250_shadowSet(pDevice, MPU9250_GYRO_CONFIG_ADDR, saved[2]);
+  mpu9250_shadowSet(pDevice, MPU9250_ACCEL_CONFIG_ADDR, saved[3]);
+  mpu9250_shadowSet(pDevice, MPU9250_ACCEL_CONFIG2_ADDR, saved[4]);
 
-  *pTemperature = (int16_t) (((int16_t) rawData[0] << 8) | rawData[1]);
+  if(mpu9250_flush(pDevice) != MPU9250_OK)
+    status = MPU9250_ERROR;
 
-  return status;
-}
+  mpu9250_delayUs(MPU9250_SELFTEST_SETTLE_US);
 
-/*******************************************************************************
- * Return Accelerometer data. Default 16.384 LSB/g
- ******************************************************************************/
-mpu9250_status_t mpu9250_readAccelData_int16(int16_t *pAccel)
-{
-  mpu9250_status_t status = MPU9250_ERROR;
+  if(status != MPU9250_OK)
+    return MPU9250_ERROR;
 
-  uint8_t rawData[6] = { 0 };
-  uint8_t *pRawData = &rawData[0];
+  if(mpu9250_readBytes(pDevice, MPU9250_SELF_TEST_X_GYRO_ADDR,
+                       &pData->GyroTrim[0], 3)
+      != MPU9250_OK)
+    return MPU9250_ERROR;
 
-  if(mpu9250_readBytes(MPU9250_ACCEL_XOUT_H_ADDR, pRawData, 6) == MPU9250_OK)
-    status = MPU9250_OK;
+  if(mpu9250_readBytes(pDevice, MPU9250_SELF_TEST_X_ACCEL_ADDR,
+                       &pData->AccelTrim[0], 3)
+      != MPU9250_OK)
+    return MPU9250_ERROR;
 
-  for(uint8_t i = 0; i < 3; i++)
-    *pAccel++ =
-        (int16_t) (((int16_t) rawData[2 * i] << 8) | rawData[2 * i + 1]);
+  if((DWT->CYCCNT - startCycles) >= timeoutCycles)
+    return MPU9250_ERROR;
 
-  return status;
+  return mpu9250_checkSelfTest(pResult);
 }
 
 /*******************************************************************************
- * Return Gyroscope data. Default 131.0 LSB/dps
+ * Self-test pass/fail criteria on pResult->Data. No bus access.
  ******************************************************************************/
-mpu9250_status_t mpu9250_readGyroData_int16(int16_t *pGyro)
+mpu9250_status_t mpu9250_checkSelfTest(mpu9250_selfTest_t *pResult)
 {
-  mpu9250_status_t status = MPU9250_ERROR;
+  mpu9250_status_t status = MPU9250_OK;
+  mpu9250_selfTestData_t *pData = &pResult->Data;
+  int32_t response = 0;
+  float32_t otp = 0.0f;
+  float32_t ratio = 0.0f;
 
-  uint8_t rawData[6] = { 0 };
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    /*!< Gyroscope */
+    response = (int32_t) pData->GyroOn[i] - pData->GyroOff[i];
+    otp = mpu9250_selfTestOtp(pData->GyroTrim[i]);
+
+    if(otp != 0.0f)
+    {
+      ratio = (float32_t) response / otp;
+      pResult->GyroDeviation[i] = (ratio - 1.0f) * 100.0f;
+      pResult->GyroPass[i] = (ratio > MPU9250_SELFTEST_GYRO_MIN_RATIO);
+    }
+    else
+    {
+      pResult->GyroDeviation[i] = 0.0f;
+      pResult->GyroPass[i] = ((response >= MPU9250_SELFTEST_GYRO_MIN_LSB)
+          || (response <= -MPU9250_SELFTEST_GYRO_MIN_LSB));
+    }
+
+    if((pData->GyroOff[i] > MPU9250_SELFTEST_GYRO_OFFSET_LSB)
+        || (pData->GyroOff[i] < -MPU9250_SELFTEST_GYRO_OFFSET_LSB))
+      pResult->GyroPass[i] = 0;
+
+    /*!< Accelerometer */
+    response = (int32_t) pData->AccelOn[i] - pData->AccelOff[i];
+    otp = mpu9250_selfTestOtp(pData->AccelTrim[i]);
+
+    if(otp != 0.0f)
+    {
+      ratio = (float32_t) response / otp;
+      pResult->AccelDeviation[i] = (ratio - 1.0f) * 100.0f;
+      pResult->AccelPass[i] = ((ratio > MPU9250_SELFTEST_ACCEL_MIN_RATIO)
+          && (ratio < MPU9250_SELFTEST_ACCEL_MAX_RATIO));
+    }
+    else
+    {
+      if(response < 0)
+        response = -response;
+
+      pResult->AccelDeviation[i] = 0.0f;
+      pResult->AccelPass[i] = ((response >= MPU9250_SELFTEST_ACCEL_MIN_LSB)
+          && (response <= MPU9250_SELFTEST_ACCEL_MAX_LSB));
+    }
+
+    if((pResult->GyroPass[i] == 0) || (pResult->AccelPass[i] == 0))
+      status = MPU9250_ERROR;
+  }
+
+  return status;
+}
+
+/*******************************************************************************
+ * Read back the offset registers (gyro 32.8 LSB/dps, accel 2048 LSB/g).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_getOffsets(mpu9250_handle_t *pDevice,
+    mpu9250_offsets_t *pOffsets)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t rawData[6] = { 0 };
+
+  if(mpu9250_readBytes(pDevice, MPU9250_XG_OFFSET_H_ADDR, &rawData[0],
+                       6) != MPU9250_OK)
+    return status;
+
+  for(uint8_t i = 0; i < 3; i++)
+    pOffsets->Gyro[i] =
+        (int16_t) (((int16_t) rawData[2 * i] << 8) | rawData[2 * i + 1]);
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    if(mpu9250_readBytes(pDevice, MPU9250_XA_OFFSET_ADDR[i], &rawData[0], 2)
+        != MPU9250_OK)
+      return status;
+
+    pOffsets->Accel[i] = (int16_t) (((int16_t) rawData[0] << 8) | rawData[1]);
+  }
+
+  status = MPU9250_OK;
+  return status;
+}
+
+/*******************************************************************************
+ * Write the offset registers. The accel temperature compensation bit
+ * (bit 0) of the device is kept, whatever pOffsets holds.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_setOffsets(mpu9250_handle_t *pDevice,
+    mpu9250_offsets_t *pOffsets)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t rawData[6] = { 0 };
+  int16_t accelOffset = 0;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    rawData[2 * i] = (uint8_t) ((uint16_t) pOffsets->Gyro[i] >> 8);
+    rawData[2 * i + 1] = (uint8_t) (pOffsets->Gyro[i] & 0xFF);
+  }
+
+  if(mpu9250_writeBytes(pDevice, MPU9250_XG_OFFSET_H_ADDR, &rawData[0],
+                        6) != MPU9250_OK)
+    return status;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    if(mpu9250_readBytes(pDevice, MPU9250_XA_OFFSET_ADDR[i], &rawData[0], 2)
+        != MPU9250_OK)
+      return status;
+
+    accelOffset = (int16_t) ((pOffsets->Accel[i] & ~MPU9250_ACCEL_OFFSET_TEMP_MSK) |
+                             (rawData[1] & MPU9250_ACCEL_OFFSET_TEMP_MSK));
+
+    rawData[0] = (uint8_t) ((uint16_t) accelOffset >> 8);
+    rawData[1] = (uint8_t) (accelOffset & 0xFF);
+    if(mpu9250_writeBytes(pDevice, MPU9250_XA_OFFSET_ADDR[i], &rawData[0], 2)
+        != MPU9250_OK)
+      return status;
+  }
+
+  status = MPU9250_OK;
+  return status;
+}
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+mpu9250_status_t mpu9250_getResolution_int16(mpu9250_handle_t *pDevice,
+    int16_t *pResolution)
+{
+  mpu9250_status_t status = MPU9250_OK;
+
+  pResolution[0] = pDevice->AccelResolution;
+  pResolution[1] = (int16_t) pDevice->GyroResolution;
+
+  return status;
+}
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+mpu9250_status_t mpu9250_getResolution_float(mpu9250_handle_t *pDevice,
+    float32_t *pResolution)
+{
+  mpu9250_status_t status = MPU9250_OK;
+
+  pResolution[1] = (float32_t) pDevice->AccelResolution;
+  pResolution[2] = pDevice->GyroResolution;
+
+  return status;
+}
+
+/*******************************************************************************
+ * Return device id --> MPU9250_DEVICE_ID == 0x71
+ ******************************************************************************/
+uint8_t mpu9250_readID(mpu9250_handle_t *pDevice)
+{
+  uint8_t devID = 0x00;
+  uint8_t *pDevID = &devID;
+
+  if(pDevice->Ready == 0)
+    mpu9250_isReady(pDevice);
+
+  mpu9250_readReg(pDevice, MPU9250_WHO_AM_I_ADDR, pDevID);
+
+  return devID;
+}
+
+/*******************************************************************************
+ * Read device's temperature: int16_t --> raw data.
+ *  float32_t:
+ *          temperature = [(rawData - RoomTemp_Offset)/ 333.87f] + 21.0f
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readTemperature_int16(mpu9250_handle_t *pDevice,
+    int16_t *pTemperature)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t rawData[2] = { 0 };
+  uint8_t *pRawData = &rawData[0];
+
+  if(mpu9250_readBytes(pDevice, MPU9250_TEMP_H_ADDR, pRawData, 2) == MPU9250_OK)
+    status = MPU9250_OK;
+
+  *pTemperature = (int16_t) (((int16_t) rawData[0] << 8) | rawData[1]);
+
+  return status;
+}
+
+/*******************************************************************************
+ * Return Accelerometer data. Default 16.384 LSB/g
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readAccelData_int16(mpu9250_handle_t *pDevice,
+    int16_t *pAccel)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t rawData[6] = { 0 };
+  uint8_t *pRawData = &rawData[0];
+
+  if(mpu9250_readBytes(pDevice, MPU9250_ACCEL_XOUT_H_ADDR, pRawData,
+                       6) == MPU9250_OK)
+    status = MPU9250_OK;
+
+  for(uint8_t i = 0; i < 3; i++)
+    *pAccel++ =
+        (int16_t) (((int16_t) rawData[2 * i] << 8) | rawData[2 * i + 1]);
+
+  return status;
+}
+
+/*******************************************************************************
+ * Return Gyroscope data. Default 131.0 LSB/dps
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readGyroData_int16(mpu9250_handle_t *pDevice,
+    int16_t *pGyro)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t rawData[6] = { 0 };
   uint8_t *pRawData = &rawData[0];
 
-  if(mpu9250_readBytes(MPU9250_GYRO_XOUT_H_ADDR, pRawData, 6) == MPU9250_OK)
+  if(mpu9250_readBytes(pDevice, MPU9250_GYRO_XOUT_H_ADDR, pRawData,
+                       6) == MPU9250_OK)
     status = MPU9250_OK;
 
   for(uint8_t i = 0; i < 3; i++)
@@ -1117,17 +1929,23 @@ mpu9250_status_t mpu9250_readGyroData_int16(int16_t *pGyro)
 /*******************************************************************************
  * Return Accelerometer and Gyroscope data
  ******************************************************************************/
-mpu9250_status_t mpu9250_readData_int16(int16_t *pAccel, int16_t *pGyro)
+mpu9250_status_t mpu9250_readData_int16(mpu9250_handle_t *pDevice,
+    int16_t *pAccel, int16_t *pGyro)
 {
   mpu9250_status_t status = MPU9250_OK;
 
-  if(mpu9250_getStatus() == MPU9250_OK)
+  mpu9250_rawData_t rawData = { { 0 }, 0, { 0 } };
+
+  if(mpu9250_getStatus(pDevice) == MPU9250_OK)
   {
-    if(mpu9250_readAccelData_int16(pAccel) != MPU9250_OK)
+    if(mpu9250_readRawData(pDevice, &rawData) != MPU9250_OK)
       status = MPU9250_ERROR;
 
-    if(mpu9250_readGyroData_int16(pGyro) != MPU9250_OK)
-      status = MPU9250_ERROR;
+    for(uint8_t i = 0; i < 3; i++)
+    {
+      *pAccel++ = rawData.Accel[i];
+      *pGyro++ = rawData.Gyro[i];
+    }
   }
 
   return status;
@@ -1138,14 +1956,15 @@ mpu9250_status_t mpu9250_readData_int16(int16_t *pAccel, int16_t *pGyro)
  *  float32_t:
  *          temperature = [(rawData - RoomTemp_Offset)/ 333.87f] + 21.0f
  ******************************************************************************/
-mpu9250_status_t mpu9250_readTemperature_float(float32_t *pTemperature)
+mpu9250_status_t mpu9250_readTemperature_float(mpu9250_handle_t *pDevice,
+    float32_t *pTemperature)
 {
   mpu9250_status_t status = MPU9250_OK;
 
   int16_t temp = 0;
   int16_t *pTemp = &temp;
 
-  if(mpu9250_readTemperature_int16(pTemp) != MPU9250_OK)
+  if(mpu9250_readTemperature_int16(pDevice, pTemp) != MPU9250_OK)
     status = MPU9250_ERROR;
 
   *pTemperature = ((float32_t) temp / 333.87f) + 21.0f;
@@ -1156,18 +1975,19 @@ mpu9250_status_t mpu9250_readTemperature_float(float32_t *pTemperature)
 /*******************************************************************************
  * Return Accelerometer data. Default 16.384 LSB/g
  ******************************************************************************/
-mpu9250_status_t mpu9250_readAccelData_float(float32_t *pAccel)
+mpu9250_status_t mpu9250_readAccelData_float(mpu9250_handle_t *pDevice,
+    float32_t *pAccel)
 {
   mpu9250_status_t status = MPU9250_OK;
 
   int16_t accData[3] = { 0 };
   int16_t *pAccData = &accData[0];
 
-  if(mpu9250_readAccelData_int16(pAccData) != MPU9250_OK)
+  if(mpu9250_readAccelData_int16(pDevice, pAccData) != MPU9250_OK)
     status = MPU9250_ERROR;
 
   for(uint8_t i = 0; i < 3; i++)
-    *pAccel++ = ((float32_t) (accData[i]) / aResolution);
+    *pAccel++ = ((float32_t) (accData[i]) / pDevice->AccelResolution);
 
   return status;
 }
@@ -1175,18 +1995,19 @@ mpu9250_status_t mpu9250_readAccelData_float(float32_t *pAccel)
 /*******************************************************************************
  * Return Gyroscope data. Default 131.0 LSB/dps
  ******************************************************************************/
-mpu9250_status_t mpu9250_readGyroData_float(float32_t *pGyro)
+mpu9250_status_t mpu9250_readGyroData_float(mpu9250_handle_t *pDevice,
+    float32_t *pGyro)
 {
   mpu9250_status_t status = MPU9250_OK;
 
   int16_t gyroData[3] = { 0 };
   int16_t *pGyroData = &gyroData[0];
 
-  if(mpu9250_readGyroData_int16(pGyroData) != MPU9250_OK)
+  if(mpu9250_readGyroData_int16(pDevice, pGyroData) != MPU9250_OK)
     status = MPU9250_ERROR;
 
   for(uint8_t i = 0; i < 3; i++)
-    *pGyro++ = ((float32_t) (gyroData[i]) / gResolution);
+    *pGyro++ = ((float32_t) (gyroData[i]) / pDevice->GyroResolution);
 
   return status;
 }
@@ -1194,97 +2015,1063 @@ mpu9250_status_t mpu9250_readGyroData_float(float32_t *pGyro)
 /*******************************************************************************
  * Return Accelerometer and Gyroscope data
  ******************************************************************************/
-mpu9250_status_t mpu9250_readData_float(float32_t *pAccel, float32_t *pGyro)
+mpu9250_status_t mpu9250_readData_float(mpu9250_handle_t *pDevice,
+    float32_t *pAccel, float32_t *pGyro)
 {
   mpu9250_status_t status = MPU9250_OK;
 
-  if(mpu9250_getStatus() == MPU9250_OK)
+  mpu9250_rawData_t rawData = { { 0 }, 0, { 0 } };
+
+  if(mpu9250_getStatus(pDevice) == MPU9250_OK)
   {
-    if(mpu9250_readAccelData_float(pAccel) != MPU9250_OK)
+    if(mpu9250_readRawData(pDevice, &rawData) != MPU9250_OK)
       status = MPU9250_ERROR;
 
-    if(mpu9250_readGyroData_float(pGyro) != MPU9250_OK)
-      status = MPU9250_ERROR;
+    mpu9250_convertData_float(pDevice, &rawData, pAccel, pGyro);
   }
 
   return status;
 }
 
-// Private Functions ===========================================================
-static mpu9250_status_t mpu9250_isReady(void)
+/*******************************************************************************
+ * Return Accelerometer, Temperature and Gyroscope raw data in a single burst
+ * read (ACCEL_XOUT_H..GYRO_ZOUT_L).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readRawData(mpu9250_handle_t *pDevice,
+    mpu9250_rawData_t *pRawData)
 {
   mpu9250_status_t status = MPU9250_ERROR;
-  uint8_t devAddr = MPU9250_ADDR;
 
-  if(cncI2C_isDeviceReady(I2C1, devAddr++))
-  {
-    mpuAddr = MPU9250_ADDR;
+  uint8_t rawData[14] = { 0 };
+  uint8_t *pRawBytes = &rawData[0];
+
+  if(mpu9250_readBytes(pDevice, MPU9250_ACCEL_XOUT_H_ADDR, pRawBytes,
+                       MPU9250_RAW_DATA_LEN) == MPU9250_OK)
     status = MPU9250_OK;
-  }
-  else if(cncI2C_isDeviceReady(I2C1, devAddr))
+
+  mpu9250_parseRawData(pRawBytes, pRawData);
+
+  return status;
+}
+
+/*******************************************************************************
+ * Non-blocking version of mpu9250_readRawData(). Queued with control priority
+ * on the I2C transaction queue (I2C events + DMA), or SPI DMA transfer.
+ * pRawData is valid when callback is called with MPU9250_OK.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readRawData_async(mpu9250_handle_t *pDevice,
+    mpu9250_rawData_t *pRawData, mpu9250_callback_t callback)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(pDevice->AsyncPending == 1)
+    return status;
+
+  pDevice->pAsyncRawData = pRawData;
+  pDevice->AsyncCallback = callback;
+  pDevice->AsyncPending = 1;
+  pDevice->AsyncStart = DWT->CYCCNT;
+
+  status = mpu9250_submitRead(pDevice, MPU9250_ACCEL_XOUT_H_ADDR,
+                              &pDevice->AsyncBuffer[0], MPU9250_RAW_DATA_LEN,
+                              &mpu9250_readDone);
+  if(status != MPU9250_OK)
+    pDevice->AsyncPending = 0;
+
+  return status;
+}
+
+/*******************************************************************************
+ * Scale raw sample: Accelerometer [g], Gyroscope [dps]
+ ******************************************************************************/
+mpu9250_status_t mpu9250_convertData_float(mpu9250_handle_t *pDevice,
+    mpu9250_rawData_t *pRawData, float32_t *pAccel, float32_t *pGyro)
+{
+  mpu9250_status_t status = MPU9250_OK;
+
+  for(uint8_t i = 0; i < 3; i++)
   {
-    mpuAddr = MPU9250_ADDR_ALT;
-    status = MPU9250_OK;
+    *pAccel++ = ((float32_t) (pRawData->Accel[i]) / pDevice->AccelResolution);
+    *pGyro++ = ((float32_t) (pRawData->Gyro[i]) / pDevice->GyroResolution);
   }
 
   return status;
 }
 
-static mpu9250_status_t mpu9250_getStatus(void)
+/*******************************************************************************
+ * Accelerometer, Temperature, Gyroscope and Magnetometer raw data in a single
+ * burst read (ACCEL_XOUT_H..EXT_SENS_DATA_06). mpu9250_initMag() first.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readRawData9(mpu9250_handle_t *pDevice,
+    mpu9250_rawData9_t *pRawData)
 {
-  uint8_t status = MPU9250_ERROR;
+  mpu9250_status_t status = MPU9250_ERROR;
 
-  uint8_t mpuStatus = 0x00;
-  uint8_t *pMpuStatus = &mpuStatus;
+  uint8_t rawData[21] = { 0 };
+  uint8_t *pRawBytes = &rawData[0];
+  uint8_t *pMagBytes = &rawData[MPU9250_RAW_DATA_LEN];
+
+  if(pDevice->MagReady != 1)
+    return status;
 
-  if(mpu9250_readReg(MPU9250_INT_STATUS_ADDR, pMpuStatus) == MPU9250_OK)
+  if(mpu9250_readBytes(pDevice, MPU9250_ACCEL_XOUT_H_ADDR, pRawBytes,
+                       MPU9250_RAW_DATA9_LEN) == MPU9250_OK)
     status = MPU9250_OK;
 
-  status =
-      (mpuStatus & MPU9250_INT_DATA_READY_MSK) ? (MPU9250_OK) : (MPU9250_ERROR);
+  mpu9250_parseRawData(pRawBytes, &pRawData->Imu);
+
+  /*!< AK8963 is little endian */
+  for(uint8_t i = 0; i < 3; i++)
+    pRawData->Mag[i] =
+        (int16_t) (((int16_t) pMagBytes[2 * i + 1] << 8) | pMagBytes[2 * i]);
+
+  pRawData->MagStatus = pRawBytes[MPU9250_RAW_DATA9_LEN - 1];
+
+  return status;
+}
+
+/*******************************************************************************
+ * Scale raw 9 axes sample: Accelerometer [g], Gyroscope [dps], Magnetometer
+ * [uT] with ASA correction, rotated to the accelerometer/gyroscope axes.
+ * MPU9250_ERROR if the magnetometer overflowed (pMag not valid).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_convertData9_float(mpu9250_handle_t *pDevice,
+    mpu9250_rawData9_t *pRawData, float32_t *pAccel, float32_t *pGyro,
+    float32_t *pMag)
+{
+  mpu9250_status_t status = MPU9250_OK;
+
+  mpu9250_convertData_float(pDevice, &pRawData->Imu, pAccel, pGyro);
+
+  /*!< AK8963 frame: X = accel Y, Y = accel X, Z = -accel Z */
+  pMag[0] = (float32_t) pRawData->Mag[1] * pDevice->MagResolution[1];
+  pMag[1] = (float32_t) pRawData->Mag[0] * pDevice->MagResolution[0];
+  pMag[2] = -(float32_t) pRawData->Mag[2] * pDevice->MagResolution[2];
+
+  if((pRawData->MagStatus & AK8963_ST2_HOFL_MSK) != 0)
+    status = MPU9250_ERROR;
 
   return status;
 }
 
-static mpu9250_status_t mpu9250_writeReg(const uint8_t regAddr, uint8_t data)
+/*******************************************************************************
+ * Return Accelerometer [g], Gyroscope [dps] and Magnetometer [uT] data
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readData9_float(mpu9250_handle_t *pDevice,
+    float32_t *pAccel, float32_t *pGyro, float32_t *pMag)
 {
   mpu9250_status_t status = MPU9250_ERROR;
 
-  uint8_t aDev[2] = { mpuAddr, regAddr };
-  uint8_t *pDev = &aDev[0];
+  mpu9250_rawData9_t rawData;
 
-  if(cncI2C_WriteByte(I2C1, pDev, data))
-    status = MPU9250_OK;
+  if(mpu9250_readRawData9(pDevice, &rawData) != MPU9250_OK)
+    return status;
+
+  status = mpu9250_convertData9_float(pDevice, &rawData, pAccel, pGyro, pMag);
 
   return status;
 }
 
-static mpu9250_status_t mpu9250_readReg(const uint8_t regAddr, uint8_t *pData)
+/*******************************************************************************
+ * FIFO mode: Accelerometer, Temperature and Gyroscope sampled at sampleRate
+ * [Hz] (<= 1kHz, Gyro_LPF 5..184 Hz) into the FIFO. The FIFO stops when
+ * full and is reset after an overflow is reported.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_initFifo(mpu9250_handle_t *pDevice,
+    uint16_t sampleRate)
 {
   mpu9250_status_t status = MPU9250_ERROR;
+  uint8_t tmpData = 0x00;
 
-  uint8_t aDev[2] = { mpuAddr, regAddr };
-  uint8_t *pDev = &aDev[0];
+  if((sampleRate == 0) || (sampleRate > 1000))
+    return status;
 
-  if(cncI2C_ReadByte(I2C1, pDev, pData))
-    status = MPU9250_OK;
+  mpu9250_shadowSet(pDevice, MPU9250_SAMPLE_RATE_DIV_ADDR,
+                    (uint8_t) ((1000 / sampleRate) - 1));
+
+  /*!< Stop when full: an overflow never leaves misaligned frames behind */
+  mpu9250_shadowSet(pDevice, MPU9250_CONFIG_ADDR,
+      mpu9250_shadowGet(pDevice, MPU9250_CONFIG_ADDR)
+          | MPU9250_CONFIG_FIFO_MODE_MSK);
+  mpu9250_shadowSet(pDevice, MPU9250_FIFO_EN_ADDR, MPU9250_FIFO_SENSORS);
+
+  if(mpu9250_flush(pDevice) != MPU9250_OK)
+    return status;
+
+  tmpData = mpu9250_shadowGet(pDevice, MPU9250_USER_CTRL_ADDR);
+  tmpData |= (MPU9250_USER_FIFO_EN_MSK | MPU9250_USER_FIFO_RST_MSK);
+  if(mpu9250_writeReg(pDevice, MPU9250_USER_CTRL_ADDR, tmpData) != MPU9250_OK)
+    return status;
+
+  status = MPU9250_OK;
+  return status;
+}
+/*******************************************************************************
+ * Drain the FIFO: read FIFO_COUNT, then up to MPU9250_FIFO_BLOCK_SIZE frames
+ * in a single burst.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readFifo(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  pBlock->Count = 0;
+  pBlock->Overflow = 0;
+
+  /*!< FIFO buffers in use by mpu9250_readFifo_async() */
+  if(pDevice->AsyncPending == 1)
+    return status;
+
+  if(mpu9250_readBytes(pDevice, MPU9250_FIFO_COUNTH_ADDR,
+                       &pDevice->FifoCountBuffer[0], 2)
+      != MPU9250_OK)
+    return status;
+
+  pBlock->Count = mpu9250_fifoFrames(&pDevice->FifoCountBuffer[0],
+                                     &pBlock->Overflow);
+
+  if(pBlock->Count > 0)
+  {
+    /*!< FIFO_R_W does not auto-increment: the whole burst comes from FIFO */
+    if(mpu9250_readBytes(pDevice, MPU9250_FIFO_RW_ADDR, &pDevice->FifoBuffer[0],
+                         pBlock->Count*MPU9250_RAW_DATA_LEN) != MPU9250_OK)
+    {
+      pBlock->Count = 0;
+      return status;
+    }
+
+    mpu9250_parseFifo(pDevice, pBlock);
+  }
 
+  if(pBlock->Overflow == 1)
+  {
+    pDevice->FifoResetCmd =
+        mpu9250_shadowGet(pDevice, MPU9250_USER_CTRL_ADDR)
+            | MPU9250_USER_FIFO_RST_MSK;
+    mpu9250_writeReg(pDevice, MPU9250_USER_CTRL_ADDR, pDevice->FifoResetCmd);
+  }
+
+  status = MPU9250_OK;
   return status;
 }
 
-static mpu9250_status_t mpu9250_readBytes(
-    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+/*******************************************************************************
+ * Non-blocking version of mpu9250_readFifo(). Count and data reads are
+ * chained on the I2C transaction queue with control priority (or SPI DMA).
+ * pBlock is valid when callback is called with MPU9250_OK.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_readFifo_async(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock, mpu9250_callback_t callback)
 {
   mpu9250_status_t status = MPU9250_ERROR;
 
-  uint8_t len = count;
-  uint8_t memAddr = regAddr;
+  if(pDevice->AsyncPending == 1)
+    return status;
 
-  while(len--)
-    if(mpu9250_readReg(memAddr++, pData++) == MPU9250_OK)
-      status = MPU9250_OK;
+  pDevice->pAsyncBlock = pBlock;
+  pDevice->AsyncCallback = callback;
+  pDevice->AsyncPending = 1;
+  pDevice->AsyncStart = DWT->CYCCNT;
+
+  pBlock->Count = 0;
+  pBlock->Overflow = 0;
+
+  status = mpu9250_submitRead(pDevice, MPU9250_FIFO_COUNTH_ADDR,
+                              &pDevice->FifoCountBuffer[0], 2,
+                              &mpu9250_fifoCountDone);
+  if(status != MPU9250_OK)
+    pDevice->AsyncPending = 0;
 
   return status;
 }
 
+/*******************************************************************************
+ * Scale a FIFO block. pAccel, pGyro: pBlock->Count*3 values, XYZ interleaved.
+ ******************************************************************************/
+mpu9250_status_t mpu9250_convertBlock_float(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock, float32_t *pAccel, float32_t *pGyro)
+{
+  mpu9250_status_t status = MPU9250_OK;
+
+  for(uint8_t i = 0; i < pBlock->Count; i++)
+    mpu9250_convertData_float(pDevice, &pBlock->Samples[i], &pAccel[3*i],
+                              &pGyro[3*i]);
+
+  return status;
+}
+
+/*******************************************************************************
+ * DWT cycles spent reading one sample. DWT->CYCCNT must be enabled.
+ * pCycles[0] --> register by register path (12 transactions).
+ * pCycles[1] --> burst read path (1 transaction).
+ ******************************************************************************/
+mpu9250_status_t mpu9250_benchmarkRead(mpu9250_handle_t *pDevice,
+    uint32_t *pCycles)
+{
+  mpu9250_status_t status = MPU9250_OK;
+
+  uint8_t rawData[6] = { 0 };
+  uint8_t *pRawBytes = &rawData[0];
+  mpu9250_rawData_t sample;
+  uint32_t startCycles = 0;
+
+  startCycles = DWT->CYCCNT;
+  if(mpu9250_readRegs(pDevice, MPU9250_ACCEL_XOUT_H_ADDR, pRawBytes,
+                      6) != MPU9250_OK)
+    status = MPU9250_ERROR;
+  if(mpu9250_readRegs(pDevice, MPU9250_GYRO_XOUT_H_ADDR, pRawBytes,
+                      6) != MPU9250_OK)
+    status = MPU9250_ERROR;
+  pCycles[0] = DWT->CYCCNT - startCycles;
+
+  startCycles = DWT->CYCCNT;
+  if(mpu9250_readRawData(pDevice, &sample) != MPU9250_OK)
+    status = MPU9250_ERROR;
+  pCycles[1] = DWT->CYCCNT - startCycles;
+
+  return status;
+}
+
+// Private Functions ===========================================================
+static mpu9250_status_t mpu9250_isReady(mpu9250_handle_t *pDevice)
+{
+  mpu9250_status_t status = pDevice->pTransport->probe(pDevice);
+
+  pDevice->Ready = (status == MPU9250_OK) ? 1 : 0;
+
+  return status;
+}
+
+static mpu9250_status_t mpu9250_getStatus(mpu9250_handle_t *pDevice)
+{
+  uint8_t status = MPU9250_ERROR;
+
+  uint8_t mpuStatus = 0x00;
+  uint8_t *pMpuStatus = &mpuStatus;
+
+  if(mpu9250_readReg(pDevice, MPU9250_INT_STATUS_ADDR,
+                     pMpuStatus) == MPU9250_OK)
+    status = MPU9250_OK;
+
+  status =
+      (mpuStatus & MPU9250_INT_DATA_READY_MSK) ? (MPU9250_OK) : (MPU9250_ERROR);
+
+  return status;
+}
+
+static mpu9250_status_t mpu9250_writeReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t data)
+{
+  if(pDevice->pTransport->write(pDevice, regAddr, &data, 1) != MPU9250_OK)
+    return MPU9250_ERROR;
+
+  mpu9250_shadowStore(pDevice, regAddr, &data, 1);
+  return MPU9250_OK;
+}
+
+static mpu9250_status_t mpu9250_readReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData)
+{
+  return pDevice->pTransport->read(pDevice, regAddr, pData, 1);
+}
+
+static mpu9250_status_t mpu9250_readBytes(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  return pDevice->pTransport->read(pDevice, regAddr, pData, count);
+}
+
+static mpu9250_status_t mpu9250_writeBytes(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  if(pDevice->pTransport->write(pDevice, regAddr, pData, count) != MPU9250_OK)
+    return MPU9250_ERROR;
+
+  mpu9250_shadowStore(pDevice, regAddr, pData, count);
+  return MPU9250_OK;
+}
+
+static int16_t mpu9250_saturate(int32_t value)
+{
+  if(value > INT16_MAX)
+    return INT16_MAX;
+
+  if(value < INT16_MIN)
+    return INT16_MIN;
+
+  return (int16_t) value;
+}
+
+/*******************************************************************************
+ * Shadow entry of a register. -1 if the register is not shadowed.
+ ******************************************************************************/
+static int8_t mpu9250_shadowIndex(const uint8_t regAddr)
+{
+  for(uint8_t i = 0; i < MPU9250_SHADOW_SIZE; i++)
+  {
+    if(MPU9250_SHADOW_ADDR[i] == regAddr)
+      return (int8_t) i;
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+ * Write-through: registers just written to the device are clean.
+ ******************************************************************************/
+static void mpu9250_shadowStore(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  int8_t index = 0;
+  uint8_t value = 0x00;
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    index = mpu9250_shadowIndex(regAddr + i);
+    if(index < 0)
+      continue;
+
+    value = pData[i];
+    if(MPU9250_SHADOW_ADDR[index] == MPU9250_USER_CTRL_ADDR)
+      value &= ~MPU9250_USER_RST_MSK;
+    else if(MPU9250_SHADOW_ADDR[index] == MPU9250_PWR_MGMT1_ADDR)
+      value &= ~MPU9250_PWR_RESET_MSK;
+
+    pDevice->Shadow[index] = value;
+    pDevice->ShadowDirty &= ~(1u << index);
+  }
+}
+
+/*******************************************************************************
+ * Read the shadowed registers back, one burst per contiguous block.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_shadowLoad(mpu9250_handle_t *pDevice)
+{
+  uint8_t first = 0;
+  uint8_t count = 0;
+  uint8_t buffer[MPU9250_SHADOW_SIZE] = { 0 };
+
+  while(first < MPU9250_SHADOW_SIZE)
+  {
+    count = 1;
+    while(((first + count) < MPU9250_SHADOW_SIZE)
+        && (MPU9250_SHADOW_ADDR[first + count]
+            == (MPU9250_SHADOW_ADDR[first] + count)))
+      count++;
+
+    if(mpu9250_readBytes(pDevice, MPU9250_SHADOW_ADDR[first], &buffer[0], count)
+        != MPU9250_OK)
+      return MPU9250_ERROR;
+
+    mpu9250_shadowStore(pDevice, MPU9250_SHADOW_ADDR[first], &buffer[0], count);
+    first += count;
+  }
+
+  return MPU9250_OK;
+}
+
+/*******************************************************************************
+ * Stage a register value. Marked dirty only if it changes.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_shadowSet(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t data)
+{
+  int8_t index = mpu9250_shadowIndex(regAddr);
+
+  if(index < 0)
+    return MPU9250_ERROR;
+
+  if(pDevice->Shadow[index] != data)
+  {
+    pDevice->Shadow[index] = data;
+    pDevice->ShadowDirty |= (1u << index);
+  }
+
+  return MPU9250_OK;
+}
+
+static uint8_t mpu9250_shadowGet(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr)
+{
+  int8_t index = mpu9250_shadowIndex(regAddr);
+
+  return (index < 0) ? 0x00 : pDevice->Shadow[index];
+}
+
+/*******************************************************************************
+ * Scale factors from the shadowed full scale settings.
+ ******************************************************************************/
+static void mpu9250_updateResolution(mpu9250_handle_t *pDevice)
+{
+  uint8_t accelScale = 0;
+
+  pDevice->GyroScale = (mpu9250_shadowGet(pDevice, MPU9250_GYRO_CONFIG_ADDR)
+      & MPU9250_GYRO_FS_MSK) >> 3;
+  pDevice->GyroResolution = MPU9250_GYRO_RESOLUTION[pDevice->GyroScale];
+
+  accelScale = (mpu9250_shadowGet(pDevice, MPU9250_ACCEL_CONFIG_ADDR)
+      & MPU9250_ACCEL_FS_MSK) >> 3;
+  pDevice->AccelResolution = MPU9250_ACCEL_RESOLUTION[accelScale];
+}
+
+static void mpu9250_delayUs(uint32_t delay)
+{
+  uint32_t startCycles = DWT->CYCCNT;
+  uint32_t delayCycles = delay*(SystemCoreClock/1000000);
+
+  while((DWT->CYCCNT - startCycles) < delayCycles)
+    ;
+}
+
+/*******************************************************************************
+ * Sum samples read at the 1kHz internal rate (one new sample per read).
+ * Returns the number of good reads.
+ ******************************************************************************/
+static uint16_t mpu9250_sampleSum(mpu9250_handle_t *pDevice,
+    uint16_t samples, int32_t *pAccelSum, int32_t *pGyroSum)
+{
+  mpu9250_rawData_t rawData;
+  uint16_t n = 0;
+  uint32_t startCycles = DWT->CYCCNT;
+  uint32_t periodCycles = MPU9250_CALIB_PERIOD_US*(SystemCoreClock/1000000);
+
+  for(uint16_t i = 0; i < samples; i++)
+  {
+    while((DWT->CYCCNT - startCycles) < periodCycles)
+      ;
+    startCycles += periodCycles;
+
+    if(mpu9250_readRawData(pDevice, &rawData) != MPU9250_OK)
+      continue;
+
+    for(uint8_t u = 0; u < 3; u++)
+    {
+      pAccelSum[u] += rawData.Accel[u];
+      pGyroSum[u] += rawData.Gyro[u];
+    }
+    n++;
+  }
+
+  return n;
+}
+
+/*******************************************************************************
+ * Let the output settle, then average MPU9250_SELFTEST_SAMPLES samples.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_selfTestAverage(mpu9250_handle_t *pDevice,
+    int16_t *pAccel, int16_t *pGyro)
+{
+  int32_t accelSum[3] = { 0 };
+  int32_t gyroSum[3] = { 0 };
+  uint16_t n = 0;
+
+  mpu9250_delayUs(MPU9250_SELFTEST_SETTLE_US);
+
+  n = mpu9250_sampleSum(pDevice, MPU9250_SELFTEST_SAMPLES, &accelSum[0],
+                        &gyroSum[0]);
+  if(n < (MPU9250_SELFTEST_SAMPLES / 2) + 1)
+    return MPU9250_ERROR;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pAccel[i] = (int16_t) (accelSum[i] / n);
+    pGyro[i] = (int16_t) (gyroSum[i] / n);
+  }
+
+  return MPU9250_OK;
+}
+
+/*******************************************************************************
+ * Factory self-test response [LSB]: 2620*1.01^(code - 1). 0: no trim.
+ ******************************************************************************/
+static float32_t mpu9250_selfTestOtp(uint8_t code)
+{
+  float32_t otp = MPU9250_SELFTEST_OTP_BASE;
+
+  if(code == 0)
+    return 0.0f;
+
+  for(uint8_t i = 1; i < code; i++)
+    otp *= 1.01f;
+
+  return otp;
+}
+
+/*******************************************************************************
+ * One transaction per register. Only kept as reference for
+ * mpu9250_benchmarkRead().
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_readRegs(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t len = count;
+  uint8_t memAddr = regAddr;
+
+  while(len--)
+    if(mpu9250_readReg(pDevice, memAddr++, pData++) == MPU9250_OK)
+      status = MPU9250_OK;
+
+  return status;
+}
+
+/*******************************************************************************
+ * Big endian burst (ACCEL_XOUT_H..GYRO_ZOUT_L) to raw sample.
+ ******************************************************************************/
+static void mpu9250_parseRawData(uint8_t *pRawBytes, mpu9250_rawData_t *pRawData)
+{
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pRawData->Accel[i] =
+        (int16_t) (((int16_t) pRawBytes[2 * i] << 8) | pRawBytes[2 * i + 1]);
+    pRawData->Gyro[i] =
+        (int16_t) (((int16_t) pRawBytes[2 * i + 8] << 8) | pRawBytes[2 * i + 9]);
+  }
+
+  pRawData->Temperature =
+      (int16_t) (((int16_t) pRawBytes[6] << 8) | pRawBytes[7]);
+}
+
+/*******************************************************************************
+ * Wait for the end of an I2C slave 4 (single byte) transfer.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_magWait(mpu9250_handle_t *pDevice)
+{
+  uint8_t mstStatus = 0x00;
+  uint32_t startCycles = DWT->CYCCNT;
+  uint32_t timeoutCycles = MPU9250_MAG_TIMEOUT_US*(SystemCoreClock/1000000);
+
+  while((DWT->CYCCNT - startCycles) < timeoutCycles)
+  {
+    if(mpu9250_readReg(pDevice, MPU9250_I2C_MST_STATUS_ADDR,
+                       &mstStatus) != MPU9250_OK)
+      return MPU9250_ERROR;
+
+    if((mstStatus & MPU9250_I2C_SLV4_NACK_MSK) != 0)
+      return MPU9250_ERROR;
+
+    if((mstStatus & MPU9250_I2C_SLV4_DONE_MSK) != 0)
+      return MPU9250_OK;
+  }
+
+  return MPU9250_ERROR;
+}
+
+/*******************************************************************************
+ * AK8963 register write through I2C slave 4.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_magWriteReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t data)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(mpu9250_writeReg(pDevice, MPU9250_I2C_SLV4_ADDRESS_ADDR,
+                      AK8963_ADDR) != MPU9250_OK)
+    return status;
+  if(mpu9250_writeReg(pDevice, MPU9250_I2C_SLV4_REG_ADDR,
+                      regAddr) != MPU9250_OK)
+    return status;
+  if(mpu9250_writeReg(pDevice, MPU9250_I2C_SLV4_DO_ADDR, data) != MPU9250_OK)
+    return status;
+  if(mpu9250_writeReg(pDevice, MPU9250_I2C_SLV4_CTRL_ADDR,
+                      MPU9250_I2C_SLV_EN_MSK)
+      != MPU9250_OK)
+    return status;
+
+  status = mpu9250_magWait(pDevice);
+  return status;
+}
+
+/*******************************************************************************
+ * AK8963 register read through I2C slave 4.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_magReadReg(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(mpu9250_writeReg(pDevice, MPU9250_I2C_SLV4_ADDRESS_ADDR,
+                      (AK8963_ADDR | MPU9250_I2C_SLV_READ_MSK)) != MPU9250_OK)
+    return status;
+  if(mpu9250_writeReg(pDevice, MPU9250_I2C_SLV4_REG_ADDR,
+                      regAddr) != MPU9250_OK)
+    return status;
+  if(mpu9250_writeReg(pDevice, MPU9250_I2C_SLV4_CTRL_ADDR,
+                      MPU9250_I2C_SLV_EN_MSK)
+      != MPU9250_OK)
+    return status;
+
+  if(mpu9250_magWait(pDevice) != MPU9250_OK)
+    return status;
+
+  status = mpu9250_readReg(pDevice, MPU9250_I2C_SLV4_DI_ADDR, pData);
+  return status;
+}
+
+/*******************************************************************************
+ * Asynchronous transfer done (interrupt context).
+ ******************************************************************************/
+static void mpu9250_readDone(mpu9250_handle_t *pDevice, uint8_t busStatus)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(busStatus == 1)
+  {
+    mpu9250_parseRawData(&pDevice->AsyncBuffer[0], pDevice->pAsyncRawData);
+    status = MPU9250_OK;
+  }
+
+  mpu9250_asyncDone(pDevice, status);
+}
+
+/*******************************************************************************
+ * End of an asynchronous read (interrupt context): bus cost from submit to
+ * here, then the user callback.
+ ******************************************************************************/
+static void mpu9250_asyncDone(mpu9250_handle_t *pDevice,
+    mpu9250_status_t status)
+{
+  uint32_t cycles = DWT->CYCCNT - pDevice->AsyncStart;
+
+  pDevice->ReadCycles = cycles;
+  if(cycles > pDevice->MaxReadCycles)
+    pDevice->MaxReadCycles = cycles;
+
+  if(status != MPU9250_OK)
+    pDevice->ReadErrors++;
+
+  pDevice->AsyncPending = 0;
+
+  if(pDevice->AsyncCallback != 0)
+    pDevice->AsyncCallback(pDevice, status);
+}
+
+/*******************************************************************************
+ * Non-blocking register read on the selected bus.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_submitRead(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count,
+    mpu9250_busCallback_t done)
+{
+  return pDevice->pTransport->submit(pDevice, regAddr, pData, count,
+                                     I2C_QUEUE_READ, done);
+}
+
+/*******************************************************************************
+ * Whole frames to read from FIFO_COUNTH/L. The FIFO stops when there is no
+ * room for another frame: that means samples were lost.
+ ******************************************************************************/
+static uint8_t mpu9250_fifoFrames(uint8_t *pCount, uint8_t *pOverflow)
+{
+  uint16_t fifoCount = (uint16_t) (((pCount[0] & 0x1F) << 8) | pCount[1]);
+  uint16_t frames = fifoCount / MPU9250_RAW_DATA_LEN;
+
+  *pOverflow = (fifoCount > (MPU9250_FIFO_SIZE - MPU9250_RAW_DATA_LEN)) ? 1 : 0;
+
+  return (frames > MPU9250_FIFO_BLOCK_SIZE) ?
+      MPU9250_FIFO_BLOCK_SIZE : (uint8_t) frames;
+}
+
+/*******************************************************************************
+ * FIFO burst (pBlock->Count frames) to raw samples.
+ ******************************************************************************/
+static void mpu9250_parseFifo(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock)
+{
+  for(uint8_t i = 0; i < pBlock->Count; i++)
+    mpu9250_parseRawData(&pDevice->FifoBuffer[i*MPU9250_RAW_DATA_LEN],
+                         &pBlock->Samples[i]);
+}
+
+/*******************************************************************************
+ * FIFO_COUNT read (interrupt context): chain the data burst.
+ ******************************************************************************/
+static void mpu9250_fifoCountDone(mpu9250_handle_t *pDevice, uint8_t busStatus)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(busStatus == 1)
+  {
+    pDevice->pAsyncBlock->Count =
+        mpu9250_fifoFrames(&pDevice->FifoCountBuffer[0],
+                           &pDevice->pAsyncBlock->Overflow);
+
+    if(pDevice->pAsyncBlock->Count == 0)
+    {
+      mpu9250_fifoDataDone(pDevice, 1);
+      return;
+    }
+
+    if(mpu9250_submitRead(pDevice, MPU9250_FIFO_RW_ADDR,
+                          &pDevice->FifoBuffer[0],
+                          pDevice->pAsyncBlock->Count*MPU9250_RAW_DATA_LEN,
+                          &mpu9250_fifoDataDone) == MPU9250_OK)
+      return;
+
+    pDevice->pAsyncBlock->Count = 0;
+  }
+
+  mpu9250_asyncDone(pDevice, status);
+}
+
+/*******************************************************************************
+ * FIFO burst read (interrupt context). After an overflow the FIFO is reset.
+ ******************************************************************************/
+static void mpu9250_fifoDataDone(mpu9250_handle_t *pDevice, uint8_t busStatus)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(busStatus == 1)
+  {
+    mpu9250_parseFifo(pDevice, pDevice->pAsyncBlock);
+    status = MPU9250_OK;
+  }
+  else
+    pDevice->pAsyncBlock->Count = 0;
+
+  if(pDevice->pAsyncBlock->Overflow == 1)
+  {
+    pDevice->FifoResetCmd =
+        mpu9250_shadowGet(pDevice, MPU9250_USER_CTRL_ADDR)
+            | MPU9250_USER_FIFO_RST_MSK;
+    pDevice->pTransport->submit(pDevice, MPU9250_USER_CTRL_ADDR,
+                                &pDevice->FifoResetCmd, 1, I2C_QUEUE_WRITE, 0);
+  }
+
+  mpu9250_asyncDone(pDevice, status);
+}
+
+// I2C transport ===============================================================
+/*******************************************************************************
+ * Probe the configured address, or both I2C addresses (AD0 low/high) if none
+ * was given.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_i2cProbe(mpu9250_handle_t *pDevice)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(pDevice->Address != 0)
+  {
+    if(cncI2C_isDeviceReady(pDevice->I2Cx, pDevice->Address))
+      status = MPU9250_OK;
+  }
+  else if(cncI2C_isDeviceReady(pDevice->I2Cx, MPU9250_ADDR))
+  {
+    pDevice->Address = MPU9250_ADDR;
+    status = MPU9250_OK;
+  }
+  else if(cncI2C_isDeviceReady(pDevice->I2Cx, MPU9250_ADDR_ALT))
+  {
+    pDevice->Address = MPU9250_ADDR_ALT;
+    status = MPU9250_OK;
+  }
+
+  return status;
+}
+
+static mpu9250_status_t mpu9250_i2cWrite(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t aDev[2] = { pDevice->Address, regAddr };
+  uint8_t *pDev = &aDev[0];
+
+  if(cncI2C_WriteMultipleBytes(pDevice->I2Cx, pDev, pData, count) == count)
+    status = MPU9250_OK;
+
+  return status;
+}
+
+static mpu9250_status_t mpu9250_i2cRead(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  uint8_t aDev[2] = { pDevice->Address, regAddr };
+  uint8_t *pDev = &aDev[0];
+
+  if(count == 1)
+  {
+    if(cncI2C_ReadByte(pDevice->I2Cx, pDev, pData))
+      status = MPU9250_OK;
+  }
+  else if(cncI2C_ReadMultipleBytes(pDevice->I2Cx, pDev, pData, count))
+    status = MPU9250_OK;
+
+  return status;
+}
+
+/*******************************************************************************
+ * Queue a control priority transaction. Deadline scales with the length.
+ * Only one transaction with callback is in flight (reads are chained).
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_i2cSubmit(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count,
+    i2c_direction_t direction, mpu9250_busCallback_t done)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  i2c_transaction_t transaction;
+
+  transaction.DevAddr = pDevice->Address;
+  transaction.RegAddr = regAddr;
+  transaction.pData = pData;
+  transaction.Count = count;
+  transaction.Direction = direction;
+  transaction.Priority = I2C_QUEUE_PRIORITY_CONTROL;
+  transaction.TimeoutUs = MPU9250_READ_TIMEOUT_US + count*MPU9250_BYTE_TIMEOUT_US;
+  transaction.Callback = (done != 0) ? &mpu9250_i2cDone : 0;
+  transaction.pContext = pDevice;
+
+  if(done != 0)
+    pDevice->BusCallback = done;
+
+  if(cncI2CQueue_submit(pDevice->I2Cx, &transaction))
+    status = MPU9250_OK;
+
+  return status;
+}
+
+/*******************************************************************************
+ * Queue transaction done (interrupt context).
+ ******************************************************************************/
+static void mpu9250_i2cDone(void *pContext, uint8_t i2cStatus)
+{
+  mpu9250_handle_t *pDevice = (mpu9250_handle_t *) pContext;
+  mpu9250_busCallback_t callback = pDevice->BusCallback;
+
+  if(callback != 0)
+    callback(pDevice, i2cStatus);
+}
+
+// SPI transport ===============================================================
+/*******************************************************************************
+ * Sensor, interrupt status, external sensor and FIFO registers are read at
+ * high speed. Anything else (and every write) at 1 MHz max.
+ ******************************************************************************/
+static spi_prescaler_t mpu9250_spiPrescaler(const uint8_t regAddr)
+{
+  if((regAddr >= MPU9250_INT_STATUS_ADDR) &&
+     (regAddr <= MPU9250_EXT_SENS_DATA_23_ADDR))
+    return MPU9250_SPI_PRESCALER_DATA;
+
+  if((regAddr >= MPU9250_FIFO_COUNTH_ADDR) && (regAddr <= MPU9250_FIFO_RW_ADDR))
+    return MPU9250_SPI_PRESCALER_DATA;
+
+  return MPU9250_SPI_PRESCALER_CONFIG;
+}
+
+/*******************************************************************************
+ * No address on SPI: the device answers WHO_AM_I or it is not there. The
+ * chip select is taken by the first device that answers.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_spiProbe(mpu9250_handle_t *pDevice)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+  uint8_t devID = 0x00;
+
+  if((pSpiDevice != 0) && (pSpiDevice != pDevice))
+    return status;
+
+  if(cncSPI_setPrescaler(MPU9250_SPI, MPU9250_SPI_PRESCALER_CONFIG) != 1)
+    return status;
+
+  if(cncSPI_ReadMultipleBytes(MPU9250_SPI, MPU9250_WHO_AM_I_ADDR, &devID, 1) &&
+     (devID == MPU9250_DEVICE_ID))
+  {
+    pSpiDevice = pDevice;
+    status = MPU9250_OK;
+  }
+
+  return status;
+}
+
+static mpu9250_status_t mpu9250_spiWrite(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(pDevice != pSpiDevice)
+    return status;
+
+  if(cncSPI_setPrescaler(MPU9250_SPI, MPU9250_SPI_PRESCALER_CONFIG) != 1)
+    return status;
+
+  if(cncSPI_WriteMultipleBytes(MPU9250_SPI, regAddr, pData, count))
+    status = MPU9250_OK;
+
+  return status;
+}
+
+static mpu9250_status_t mpu9250_spiRead(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+
+  if(pDevice != pSpiDevice)
+    return status;
+
+  if(cncSPI_setPrescaler(MPU9250_SPI, mpu9250_spiPrescaler(regAddr)) != 1)
+    return status;
+
+  if(cncSPI_ReadMultipleBytes(MPU9250_SPI, regAddr, pData, count))
+    status = MPU9250_OK;
+
+  return status;
+}
+
+/*******************************************************************************
+ * Start a DMA transfer. No queue: fails if the bus is busy.
+ ******************************************************************************/
+static mpu9250_status_t mpu9250_spiSubmit(mpu9250_handle_t *pDevice,
+    const uint8_t regAddr, uint8_t *pData, uint8_t count,
+    i2c_direction_t direction, mpu9250_busCallback_t done)
+{
+  mpu9250_status_t status = MPU9250_ERROR;
+  spi_prescaler_t prescaler = MPU9250_SPI_PRESCALER_CONFIG;
+  cncSPI_callback_t callback = 0;
+  uint8_t started = 0;
+
+  if(pDevice != pSpiDevice)
+    return status;
+
+  if(direction == I2C_QUEUE_READ)
+    prescaler = mpu9250_spiPrescaler(regAddr);
+
+  if(cncSPI_setPrescaler(MPU9250_SPI, prescaler) != 1)
+    return status;
+
+  if(done != 0)
+  {
+    pDevice->BusCallback = done;
+    callback = &mpu9250_spiDone;
+  }
+
+  if(direction == I2C_QUEUE_READ)
+    started = cncSPI_ReadAsync(MPU9250_SPI, regAddr, pData, count, callback,
+                               pDevice);
+  else
+    started = cncSPI_WriteAsync(MPU9250_SPI, regAddr, pData, count, callback,
+                                pDevice);
+
+  if(started == 1)
+    status = MPU9250_OK;
+
+  return status;
+}
+
+/*******************************************************************************
+ * SPI DMA transfer done (interrupt context).
+ ******************************************************************************/
+static void mpu9250_spiDone(void *pContext, uint8_t spiStatus)
+{
+  mpu9250_handle_t *pDevice = (mpu9250_handle_t *) pContext;
+  mpu9250_busCallback_t callback = pDevice->BusCallback;
+
+  if(callback != 0)
+    callback(pDevice, spiStatus);
+}
+
 // EOF =========================================================================
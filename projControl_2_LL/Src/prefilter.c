@@ -0,0 +1,218 @@
+// Includes ====================================================================
+#include "prefilter.h"
+#include "arm_math.h"
+
+// =============================================================================
+/*!< Channels: gyro X, Y, Z then accel X, Y, Z */
+#define PREFILTER_CHANNELS    6
+
+static float32_t aCoeffs[2][5*PREFILTER_MAX_SECTIONS];
+static float32_t aState[PREFILTER_CHANNELS][2*PREFILTER_MAX_SECTIONS];
+static float32_t aChannel[PREFILTER_CHANNELS][MPU9250_FIFO_BLOCK_SIZE];
+static arm_biquad_cascade_df2T_instance_f32 filters[PREFILTER_CHANNELS];
+static prefilter_type_t aTypes[2][PREFILTER_MAX_SECTIONS];
+static prefilter_stats_t stats;
+static float32_t rate = 0.0f;
+
+// Private functions prototypes ================================================
+static void prefilter_setStages(prefilter_sensor_t sensor);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the bank, every section PREFILTER_NONE.
+ * @param   sampleRate: sensor sample rate [Hz].
+ * @retval  1 if successful. 0 if sampleRate is 0.
+ ******************************************************************************/
+uint8_t prefilter_init(float32_t sampleRate)
+{
+  if(sampleRate <= 0.0f)
+    return 0;
+
+  rate = sampleRate;
+
+  for(uint8_t sensor = 0; sensor < 2; sensor++)
+  {
+    for(uint8_t i = 0; i < PREFILTER_MAX_SECTIONS; i++)
+    {
+      aTypes[sensor][i] = PREFILTER_NONE;
+      aCoeffs[sensor][5*i] = 1.0f;
+      for(uint8_t j = 1; j < 5; j++)
+        aCoeffs[sensor][5*i + j] = 0.0f;
+    }
+  }
+
+  for(uint8_t ch = 0; ch < PREFILTER_CHANNELS; ch++)
+    arm_biquad_cascade_df2T_init_f32(&filters[ch], PREFILTER_MAX_SECTIONS,
+                                     &aCoeffs[ch/3][0], &aState[ch][0]);
+
+  prefilter_setStages(PREFILTER_GYRO);
+  prefilter_setStages(PREFILTER_ACCEL);
+  prefilter_reset();
+
+  stats.Cycles = 0;
+  stats.SampleCycles = 0;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Set one section of a sensor cascade.
+ * @param   sensor: cascade.
+ * @param   index: section, 0..PREFILTER_MAX_SECTIONS-1.
+ * @param   pSection: type, frequency and Q.
+ * @retval  1 if successful. 0 if index, frequency or Q is out of range.
+ ******************************************************************************/
+uint8_t prefilter_setSection(prefilter_sensor_t sensor, uint8_t index,
+                             const prefilter_section_t *pSection)
+{
+  float32_t coeffs[5] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+  float32_t sinW0 = 0.0f, cosW0 = 0.0f;
+  float32_t alpha = 0.0f, a0 = 0.0f;
+  uint32_t primask = 0;
+
+  if((sensor > PREFILTER_ACCEL) || (index >= PREFILTER_MAX_SECTIONS))
+    return 0;
+
+  if(pSection->Type != PREFILTER_NONE)
+  {
+    if((pSection->Frequency <= 0.0f) || (pSection->Frequency >= 0.5f*rate)
+        || (pSection->Q <= 0.0f))
+      return 0;
+
+    /*!< w0 = 2*pi*f/fs, arm_sin_cos_f32() takes degrees */
+    arm_sin_cos_f32(360.0f*pSection->Frequency/rate, &sinW0, &cosW0);
+    alpha = sinW0/(2.0f*pSection->Q);
+    a0 = 1.0f + alpha;
+
+    if(pSection->Type == PREFILTER_LOWPASS)
+    {
+      coeffs[0] = 0.5f*(1.0f - cosW0)/a0;
+      coeffs[1] = (1.0f - cosW0)/a0;
+      coeffs[2] = coeffs[0];
+    }
+    else
+    {
+      coeffs[0] = 1.0f/a0;
+      coeffs[1] = -2.0f*cosW0/a0;
+      coeffs[2] = coeffs[0];
+    }
+
+    /*!< CMSIS adds the feedback terms: a1, a2 with the sign changed */
+    coeffs[3] = 2.0f*cosW0/a0;
+    coeffs[4] = -(1.0f - alpha)/a0;
+  }
+
+  /*!< Set from a lower priority context (e.g. the vibration analyzer): a
+   *   block never runs with half of the new coefficients */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  for(uint8_t j = 0; j < 5; j++)
+    aCoeffs[sensor][5*index + j] = coeffs[j];
+
+  /*!< Off, the section state is whatever it held when it was last run:
+   *   turned back on it starts from rest. A retune keeps it */
+  if((aTypes[sensor][index] == PREFILTER_NONE)
+      && (pSection->Type != PREFILTER_NONE))
+  {
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      aState[3*sensor + axis][2*index] = 0.0f;
+      aState[3*sensor + axis][2*index + 1] = 0.0f;
+    }
+  }
+
+  aTypes[sensor][index] = pSection->Type;
+  prefilter_setStages(sensor);
+  __set_PRIMASK(primask);
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Filter one block in place.
+ * @param   pAccel: accelerometer, XYZ interleaved.
+ * @param   pGyro: gyroscope, XYZ interleaved.
+ * @param   count: samples, up to MPU9250_FIFO_BLOCK_SIZE.
+ * @retval  None.
+ ******************************************************************************/
+void prefilter_processBlock(float32_t *pAccel, float32_t *pGyro,
+                            uint8_t count)
+{
+  float32_t *apSensor[2] = { pGyro, pAccel };
+  float32_t *pData = 0;
+  uint32_t startCycles = DWT->CYCCNT;
+
+  if((count == 0) || (count > MPU9250_FIFO_BLOCK_SIZE))
+    return;
+
+  for(uint8_t sensor = 0; sensor < 2; sensor++)
+  {
+    if(stats.Sections[sensor] == 0)
+      continue;
+
+    pData = apSensor[sensor];
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+      for(uint8_t axis = 0; axis < 3; axis++)
+        aChannel[3*sensor + axis][i] = pData[3*i + axis];
+    }
+
+    for(uint8_t axis = 0; axis < 3; axis++)
+      arm_biquad_cascade_df2T_f32(&filters[3*sensor + axis],
+                                  &aChannel[3*sensor + axis][0],
+                                  &aChannel[3*sensor + axis][0], count);
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+      for(uint8_t axis = 0; axis < 3; axis++)
+        pData[3*i + axis] = aChannel[3*sensor + axis][i];
+    }
+  }
+
+  stats.Cycles = DWT->CYCCNT - startCycles;
+  stats.SampleCycles = stats.Cycles/count;
+}
+
+/*******************************************************************************
+ * @brief   Clear the filter states (e.g. after a gap in the samples).
+ * @retval  None.
+ ******************************************************************************/
+void prefilter_reset(void)
+{
+  for(uint8_t ch = 0; ch < PREFILTER_CHANNELS; ch++)
+  {
+    for(uint8_t i = 0; i < 2*PREFILTER_MAX_SECTIONS; i++)
+      aState[ch][i] = 0.0f;
+  }
+}
+
+/*******************************************************************************
+ * @brief   Sections in use and cost.
+ * @retval  Statistics.
+ ******************************************************************************/
+const prefilter_stats_t *prefilter_getStats(void)
+{
+  return &stats;
+}
+
+// Private functions ===========================================================
+/*!< Stages run: up to the last section in use. A section set back to
+ *   PREFILTER_NONE inside the cascade passes through */
+static void prefilter_setStages(prefilter_sensor_t sensor)
+{
+  uint8_t stages = 0;
+
+  for(uint8_t i = 0; i < PREFILTER_MAX_SECTIONS; i++)
+  {
+    if(aTypes[sensor][i] != PREFILTER_NONE)
+      stages = i + 1;
+  }
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+    filters[3*sensor + axis].numStages = stages;
+
+  stats.Sections[sensor] = stages;
+}
+
+// EOF =========================================================================
@@ -0,0 +1,354 @@
+// Includes ====================================================================
+#include "vibration.h"
+#include "arm_math.h"
+
+// =============================================================================
+/*!< Windows being filled by the tick and taken by the analysis */
+static float32_t aWindow[2][VIBRATION_FFT_SIZE];
+static uint8_t aWindowAxis[2];
+static __IO uint8_t fillIndex = 0;
+static __IO uint16_t fillCount = 0;
+static __IO uint8_t windowReady = 0;
+static uint8_t fillAxis = 0;
+
+/*!< Analysis, main loop only */
+static float32_t aTaper[VIBRATION_FFT_SIZE];  /*!< Hann, amplitude scaled */
+static float32_t aFrame[VIBRATION_FFT_SIZE];  /*!< Overwritten by the FFT */
+static float32_t aBins[VIBRATION_FFT_SIZE];   /*!< Packed complex spectrum */
+static float32_t aMagnitude[VIBRATION_BINS];
+static float32_t aSpectrum[VIBRATION_BINS];
+static arm_rfft_fast_instance_f32 fft;
+static uint8_t spectrumAxis = 0;
+static uint8_t spectrumNew = 0;
+static uint8_t spectrumHeld = 0;
+static uint8_t lostWindows = 0;
+
+static vibration_init_t settings;
+static vibration_stats_t stats;
+static float32_t binWidth = 0.0f;             /*!< [Hz], 0: not initialised */
+
+// Private functions prototypes ================================================
+static void vibration_findPeaks(uint8_t axis);
+static void vibration_updateNotch(void);
+
+// Public functions ============================================================
+/*******************************************************************************
+ * @brief   Init the analyzer, no window, no notch.
+ * @param   vibration_InitStruct: settings.
+ * @retval  1 if successful. 0 if a setting is out of range.
+ ******************************************************************************/
+uint8_t vibration_init(vibration_init_t *vibration_InitStruct)
+{
+  if((vibration_InitStruct->SampleRate <= 0.0f)
+      || (vibration_InitStruct->MinFrequency < 0.0f)
+      || (vibration_InitStruct->Threshold < 0.0f)
+      || (vibration_InitStruct->NotchSection >= PREFILTER_MAX_SECTIONS)
+      || (vibration_InitStruct->NotchQ <= 0.0f))
+    return 0;
+
+  if(arm_rfft_fast_init_f32(&fft, VIBRATION_FFT_SIZE) != ARM_MATH_SUCCESS)
+    return 0;
+
+  settings = *vibration_InitStruct;
+
+  /*!< Periodic Hann. Coherent gain 1/2 and one sided spectrum: 4/N gives
+   *   the amplitude of a sine */
+  for(uint16_t i = 0; i < VIBRATION_FFT_SIZE; i++)
+    aTaper[i] = (2.0f/VIBRATION_FFT_SIZE)
+        *(1.0f - arm_cos_f32(2.0f*PI*i/VIBRATION_FFT_SIZE));
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+  {
+    for(uint8_t i = 0; i < VIBRATION_MAX_PEAKS; i++)
+    {
+      stats.Peaks[axis][i].Frequency = 0.0f;
+      stats.Peaks[axis][i].Amplitude = 0.0f;
+      stats.Peaks[axis][i].Stable = 0;
+    }
+  }
+
+  stats.NotchFrequency = 0.0f;
+  stats.Axis = 0;
+  stats.Windows = 0;
+  stats.Dropped = 0;
+  stats.Cycles = 0;
+
+  fillIndex = 0;
+  fillCount = 0;
+  fillAxis = 0;
+  aWindowAxis[0] = 0;
+  windowReady = 0;
+  spectrumNew = 0;
+  spectrumHeld = 0;
+  lostWindows = 0;
+
+  binWidth = vibration_InitStruct->SampleRate/VIBRATION_FFT_SIZE;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Collect the samples of one block. Control tick.
+ * @param   pGyro: gyroscope, XYZ interleaved [dps].
+ * @param   count: samples.
+ * @retval  None.
+ ******************************************************************************/
+void vibration_addBlock(const float32_t *pGyro, uint8_t count)
+{
+  float32_t *pFill = &aWindow[fillIndex][0];
+  uint16_t n = fillCount;
+
+  if(binWidth == 0.0f)
+    return;
+
+  /*!< Gap in the samples: the window would not be uniformly sampled */
+  if(count == 0)
+  {
+    fillCount = 0;
+    return;
+  }
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    pFill[n++] = pGyro[3*i + fillAxis];
+
+    if(n == VIBRATION_FFT_SIZE)
+    {
+      if(windowReady == 0)
+      {
+        fillIndex ^= 0x01;
+        windowReady = 1;
+        fillAxis = (fillAxis + 1) % 3;
+        aWindowAxis[fillIndex] = fillAxis;
+        pFill = &aWindow[fillIndex][0];
+      }
+      else
+        stats.Dropped++;
+
+      n = 0;
+    }
+  }
+
+  fillCount = n;
+}
+
+/*******************************************************************************
+ * @brief   A full window waits for vibration_process().
+ * @retval  1 if a window is ready.
+ ******************************************************************************/
+uint8_t vibration_isReady(void)
+{
+  return windowReady;
+}
+
+/*******************************************************************************
+ * @brief   Analyse the ready window, if any. Background (main loop).
+ * @retval  1 if a window was analysed.
+ ******************************************************************************/
+uint8_t vibration_process(void)
+{
+  uint32_t startCycles = DWT->CYCCNT;
+  uint8_t k = 0;
+  uint8_t axis = 0;
+  float32_t mean = 0.0f;
+
+  if(windowReady == 0)
+    return 0;
+
+  /*!< The tick only swaps the buffers while no window is ready */
+  k = fillIndex ^ 0x01;
+  axis = aWindowAxis[k];
+
+  arm_mean_f32(&aWindow[k][0], VIBRATION_FFT_SIZE, &mean);
+  arm_offset_f32(&aWindow[k][0], -mean, &aFrame[0], VIBRATION_FFT_SIZE);
+  arm_mult_f32(&aFrame[0], &aTaper[0], &aFrame[0], VIBRATION_FFT_SIZE);
+
+  /*!< Copied: the tick may hand over the next one */
+  windowReady = 0;
+
+  arm_rfft_fast_f32(&fft, &aFrame[0], &aBins[0], 0);
+
+  /*!< Packed output: DC and Nyquist real parts first. Both are one sided
+   *   already, half the scale of the other bins */
+  aMagnitude[0] = 0.5f*fabsf(aBins[0]);
+  aMagnitude[VIBRATION_BINS - 1] = 0.5f*fabsf(aBins[1]);
+  arm_cmplx_mag_f32(&aBins[2], &aMagnitude[1], VIBRATION_BINS - 2);
+
+  vibration_findPeaks(axis);
+
+  if(settings.AutoNotch == 1)
+    vibration_updateNotch();
+
+  if(spectrumHeld == 0)
+  {
+    arm_copy_f32(&aMagnitude[0], &aSpectrum[0], VIBRATION_BINS);
+    spectrumAxis = axis;
+    spectrumNew = 1;
+  }
+
+  stats.Axis = axis;
+  stats.Windows++;
+  stats.Cycles = DWT->CYCCNT - startCycles;
+
+  return 1;
+}
+
+/*******************************************************************************
+ * @brief   Restart the window being filled (e.g. after a gap in the
+ *          samples). Not while the tick runs.
+ * @retval  None.
+ ******************************************************************************/
+void vibration_reset(void)
+{
+  fillCount = 0;
+}
+
+/*******************************************************************************
+ * @brief   Hold the last spectrum until vibration_releaseSpectrum().
+ * @param   pAxis: axis of the spectrum.
+ * @retval  VIBRATION_BINS amplitudes [dps], bin k at k*SampleRate/
+ *          VIBRATION_FFT_SIZE. 0 if there is no new one.
+ ******************************************************************************/
+const float32_t *vibration_holdSpectrum(uint8_t *pAxis)
+{
+  if(spectrumNew == 0)
+    return 0;
+
+  spectrumNew = 0;
+  spectrumHeld = 1;
+  *pAxis = spectrumAxis;
+
+  return &aSpectrum[0];
+}
+
+/*******************************************************************************
+ * @brief   Let the analysis update the spectrum again.
+ * @retval  None.
+ ******************************************************************************/
+void vibration_releaseSpectrum(void)
+{
+  spectrumHeld = 0;
+}
+
+/*******************************************************************************
+ * @brief   Peaks, notch and cost.
+ * @retval  Statistics.
+ ******************************************************************************/
+const vibration_stats_t *vibration_getStats(void)
+{
+  return &stats;
+}
+
+// Private functions ===========================================================
+/*!< Strongest local maxima of aMagnitude, refined by a parabola through the
+ *   bin and its neighbours, matched against the previous peaks of the axis */
+static void vibration_findPeaks(uint8_t axis)
+{
+  vibration_peak_t aFound[VIBRATION_MAX_PEAKS] = { 0 };
+  vibration_peak_t *pPrevious = &stats.Peaks[axis][0];
+  float32_t a = 0.0f, b = 0.0f, c = 0.0f;
+  float32_t delta = 0.0f, amplitude = 0.0f;
+  uint16_t first = (uint16_t)(settings.MinFrequency/binWidth) + 1;
+  uint8_t j = 0;
+
+  for(uint16_t k = first; k < (VIBRATION_BINS - 1); k++)
+  {
+    a = aMagnitude[k - 1];
+    b = aMagnitude[k];
+    c = aMagnitude[k + 1];
+
+    if((b <= a) || (b < c) || (b < settings.Threshold))
+      continue;
+
+    delta = ((a - 2.0f*b + c) < 0.0f) ? 0.5f*(a - c)/(a - 2.0f*b + c) : 0.0f;
+    amplitude = b - 0.25f*(a - c)*delta;
+
+    /*!< Sorted insert, strongest first */
+    for(j = VIBRATION_MAX_PEAKS; j > 0; j--)
+    {
+      if(aFound[j - 1].Amplitude >= amplitude)
+        break;
+
+      if(j < VIBRATION_MAX_PEAKS)
+        aFound[j] = aFound[j - 1];
+    }
+
+    if(j < VIBRATION_MAX_PEAKS)
+    {
+      aFound[j].Frequency = (k + delta)*binWidth;
+      aFound[j].Amplitude = amplitude;
+    }
+  }
+
+  for(uint8_t i = 0; i < VIBRATION_MAX_PEAKS; i++)
+  {
+    if(aFound[i].Frequency == 0.0f)
+      continue;
+
+    aFound[i].Stable = 1;
+
+    for(j = 0; j < VIBRATION_MAX_PEAKS; j++)
+    {
+      if((pPrevious[j].Frequency != 0.0f)
+          && (fabsf(aFound[i].Frequency - pPrevious[j].Frequency)
+              <= VIBRATION_TRACK_BINS*binWidth))
+      {
+        if(pPrevious[j].Stable < 255)
+          aFound[i].Stable = pPrevious[j].Stable + 1;
+        else
+          aFound[i].Stable = 255;
+        break;
+      }
+    }
+  }
+
+  for(uint8_t i = 0; i < VIBRATION_MAX_PEAKS; i++)
+    pPrevious[i] = aFound[i];
+}
+
+/*!< Notch on the strongest stable peak of any axis */
+static void vibration_updateNotch(void)
+{
+  prefilter_section_t section = { PREFILTER_NONE, 0.0f, 0.0f };
+  vibration_peak_t *pBest = 0;
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+  {
+    for(uint8_t i = 0; i < VIBRATION_MAX_PEAKS; i++)
+    {
+      if((stats.Peaks[axis][i].Stable >= VIBRATION_STABLE_WINDOWS)
+          && ((pBest == 0)
+              || (stats.Peaks[axis][i].Amplitude > pBest->Amplitude)))
+        pBest = &stats.Peaks[axis][i];
+    }
+  }
+
+  if(pBest == 0)
+  {
+    if(lostWindows < VIBRATION_LOST_WINDOWS)
+      lostWindows++;
+
+    if((lostWindows == VIBRATION_LOST_WINDOWS)
+        && (stats.NotchFrequency != 0.0f)
+        && (prefilter_setSection(PREFILTER_GYRO, settings.NotchSection,
+                                 &section) == 1))
+      stats.NotchFrequency = 0.0f;
+
+    return;
+  }
+
+  lostWindows = 0;
+
+  if(fabsf(pBest->Frequency - stats.NotchFrequency) < 0.5f*binWidth)
+    return;
+
+  section.Type = PREFILTER_NOTCH;
+  section.Frequency = pBest->Frequency;
+  section.Q = settings.NotchQ;
+
+  if(prefilter_setSection(PREFILTER_GYRO, settings.NotchSection,
+                          &section) == 1)
+    stats.NotchFrequency = pBest->Frequency;
+}
+
+// EOF =========================================================================
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * @file    host.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Host (PC) build of the target sources: the core registers used by
+ *          the drivers on plain memory, C versions of the DSP intrinsics and
+ *          a minimal check/report helper.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Include it after the module header and before the module source:
+        #include "prefilter.h"
+        #include "host.h"
+        #include "../Src/prefilter.c"
+    The source sees DWT->CYCCNT and PRIMASK as variables.
+  - One module source per test binary: the modules share static names.
+    Other sources a test needs are listed in run_host_tests.sh and built
+    on their own, with this header forced in (-include).
+  - __QADD, __PKHBT, __SMUAD and __RBIT (LL POSITION_VAL) are inline
+    assembly in cmsis_gcc.h: calls go to the C versions below.
+  - HOST_CHECK(cond, ...): prints the message, counts failures.
+    HOST_REPORT(): PASS/FAIL line, exit status for run_host_tests.sh.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef HOST_H_
+#define HOST_H_
+
+//Includes =====================================================================
+#include "stm32f4xx.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+// =============================================================================
+static DWT_Type hostDwt;
+static uint32_t hostPrimask = 0;
+static uint32_t hostFailures = 0;
+
+#undef DWT
+#define DWT                 (&hostDwt)
+
+#define __disable_irq()     (hostPrimask = 1)
+#define __enable_irq()      (hostPrimask = 0)
+#define __get_PRIMASK()     (hostPrimask)
+#define __set_PRIMASK(x)    (hostPrimask = (x))
+
+#define __QADD(a, b)        hostQadd((a), (b))
+#define __SMUAD(a, b)       hostSmuad((a), (b))
+#undef __PKHBT
+#define __PKHBT(a, b, s)    hostPkhbt((a), (b), (s))
+#define __RBIT(x)           hostRbit((x))
+
+static inline int32_t hostQadd(int32_t a, int32_t b)
+{
+  int64_t sum = (int64_t)a + b;
+
+  return (sum > INT32_MAX) ? INT32_MAX : ((sum < INT32_MIN) ? INT32_MIN : (int32_t)sum);
+}
+
+static inline uint32_t hostSmuad(uint32_t a, uint32_t b)
+{
+  return (uint32_t)((int32_t)(int16_t)a*(int16_t)b
+                    + (int32_t)(int16_t)(a >> 16)*(int16_t)(b >> 16));
+}
+
+static inline uint32_t hostPkhbt(uint32_t a, uint32_t b, uint32_t shift)
+{
+  return (a & 0x0000FFFFU) | ((b << shift) & 0xFFFF0000U);
+}
+
+static inline uint32_t hostRbit(uint32_t value)
+{
+  uint32_t result = 0;
+
+  for(uint8_t i = 0; i < 32; i++)
+    result |= ((value >> i) & 0x1U) << (31 - i);
+
+  return result;
+}
+
+#define HOST_CHECK(cond, ...)                                                  \
+  do                                                                           \
+  {                                                                            \
+    if(!(cond))                                                                \
+    {                                                                          \
+      hostFailures++;                                                          \
+      printf("  FAIL %s:%d: ", __FILE__, __LINE__);                            \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+    }                                                                          \
+  } while(0)
+
+#define HOST_REPORT(name)                                                      \
+  do                                                                           \
+  {                                                                            \
+    printf("%s: %s\n", (name), (hostFailures == 0) ? "PASS" : "FAIL");         \
+    return (hostFailures == 0) ? 0 : 1;                                        \
+  } while(0)
+
+#endif /* HOST_H_ */
+// EOF =========================================================================
@@ -0,0 +1,272 @@
+/*******************************************************************************
+ * @file    mpu9250_stub.h
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   Fake MPU9250 behind the I2C (blocking + transaction queue) and SPI
+ *          (blocking + DMA) driver calls of mpu9250.c: one 128-byte register
+ *          file and a FIFO, shared by both buses.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Include it after the module source, once per test binary:
+        #include "mpu9250.h"
+        #include "host.h"
+        #include "../Src/mpu9250.c"
+        #include "mpu9250_stub.h"
+  - Register file: auto-increment on bursts, FIFO_R_W pops the FIFO (no
+    increment), FIFO_COUNTH/L follow it, INT_STATUS always reports data
+    ready. H_RESET (PWR_MGMT1) and FIFO_RST (USER_CTRL) act at once.
+  - I2C answers at stubImu.Address on stubImu.I2Cx only. Asynchronous
+    transfers complete inside the submit call.
+  - Every bus transfer moves DWT->CYCCNT on by STUB_BUS_CYCLES, so the
+    driver polling loops see time pass.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#ifndef MPU9250_STUB_H_
+#define MPU9250_STUB_H_
+
+//Includes =====================================================================
+#include <string.h>
+
+// =============================================================================
+#define STUB_REGS           128
+#define STUB_FIFO_SIZE      512
+#define STUB_FRAME          14
+#define STUB_BUS_CYCLES     1000
+
+#define STUB_WHO_AM_I       0x75
+#define STUB_PWR_MGMT1      0x6B
+#define STUB_USER_CTRL      0x6A
+#define STUB_INT_STATUS     0x3A
+#define STUB_FIFO_COUNTH    0x72
+#define STUB_FIFO_COUNTL    0x73
+#define STUB_FIFO_RW        0x74
+
+typedef struct
+{
+  uint8_t Regs[STUB_REGS];
+  uint8_t Fifo[STUB_FIFO_SIZE];
+  uint16_t FifoCount;
+  I2C_TypeDef *I2Cx;                  /*!< Bus the device sits on */
+  uint8_t Address;                    /*!< 7 bits I2C address */
+  uint32_t I2cTransfers;              /*!< Every call, probe included */
+  uint32_t SpiTransfers;
+  uint32_t Reads;                     /*!< Read transactions, both buses */
+  uint32_t Writes;
+  spi_prescaler_t Prescaler;
+  spi_prescaler_t ReadPrescaler;      /*!< Of the last SPI read */
+  uint8_t FastWrites;                 /*!< SPI writes above 1 MHz */
+} stubImu_t;
+
+uint32_t SystemCoreClock = 168000000;
+
+static stubImu_t stubImu;
+
+/*!< Register values after power-on or H_RESET */
+static void stubImu_powerOn(void)
+{
+  memset(&stubImu.Regs[0], 0, STUB_REGS);
+  stubImu.Regs[STUB_WHO_AM_I] = 0x71;
+  stubImu.Regs[STUB_PWR_MGMT1] = 0x01;
+  stubImu.FifoCount = 0;
+}
+
+static void stubImu_init(I2C_TypeDef *I2Cx, uint8_t address)
+{
+  memset(&stubImu, 0, sizeof(stubImu));
+  stubImu_powerOn();
+  stubImu.I2Cx = I2Cx;
+  stubImu.Address = address;
+  stubImu.Prescaler = SPI_PRESCALER_128;
+}
+
+/*!< One sample into the FIFO. Stops when full, as FIFO_MODE = 1 */
+static void stubImu_push(const uint8_t *pFrame)
+{
+  if((stubImu.FifoCount + STUB_FRAME) > STUB_FIFO_SIZE)
+    return;
+
+  memcpy(&stubImu.Fifo[stubImu.FifoCount], pFrame, STUB_FRAME);
+  stubImu.FifoCount += STUB_FRAME;
+}
+
+static uint8_t stubImu_readByte(uint8_t regAddr)
+{
+  uint8_t value = 0x00;
+
+  switch(regAddr)
+  {
+    case STUB_INT_STATUS:
+      return stubImu.Regs[regAddr] | 0x01;
+    case STUB_FIFO_COUNTH:
+      return (uint8_t)(stubImu.FifoCount >> 8);
+    case STUB_FIFO_COUNTL:
+      return (uint8_t)stubImu.FifoCount;
+    case STUB_FIFO_RW:
+      if(stubImu.FifoCount == 0)
+        return 0xFF;
+      value = stubImu.Fifo[0];
+      stubImu.FifoCount--;
+      memmove(&stubImu.Fifo[0], &stubImu.Fifo[1], stubImu.FifoCount);
+      return value;
+    default:
+      return stubImu.Regs[regAddr & (STUB_REGS - 1)];
+  }
+}
+
+static void stubImu_writeByte(uint8_t regAddr, uint8_t value)
+{
+  switch(regAddr)
+  {
+    case STUB_PWR_MGMT1:
+      if((value & 0x80) != 0)
+        stubImu_powerOn();
+      else
+        stubImu.Regs[regAddr] = value;
+      break;
+    case STUB_USER_CTRL:
+      if((value & 0x04) != 0)
+        stubImu.FifoCount = 0;
+      stubImu.Regs[regAddr] = value & ~0x07;
+      break;
+    default:
+      stubImu.Regs[regAddr & (STUB_REGS - 1)] = value;
+      break;
+  }
+}
+
+static void stubImu_read(uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  stubImu.Reads++;
+  hostDwt.CYCCNT += STUB_BUS_CYCLES;
+
+  for(uint8_t i = 0; i < count; i++)
+    pData[i] = stubImu_readByte((regAddr == STUB_FIFO_RW) ? regAddr
+                                                          : regAddr + i);
+}
+
+static void stubImu_write(uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  stubImu.Writes++;
+  hostDwt.CYCCNT += STUB_BUS_CYCLES;
+
+  for(uint8_t i = 0; i < count; i++)
+    stubImu_writeByte(regAddr + i, pData[i]);
+}
+
+static uint8_t stubImu_acks(I2C_TypeDef *I2Cx, uint8_t devAddr)
+{
+  stubImu.I2cTransfers++;
+
+  return (I2Cx == stubImu.I2Cx) && (devAddr == stubImu.Address);
+}
+
+// I2C =========================================================================
+uint8_t cncI2C_isDeviceReady(I2C_TypeDef *I2Cx, uint8_t devAddr)
+{
+  return stubImu_acks(I2Cx, devAddr);
+}
+
+uint8_t cncI2C_ReadByte(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData)
+{
+  if(!stubImu_acks(I2Cx, pDev[0]))
+    return 0;
+
+  stubImu_read(pDev[1], pData, 1);
+  return 1;
+}
+
+uint8_t cncI2C_ReadMultipleBytes(
+    I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData, uint8_t count)
+{
+  if(!stubImu_acks(I2Cx, pDev[0]))
+    return 0;
+
+  stubImu_read(pDev[1], pData, count);
+  return 1;
+}
+
+uint8_t cncI2C_WriteMultipleBytes(
+    I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData, uint8_t count)
+{
+  if(!stubImu_acks(I2Cx, pDev[0]))
+    return 0;
+
+  stubImu_write(pDev[1], pData, count);
+  return count;
+}
+
+uint8_t cncI2CQueue_submit(I2C_TypeDef *I2Cx, i2c_transaction_t *pTransaction)
+{
+  uint8_t status = stubImu_acks(I2Cx, pTransaction->DevAddr);
+
+  if(status == 1)
+  {
+    if(pTransaction->Direction == I2C_QUEUE_READ)
+      stubImu_read(pTransaction->RegAddr, pTransaction->pData,
+                   pTransaction->Count);
+    else
+      stubImu_write(pTransaction->RegAddr, pTransaction->pData,
+                    pTransaction->Count);
+  }
+
+  if(pTransaction->Callback != 0)
+    pTransaction->Callback(pTransaction->pContext, status);
+
+  return 1;
+}
+
+// SPI =========================================================================
+uint8_t cncSPI_setPrescaler(SPI_TypeDef *SPIx, spi_prescaler_t prescaler)
+{
+  stubImu.Prescaler = prescaler;
+  return 1;
+}
+
+uint8_t cncSPI_ReadMultipleBytes(
+    SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  stubImu.SpiTransfers++;
+  stubImu.ReadPrescaler = stubImu.Prescaler;
+  stubImu_read(regAddr, pData, count);
+  return 1;
+}
+
+uint8_t cncSPI_WriteMultipleBytes(
+    SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData, uint8_t count)
+{
+  stubImu.SpiTransfers++;
+  if(stubImu.Prescaler != SPI_PRESCALER_128)
+    stubImu.FastWrites++;
+  stubImu_write(regAddr, pData, count);
+  return 1;
+}
+
+uint8_t cncSPI_ReadAsync(SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData,
+                         uint8_t count, cncSPI_callback_t callback,
+                         void *pContext)
+{
+  cncSPI_ReadMultipleBytes(SPIx, regAddr, pData, count);
+
+  if(callback != 0)
+    callback(pContext, 1);
+
+  return 1;
+}
+
+uint8_t cncSPI_WriteAsync(SPI_TypeDef *SPIx, uint8_t regAddr, uint8_t *pData,
+                          uint8_t count, cncSPI_callback_t callback,
+                          void *pContext)
+{
+  cncSPI_WriteMultipleBytes(SPIx, regAddr, pData, count);
+
+  if(callback != 0)
+    callback(pContext, 1);
+
+  return 1;
+}
+
+#endif /* MPU9250_STUB_H_ */
+// EOF =========================================================================
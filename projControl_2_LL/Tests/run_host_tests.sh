@@ -0,0 +1,83 @@
+#!/bin/sh
+# Host (PC) tests of the target modules, see host.h.
+# Usage: sh Tests/run_host_tests.sh [test_name ...]  (gcc, from any directory)
+
+cd "$(dirname "$0")" || exit 1
+
+CC=${CC:-gcc}
+DSP=../Drivers/CMSIS/DSP_Lib/Source
+LL=../Drivers/STM32F4xx_HAL_Driver/Src
+CFLAGS="-O2 -std=gnu11 -Wall -Wno-unused-function -Wno-unused-variable
+ -Wno-unused-but-set-variable -Wno-pointer-sign -Wno-int-to-pointer-cast
+ -Wno-pointer-to-int-cast
+ -DSTM32F407xx -DARM_MATH_CM4 -DUSE_FULL_LL_DRIVER
+ -I. -I../Inc -I../Drivers/CMSIS/Include
+ -I../Drivers/CMSIS/Device/ST/STM32F4xx/Include
+ -I../Drivers/STM32F4xx_HAL_Driver/Inc -include host.h"
+OUT=${TMPDIR:-/tmp}/projControl_host_tests
+mkdir -p "$OUT"
+
+# Module and CMSIS-DSP sources each test links against
+sources()
+{
+  case "$1" in
+    test_i2c_queue)
+      ;;
+    test_mpu9250_parse|test_mpu9250_selftest|test_mpu9250_transport)
+      ;;
+    test_ll_i2c)
+      echo "$LL/stm32f4xx_ll_i2c.c $LL/stm32f4xx_ll_gpio.c $LL/stm32f4xx_ll_rcc.c
+            ../Src/system_stm32f4xx.c"
+      ;;
+    test_gyro_bias|test_imu_redundant)
+      ;;
+    test_fast_math)
+      echo "$DSP/FastMathFunctions/arm_sin_f32.c $DSP/FastMathFunctions/arm_cos_f32.c
+            $DSP/ControllerFunctions/arm_sin_cos_f32.c $DSP/CommonTables/arm_common_tables.c"
+      ;;
+    test_prefilter)
+      echo "$DSP/FilteringFunctions/arm_biquad_cascade_df2T_f32.c
+            $DSP/FilteringFunctions/arm_biquad_cascade_df2T_init_f32.c
+            $DSP/ControllerFunctions/arm_sin_cos_f32.c $DSP/CommonTables/arm_common_tables.c"
+      ;;
+    test_estimator_adaptive)
+      echo "../Src/fast_math.c
+            $DSP/BasicMathFunctions/arm_scale_f32.c $DSP/BasicMathFunctions/arm_add_f32.c
+            $DSP/BasicMathFunctions/arm_sub_f32.c $DSP/StatisticsFunctions/arm_power_f32.c
+            $DSP/MatrixFunctions/arm_mat_mult_f32.c $DSP/MatrixFunctions/arm_mat_trans_f32.c
+            $DSP/MatrixFunctions/arm_mat_add_f32.c $DSP/MatrixFunctions/arm_mat_sub_f32.c
+            $DSP/MatrixFunctions/arm_mat_scale_f32.c $DSP/MatrixFunctions/arm_mat_inverse_f32.c
+            $DSP/MatrixFunctions/arm_mat_init_f32.c
+            $DSP/ControllerFunctions/arm_sin_cos_f32.c $DSP/CommonTables/arm_common_tables.c"
+      ;;
+    test_q31_equivalence)
+      echo "../Src/estimador_q31.c ../Src/controlador.c ../Src/fast_math.c
+            $DSP/BasicMathFunctions/arm_scale_f32.c $DSP/BasicMathFunctions/arm_add_f32.c
+            $DSP/BasicMathFunctions/arm_sub_f32.c $DSP/BasicMathFunctions/arm_scale_q31.c
+            $DSP/BasicMathFunctions/arm_add_q31.c $DSP/FastMathFunctions/arm_sqrt_q31.c
+            $DSP/SupportFunctions/arm_float_to_q31.c $DSP/SupportFunctions/arm_copy_q31.c
+            $DSP/StatisticsFunctions/arm_power_f32.c $DSP/MatrixFunctions/arm_mat_mult_f32.c
+            $DSP/MatrixFunctions/arm_mat_trans_f32.c $DSP/MatrixFunctions/arm_mat_add_f32.c
+            $DSP/MatrixFunctions/arm_mat_sub_f32.c $DSP/MatrixFunctions/arm_mat_scale_f32.c
+            $DSP/MatrixFunctions/arm_mat_inverse_f32.c $DSP/MatrixFunctions/arm_mat_init_f32.c
+            $DSP/ControllerFunctions/arm_sin_cos_f32.c $DSP/CommonTables/arm_common_tables.c"
+      ;;
+  esac
+}
+
+tests=$*
+[ -z "$tests" ] && tests=$(ls test_*.c | sed 's/\.c$//')
+
+failed=0
+for t in $tests; do
+  if ! $CC $CFLAGS "$t.c" $(sources "$t") -lm -o "$OUT/$t" 2> "$OUT/$t.log"; then
+    echo "$t: BUILD FAILED"
+    cat "$OUT/$t.log"
+    failed=1
+    continue
+  fi
+  grep "warning" "$OUT/$t.log" | grep -v "Drivers/"
+  "$OUT/$t" || failed=1
+done
+
+exit $failed
@@ -0,0 +1,263 @@
+/*******************************************************************************
+ * @file    test_estimator_adaptive.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   FILTER_COMPLEMENTARY with the adaptive accelerometer gain against
+ *          the fixed weight, on synthetic motion with known attitude.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - AE_BLOCKS blocks of 10 samples at 1 kHz (100 Hz control tick), 0.01 g
+    and 0.1 dps gaussian noise (fixed seed), initHardware settings:
+    Weight 0.9, breakpoints 0.02/0.1 g and 100/400 dps.
+  - Profiles: pitch/roll sines (+/-20 and +/-10 deg), the same with
+    0.3..0.6 g linear acceleration bursts, and faster sines (+/-30 deg at
+    1.5 Hz) with the bursts. Gravity plus linear acceleration rotated to
+    the body (pitch about Y, then roll about X), body rates to match.
+  - Pitch/roll RMS error after the first 2 s: the adaptive filter must stay
+    within aBound[] and below the fixed weight on every profile.
+  - Gain: 1 at rest, 0 during a burst (attitude held by the gyro), ramp
+    midpoints.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "estimador.h"
+#include "host.h"
+#include "../Src/estimador.c"
+
+// =============================================================================
+#define AE_BLOCKS         3000            /*!< 30 s */
+#define AE_BLOCK          10
+#define AE_SKIP           200             /*!< 2 s to converge */
+#define AE_RAD_TO_DEG     (180.0/M_PI)
+
+typedef enum
+{
+  AE_ROTATION = 0,
+  AE_BURSTS,
+  AE_FAST_BURSTS,
+} ae_profile_t;
+
+static const char *apProfile[3] = { "rotation", "rotation+bursts",
+                                    "fast+bursts" };
+/*!< Adaptive RMS bound [deg], 2x the reference replay */
+static const double aBound[3] = { 0.7, 0.8, 4.2 };
+
+static mpu9250_handle_t hostImu;
+static uint32_t seed = 12345;
+
+mpu9250_handle_t *mpu9250_getHandle(uint8_t index)
+{
+  return &hostImu;
+}
+
+uint8_t mpu9250_readID(mpu9250_handle_t *pDevice)
+{
+  return MPU9250_DEVICE_ID;
+}
+
+mpu9250_status_t mpu9250_readData_float(mpu9250_handle_t *pDevice,
+                                        float32_t *pAccel, float32_t *pGyro)
+{
+  return MPU9250_OK;
+}
+
+/*!< Standard normal, Box-Muller on a fixed LCG */
+static double gauss(void)
+{
+  double u = 0.0, v = 0.0;
+
+  seed = seed*1103515245U + 12345U;
+  u = ((seed >> 8) + 1.0)/16777218.0;
+  seed = seed*1103515245U + 12345U;
+  v = ((seed >> 8) + 1.0)/16777218.0;
+
+  return sqrt(-2.0*log(u))*cos(2.0*M_PI*v);
+}
+
+/*!< Pitch, roll [rad], their rates [rad/s] and linear acceleration [g],
+ *   earth frame */
+static void truth(ae_profile_t profile, double t, double *pAngle,
+                  double *pRate, double *pLinear)
+{
+  double a = 20.0, b = 10.0, f1 = 0.5, f2 = 0.3, c = fmod(t, 3.0);
+
+  if(profile == AE_FAST_BURSTS)
+  {
+    a = 30.0;
+    b = 25.0;
+    f1 = 1.5;
+    f2 = 1.1;
+  }
+
+  pAngle[0] = a*sin(2.0*M_PI*f1*t)/AE_RAD_TO_DEG;
+  pRate[0] = a*2.0*M_PI*f1*cos(2.0*M_PI*f1*t)/AE_RAD_TO_DEG;
+  pAngle[1] = b*sin(2.0*M_PI*f2*t)/AE_RAD_TO_DEG;
+  pRate[1] = b*2.0*M_PI*f2*cos(2.0*M_PI*f2*t)/AE_RAD_TO_DEG;
+
+  pLinear[0] = pLinear[1] = pLinear[2] = 0.0;
+  if(profile == AE_ROTATION)
+    return;
+
+  if((c > 1.0) && (c < 1.6))
+  {
+    pLinear[0] = 0.5;
+    pLinear[1] = -0.3;
+  }
+  else if((c > 2.0) && (c < 2.3))
+  {
+    pLinear[0] = -0.4;
+    pLinear[2] = 0.4;
+  }
+}
+
+/*!< Accelerometer [g] and gyro [dps] sample of the true motion */
+static void sample(ae_profile_t profile, double t, float32_t *pAccel,
+                   float32_t *pGyro, double *pAngle)
+{
+  double rate[2], linear[3], w[3], y = 0.0, z = 0.0;
+  double pitch = 0.0, roll = 0.0;
+
+  truth(profile, t, pAngle, &rate[0], &linear[0]);
+  pitch = pAngle[0];
+  roll = pAngle[1];
+
+  /*!< Specific force: gravity reaction (up) plus linear acceleration */
+  w[0] = linear[0];
+  w[1] = linear[1];
+  w[2] = 1.0 + linear[2];
+
+  y = w[1];
+  z = sin(pitch)*w[0] + cos(pitch)*w[2];
+  pAccel[0] = (float32_t)(cos(pitch)*w[0] - sin(pitch)*w[2] + 0.01*gauss());
+  pAccel[1] = (float32_t)(cos(roll)*y + sin(roll)*z + 0.01*gauss());
+  pAccel[2] = (float32_t)(-sin(roll)*y + cos(roll)*z + 0.01*gauss());
+
+  pGyro[0] = (float32_t)(rate[1]*AE_RAD_TO_DEG + 0.1*gauss());
+  pGyro[1] = (float32_t)(rate[0]*cos(roll)*AE_RAD_TO_DEG + 0.1*gauss());
+  pGyro[2] = (float32_t)(-rate[0]*sin(roll)*AE_RAD_TO_DEG + 0.1*gauss());
+}
+
+static void settings(filter_init_t *pSettings, uint8_t adaptive)
+{
+  memset(pSettings, 0, sizeof(*pSettings));
+  pSettings->SampleRate = 100;
+  pSettings->Weight = 0.9f;
+  pSettings->Type = FILTER_COMPLEMENTARY;
+  pSettings->Accuracy = FAST_MATH_FINE;
+  pSettings->Adaptive = adaptive;
+  pSettings->AccelLow = 0.02f;
+  pSettings->AccelHigh = 0.1f;
+  pSettings->RateLow = 100.0f;
+  pSettings->RateHigh = 400.0f;
+}
+
+/*!< Pitch/roll RMS error [deg] */
+static double replay(ae_profile_t profile, uint8_t adaptive)
+{
+  estimator_t *pEstimator = estimator_getHandle(0);
+  filter_init_t init;
+  float32_t aAccel[3*AE_BLOCK], aGyro[3*AE_BLOCK], aAngles[3];
+  double angle[2], sum = 0.0, pitch = 0.0, roll = 0.0;
+  uint32_t n = 0;
+
+  seed = 12345;
+  settings(&init, adaptive);
+  HOST_CHECK(estimator_init(pEstimator, &init) == FILTER_OK, "init");
+
+  for(uint32_t k = 0; k < AE_BLOCKS; k++)
+  {
+    for(uint8_t i = 0; i < AE_BLOCK; i++)
+      sample(profile, (k*AE_BLOCK + i)*0.001, &aAccel[3*i], &aGyro[3*i],
+             &angle[0]);
+
+    estimator_updateBlock(pEstimator, &aAccel[0], &aGyro[0], AE_BLOCK,
+                          (uint64_t)(k + 1)*10000, &aAngles[0]);
+    if(k < AE_SKIP)
+      continue;
+
+    pitch = aAngles[0] - angle[0]*AE_RAD_TO_DEG;
+    roll = aAngles[1] - angle[1]*AE_RAD_TO_DEG;
+    sum += pitch*pitch + roll*roll;
+    n++;
+  }
+
+  return sqrt(sum/n);
+}
+
+static void test_profiles(void)
+{
+  double fixed = 0.0, adaptive = 0.0;
+
+  for(uint8_t p = AE_ROTATION; p <= AE_FAST_BURSTS; p++)
+  {
+    fixed = replay((ae_profile_t)p, 0);
+    adaptive = replay((ae_profile_t)p, 1);
+    printf("  %-16s RMS fixed %6.3f deg, adaptive %6.3f deg\n", apProfile[p],
+           fixed, adaptive);
+
+    HOST_CHECK(adaptive <= aBound[p], "%s: adaptive %.3f deg", apProfile[p],
+               adaptive);
+    HOST_CHECK(adaptive < fixed, "%s: adaptive %.3f, fixed %.3f deg",
+               apProfile[p], adaptive, fixed);
+  }
+}
+
+static void test_gain(void)
+{
+  estimator_t *pEstimator = estimator_getHandle(0);
+  filter_init_t init;
+  float32_t aAccel[3] = { 0.0f, 0.0f, 1.0f }, aGyro[3] = { 0.0f };
+  float32_t aAngles[3], aHeld[3];
+
+  settings(&init, 1);
+  estimator_init(pEstimator, &init);
+
+  HOST_CHECK(eCalc_AdaptiveGain(pEstimator, &aAccel[0], &aGyro[0]) == 1.0f,
+             "gain at rest");
+  aAccel[2] = 1.06f;
+  HOST_CHECK(fabsf(eCalc_AdaptiveGain(pEstimator, &aAccel[0], &aGyro[0])
+                   - 0.5f) < 1e-5f, "gain at 0.06 g");
+  aAccel[2] = 1.0f;
+  aGyro[0] = 250.0f;
+  HOST_CHECK(fabsf(eCalc_AdaptiveGain(pEstimator, &aAccel[0], &aGyro[0])
+                   - 0.5f) < 1e-5f, "gain at 250 dps");
+  aAccel[0] = 0.5f;
+  HOST_CHECK(eCalc_AdaptiveGain(pEstimator, &aAccel[0], &aGyro[0]) == 0.0f,
+             "gain during a burst");
+
+  /*!< Converge at 10 deg pitch, then a 0.4 g burst along X and Z (1.4 g,
+   *   -9 deg for the accelerometer): the gyro holds the attitude */
+  for(uint16_t k = 0; k < 500; k++)
+  {
+    aAccel[0] = -0.17364818f;
+    aAccel[1] = 0.0f;
+    aAccel[2] = 0.98480775f;
+    aGyro[0] = aGyro[1] = aGyro[2] = 0.0f;
+    estimator_update(pEstimator, &aAccel[0], &aGyro[0], &aHeld[0]);
+  }
+  HOST_CHECK(fabsf(aHeld[0] - 10.0f) < 0.05f, "pitch %g deg", aHeld[0]);
+
+  for(uint16_t k = 0; k < 50; k++)
+  {
+    aAccel[0] = -0.17364818f + 0.4f;
+    aAccel[1] = 0.0f;
+    aAccel[2] = 0.98480775f + 0.4f;
+    aGyro[0] = aGyro[1] = aGyro[2] = 0.0f;
+    estimator_update(pEstimator, &aAccel[0], &aGyro[0], &aAngles[0]);
+  }
+  HOST_CHECK((pEstimator->Gain == 0.0f) && (aAngles[0] == aHeld[0])
+             && (aAngles[1] == aHeld[1]), "burst moved the attitude: %g %g",
+             aAngles[0], aAngles[1]);
+}
+
+int main(void)
+{
+  test_gain();
+  test_profiles();
+
+  HOST_REPORT("test_estimator_adaptive");
+}
+
+// EOF =========================================================================
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * @file    test_fast_math.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   fastMath_atan2Deg() accuracy against double atan2(), signed zeros
+ *          and the block version.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Exhaustive octant sweep: every float32 r in [0, 1] as atan2(r, 1) and
+    atan2(1, r), ~1.07e9 values per kernel (about 2 minutes). The other
+    octants only change signs and add 90 / 180 deg.
+  - Circle sweep: FM_CIRCLE angles in all quadrants at 1e-3, 1 and 1e3.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "fast_math.h"
+#include "host.h"
+#include "../Src/fast_math.c"
+#include <string.h>
+
+// =============================================================================
+#define FM_FINE_TOL       0.0047          /*!< deg */
+#define FM_COARSE_TOL     0.035           /*!< deg */
+#define FM_CIRCLE         2000000
+#define FM_RAD_TO_DEG     (180.0/M_PI)
+
+/*!< Both kernels in one pass: the double reference is the slow part */
+static void octantError(double *pMaxError)
+{
+  double reference = 0.0, error = 0.0;
+  float32_t r = 0.0f;
+
+  for(uint32_t bits = 0; bits <= 0x3F800000U; bits++)
+  {
+    memcpy(&r, &bits, sizeof(r));
+    reference = atan((double)r)*FM_RAD_TO_DEG;
+
+    for(uint8_t i = 0; i < 2; i++)
+    {
+      error = fabs(fastMath_atan2Deg(r, 1.0f, FAST_MATH_FINE + i) - reference);
+      if(error > pMaxError[i])
+        pMaxError[i] = error;
+
+      error = fabs(fastMath_atan2Deg(1.0f, r, FAST_MATH_FINE + i)
+                   - (90.0 - reference));
+      if(error > pMaxError[i])
+        pMaxError[i] = error;
+    }
+  }
+}
+
+static double circleError(fastMath_accuracy_t accuracy)
+{
+  const double aScale[3] = { 1e-3, 1.0, 1e3 };
+  double error = 0.0, maxError = 0.0, theta = 0.0;
+  float32_t y = 0.0f, x = 0.0f;
+
+  for(uint32_t k = 0; k < FM_CIRCLE; k++)
+  {
+    theta = -M_PI + 2.0*M_PI*k/FM_CIRCLE;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+      y = (float32_t)(aScale[i]*sin(theta));
+      x = (float32_t)(aScale[i]*cos(theta));
+
+      /*!< +/-180 are the same angle */
+      error = fabs(fastMath_atan2Deg(y, x, accuracy)
+                   - atan2((double)y, (double)x)*FM_RAD_TO_DEG);
+      if(error > 180.0)
+        error = fabs(error - 360.0);
+      if(error > maxError)
+        maxError = error;
+    }
+  }
+
+  return maxError;
+}
+
+static void test_accuracy(void)
+{
+  const double aTol[2] = { FM_FINE_TOL, FM_COARSE_TOL };
+  const char *apName[2] = { "fine", "coarse" };
+  double aOctant[2] = { 0.0, 0.0 }, circle = 0.0;
+
+  octantError(&aOctant[0]);
+
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    circle = circleError((fastMath_accuracy_t)(FAST_MATH_FINE + i));
+    printf("  %s: octant %.5f deg, circle %.5f deg\n", apName[i], aOctant[i],
+           circle);
+
+    HOST_CHECK(aOctant[i] <= aTol[i], "%s octant: %.5f deg", apName[i],
+               aOctant[i]);
+    HOST_CHECK(circle <= aTol[i], "%s circle: %.5f deg", apName[i], circle);
+  }
+}
+
+/*!< Exact, sign included, for both kernels */
+static void test_signedZeros(void)
+{
+  const float32_t aY[8] = { 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f };
+  const float32_t aX[8] = { 1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -0.0f, -0.0f };
+  float32_t angle = 0.0f, reference = 0.0f;
+
+  for(uint8_t k = FAST_MATH_FINE; k <= FAST_MATH_COARSE; k++)
+  {
+    for(uint8_t i = 0; i < 8; i++)
+    {
+      angle = fastMath_atan2Deg(aY[i], aX[i], (fastMath_accuracy_t)k);
+      reference = atan2f(aY[i], aX[i])*(180.0f/PI);
+
+      HOST_CHECK((angle == reference)
+                 && ((signbit(angle) != 0) == (signbit(reference) != 0)),
+                 "kernel %u: atan2(%g, %g) = %g, atan2f %g", k, aY[i], aX[i],
+                 angle, reference);
+    }
+  }
+}
+
+static void test_block(void)
+{
+  float32_t aY[6] = { 1.0f, -1.0f, 0.3f, -2.0f, -0.0f, 5.0f };
+  float32_t aX[6] = { 0.5f, -3.0f, -1.0f, 2.0f, -1.0f, 0.0f };
+  float32_t aDst[6];
+
+  fastMath_atan2Deg_f32(&aY[0], &aX[0], &aDst[0], 6, FAST_MATH_FINE);
+
+  for(uint8_t i = 0; i < 6; i++)
+    HOST_CHECK(aDst[i] == fastMath_atan2Deg(aY[i], aX[i], FAST_MATH_FINE),
+               "block %u: %g", i, aDst[i]);
+}
+
+int main(void)
+{
+  test_signedZeros();
+  test_block();
+  test_accuracy();
+
+  HOST_REPORT("test_fast_math");
+}
+
+// EOF =========================================================================
@@ -0,0 +1,240 @@
+/*******************************************************************************
+ * @file    test_gyro_bias.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   gyroBias: temperature ramp replay, still block detection and
+ *          model store/restore.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Ramp: GB_BLOCKS still blocks of 10 samples at 100 Hz while the die warms
+    from 25 to 35 C, bias = aOffset + aSlope*(TEMP_OUT - GB_TEMP_REF)
+    and +/-GB_NOISE LSB (fixed seed). The learnt model must give the slope
+    within GB_SLOPE_TOL and the bias within GB_BIAS_TOL over the ramp.
+  - isStill(): moving and stuck (every frame identical) blocks are not
+    still, nor a block too far from the model.
+  - getModel() returns what setModel() stored, and correctBlock() uses it.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "gyro_bias.h"
+#include "host.h"
+#include "../Src/gyro_bias.c"
+
+// =============================================================================
+#define GB_BLOCKS         60000           /*!< 10 min */
+#define GB_BLOCK          10
+#define GB_RES            131.0f          /*!< LSB/dps, +/-250 dps */
+#define GB_NOISE          10              /*!< LSB */
+#define GB_TEMP_REF       1670.0          /*!< TEMP_OUT at 26 C */
+#define GB_SLOPE_TOL      0.03            /*!< Relative */
+#define GB_BIAS_TOL       1.0             /*!< LSB */
+
+static const double aOffset[3] = { 20.0, -35.0, 10.0 };     /*!< LSB */
+static const double aSlope[3] = { 0.02, -0.015, 0.01 };     /*!< LSB/LSB */
+
+static mpu9250_handle_t hostImu;
+static uint32_t seed = 12345;
+
+mpu9250_handle_t *mpu9250_getHandle(uint8_t index)
+{
+  return &hostImu;
+}
+
+/*!< Uniform in [-range, range] */
+static int32_t noise(int32_t range)
+{
+  seed = seed*1103515245U + 12345U;
+
+  return (int32_t)((seed >> 16) % (uint32_t)(2*range + 1)) - range;
+}
+
+static double trueBias(uint8_t axis, double temp)
+{
+  return aOffset[axis] + aSlope[axis]*(temp - GB_TEMP_REF);
+}
+
+/*!< Still block at temp [TEMP_OUT LSB], rate [dps] added on every axis */
+static void makeBlock(mpu9250_fifoBlock_t *pBlock, double temp, double rate)
+{
+  pBlock->Count = GB_BLOCK;
+  pBlock->Overflow = 0;
+
+  for(uint8_t i = 0; i < GB_BLOCK; i++)
+  {
+    pBlock->Samples[i].Temperature = (int16_t)lround(temp);
+
+    for(uint8_t axis = 0; axis < 3; axis++)
+      pBlock->Samples[i].Gyro[axis] =
+          (int16_t)lround(trueBias(axis, temp) + rate*GB_RES) + noise(GB_NOISE);
+  }
+}
+
+static void test_ramp(void)
+{
+  mpu9250_fifoBlock_t block;
+  gyroBias_model_t model = { 0 };
+  double temp = 0.0, error = 0.0, maxError = 0.0, residual = 0.0;
+  uint32_t learnt = 0;
+
+  gyroBias_init(1);
+
+  for(uint32_t k = 0; k < GB_BLOCKS; k++)
+  {
+    temp = (25.0 + 10.0*k/GB_BLOCKS - 21.0)*GYRO_BIAS_TEMP_SENSITIVITY;
+    makeBlock(&block, temp, 0.0);
+    learnt += gyroBias_update(0, &block);
+    gyroBias_correctBlock(0, &block);
+
+    /*!< Corrected output over the last minute */
+    if(k >= (GB_BLOCKS - 6000))
+      for(uint8_t i = 0; i < GB_BLOCK; i++)
+        residual += block.Samples[i].Gyro[0];
+  }
+
+  residual /= 6000.0*GB_BLOCK;
+
+  HOST_CHECK(gyroBias_getModel(0, &model) == 1, "getModel");
+  HOST_CHECK(model.Valid == 1, "no model");
+  HOST_CHECK(learnt == (GB_BLOCKS - GYRO_BIAS_STILL_TICKS),
+             "%u blocks learnt", learnt);
+  HOST_CHECK(gyroBias_getStats(0)->SlopeFits > 0, "no slope fit");
+
+  for(uint8_t axis = 0; axis < 3; axis++)
+  {
+    error = fabs(model.Slope[axis]/aSlope[axis] - 1.0);
+    HOST_CHECK(error <= GB_SLOPE_TOL, "axis %u: slope %g, true %g", axis,
+               model.Slope[axis], aSlope[axis]);
+
+    /*!< Model against the true bias from 26 to 35 C */
+    maxError = 0.0;
+    for(double c = 26.0; c <= 35.0; c += 0.5)
+    {
+      temp = (c - 21.0)*GYRO_BIAS_TEMP_SENSITIVITY;
+      error = fabs(model.Offset[axis] + model.Slope[axis]*(temp - model.TempRef)
+                   - trueBias(axis, temp));
+      if(error > maxError)
+        maxError = error;
+    }
+    HOST_CHECK(maxError <= GB_BIAS_TOL, "axis %u: bias error %.3f LSB", axis,
+               maxError);
+  }
+
+  printf("  slope %.5f %.5f %.5f, corrected mean %.3f LSB\n", model.Slope[0],
+         model.Slope[1], model.Slope[2], residual);
+  HOST_CHECK(fabs(residual) <= GB_BIAS_TOL, "corrected mean %.3f LSB",
+             residual);
+}
+
+static void test_still(void)
+{
+  gyroBias_unit_t *pUnit = &units[0];
+  mpu9250_fifoBlock_t block;
+  float32_t temp = 0.0f, aGyro[3];
+
+  gyroBias_init(1);
+
+  makeBlock(&block, GB_TEMP_REF, 0.0);
+  HOST_CHECK(gyroBias_isStill(pUnit, &block, GB_RES, &temp, &aGyro[0]) == 1,
+             "still block rejected");
+  HOST_CHECK(temp == (float32_t)lround(GB_TEMP_REF), "block temperature %g",
+             temp);
+
+  /*!< Moving: 5 dps swing on one axis */
+  makeBlock(&block, GB_TEMP_REF, 0.0);
+  for(uint8_t i = 0; i < GB_BLOCK; i++)
+    block.Samples[i].Gyro[1] += (int16_t)(i*GB_RES*5.0f/GB_BLOCK);
+  HOST_CHECK(gyroBias_isStill(pUnit, &block, GB_RES, &temp, &aGyro[0]) == 0,
+             "moving block accepted");
+
+  /*!< Constant rotation: quiet, but 3 dps off the (zero) model */
+  makeBlock(&block, GB_TEMP_REF, 3.0);
+  HOST_CHECK(gyroBias_isStill(pUnit, &block, GB_RES, &temp, &aGyro[0]) == 0,
+             "rotating block accepted");
+
+  /*!< Stuck: every frame identical */
+  makeBlock(&block, GB_TEMP_REF, 0.0);
+  for(uint8_t i = 1; i < GB_BLOCK; i++)
+    block.Samples[i] = block.Samples[0];
+  HOST_CHECK(gyroBias_isStill(pUnit, &block, GB_RES, &temp, &aGyro[0]) == 0,
+             "stuck block accepted");
+
+  block.Count = 1;
+  HOST_CHECK(gyroBias_isStill(pUnit, &block, GB_RES, &temp, &aGyro[0]) == 0,
+             "single sample accepted");
+
+  /*!< A moving block restarts the still count */
+  for(uint8_t k = 0; k < 10; k++)
+  {
+    makeBlock(&block, GB_TEMP_REF, 0.0);
+    gyroBias_update(0, &block);
+  }
+  HOST_CHECK(pUnit->Stats.StillTicks == 10, "still ticks %u",
+             pUnit->Stats.StillTicks);
+  makeBlock(&block, GB_TEMP_REF, 3.0);
+  HOST_CHECK(gyroBias_update(0, &block) == 0, "rotating block learnt");
+  HOST_CHECK(pUnit->Stats.StillTicks == 0, "still ticks %u after motion",
+             pUnit->Stats.StillTicks);
+}
+
+static void test_model(void)
+{
+  const gyroBias_model_t stored = { { 12.5f, -40.25f, 3.0f },
+                                    { 0.02f, -0.01f, 0.0f }, 1500.0f, 1 };
+  gyroBias_model_t model = { 0 };
+  mpu9250_fifoBlock_t block;
+
+  gyroBias_init(2);
+
+  HOST_CHECK(gyroBias_setModel(1, &stored) == 1, "setModel");
+  HOST_CHECK(gyroBias_getModel(1, &model) == 1, "getModel");
+  for(uint8_t axis = 0; axis < 3; axis++)
+    HOST_CHECK((model.Offset[axis] == stored.Offset[axis])
+               && (model.Slope[axis] == stored.Slope[axis]),
+               "axis %u: offset %g slope %g", axis, model.Offset[axis],
+               model.Slope[axis]);
+  HOST_CHECK((model.TempRef == stored.TempRef) && (model.Valid == 1),
+             "TempRef %g, Valid %u", model.TempRef, model.Valid);
+  HOST_CHECK(gyroBias_getStats(1)->Points == 1, "%u points",
+             gyroBias_getStats(1)->Points);
+
+  HOST_CHECK(gyroBias_getModel(0, &model) == 1, "getModel unit 0");
+  HOST_CHECK(model.Valid == 0, "unit 0 has a model");
+
+  /*!< Applied at the sample temperature, saturated values left alone */
+  block.Count = 2;
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    block.Samples[i].Temperature = 1600;
+    for(uint8_t axis = 0; axis < 3; axis++)
+      block.Samples[i].Gyro[axis] = (int16_t)lroundf(stored.Offset[axis]
+                                    + stored.Slope[axis]*100.0f) + 100;
+  }
+  block.Samples[1].Gyro[2] = INT16_MIN;
+
+  gyroBias_correctBlock(1, &block);
+  for(uint8_t axis = 0; axis < 3; axis++)
+    HOST_CHECK(abs(block.Samples[0].Gyro[axis] - 100) <= 1,
+               "axis %u corrected to %d", axis, block.Samples[0].Gyro[axis]);
+  HOST_CHECK(block.Samples[1].Gyro[2] == INT16_MIN, "saturation corrected");
+
+  /*!< Units past count */
+  gyroBias_init(1);
+  HOST_CHECK(gyroBias_setModel(1, &stored) == 0, "setModel past count");
+  HOST_CHECK(gyroBias_getModel(1, &model) == 0, "getModel past count");
+  HOST_CHECK(gyroBias_getStats(1) == 0, "getStats past count");
+}
+
+int main(void)
+{
+  hostImu.GyroResolution = GB_RES;
+
+  test_still();
+  test_model();
+  test_ramp();
+
+  HOST_REPORT("test_gyro_bias");
+}
+
+// EOF =========================================================================
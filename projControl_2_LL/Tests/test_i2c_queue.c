@@ -0,0 +1,395 @@
+/*******************************************************************************
+ * @file    test_i2c_queue.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   cnc_i2c_queue on simulated buses: ordering, aging, chaining from
+ *          the completion interrupt (FIFO count then data burst), stall
+ *          report, busy bus retry, statistics and two independent buses.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - The bus replaces cnc_ll_i2c: one transfer at a time per I2C instance,
+    completed by simBus_complete() as the transfer complete interrupt
+    would. The single bus tests run on I2C1.
+  - RegAddr of each transaction is its tag in the start log.
+  - A start with PRIMASK set is counted: the STOP wait must not run masked.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "cnc_i2c_queue.h"
+#include "host.h"
+#include "../Src/cnc_i2c_queue.c"
+
+// Simulated bus ===============================================================
+#define SIM_LOG_SIZE    64
+#define SIM_BUS_CYCLES  1000            /*!< Per transfer */
+
+/*!< I2C1 bus, the single bus tests use it directly */
+#define simCallback(status)   aSimCallback[0](aSimContext[0], (status))
+#define simActive             aSimActive[0]
+
+static cncI2C_callback_t aSimCallback[2];
+static void *aSimContext[2];
+static uint8_t aSimActive[2];
+static uint8_t simHeld = 0;             /*!< I2C1 owned by someone else */
+static uint8_t aSimLog[SIM_LOG_SIZE];
+static I2C_TypeDef *aSimBus[SIM_LOG_SIZE];
+static uint8_t simStarts = 0;
+static uint8_t simCallbacks = 0;
+static uint8_t simMaskedStarts = 0;
+
+static uint8_t simBus_index(I2C_TypeDef *I2Cx)
+{
+  return (I2Cx == I2C2) ? 1 : 0;
+}
+
+static uint8_t simBus_start(I2C_TypeDef *I2Cx, uint8_t *pDev,
+                            cncI2C_callback_t callback, void *pContext)
+{
+  uint8_t bus = simBus_index(I2Cx);
+
+  if(hostPrimask != 0)
+    simMaskedStarts++;
+
+  if((aSimActive[bus] == 1) || ((bus == 0) && (simHeld == 1)))
+    return 0;
+
+  aSimActive[bus] = 1;
+  aSimCallback[bus] = callback;
+  aSimContext[bus] = pContext;
+  if(simStarts < SIM_LOG_SIZE)
+  {
+    aSimLog[simStarts] = pDev[1];
+    aSimBus[simStarts] = I2Cx;
+  }
+  simStarts++;
+
+  return 1;
+}
+
+static void simBus_completeOn(I2C_TypeDef *I2Cx, uint8_t status)
+{
+  uint8_t bus = simBus_index(I2Cx);
+
+  hostDwt.CYCCNT += SIM_BUS_CYCLES;
+  aSimActive[bus] = 0;
+  aSimCallback[bus](aSimContext[bus], status);
+}
+
+static void simBus_complete(uint8_t status)
+{
+  simBus_completeOn(I2C1, status);
+}
+
+static void simBus_reset(void)
+{
+  aSimActive[0] = 0;
+  aSimActive[1] = 0;
+  simHeld = 0;
+  simStarts = 0;
+  simCallbacks = 0;
+  cncI2CQueue_init(I2C1);
+}
+
+uint8_t cncI2C_ReadAsync(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData,
+                         uint8_t count, cncI2C_callback_t callback,
+                         void *pContext)
+{
+  return simBus_start(I2Cx, pDev, callback, pContext);
+}
+
+uint8_t cncI2C_WriteAsync(I2C_TypeDef *I2Cx, uint8_t *pDev, uint8_t *pData,
+                          uint8_t count, cncI2C_callback_t callback,
+                          void *pContext)
+{
+  return simBus_start(I2Cx, pDev, callback, pContext);
+}
+
+uint8_t cncI2C_isBusyAsync(I2C_TypeDef *I2Cx)
+{
+  return aSimActive[simBus_index(I2Cx)];
+}
+
+uint8_t cncI2C_setTimeout(I2C_TypeDef *I2Cx, uint32_t timeout_us)
+{
+  return 1;
+}
+
+uint8_t cncI2C_checkTimeoutAsync(I2C_TypeDef *I2Cx)
+{
+  return 0;
+}
+
+// =============================================================================
+static uint8_t buffer[14];
+static uint8_t resubmit = 0;            /*!< Control reads submitted on completion */
+static uint8_t nextTag = 0;
+
+static void onDone(void *pContext, uint8_t status)
+{
+  simCallbacks++;
+}
+
+static uint8_t submit(uint8_t devAddr, uint8_t tag, i2c_priority_t priority)
+{
+  i2c_transaction_t transaction = { devAddr, tag, &buffer[0], 14,
+                                    I2C_QUEUE_READ, priority, 0, &onDone, 0 };
+
+  return cncI2CQueue_submit(I2C1, &transaction);
+}
+
+/*!< A control read per completion, as a sampler that never stops */
+static void onControlDone(void *pContext, uint8_t status)
+{
+  i2c_transaction_t transaction = { 0x68, 0, &buffer[0], 14, I2C_QUEUE_READ,
+                                    I2C_QUEUE_PRIORITY_CONTROL, 0,
+                                    &onControlDone, 0 };
+
+  simCallbacks++;
+  if(resubmit > 0)
+  {
+    resubmit--;
+    transaction.RegAddr = nextTag++;
+    cncI2CQueue_submit(I2C1, &transaction);
+  }
+}
+
+static void test_ordering(void)
+{
+  const uint8_t aExpected[7] = { 0x10, 0xC1, 0xC2, 0x01, 0x02, 0xF1, 0xF2 };
+
+  simBus_reset();
+
+  /*!< 0x10 takes the bus, the others wait behind it */
+  submit(0x68, 0x10, I2C_QUEUE_PRIORITY_NORMAL);
+  submit(0x50, 0xF1, I2C_QUEUE_PRIORITY_HOUSEKEEPING);
+  submit(0x68, 0x01, I2C_QUEUE_PRIORITY_NORMAL);
+  submit(0x68, 0xC1, I2C_QUEUE_PRIORITY_CONTROL);
+  submit(0x50, 0xF2, I2C_QUEUE_PRIORITY_HOUSEKEEPING);
+  submit(0x69, 0xC2, I2C_QUEUE_PRIORITY_CONTROL);
+  submit(0x68, 0x02, I2C_QUEUE_PRIORITY_NORMAL);
+
+  HOST_CHECK(cncI2CQueue_getPending(I2C1) == 6, "pending %u",
+             cncI2CQueue_getPending(I2C1));
+
+  /*!< Each completion starts the next one from the interrupt: no process() */
+  for(uint8_t i = 1; i < 7; i++)
+  {
+    simBus_complete(1);
+    HOST_CHECK(simStarts == (i + 1), "completion %u did not chain (starts %u)",
+               i, simStarts);
+  }
+  simBus_complete(1);
+
+  for(uint8_t i = 0; i < 7; i++)
+    HOST_CHECK(aSimLog[i] == aExpected[i], "start %u: 0x%02X, expected 0x%02X",
+               i, aSimLog[i], aExpected[i]);
+
+  HOST_CHECK(simCallbacks == 7, "callbacks %u", simCallbacks);
+  HOST_CHECK(cncI2CQueue_getPending(I2C1) == 0, "left %u",
+             cncI2CQueue_getPending(I2C1));
+}
+
+static void test_noStarvation(void)
+{
+  i2c_transaction_t control = { 0x68, 0, &buffer[0], 14, I2C_QUEUE_READ,
+                                I2C_QUEUE_PRIORITY_CONTROL, 0,
+                                &onControlDone, 0 };
+  uint8_t position = 0xFF;
+
+  simBus_reset();
+  resubmit = 20;
+  nextTag = 1;
+
+  /*!< Two control reads always pending ahead of the housekeeping write */
+  control.RegAddr = nextTag++;
+  cncI2CQueue_submit(I2C1, &control);
+  control.RegAddr = nextTag++;
+  cncI2CQueue_submit(I2C1, &control);
+  submit(0x50, 0xEE, I2C_QUEUE_PRIORITY_HOUSEKEEPING);
+
+  while((simActive == 1) && (simStarts < SIM_LOG_SIZE))
+    simBus_complete(1);
+
+  for(uint8_t i = 0; i < simStarts; i++)
+  {
+    if(aSimLog[i] == 0xEE)
+      position = i;
+  }
+
+  /*!< Started after at most I2C_QUEUE_AGING_MAX control reads */
+  HOST_CHECK(position != 0xFF, "housekeeping never started");
+  HOST_CHECK(position <= (I2C_QUEUE_AGING_MAX + 1), "housekeeping started at %u",
+             position);
+  HOST_CHECK(simStarts == 23, "starts %u", simStarts);
+
+  /*!< Control reads keep their submit order */
+  for(uint8_t i = 1, last = 0; i < simStarts; i++)
+  {
+    if(aSimLog[i] == 0xEE)
+      continue;
+
+    HOST_CHECK(aSimLog[i] > last, "control 0x%02X after 0x%02X", aSimLog[i], last);
+    last = aSimLog[i];
+  }
+}
+
+/*!< FIFO_COUNT done: the FIFO_R_W burst is submitted from the callback */
+static void onCountDone(void *pContext, uint8_t status)
+{
+  simCallbacks++;
+  submit(0x68, 0x74, I2C_QUEUE_PRIORITY_CONTROL);
+}
+
+static void test_fifoChain(void)
+{
+  i2c_transaction_t count = { 0x68, 0x72, &buffer[0], 2, I2C_QUEUE_READ,
+                              I2C_QUEUE_PRIORITY_CONTROL, 0, &onCountDone, 0 };
+
+  /*!< Data burst on the bus in the same interrupt as the count read end */
+  simBus_reset();
+  cncI2CQueue_submit(I2C1, &count);
+  simBus_complete(1);
+  HOST_CHECK(simStarts == 2, "data burst not chained (starts %u)", simStarts);
+  HOST_CHECK(cncI2CQueue_isStalled(I2C1) == 0,
+             "stalled with the burst on the bus");
+  simBus_complete(1);
+  HOST_CHECK((aSimLog[0] == 0x72) && (aSimLog[1] == 0x74), "log 0x%02X 0x%02X",
+             aSimLog[0], aSimLog[1]);
+
+  /*!< Bus taken meanwhile: reported stalled until the next process() */
+  simBus_reset();
+  cncI2CQueue_submit(I2C1, &count);
+  simHeld = 1;
+  simActive = 0;
+  simCallback(1);
+  HOST_CHECK(cncI2CQueue_isStalled(I2C1) == 1, "stall not reported");
+  simHeld = 0;
+  cncI2CQueue_process(I2C1);
+  HOST_CHECK((simStarts == 2) && (cncI2CQueue_isStalled(I2C1) == 0),
+             "not restarted");
+  simBus_complete(1);
+}
+
+static void test_busyBus(void)
+{
+  simBus_reset();
+
+  /*!< Bus held (blocking transfer, other master): queued, not lost */
+  simHeld = 1;
+  HOST_CHECK(submit(0x68, 0x01, I2C_QUEUE_PRIORITY_CONTROL) == 1, "submit");
+  HOST_CHECK(simStarts == 0, "started on a held bus");
+  HOST_CHECK(cncI2CQueue_getPending(I2C1) == 1, "pending %u",
+             cncI2CQueue_getPending(I2C1));
+
+  simHeld = 0;
+  cncI2CQueue_process(I2C1);
+  HOST_CHECK(simStarts == 1, "not retried");
+  simBus_complete(1);
+  HOST_CHECK(simCallbacks == 1, "callbacks %u", simCallbacks);
+  HOST_CHECK(hostPrimask == 0, "PRIMASK left set after the rollback");
+}
+
+static void test_full(void)
+{
+  uint8_t accepted = 0;
+
+  simBus_reset();
+  simHeld = 1;
+
+  for(uint8_t i = 0; i < (I2C_QUEUE_SIZE + 2); i++)
+    accepted += submit(0x68, i, I2C_QUEUE_PRIORITY_NORMAL);
+
+  HOST_CHECK(accepted == I2C_QUEUE_SIZE, "accepted %u", accepted);
+  simHeld = 0;
+}
+
+static void test_stats(void)
+{
+  i2c_devStats_t stats68, stats50;
+
+  simBus_reset();
+  submit(0x68, 0x01, I2C_QUEUE_PRIORITY_CONTROL);
+  submit(0x50, 0x02, I2C_QUEUE_PRIORITY_HOUSEKEEPING);
+  submit(0x68, 0x03, I2C_QUEUE_PRIORITY_CONTROL);
+  simBus_complete(1);
+  simBus_complete(0);
+  simBus_complete(1);
+
+  HOST_CHECK(cncI2CQueue_getStats(I2C1, 0x68, &stats68) == 1, "no stats 0x68");
+  HOST_CHECK(cncI2CQueue_getStats(I2C1, 0x50, &stats50) == 1, "no stats 0x50");
+  HOST_CHECK(stats68.Transactions == 2, "0x68 transactions %u", stats68.Transactions);
+  HOST_CHECK(stats68.Errors == 1, "0x68 errors %u", stats68.Errors);
+  HOST_CHECK(stats50.Errors == 0, "0x50 errors %u", stats50.Errors);
+  HOST_CHECK(stats68.MaxBusCycles == SIM_BUS_CYCLES, "bus %u", stats68.MaxBusCycles);
+  HOST_CHECK(stats50.MaxWaitCycles == 2*SIM_BUS_CYCLES, "0x50 wait %u",
+             stats50.MaxWaitCycles);
+}
+
+/*!< Second IMU on I2C2: both drains on the bus at once, completions routed
+ *   to their own queue, nothing of one bus in the other's state */
+static void test_twoBuses(void)
+{
+  i2c_transaction_t transaction = { 0x68, 0x3B, &buffer[0], 14, I2C_QUEUE_READ,
+                                    I2C_QUEUE_PRIORITY_CONTROL, 0, &onDone, 0 };
+  i2c_devStats_t stats;
+
+  simBus_reset();
+  HOST_CHECK(cncI2CQueue_submit(I2C2, &transaction) == 0,
+             "submit on a bus without queue");
+  HOST_CHECK(cncI2CQueue_init(I2C2) == 1, "I2C2 init");
+  HOST_CHECK(cncI2CQueue_init((I2C_TypeDef *) SPI1) == 0, "init of a non-I2C");
+
+  cncI2CQueue_submit(I2C1, &transaction);
+  transaction.RegAddr = 0x72;
+  cncI2CQueue_submit(I2C1, &transaction);
+  transaction.DevAddr = 0x69;
+  transaction.RegAddr = 0x3C;
+  cncI2CQueue_submit(I2C2, &transaction);
+
+  HOST_CHECK((simStarts == 2) && (aSimActive[0] == 1) && (aSimActive[1] == 1),
+             "not started in parallel (starts %u)", simStarts);
+  HOST_CHECK((aSimBus[0] == I2C1) && (aSimBus[1] == I2C2), "start buses");
+  HOST_CHECK(cncI2CQueue_getPending(I2C1) == 1, "I2C1 pending %u",
+             cncI2CQueue_getPending(I2C1));
+  HOST_CHECK(cncI2CQueue_getPending(I2C2) == 0, "I2C2 pending %u",
+             cncI2CQueue_getPending(I2C2));
+
+  /*!< I2C2 done: chains nothing on I2C1 */
+  simBus_completeOn(I2C2, 1);
+  HOST_CHECK(simStarts == 2, "I2C2 completion started a transfer");
+  HOST_CHECK(cncI2CQueue_getStats(I2C2, 0x69, &stats) == 1, "no I2C2 stats");
+  HOST_CHECK(stats.Transactions == 1, "I2C2 transactions %u",
+             stats.Transactions);
+  HOST_CHECK(cncI2CQueue_getStats(I2C1, 0x69, &stats) == 0,
+             "I2C2 device in I2C1 stats");
+
+  /*!< I2C1 done: its second transaction follows on I2C1 */
+  simBus_completeOn(I2C1, 1);
+  HOST_CHECK((simStarts == 3) && (aSimBus[2] == I2C1) && (aSimLog[2] == 0x72),
+             "I2C1 chain");
+  simBus_completeOn(I2C1, 1);
+  HOST_CHECK(cncI2CQueue_getStats(I2C1, 0x68, &stats) == 1, "no I2C1 stats");
+  HOST_CHECK(stats.Transactions == 2, "I2C1 transactions %u",
+             stats.Transactions);
+  HOST_CHECK(simCallbacks == 3, "callbacks %u", simCallbacks);
+}
+
+int main(void)
+{
+  test_ordering();
+  test_noStarvation();
+  test_fifoChain();
+  test_busyBus();
+  test_full();
+  test_stats();
+  test_twoBuses();
+
+  HOST_CHECK(simMaskedStarts == 0, "%u starts with interrupts masked",
+             simMaskedStarts);
+
+  HOST_REPORT("test_i2c_queue");
+}
+
+// EOF =========================================================================
@@ -0,0 +1,307 @@
+/*******************************************************************************
+ * @file    test_imu_redundant.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   imuRedundant_fuse() on three units: median vote, averaging and
+ *          the health transitions of a biased, a stuck and a failing unit.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Every tick the units sample the same motion (level, IR_RATE dps on Z)
+    with their own +/-IR_NOISE LSB noise (fixed seed), 10 samples at
+    131 LSB/dps and 16384 LSB/g.
+  - Biased: IR_BIAS dps on X. Outvoted on every tick, failed after
+    IMU_REDUNDANT_FAULT_TICKS, kept out while biased, back after
+    IMU_REDUNDANT_RECOVER_TICKS agreeing ticks. The median never follows it.
+  - Stuck (every frame identical) and failing reads: failed after
+    IMU_REDUNDANT_FAULT_TICKS, the other two averaged.
+  - Two outliers out of three, or two units that disagree: counted, nobody
+    voted out. No read at all: nothing fused, NoData counted.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "imu_redundant.h"
+#include "host.h"
+#include "../Src/imu_redundant.c"
+
+// =============================================================================
+#define IR_BLOCK          10
+#define IR_GYRO_RES       131.0f          /*!< LSB/dps, +/-250 dps */
+#define IR_ACCEL_RES      16384.0f        /*!< LSB/g, +/-2 g */
+#define IR_NOISE          5               /*!< LSB */
+#define IR_RATE           30.0f           /*!< dps, Z */
+#define IR_BIAS           20.0f           /*!< dps, X */
+#define IR_TOL            0.1f            /*!< dps, fused against the truth */
+
+typedef enum
+{
+  IR_GOOD = 0,
+  IR_BIASED,
+  IR_STUCK,
+  IR_NO_READ,
+} ir_behavior_t;
+
+static mpu9250_handle_t hostImu;
+static mpu9250_fifoBlock_t aBlock[MPU9250_MAX_DEVICES];
+static uint8_t aReadOk[MPU9250_MAX_DEVICES];
+static float32_t aAccel[3*MPU9250_FIFO_BLOCK_SIZE];
+static float32_t aGyro[3*MPU9250_FIFO_BLOCK_SIZE];
+static uint32_t seed = 12345;
+
+mpu9250_handle_t *mpu9250_getHandle(uint8_t index)
+{
+  return &hostImu;
+}
+
+mpu9250_status_t mpu9250_convertBlock_float(mpu9250_handle_t *pDevice,
+    mpu9250_fifoBlock_t *pBlock, float32_t *pAccel, float32_t *pGyro)
+{
+  for(uint8_t i = 0; i < pBlock->Count; i++)
+  {
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      pAccel[3*i + axis] = pBlock->Samples[i].Accel[axis]/IR_ACCEL_RES;
+      pGyro[3*i + axis] = pBlock->Samples[i].Gyro[axis]/IR_GYRO_RES;
+    }
+  }
+
+  return MPU9250_OK;
+}
+
+/*!< Uniform in [-range, range] */
+static int16_t noise(int32_t range)
+{
+  seed = seed*1103515245U + 12345U;
+
+  return (int16_t)((int32_t)((seed >> 16) % (uint32_t)(2*range + 1)) - range);
+}
+
+static void makeBlock(uint8_t unit, ir_behavior_t behavior, float32_t bias)
+{
+  mpu9250_fifoBlock_t *pBlock = &aBlock[unit];
+
+  pBlock->Count = IR_BLOCK;
+  pBlock->Overflow = 0;
+  aReadOk[unit] = (behavior == IR_NO_READ) ? 0 : 1;
+
+  for(uint8_t i = 0; i < IR_BLOCK; i++)
+  {
+    pBlock->Samples[i].Accel[0] = noise(10*IR_NOISE);
+    pBlock->Samples[i].Accel[1] = noise(10*IR_NOISE);
+    pBlock->Samples[i].Accel[2] = (int16_t)IR_ACCEL_RES + noise(10*IR_NOISE);
+    pBlock->Samples[i].Gyro[0] = (int16_t)lroundf(bias*IR_GYRO_RES)
+                                 + noise(IR_NOISE);
+    pBlock->Samples[i].Gyro[1] = noise(IR_NOISE);
+    pBlock->Samples[i].Gyro[2] = (int16_t)lroundf(IR_RATE*IR_GYRO_RES)
+                                 + noise(IR_NOISE);
+
+    if(behavior == IR_STUCK)
+      pBlock->Samples[i] = pBlock->Samples[0];
+  }
+}
+
+/*!< One tick, unit 'odd' behaving as told. Fused samples */
+static uint8_t tick(uint8_t units, uint8_t odd, ir_behavior_t behavior)
+{
+  for(uint8_t u = 0; u < units; u++)
+  {
+    if(u == odd)
+      makeBlock(u, behavior, (behavior == IR_BIASED) ? IR_BIAS : 0.0f);
+    else
+      makeBlock(u, IR_GOOD, 0.0f);
+  }
+
+  return imuRedundant_fuse(&aBlock[0], &aReadOk[0], &aAccel[0], &aGyro[0]);
+}
+
+/*!< Largest fused error against the true motion [dps] */
+static float32_t gyroError(uint8_t count)
+{
+  float32_t error = 0.0f, maxError = 0.0f;
+
+  for(uint8_t i = 0; i < count; i++)
+  {
+    error = fabsf(aGyro[3*i]);
+    if(fabsf(aGyro[3*i + 1]) > error)
+      error = fabsf(aGyro[3*i + 1]);
+    if(fabsf(aGyro[3*i + 2] - IR_RATE) > error)
+      error = fabsf(aGyro[3*i + 2] - IR_RATE);
+    if(error > maxError)
+      maxError = error;
+  }
+
+  return maxError;
+}
+
+static void checkHealthy(const char *pName, uint8_t mask)
+{
+  for(uint8_t u = 0; u < 3; u++)
+    HOST_CHECK(imuRedundant_getUnit(u)->Healthy == ((mask >> u) & 0x01),
+               "%s: unit %u healthy %u", pName, u,
+               imuRedundant_getUnit(u)->Healthy);
+}
+
+/*!< 'odd' faulty: counted on each tick, failed on the last of
+ *   IMU_REDUNDANT_FAULT_TICKS, the fusion never follows it */
+static void fail(const char *pName, uint8_t odd, ir_behavior_t behavior,
+                 imu_fault_t fault)
+{
+  const imu_unit_t *pUnit = imuRedundant_getUnit(odd);
+  uint8_t count = 0;
+
+  for(uint8_t k = 1; k <= IMU_REDUNDANT_FAULT_TICKS; k++)
+  {
+    count = tick(3, odd, behavior);
+    HOST_CHECK((count == IR_BLOCK) && (gyroError(count) <= IR_TOL),
+               "%s tick %u: %u samples, error %.3f dps", pName, k, count,
+               gyroError(count));
+    HOST_CHECK((pUnit->LastFault == fault) && (pUnit->FaultTicks == k),
+               "%s tick %u: fault %d, %u ticks", pName, k, pUnit->LastFault,
+               pUnit->FaultTicks);
+    HOST_CHECK(pUnit->Healthy == (k < IMU_REDUNDANT_FAULT_TICKS),
+               "%s tick %u: healthy %u", pName, k, pUnit->Healthy);
+  }
+
+  HOST_CHECK(pUnit->Failures == 1, "%s: %u failures", pName,
+             pUnit->Failures);
+
+  /*!< The other two averaged */
+  count = tick(3, odd, behavior);
+  HOST_CHECK((imuRedundant_getStats()->Used == 2)
+             && (gyroError(count) <= IR_TOL), "%s: %u used, error %.3f dps",
+             pName, imuRedundant_getStats()->Used, gyroError(count));
+}
+
+/*!< Back after IMU_REDUNDANT_RECOVER_TICKS good ticks in a row */
+static void recover(const char *pName, uint8_t odd)
+{
+  const imu_unit_t *pUnit = imuRedundant_getUnit(odd);
+
+  for(uint16_t k = 1; k < IMU_REDUNDANT_RECOVER_TICKS; k++)
+    tick(3, odd, IR_GOOD);
+  HOST_CHECK((pUnit->Healthy == 0)
+             && (pUnit->GoodTicks == IMU_REDUNDANT_RECOVER_TICKS - 1),
+             "%s: healthy %u after %u good ticks", pName, pUnit->Healthy,
+             pUnit->GoodTicks);
+
+  tick(3, odd, IR_GOOD);
+  HOST_CHECK(pUnit->Healthy == 1, "%s: not recovered", pName);
+  HOST_CHECK(imuRedundant_getStats()->Used == 2, "%s: %u used", pName,
+             imuRedundant_getStats()->Used);
+  tick(3, odd, IR_GOOD);
+  HOST_CHECK(imuRedundant_getStats()->Used == 3, "%s: %u used", pName,
+             imuRedundant_getStats()->Used);
+}
+
+static void test_vote(void)
+{
+  const imu_unit_t *pUnit = 0;
+  uint8_t count = 0;
+
+  HOST_CHECK(imuRedundant_init(3) == 1, "init 3 units");
+  HOST_CHECK(imuRedundant_init(MPU9250_MAX_DEVICES + 1) == 0,
+             "init past MPU9250_MAX_DEVICES");
+  imuRedundant_init(3);
+  checkHealthy("init", 0x07);
+
+  /*!< All good. Aligned on the newest sample of the shortest block */
+  count = tick(3, 0, IR_GOOD);
+  HOST_CHECK((count == IR_BLOCK) && (imuRedundant_getStats()->Used == 3)
+             && (gyroError(count) <= IR_TOL), "good: %u samples, %u used",
+             count, imuRedundant_getStats()->Used);
+  makeBlock(2, IR_GOOD, 0.0f);
+  aBlock[2].Count = IR_BLOCK - 3;
+  count = imuRedundant_fuse(&aBlock[0], &aReadOk[0], &aAccel[0], &aGyro[0]);
+  HOST_CHECK(count == IR_BLOCK - 3, "short block: %u samples", count);
+  HOST_CHECK(imuRedundant_getStats()->Disagreements == 0, "%u disagreements",
+             imuRedundant_getStats()->Disagreements);
+
+  /*!< Biased: voted out, kept out while biased, back once it agrees */
+  fail("biased", 1, IR_BIASED, IMU_FAULT_DISAGREE);
+  checkHealthy("biased", 0x05);
+  for(uint16_t k = 0; k < 2*IMU_REDUNDANT_RECOVER_TICKS; k++)
+    tick(3, 1, IR_BIASED);
+  pUnit = imuRedundant_getUnit(1);
+  HOST_CHECK((pUnit->Healthy == 0) && (pUnit->LastFault == IMU_FAULT_DISAGREE),
+             "biased: recovered, fault %d", pUnit->LastFault);
+  recover("biased", 1);
+
+  fail("stuck", 2, IR_STUCK, IMU_FAULT_STUCK);
+  checkHealthy("stuck", 0x03);
+  recover("stuck", 2);
+
+  fail("no read", 0, IR_NO_READ, IMU_FAULT_READ);
+  checkHealthy("no read", 0x06);
+  recover("no read", 0);
+  checkHealthy("recovered", 0x07);
+
+  /*!< A single good tick clears the fault count */
+  tick(3, 1, IR_STUCK);
+  tick(3, 1, IR_STUCK);
+  tick(3, 1, IR_GOOD);
+  tick(3, 1, IR_STUCK);
+  HOST_CHECK(imuRedundant_getUnit(1)->FaultTicks == 1, "fault ticks %u",
+             imuRedundant_getUnit(1)->FaultTicks);
+  checkHealthy("intermittent", 0x07);
+}
+
+static void test_noMajority(void)
+{
+  uint32_t disagreements = 0;
+
+  /*!< Units 1 and 2 off in opposite directions: the median is unit 0, but
+   *   two outliers out of three are not a majority to trust */
+  imuRedundant_init(3);
+  for(uint8_t k = 0; k < 2*IMU_REDUNDANT_FAULT_TICKS; k++)
+  {
+    makeBlock(0, IR_GOOD, 0.0f);
+    makeBlock(1, IR_BIASED, IR_BIAS);
+    makeBlock(2, IR_BIASED, -IR_BIAS);
+    imuRedundant_fuse(&aBlock[0], &aReadOk[0], &aAccel[0], &aGyro[0]);
+  }
+  HOST_CHECK(imuRedundant_getStats()->Disagreements
+             == 2*IMU_REDUNDANT_FAULT_TICKS, "no majority: %u disagreements",
+             imuRedundant_getStats()->Disagreements);
+  checkHealthy("no majority", 0x07);
+
+  /*!< Two units: averaged, the disagreement only counted */
+  imuRedundant_init(2);
+  for(uint8_t k = 0; k < 2*IMU_REDUNDANT_FAULT_TICKS; k++)
+    tick(2, 1, IR_BIASED);
+  disagreements = imuRedundant_getStats()->Disagreements;
+  HOST_CHECK((disagreements == 2*IMU_REDUNDANT_FAULT_TICKS)
+             && (imuRedundant_getUnit(0)->Healthy == 1)
+             && (imuRedundant_getUnit(1)->Healthy == 1),
+             "two units: %u disagreements", disagreements);
+  HOST_CHECK(fabsf(aGyro[0] - 0.5f*IR_BIAS) <= IR_TOL, "two units: mean %g",
+             aGyro[0]);
+  tick(2, 1, IR_GOOD);
+  HOST_CHECK(imuRedundant_getStats()->Disagreements == disagreements,
+             "two units: agreeing tick counted");
+}
+
+static void test_noData(void)
+{
+  imuRedundant_init(3);
+  for(uint8_t u = 0; u < 3; u++)
+    makeBlock(u, IR_NO_READ, 0.0f);
+
+  HOST_CHECK(imuRedundant_fuse(&aBlock[0], &aReadOk[0], &aAccel[0], &aGyro[0])
+             == 0, "fused without a read");
+  HOST_CHECK((imuRedundant_getStats()->NoData == 1)
+             && (imuRedundant_getStats()->Used == 0), "NoData %u, used %u",
+             imuRedundant_getStats()->NoData, imuRedundant_getStats()->Used);
+  HOST_CHECK(imuRedundant_getUnit(3) == 0, "unit past count");
+}
+
+int main(void)
+{
+  test_vote();
+  test_noMajority();
+  test_noData();
+
+  HOST_REPORT("test_imu_redundant");
+}
+
+// EOF =========================================================================
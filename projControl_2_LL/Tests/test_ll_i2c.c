@@ -0,0 +1,317 @@
+/*******************************************************************************
+ * @file    test_ll_i2c.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   cnc_ll_i2c on register stubs: pin, clock and DMA map of I2C1..3,
+ *          the asynchronous state machine of one instance next to an idle
+ *          one, and the timeout abort.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - The peripheral (0x40000000) and system control (0xE000E000) address
+    ranges are mapped as plain memory: the driver and LL run unchanged.
+    Flags the hardware would set (SB, ADDR, BTF, DMA TC, SDA level) are
+    written by the test before calling the IRQ handler.
+  - SystemCoreClock 0: every DWT wait (STOP wait, recovery half periods)
+    ends at once, every async deadline is already past.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "cnc_ll_i2c.h"
+#include "host.h"
+#include "../Src/cnc_ll_i2c.c"
+#include <string.h>
+#include <sys/mman.h>
+
+// Register stubs ==============================================================
+#define REG_PERIPH_SIZE   0x00030000U     /*!< APB1, APB2 and AHB1 up to DMA2 */
+#define REG_SCS_SIZE      0x00001000U
+
+static uint8_t regs_map(void)
+{
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE;
+  void *pPeriph = mmap((void *) PERIPH_BASE, REG_PERIPH_SIZE,
+                       PROT_READ | PROT_WRITE, flags, -1, 0);
+  void *pScs = mmap((void *) SCS_BASE, REG_SCS_SIZE, PROT_READ | PROT_WRITE,
+                    flags, -1, 0);
+
+  return ((pPeriph == (void *) PERIPH_BASE) && (pScs == (void *) SCS_BASE))
+      ? 1 : 0;
+}
+
+/*!< Reset state, driver contexts included */
+static void regs_reset(void)
+{
+  memset((void *) PERIPH_BASE, 0, REG_PERIPH_SIZE);
+  memset((void *) SCS_BASE, 0, REG_SCS_SIZE);
+
+  for(uint8_t i = 0; i < I2C_INSTANCES; i++)
+    i2cHandle[i].Async.state = I2C_ASYNC_IDLE;
+}
+
+// =============================================================================
+/*!< Expected map, from the STM32F407 datasheet (AF4) and RM0090 DMA1 table */
+typedef struct
+{
+  I2C_TypeDef *I2Cx;
+  GPIO_TypeDef *SclPort;
+  uint32_t SclPin;
+  GPIO_TypeDef *SdaPort;
+  uint32_t SdaPin;
+  uint32_t ClockEnable;
+  uint32_t StreamRx;
+  uint32_t StreamTx;
+  uint32_t Channel;
+} i2c_map_t;
+
+static const i2c_map_t MAP[3] =
+{
+  { I2C1, GPIOB, 6, GPIOB, 7, RCC_APB1ENR_I2C1EN, 0, 6, 1 },
+  { I2C2, GPIOB, 10, GPIOB, 11, RCC_APB1ENR_I2C2EN, 3, 7, 7 },
+  { I2C3, GPIOA, 8, GPIOC, 9, RCC_APB1ENR_I2C3EN, 2, 4, 3 },
+};
+
+static GPIO_TypeDef *const PORTS[3] = { GPIOA, GPIOB, GPIOC };
+
+static DMA_Stream_TypeDef *stream(uint32_t index)
+{
+  return (DMA_Stream_TypeDef *) (DMA1_BASE + 0x10U + 0x18U*index);
+}
+
+/*!< Alternate function 4, open drain, pull-up */
+static uint8_t isI2CPin(GPIO_TypeDef *GPIOx, uint32_t pin)
+{
+  return ((((GPIOx->MODER >> (2*pin)) & 0x3) == 2)
+          && (((GPIOx->OTYPER >> pin) & 0x1) == 1)
+          && (((GPIOx->PUPDR >> (2*pin)) & 0x3) == 1)
+          && (((GPIOx->AFR[pin >> 3] >> (4*(pin & 0x7))) & 0xF) == 4)) ? 1 : 0;
+}
+
+static uint8_t lastStatus = 0xFF;
+static void *pLastContext = 0;
+static uint32_t lastPrimask = 0xFF;
+static uint8_t callbacks = 0;
+
+static void onDone(void *pContext, uint8_t status)
+{
+  lastStatus = status;
+  pLastContext = pContext;
+  lastPrimask = hostPrimask;
+  callbacks++;
+}
+
+static void test_pinMap(void)
+{
+  const i2c_map_t *pMap = 0;
+  uint32_t alternate = 0;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pMap = &MAP[i];
+    regs_reset();
+
+    HOST_CHECK(cncI2C_getHandle(pMap->I2Cx) == &i2cHandle[i], "I2C%u handle",
+               i + 1);
+    HOST_CHECK(cncI2C_Init(pMap->I2Cx, 400000) == 1, "I2C%u init", i + 1);
+
+    HOST_CHECK(isI2CPin(pMap->SclPort, pMap->SclPin), "I2C%u SCL", i + 1);
+    HOST_CHECK(isI2CPin(pMap->SdaPort, pMap->SdaPin), "I2C%u SDA", i + 1);
+    HOST_CHECK(RCC->APB1ENR == pMap->ClockEnable, "I2C%u APB1ENR 0x%08X",
+               i + 1, RCC->APB1ENR);
+    HOST_CHECK(LL_I2C_IsEnabled(pMap->I2Cx) == 1, "I2C%u not enabled", i + 1);
+
+    /*!< No other pin of ports A..C moved */
+    for(uint8_t port = 0; port < 3; port++)
+    {
+      alternate = 0;
+      for(uint32_t pin = 0; pin < 16; pin++)
+      {
+        if(((PORTS[port]->MODER >> (2*pin)) & 0x3) != 0)
+          alternate++;
+      }
+
+      HOST_CHECK(alternate == ((PORTS[port] == pMap->SclPort)
+                               + (PORTS[port] == pMap->SdaPort)),
+                 "I2C%u: %u pins of port %c configured", i + 1, alternate,
+                 'A' + port);
+    }
+
+    /*!< The other instances stay off */
+    for(uint8_t j = 0; j < 3; j++)
+    {
+      if(j != i)
+        HOST_CHECK(MAP[j].I2Cx->CR1 == 0, "I2C%u init wrote I2C%u", i + 1,
+                   j + 1);
+    }
+  }
+
+  HOST_CHECK(cncI2C_getHandle((I2C_TypeDef *) SPI1) == 0, "SPI1 handle");
+  HOST_CHECK(cncI2C_Init((I2C_TypeDef *) SPI1, 400000) == 0, "SPI1 init");
+}
+
+static void test_dmaMap(void)
+{
+  const i2c_map_t *pMap = 0;
+  DMA_Stream_TypeDef *pRx = 0, *pTx = 0;
+  uint32_t channel = 0;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pMap = &MAP[i];
+    regs_reset();
+    cncI2C_Init(pMap->I2Cx, 400000);
+    HOST_CHECK(cncI2C_InitDMA(pMap->I2Cx) == 1, "I2C%u DMA init", i + 1);
+
+    pRx = stream(pMap->StreamRx);
+    pTx = stream(pMap->StreamTx);
+    channel = pMap->Channel << DMA_SxCR_CHSEL_Pos;
+
+    HOST_CHECK((pRx->CR & DMA_SxCR_CHSEL) == channel, "I2C%u RX channel 0x%08X",
+               i + 1, pRx->CR);
+    HOST_CHECK((pTx->CR & DMA_SxCR_CHSEL) == channel, "I2C%u TX channel 0x%08X",
+               i + 1, pTx->CR);
+    HOST_CHECK((pRx->CR & DMA_SxCR_DIR) == 0, "I2C%u RX direction", i + 1);
+    HOST_CHECK((pTx->CR & DMA_SxCR_DIR) == DMA_SxCR_DIR_0, "I2C%u TX direction",
+               i + 1);
+    HOST_CHECK((pRx->PAR == (uint32_t) &pMap->I2Cx->DR)
+               && (pTx->PAR == (uint32_t) &pMap->I2Cx->DR), "I2C%u DR address",
+               i + 1);
+  }
+}
+
+/*!< 14 byte read on I2C2 event by event, I2C1 initialized and idle */
+static void test_state(void)
+{
+  cncI2C_handle_t *hI2C1 = cncI2C_getHandle(I2C1);
+  cncI2C_handle_t *hI2C2 = cncI2C_getHandle(I2C2);
+  DMA_Stream_TypeDef *pRx = stream(MAP[1].StreamRx);
+  uint8_t aDev[2] = { 0x69, 0x3B };
+  uint8_t aData[14];
+  uint32_t cr1 = 0;
+
+  regs_reset();
+  cncI2C_Init(I2C1, 400000);
+  cncI2C_InitDMA(I2C1);
+  cncI2C_Init(I2C2, 400000);
+  cncI2C_InitDMA(I2C2);
+  cr1 = I2C1->CR1;
+  callbacks = 0;
+
+  HOST_CHECK(cncI2C_ReadAsync(I2C2, &aDev[0], &aData[0], 14, &onDone, hI2C2)
+             == 1, "start");
+  HOST_CHECK(cncI2C_ReadAsync(I2C2, &aDev[0], &aData[0], 14, &onDone, hI2C2)
+             == 0, "second start on a busy instance");
+  HOST_CHECK((I2C2->CR1 & I2C_CR1_START) != 0, "no START");
+  HOST_CHECK((cncI2C_isBusyAsync(I2C2) == 1) && (cncI2C_isBusyAsync(I2C1) == 0),
+             "busy I2C1 %u I2C2 %u", cncI2C_isBusyAsync(I2C1),
+             cncI2C_isBusyAsync(I2C2));
+
+  I2C2->SR1 = I2C_SR1_SB;
+  I2C2_EV_IRQHandler();
+  HOST_CHECK((hI2C2->Async.state == I2C_ASYNC_ADDR_W) && (I2C2->DR == 0xD2),
+             "address write: state %u DR 0x%02X", hI2C2->Async.state, I2C2->DR);
+
+  I2C2->SR1 = I2C_SR1_ADDR;
+  I2C2_EV_IRQHandler();
+  HOST_CHECK((hI2C2->Async.state == I2C_ASYNC_REG) && (I2C2->DR == 0x3B),
+             "register: state %u DR 0x%02X", hI2C2->Async.state, I2C2->DR);
+
+  I2C2->SR1 = I2C_SR1_BTF;
+  I2C2_EV_IRQHandler();
+  HOST_CHECK(hI2C2->Async.state == I2C_ASYNC_START_R, "restart: state %u",
+             hI2C2->Async.state);
+
+  I2C2->SR1 = I2C_SR1_SB;
+  I2C2_EV_IRQHandler();
+  HOST_CHECK((hI2C2->Async.state == I2C_ASYNC_ADDR_R) && (I2C2->DR == 0xD3),
+             "address read: state %u DR 0x%02X", hI2C2->Async.state, I2C2->DR);
+
+  I2C2->SR1 = I2C_SR1_ADDR;
+  I2C2_EV_IRQHandler();
+  HOST_CHECK(hI2C2->Async.state == I2C_ASYNC_DATA_RX, "DMA: state %u",
+             hI2C2->Async.state);
+  HOST_CHECK(((pRx->CR & DMA_SxCR_EN) != 0) && (pRx->NDTR == 14)
+             && (pRx->M0AR == (uint32_t) &aData[0]), "RX stream not armed");
+  HOST_CHECK((I2C2->CR2 & (I2C_CR2_DMAEN | I2C_CR2_LAST))
+             == (I2C_CR2_DMAEN | I2C_CR2_LAST), "I2C2 CR2 0x%08X", I2C2->CR2);
+
+  DMA1->LISR = DMA_LISR_TCIF3;
+  DMA1_Stream3_IRQHandler();
+  HOST_CHECK((callbacks == 1) && (lastStatus == 1) && (pLastContext == hI2C2),
+             "callback %u status %u", callbacks, lastStatus);
+  HOST_CHECK(hI2C2->Async.state == I2C_ASYNC_IDLE, "end: state %u",
+             hI2C2->Async.state);
+  HOST_CHECK((I2C2->CR1 & I2C_CR1_STOP) != 0, "no STOP");
+
+  /*!< Nothing of the transfer on I2C1 */
+  HOST_CHECK((hI2C1->Async.state == I2C_ASYNC_IDLE) && (I2C1->CR1 == cr1)
+             && (I2C1->DR == 0),
+             "I2C1 touched: CR1 0x%08X DR 0x%02X", I2C1->CR1, I2C1->DR);
+  HOST_CHECK((stream(MAP[0].StreamRx)->CR & DMA_SxCR_EN) == 0,
+             "I2C1 stream enabled");
+}
+
+/*!< Past the deadline: aborted masked, recovered and ended unmasked */
+static void test_timeout(void)
+{
+  cncI2C_handle_t *hI2C1 = cncI2C_getHandle(I2C1);
+  uint8_t aDev[2] = { 0x68, 0x6B };
+  uint8_t data = 0x01;
+
+  regs_reset();
+  cncI2C_Init(I2C1, 400000);
+  cncI2C_InitDMA(I2C1);
+  callbacks = 0;
+  lastPrimask = 0xFF;
+
+  HOST_CHECK(cncI2C_WriteAsync(I2C1, &aDev[0], &data, 1, &onDone, hI2C1) == 1,
+             "start");
+  HOST_CHECK(cncI2C_checkTimeoutAsync(I2C1) == 0, "aborted within deadline");
+
+  /*!< SDA released by the slave */
+  GPIOB->IDR = (0x01U << MAP[0].SdaPin);
+  hostDwt.CYCCNT++;
+  HOST_CHECK(cncI2C_checkTimeoutAsync(I2C1) == 1, "not aborted");
+  HOST_CHECK((callbacks == 1) && (lastStatus == 0), "callback %u status %u",
+             callbacks, lastStatus);
+  HOST_CHECK(lastPrimask == 0, "recovery ended with interrupts masked");
+  HOST_CHECK(hostPrimask == 0, "PRIMASK left set");
+  HOST_CHECK((hI2C1->TimeoutCount == 1) && (hI2C1->RecoveryCount == 1),
+             "timeouts %u recoveries %u", hI2C1->TimeoutCount,
+             hI2C1->RecoveryCount);
+  HOST_CHECK(hI2C1->Async.state == I2C_ASYNC_IDLE, "state %u",
+             hI2C1->Async.state);
+  HOST_CHECK(isI2CPin(MAP[0].SclPort, MAP[0].SclPin)
+             && isI2CPin(MAP[0].SdaPort, MAP[0].SdaPin), "pins not restored");
+
+  /*!< Events pended before the abort are dropped */
+  hI2C1->Async.state = I2C_ASYNC_RECOVER;
+  I2C1->SR1 = I2C_SR1_BERR;
+  I2C1_ER_IRQHandler();
+  DMA1->HISR = DMA_HISR_TCIF6;
+  DMA1_Stream6_IRQHandler();
+  I2C1_EV_IRQHandler();
+  HOST_CHECK((callbacks == 1) && (hI2C1->Async.state == I2C_ASYNC_RECOVER),
+             "pended event ended the aborted transfer");
+  hI2C1->Async.state = I2C_ASYNC_IDLE;
+}
+
+int main(void)
+{
+  if(regs_map() != 1)
+  {
+    printf("  cannot map the register ranges\n");
+    return 1;
+  }
+
+  SystemCoreClock = 0;
+  test_pinMap();
+  test_dmaMap();
+  test_state();
+  test_timeout();
+
+  HOST_REPORT("test_ll_i2c");
+}
+
+// EOF =========================================================================
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * @file    test_mpu9250_parse.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   mpu9250_readRawData() / mpu9250_parseRawData(): the 14-byte burst
+ *          ACCEL_XOUT_H..GYRO_ZOUT_L to mpu9250_rawData_t, on the register
+ *          file of mpu9250_stub.h.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Big endian words, signed: 0x8000, 0xFFFF and 0x7FFF included.
+  - TEMP_OUT sits between the accel and the gyro words.
+  - One bus transaction per sample, on I2C and on SPI.
+  - A failed read returns MPU9250_ERROR.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "mpu9250.h"
+#include "host.h"
+#include "../Src/mpu9250.c"
+#include "mpu9250_stub.h"
+
+// =============================================================================
+/*!< ACCEL_XOUT_H..GYRO_ZOUT_L and the words they hold */
+static const uint8_t aBurst[14] = { 0x12, 0x34, 0xFF, 0xFE, 0x80, 0x00,
+                                    0x0A, 0x5C, 0x7F, 0xFF, 0xFF, 0xFF,
+                                    0xC0, 0x01 };
+static const int16_t aAccel[3] = { 0x1234, -2, -32768 };
+static const int16_t temperature = 0x0A5C;
+static const int16_t aGyro[3] = { 32767, -1, -16383 };
+
+static void checkSample(const char *pName, mpu9250_rawData_t *pRaw)
+{
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    HOST_CHECK(pRaw->Accel[i] == aAccel[i], "%s: accel %u = %d, expected %d",
+               pName, i, pRaw->Accel[i], aAccel[i]);
+    HOST_CHECK(pRaw->Gyro[i] == aGyro[i], "%s: gyro %u = %d, expected %d",
+               pName, i, pRaw->Gyro[i], aGyro[i]);
+  }
+
+  HOST_CHECK(pRaw->Temperature == temperature, "%s: temperature %d", pName,
+             pRaw->Temperature);
+}
+
+static void test_parse(void)
+{
+  uint8_t aBytes[14];
+  mpu9250_rawData_t raw;
+
+  memcpy(&aBytes[0], &aBurst[0], sizeof(aBytes));
+  mpu9250_parseRawData(&aBytes[0], &raw);
+  checkSample("parse", &raw);
+}
+
+static void test_read(mpu9250_Interface_t interface)
+{
+  mpu9250_handle_t *pDevice = mpu9250_getHandle(interface);
+  mpu9250_InitStruct_t init = { 0 };
+  mpu9250_rawData_t raw;
+  const char *pName = (interface == MPU9250_INTERFACE_I2C) ? "I2C" : "SPI";
+
+  stubImu_init(I2C1, 0x68);
+  init.Interface = interface;
+  HOST_CHECK(mpu9250_init(pDevice, &init) == MPU9250_OK, "%s: init", pName);
+
+  memcpy(&stubImu.Regs[0x3B], &aBurst[0], sizeof(aBurst));
+  stubImu.Reads = 0;
+  memset(&raw, 0, sizeof(raw));
+
+  HOST_CHECK(mpu9250_readRawData(pDevice, &raw) == MPU9250_OK,
+             "%s: readRawData", pName);
+  HOST_CHECK(stubImu.Reads == 1, "%s: %u transactions", pName, stubImu.Reads);
+  checkSample(pName, &raw);
+
+  /*!< Device gone */
+  if(interface == MPU9250_INTERFACE_I2C)
+  {
+    stubImu.Address = 0x69;
+    HOST_CHECK(mpu9250_readRawData(pDevice, &raw) == MPU9250_ERROR,
+               "I2C: read without acknowledge");
+  }
+}
+
+int main(void)
+{
+  test_parse();
+  test_read(MPU9250_INTERFACE_I2C);
+  test_read(MPU9250_INTERFACE_SPI);
+
+  HOST_REPORT("test_mpu9250_parse");
+}
+
+// EOF =========================================================================
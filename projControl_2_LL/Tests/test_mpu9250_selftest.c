@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * @file    test_mpu9250_selftest.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   mpu9250_checkSelfTest() pass/fail criteria on synthetic
+ *          self-test data.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Nominal: every axis answers 5 % above its factory response
+    2620*1.01^(code - 1).
+  - Zero trim codes: absolute limits, either sign for the gyro.
+  - Dead gyro axis, accel ratio out of (0.5, 1.5), gyro offset past
+    MPU9250_SELFTEST_GYRO_OFFSET_LSB: only that axis fails.
+  - mpu9250_stub.h only provides the bus calls to link mpu9250.c:
+    mpu9250_checkSelfTest() does not touch the bus.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "mpu9250.h"
+#include "host.h"
+#include "../Src/mpu9250.c"
+#include "mpu9250_stub.h"
+
+// =============================================================================
+#define ST_DEVIATION_TOL  0.1             /*!< % */
+
+static const uint8_t aGyroTrim[3] = { 100, 110, 90 };
+static const uint8_t aAccelTrim[3] = { 120, 115, 125 };
+static const int16_t aGyroOff[3] = { 30, -40, 10 };
+static const int16_t aAccelOff[3] = { 100, -200, 16384 };
+
+/*!< Ratio times the factory response of a trim code [LSB] */
+static int16_t response(uint8_t code, double ratio)
+{
+  return (int16_t)lround(ratio*2620.0*pow(1.01, code - 1));
+}
+
+/*!< Self-test response ratio times the factory response on every axis */
+static void makeData(mpu9250_selfTest_t *pResult, double ratio)
+{
+  mpu9250_selfTestData_t *pData = &pResult->Data;
+
+  memset(pResult, 0, sizeof(*pResult));
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pData->GyroTrim[i] = aGyroTrim[i];
+    pData->AccelTrim[i] = aAccelTrim[i];
+    pData->GyroOff[i] = aGyroOff[i];
+    pData->AccelOff[i] = aAccelOff[i];
+    pData->GyroOn[i] = aGyroOff[i] + response(aGyroTrim[i], ratio);
+    pData->AccelOn[i] = aAccelOff[i] + response(aAccelTrim[i], ratio);
+  }
+}
+
+/*!< Pass flags as bits: gyro X/Y/Z in 0..2, accel X/Y/Z in 4..6 */
+static uint8_t passMask(mpu9250_selfTest_t *pResult)
+{
+  uint8_t mask = 0;
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    mask |= (pResult->GyroPass[i] != 0) << i;
+    mask |= (pResult->AccelPass[i] != 0) << (i + 4);
+  }
+
+  return mask;
+}
+
+static void test_nominal(void)
+{
+  mpu9250_selfTest_t result;
+
+  makeData(&result, 1.05);
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_OK, "nominal failed");
+  HOST_CHECK(passMask(&result) == 0x77, "nominal: pass 0x%02X",
+             passMask(&result));
+
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    HOST_CHECK(fabs(result.GyroDeviation[i] - 5.0) <= ST_DEVIATION_TOL,
+               "gyro %u deviation %.3f %%", i, result.GyroDeviation[i]);
+    HOST_CHECK(fabs(result.AccelDeviation[i] - 5.0) <= ST_DEVIATION_TOL,
+               "accel %u deviation %.3f %%", i, result.AccelDeviation[i]);
+  }
+}
+
+static void test_zeroTrim(void)
+{
+  mpu9250_selfTest_t result;
+  mpu9250_selfTestData_t *pData = &result.Data;
+  /*!< Gyro limit 7860 LSB either sign, accel 3686..11059 LSB */
+  const int16_t aGyroResponse[3] = { 7860, -8000, 20000 };
+  const int16_t aAccelResponse[3] = { 3686, -5000, 11059 };
+
+  makeData(&result, 1.0);
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    pData->GyroTrim[i] = 0;
+    pData->AccelTrim[i] = 0;
+    pData->GyroOn[i] = pData->GyroOff[i] + aGyroResponse[i];
+    pData->AccelOn[i] = pData->AccelOff[i] + aAccelResponse[i];
+  }
+
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_OK, "no trim failed");
+  HOST_CHECK(passMask(&result) == 0x77, "no trim: pass 0x%02X",
+             passMask(&result));
+  for(uint8_t i = 0; i < 3; i++)
+    HOST_CHECK((result.GyroDeviation[i] == 0.0f)
+               && (result.AccelDeviation[i] == 0.0f),
+               "no trim %u: deviation %g %g", i, result.GyroDeviation[i],
+               result.AccelDeviation[i]);
+
+  /*!< One LSB past each limit */
+  pData->GyroOn[0] = pData->GyroOff[0] + 7859;
+  pData->GyroOn[1] = pData->GyroOff[1] - 7859;
+  pData->AccelOn[0] = pData->AccelOff[0] + 3685;
+  pData->AccelOn[2] = pData->AccelOff[2] + 11060;
+
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_ERROR,
+             "no trim: limits passed");
+  HOST_CHECK(passMask(&result) == 0x24, "no trim limits: pass 0x%02X",
+             passMask(&result));
+}
+
+static void test_deadGyro(void)
+{
+  mpu9250_selfTest_t result;
+
+  makeData(&result, 1.0);
+  result.Data.GyroOn[1] = result.Data.GyroOff[1];
+
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_ERROR,
+             "dead gyro passed");
+  HOST_CHECK(passMask(&result) == 0x75, "dead gyro: pass 0x%02X",
+             passMask(&result));
+  HOST_CHECK(fabs(result.GyroDeviation[1] + 100.0) <= ST_DEVIATION_TOL,
+             "dead gyro deviation %.3f %%", result.GyroDeviation[1]);
+}
+
+static void test_accelRatio(void)
+{
+  mpu9250_selfTest_t result;
+  mpu9250_selfTestData_t *pData = &result.Data;
+
+  makeData(&result, 1.0);
+  pData->AccelOn[0] = pData->AccelOff[0] + response(aAccelTrim[0], 1.6);
+  pData->AccelOn[2] = pData->AccelOff[2] + response(aAccelTrim[2], 0.4);
+
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_ERROR,
+             "accel ratio passed");
+  HOST_CHECK(passMask(&result) == 0x27, "accel ratio: pass 0x%02X",
+             passMask(&result));
+
+  /*!< Inside the band near both ends */
+  pData->AccelOn[0] = pData->AccelOff[0] + response(aAccelTrim[0], 1.45);
+  pData->AccelOn[2] = pData->AccelOff[2] + response(aAccelTrim[2], 0.55);
+
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_OK,
+             "accel ratio 1.45 / 0.55 failed, pass 0x%02X", passMask(&result));
+}
+
+static void test_gyroOffset(void)
+{
+  mpu9250_selfTest_t result;
+  mpu9250_selfTestData_t *pData = &result.Data;
+
+  /*!< Response still nominal: only the offset is wrong */
+  makeData(&result, 1.0);
+  pData->GyroOff[0] = 2620;
+  pData->GyroOn[0] = 2620 + response(aGyroTrim[0], 1.0);
+  pData->GyroOff[2] = 2621;
+  pData->GyroOn[2] = 2621 + response(aGyroTrim[2], 1.0);
+
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_ERROR,
+             "gyro offset passed");
+  HOST_CHECK(passMask(&result) == 0x73, "gyro offset: pass 0x%02X",
+             passMask(&result));
+
+  pData->GyroOff[2] = -2621;
+  pData->GyroOn[2] = -2621 + response(aGyroTrim[2], 1.0);
+
+  HOST_CHECK(mpu9250_checkSelfTest(&result) == MPU9250_ERROR,
+             "negative gyro offset passed");
+  HOST_CHECK(passMask(&result) == 0x73, "negative gyro offset: pass 0x%02X",
+             passMask(&result));
+}
+
+int main(void)
+{
+  test_nominal();
+  test_zeroTrim();
+  test_deadGyro();
+  test_accelRatio();
+  test_gyroOffset();
+
+  HOST_REPORT("test_mpu9250_selftest");
+}
+
+// EOF =========================================================================
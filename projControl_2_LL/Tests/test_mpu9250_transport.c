@@ -0,0 +1,227 @@
+/*******************************************************************************
+ * @file    test_mpu9250_transport.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   mpu9250.c over the I2C and the SPI transport: the same register
+ *          file (mpu9250_stub.h) must end up with the same configuration and
+ *          give the same samples through either bus.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Each run starts from a register file full of stale values, then:
+    init, a staged setting written by flush, readRawData (blocking and
+    async), initFifo and readFifo (blocking and async, with an overflow).
+  - I2C runs on I2C2 at the alternate address (0x69, probed): only the bus
+    of the handle may be used. No SPI call during the I2C run and no I2C
+    call during the SPI run.
+  - SPI only: I2C_IF_DIS set, data registers read at 10.5 MHz, every
+    write at 656 kHz.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "mpu9250.h"
+#include "host.h"
+#include "../Src/mpu9250.c"
+#include "mpu9250_stub.h"
+
+// =============================================================================
+#define TT_FRAMES         5
+#define TT_FULL_FRAMES    40              /*!< 36 fit in the FIFO */
+
+typedef struct
+{
+  uint8_t Regs[STUB_REGS];                /*!< After init + flush */
+  mpu9250_rawData_t Raw;
+  mpu9250_rawData_t RawAsync;
+  mpu9250_fifoBlock_t Block;
+  mpu9250_fifoBlock_t BlockAsync;
+  mpu9250_fifoBlock_t Full;
+  uint16_t FifoLeft;                      /*!< After the overflow drain */
+} transport_run_t;
+
+static mpu9250_handle_t aDevice[2];
+static uint32_t asyncDone = 0;
+
+/*!< Frame k: distinct bytes, negative values included */
+static void makeFrame(uint8_t k, uint8_t *pFrame)
+{
+  for(uint8_t i = 0; i < STUB_FRAME; i++)
+    pFrame[i] = (uint8_t)(0x80 + 17*k + 3*i);
+}
+
+static void readDone(mpu9250_handle_t *pDevice, mpu9250_status_t status)
+{
+  if(status == MPU9250_OK)
+    asyncDone++;
+}
+
+static void run(mpu9250_Interface_t interface, transport_run_t *pRun)
+{
+  mpu9250_handle_t *pDevice = &aDevice[interface];
+  mpu9250_InitStruct_t init = { 0 };
+  uint8_t aFrame[STUB_FRAME];
+  const char *pName = (interface == MPU9250_INTERFACE_I2C) ? "I2C" : "SPI";
+
+  stubImu_init(I2C2, 0x69);
+  memset(&stubImu.Regs[0], 0xA5, STUB_REGS);
+  stubImu.Regs[STUB_WHO_AM_I] = 0x71;
+
+  init.Interface = interface;
+  init.Gyro_Scale = MPU9250_GYRO_FULLSCALE_500DPS;
+  init.Gyro_LPF = MPU9250_GYRO_LPF_41HZ;
+  init.Accel_Scale = MPU9250_ACCEL_FULLSCALE_4G;
+  init.Accel_LPF = MPU9250_ACCEL_LPF_44_8HZ;
+  init.I2Cx = I2C2;
+
+  HOST_CHECK(mpu9250_init(pDevice, &init) == MPU9250_OK, "%s: init", pName);
+  HOST_CHECK(pDevice->Ready == 1, "%s: not ready", pName);
+  HOST_CHECK((pDevice->GyroResolution == 65.5f)
+             && (pDevice->AccelResolution == 8192),
+             "%s: resolution %g %u", pName, pDevice->GyroResolution,
+             pDevice->AccelResolution);
+  HOST_CHECK(stubImu.Regs[0x38] == 0x01, "%s: INT_ENABLE 0x%02X", pName,
+             stubImu.Regs[0x38]);
+  if(interface == MPU9250_INTERFACE_I2C)
+    HOST_CHECK(pDevice->Address == 0x69, "I2C: address 0x%02X",
+               pDevice->Address);
+
+  /*!< Staged: nothing on the bus until flush, then one burst */
+  mpu9250_setGyroScale(pDevice, MPU9250_GYRO_FULLSCALE_2000DPS);
+  HOST_CHECK((stubImu.Regs[0x1B] & 0x18) == 0x08, "%s: written before flush",
+             pName);
+  stubImu.Writes = 0;
+  HOST_CHECK(mpu9250_flush(pDevice) == MPU9250_OK, "%s: flush", pName);
+  HOST_CHECK(((stubImu.Regs[0x1B] & 0x18) == 0x18) && (stubImu.Writes == 1),
+             "%s: GYRO_CONFIG 0x%02X, %u writes", pName, stubImu.Regs[0x1B],
+             stubImu.Writes);
+  HOST_CHECK(pDevice->GyroResolution == 16.4f, "%s: resolution %g", pName,
+             pDevice->GyroResolution);
+  memcpy(&pRun->Regs[0], &stubImu.Regs[0], STUB_REGS);
+
+  /*!< Sensor registers */
+  makeFrame(0, &aFrame[0]);
+  memcpy(&stubImu.Regs[0x3B], &aFrame[0], STUB_FRAME);
+  HOST_CHECK(mpu9250_readRawData(pDevice, &pRun->Raw) == MPU9250_OK,
+             "%s: readRawData", pName);
+  asyncDone = 0;
+  HOST_CHECK((mpu9250_readRawData_async(pDevice, &pRun->RawAsync, &readDone)
+              == MPU9250_OK) && (asyncDone == 1), "%s: readRawData_async",
+             pName);
+  if(interface == MPU9250_INTERFACE_SPI)
+    HOST_CHECK(stubImu.ReadPrescaler == SPI_PRESCALER_8,
+               "SPI: data read prescaler %u", stubImu.ReadPrescaler);
+
+  /*!< FIFO */
+  HOST_CHECK(mpu9250_initFifo(pDevice, 1000) == MPU9250_OK, "%s: initFifo",
+             pName);
+  for(uint8_t k = 0; k < TT_FRAMES; k++)
+  {
+    makeFrame(k + 1, &aFrame[0]);
+    stubImu_push(&aFrame[0]);
+  }
+  HOST_CHECK(mpu9250_readFifo(pDevice, &pRun->Block) == MPU9250_OK,
+             "%s: readFifo", pName);
+
+  for(uint8_t k = 0; k < TT_FRAMES; k++)
+  {
+    makeFrame(k + 1, &aFrame[0]);
+    stubImu_push(&aFrame[0]);
+  }
+  asyncDone = 0;
+  HOST_CHECK((mpu9250_readFifo_async(pDevice, &pRun->BlockAsync, &readDone)
+              == MPU9250_OK) && (asyncDone == 1), "%s: readFifo_async", pName);
+
+  for(uint8_t k = 0; k < TT_FULL_FRAMES; k++)
+  {
+    makeFrame(k, &aFrame[0]);
+    stubImu_push(&aFrame[0]);
+  }
+  HOST_CHECK(mpu9250_readFifo(pDevice, &pRun->Full) == MPU9250_OK,
+             "%s: readFifo full", pName);
+  pRun->FifoLeft = stubImu.FifoCount;
+
+  if(interface == MPU9250_INTERFACE_I2C)
+    HOST_CHECK(stubImu.SpiTransfers == 0, "I2C: %u SPI transfers",
+               stubImu.SpiTransfers);
+  else
+  {
+    HOST_CHECK(stubImu.I2cTransfers == 0, "SPI: %u I2C transfers",
+               stubImu.I2cTransfers);
+    HOST_CHECK(stubImu.FastWrites == 0, "SPI: %u writes above 1 MHz",
+               stubImu.FastWrites);
+  }
+}
+
+static void test_frames(const char *pName, mpu9250_fifoBlock_t *pBlock,
+                        uint8_t first)
+{
+  mpu9250_rawData_t expected;
+  uint8_t aFrame[STUB_FRAME];
+
+  for(uint8_t k = 0; k < pBlock->Count; k++)
+  {
+    makeFrame(first + k, &aFrame[0]);
+    mpu9250_parseRawData(&aFrame[0], &expected);
+    HOST_CHECK(memcmp(&pBlock->Samples[k], &expected, sizeof(expected)) == 0,
+               "%s: frame %u", pName, k);
+  }
+}
+
+int main(void)
+{
+  transport_run_t aRun[2];
+  mpu9250_rawData_t expected;
+  uint8_t aFrame[STUB_FRAME];
+  uint8_t reg = 0;
+
+  memset(&aRun[0], 0, sizeof(aRun));
+  run(MPU9250_INTERFACE_I2C, &aRun[0]);
+  run(MPU9250_INTERFACE_SPI, &aRun[1]);
+
+  /*!< Same configuration: I2C_IF_DIS is the only difference */
+  HOST_CHECK((aRun[0].Regs[0x6A] & 0x10) == 0, "I2C: I2C_IF_DIS set");
+  HOST_CHECK((aRun[1].Regs[0x6A] & 0x10) != 0, "SPI: I2C_IF_DIS clear");
+  aRun[1].Regs[0x6A] &= ~0x10;
+  while((reg < (STUB_REGS - 1)) && (aRun[0].Regs[reg] == aRun[1].Regs[reg]))
+    reg++;
+  HOST_CHECK(aRun[0].Regs[reg] == aRun[1].Regs[reg],
+             "register 0x%02X: I2C 0x%02X, SPI 0x%02X", reg, aRun[0].Regs[reg],
+             aRun[1].Regs[reg]);
+
+  /*!< Same samples, and the expected ones */
+  makeFrame(0, &aFrame[0]);
+  mpu9250_parseRawData(&aFrame[0], &expected);
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    HOST_CHECK(memcmp(&aRun[i].Raw, &expected, sizeof(expected)) == 0,
+               "run %u: readRawData", i);
+    HOST_CHECK(memcmp(&aRun[i].RawAsync, &expected, sizeof(expected)) == 0,
+               "run %u: readRawData_async", i);
+
+    HOST_CHECK((aRun[i].Block.Count == TT_FRAMES)
+               && (aRun[i].Block.Overflow == 0), "run %u: block %u/%u", i,
+               aRun[i].Block.Count, aRun[i].Block.Overflow);
+    test_frames("block", &aRun[i].Block, 1);
+
+    HOST_CHECK((aRun[i].BlockAsync.Count == TT_FRAMES)
+               && (aRun[i].BlockAsync.Overflow == 0),
+               "run %u: async block %u/%u", i, aRun[i].BlockAsync.Count,
+               aRun[i].BlockAsync.Overflow);
+    test_frames("async block", &aRun[i].BlockAsync, 1);
+
+    /*!< Full FIFO: one block drained, the rest dropped by the reset */
+    HOST_CHECK((aRun[i].Full.Count == MPU9250_FIFO_BLOCK_SIZE)
+               && (aRun[i].Full.Overflow == 1) && (aRun[i].FifoLeft == 0),
+               "run %u: full %u/%u, %u bytes left", i, aRun[i].Full.Count,
+               aRun[i].Full.Overflow, aRun[i].FifoLeft);
+    test_frames("full", &aRun[i].Full, 0);
+  }
+
+  HOST_CHECK(memcmp(&aRun[0].Full, &aRun[1].Full, sizeof(aRun[0].Full)) == 0,
+             "full blocks differ");
+
+  HOST_REPORT("test_mpu9250_transport");
+}
+
+// EOF =========================================================================
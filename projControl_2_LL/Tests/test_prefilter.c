@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * @file    test_prefilter.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   prefilter_setSection() coefficients: low-pass -3 dB at Frequency,
+ *          notch depth at its centre, and the section state on a change.
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - Responses are evaluated in double from the coefficients the bank runs
+    (aCoeffs, CMSIS sign convention) at the sample rate of the tick.
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "prefilter.h"
+#include "host.h"
+#include "../Src/prefilter.c"
+
+// =============================================================================
+#define PF_RATE           1000.0f         /*!< IMU_FIFO_FREQ */
+#define PF_CORNER_TOL     0.05            /*!< dB around -3.01 */
+#define PF_PASS_TOL       0.01            /*!< dB */
+#define PF_NOTCH_DEPTH    -60.0           /*!< dB at the centre */
+
+/*!< |H| [dB] of one section at f [Hz] */
+static double gainDb(prefilter_sensor_t sensor, uint8_t index, double f)
+{
+  const float32_t *pC = &aCoeffs[sensor][5*index];
+  double w = 2.0*M_PI*f/PF_RATE;
+  double numRe = pC[0] + pC[1]*cos(w) + pC[2]*cos(2.0*w);
+  double numIm = -pC[1]*sin(w) - pC[2]*sin(2.0*w);
+  double denRe = 1.0 - pC[3]*cos(w) - pC[4]*cos(2.0*w);
+  double denIm = pC[3]*sin(w) + pC[4]*sin(2.0*w);
+
+  return 10.0*log10((numRe*numRe + numIm*numIm)/(denRe*denRe + denIm*denIm));
+}
+
+static void test_lowpass(void)
+{
+  const float32_t aFrequency[5] = { 2.0f, 20.0f, 80.0f, 250.0f, 450.0f };
+  prefilter_section_t section = { PREFILTER_LOWPASS, 0.0f, 0.7071068f };
+  double gain = 0.0;
+
+  for(uint8_t i = 0; i < 5; i++)
+  {
+    section.Frequency = aFrequency[i];
+    HOST_CHECK(prefilter_setSection(PREFILTER_ACCEL, 0, &section) == 1,
+               "low-pass %.0f Hz rejected", aFrequency[i]);
+
+    gain = gainDb(PREFILTER_ACCEL, 0, aFrequency[i]);
+    HOST_CHECK(fabs(gain + 3.0103) <= PF_CORNER_TOL,
+               "low-pass %.0f Hz: %.3f dB at the corner", aFrequency[i], gain);
+
+    gain = gainDb(PREFILTER_ACCEL, 0, 0.0);
+    HOST_CHECK(fabs(gain) <= PF_PASS_TOL, "low-pass %.0f Hz: %.3f dB at DC",
+               aFrequency[i], gain);
+  }
+}
+
+static void test_notch(void)
+{
+  const float32_t aFrequency[4] = { 15.0f, 50.0f, 120.0f, 380.0f };
+  const float32_t aQ[3] = { 1.0f, 4.0f, 10.0f };
+  prefilter_section_t section = { PREFILTER_NOTCH, 0.0f, 0.0f };
+  double gain = 0.0;
+
+  for(uint8_t i = 0; i < 4; i++)
+  {
+    for(uint8_t j = 0; j < 3; j++)
+    {
+      section.Frequency = aFrequency[i];
+      section.Q = aQ[j];
+      HOST_CHECK(prefilter_setSection(PREFILTER_GYRO, 1, &section) == 1,
+                 "notch %.0f Hz rejected", aFrequency[i]);
+
+      gain = gainDb(PREFILTER_GYRO, 1, aFrequency[i]);
+      HOST_CHECK(gain <= PF_NOTCH_DEPTH, "notch %.0f Hz Q %.0f: %.1f dB deep",
+                 aFrequency[i], aQ[j], gain);
+
+      gain = gainDb(PREFILTER_GYRO, 1, 0.0);
+      HOST_CHECK(fabs(gain) <= PF_PASS_TOL, "notch %.0f Hz Q %.0f: %.3f dB at DC",
+                 aFrequency[i], aQ[j], gain);
+    }
+  }
+}
+
+static void test_state(void)
+{
+  prefilter_section_t lowpass = { PREFILTER_LOWPASS, 20.0f, 0.7071068f };
+  prefilter_section_t none = { PREFILTER_NONE, 0.0f, 0.0f };
+  float32_t aAccel[3*MPU9250_FIFO_BLOCK_SIZE], aGyro[3*MPU9250_FIFO_BLOCK_SIZE];
+  float32_t d1 = 0.0f;
+
+  prefilter_init(PF_RATE);
+
+  for(uint8_t i = 0; i < 3*MPU9250_FIFO_BLOCK_SIZE; i++)
+  {
+    aAccel[i] = 1.0f;
+    aGyro[i] = 100.0f;
+  }
+
+  /*!< Section 1 runs, then is left behind as the trailing section */
+  prefilter_setSection(PREFILTER_GYRO, 0, &lowpass);
+  prefilter_setSection(PREFILTER_GYRO, 1, &lowpass);
+  prefilter_processBlock(&aAccel[0], &aGyro[0], MPU9250_FIFO_BLOCK_SIZE);
+  d1 = aState[0][2];
+  HOST_CHECK(d1 != 0.0f, "section 1 did not run");
+
+  /*!< Retune: state kept */
+  lowpass.Frequency = 25.0f;
+  prefilter_setSection(PREFILTER_GYRO, 1, &lowpass);
+  HOST_CHECK(aState[0][2] == d1, "retune cleared the state");
+
+  /*!< Off, not run, then on again: from rest */
+  prefilter_setSection(PREFILTER_GYRO, 1, &none);
+  HOST_CHECK(stats.Sections[PREFILTER_GYRO] == 1, "trailing section still run");
+  prefilter_processBlock(&aAccel[0], &aGyro[0], MPU9250_FIFO_BLOCK_SIZE);
+  HOST_CHECK(aState[0][2] == d1, "section off but run");
+
+  prefilter_setSection(PREFILTER_GYRO, 1, &lowpass);
+  for(uint8_t axis = 0; axis < 3; axis++)
+    HOST_CHECK((aState[axis][2] == 0.0f) && (aState[axis][3] == 0.0f),
+               "axis %u: stale state %g %g", axis, aState[axis][2], aState[axis][3]);
+
+  /*!< Other sections untouched */
+  HOST_CHECK(aState[0][0] != 0.0f, "section 0 cleared");
+}
+
+int main(void)
+{
+  HOST_CHECK(prefilter_init(PF_RATE) == 1, "init");
+
+  test_lowpass();
+  test_notch();
+  test_state();
+
+  HOST_REPORT("test_prefilter");
+}
+
+// EOF =========================================================================
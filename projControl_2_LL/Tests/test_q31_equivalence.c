@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * @file    test_q31_equivalence.c
+ * @author  Contrera Carlos - carlos.n.contrera@gmail.com
+ * @brief   PIPELINE_Q31 against the float pipeline: the same raw FIFO blocks
+ *          through estimator_updateBlock() + controlador_planta() and
+ *          estimatorQ31_updateBlock() + controlador_planta_q31().
+ * -----------------------------------------------------------------------------
+  @verbatim
+  ==============================================================================
+  - EQ_TICKS blocks of EQ_BLOCK samples at 1 kHz: roll +/-60 deg, pitch
+    +/-40 deg, gyro rates consistent with them, +/-20 LSB accel and
+    +/-10 LSB gyro noise (fixed seed). Every 7th block arrives 3 ms late.
+  - FILTER_COMPLEMENTARY, Weight 0.9, libm atan2 on the float side.
+  - Largest difference: EQ_ANGLE_TOL on the angles, EQ_CONTROL_TOL on the
+    controller output (plant 0, fed with the pitch).
+  ==============================================================================
+  @endverbatim
+ * -----------------------------------------------------------------------------
+ * @attention
+ ******************************************************************************/
+#include "estimador_q31.h"
+#include "host.h"
+#include "../Src/estimador.c"
+
+// =============================================================================
+#define EQ_TICKS          20000
+#define EQ_BLOCK          10
+#define EQ_ACCEL_LSB      16384.0         /*!< +/-2 g */
+#define EQ_GYRO_LSB       131.0           /*!< +/-250 dps */
+#define EQ_ANGLE_TOL      0.003           /*!< deg */
+#define EQ_CONTROL_TOL    0.0015          /*!< deg */
+
+static mpu9250_handle_t hostImu;
+static uint32_t seed = 12345;
+
+mpu9250_handle_t *mpu9250_getHandle(uint8_t index)
+{
+  return &hostImu;
+}
+
+uint8_t mpu9250_readID(mpu9250_handle_t *pDevice)
+{
+  return MPU9250_DEVICE_ID;
+}
+
+mpu9250_status_t mpu9250_readData_float(mpu9250_handle_t *pDevice,
+                                        float32_t *pAccel, float32_t *pGyro)
+{
+  return MPU9250_OK;
+}
+
+/*!< Uniform in [-range, range] */
+static int32_t noise(int32_t range)
+{
+  seed = seed*1103515245U + 12345U;
+
+  return (int32_t)((seed >> 16) % (uint32_t)(2*range + 1)) - range;
+}
+
+/*!< Raw block and its float scaling, as mpu9250_convertBlock_float() */
+static void makeBlock(double t, mpu9250_fifoBlock_t *pBlock, float32_t *pAccel,
+                      float32_t *pGyro)
+{
+  double roll = 60.0*sin(0.3*t)*M_PI/180.0;
+  double pitch = 40.0*sin(0.17*t + 1.0)*M_PI/180.0;
+  double accel[3] = { -sin(pitch), sin(roll)*cos(pitch), cos(roll)*cos(pitch) };
+  double gyro[3] = { 60.0*0.3*cos(0.3*t), 40.0*0.17*cos(0.17*t + 1.0), 0.0 };
+
+  pBlock->Count = EQ_BLOCK;
+  pBlock->Overflow = 0;
+
+  for(uint8_t i = 0; i < EQ_BLOCK; i++)
+  {
+    for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      pBlock->Samples[i].Accel[axis] = (int16_t)(accel[axis]*EQ_ACCEL_LSB
+                                                 + noise(20));
+      pBlock->Samples[i].Gyro[axis] = (int16_t)(gyro[axis]*EQ_GYRO_LSB
+                                                + noise(10));
+      pAccel[3*i + axis] = pBlock->Samples[i].Accel[axis]/(float32_t)EQ_ACCEL_LSB;
+      pGyro[3*i + axis] = pBlock->Samples[i].Gyro[axis]/(float32_t)EQ_GYRO_LSB;
+    }
+  }
+}
+
+int main(void)
+{
+  filter_init_t settings = { 0 };
+  estimator_t *pEstimator = estimator_getHandle(0);
+  mpu9250_fifoBlock_t block;
+  float32_t aAccel[3*EQ_BLOCK], aGyro[3*EQ_BLOCK], aAngles[3];
+  q31_t aAnglesQ31[3];
+  float32_t output = 0.0f;
+  q31_t outputQ31 = 0;
+  double angleError[3] = { 0.0 }, controlError = 0.0, error = 0.0;
+  uint64_t timestamp = 0;
+
+  hostImu.GyroResolution = (float32_t)EQ_GYRO_LSB;
+  settings.SampleRate = 100;
+  settings.Weight = 0.9f;
+  settings.Type = FILTER_COMPLEMENTARY;
+  settings.Accuracy = FAST_MATH_LIBM;
+
+  HOST_CHECK(estimator_init(pEstimator, &settings) == FILTER_OK, "float init");
+  HOST_CHECK(estimatorQ31_init(&settings) == FILTER_OK, "Q31 init");
+
+  for(uint32_t k = 0; k < EQ_TICKS; k++)
+  {
+    makeBlock(k*0.01, &block, &aAccel[0], &aGyro[0]);
+    timestamp = (uint64_t)(k + 1)*10000 + (((k % 7) == 0) ? 3000 : 0);
+
+    estimator_updateBlock(pEstimator, &aAccel[0], &aGyro[0], EQ_BLOCK,
+                          timestamp, &aAngles[0]);
+    estimatorQ31_updateBlock(&block, timestamp, &aAnglesQ31[0]);
+
+    output = controlador_planta(aAngles[0], 0);
+    outputQ31 = controlador_planta_q31(aAnglesQ31[0], 0);
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+      error = fabs(aAngles[i] - ESTIMATOR_Q31_TO_DEG(aAnglesQ31[i]));
+      if(error > angleError[i])
+        angleError[i] = error;
+    }
+
+    error = fabs(output - ESTIMATOR_Q31_TO_DEG(outputQ31));
+    if(error > controlError)
+      controlError = error;
+  }
+
+  printf("  max difference [deg]: pitch %.5f roll %.5f tilt %.5f control %.5f\n",
+         angleError[0], angleError[1], angleError[2], controlError);
+
+  for(uint8_t i = 0; i < 3; i++)
+    HOST_CHECK(angleError[i] <= EQ_ANGLE_TOL, "angle %u: %.5f deg", i,
+               angleError[i]);
+
+  HOST_CHECK(controlError <= EQ_CONTROL_TOL, "control: %.5f deg", controlError);
+
+  HOST_REPORT("test_q31_equivalence");
+}
+
+// EOF =========================================================================